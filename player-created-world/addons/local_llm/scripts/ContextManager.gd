@@ -12,6 +12,11 @@ const CHARS_PER_TOKEN_ESTIMATE = 4.0
 ## Default context budget (leave room for response)
 const DEFAULT_RESPONSE_RESERVE = 1024
 
+## LLMTokenizer used for exact counts; null falls back to estimate_tokens().
+## LocalLLMService sets it when a model loads; set it earlier (e.g. from
+## LocalLLMService.get_tokenizer()) to budget for a model that is not loaded.
+static var tokenizer = null
+
 
 ## Estimate token count for text
 ## This is a rough estimate - actual tokenization varies by model
@@ -21,21 +26,58 @@ static func estimate_tokens(text: String) -> int:
 	return max(1, int(ceil(text.length() / CHARS_PER_TOKEN_ESTIMATE)))
 
 
+## Token count for text: exact with a tokenizer, estimated otherwise
+static func count_tokens(text: String) -> int:
+	if tokenizer != null and not text.is_empty():
+		return tokenizer.count_tokens(text)
+	return estimate_tokens(text)
+
+
 ## Check if text fits within a token budget
 static func fits_in_context(text: String, max_tokens: int) -> bool:
-	return estimate_tokens(text) <= max_tokens
+	return count_tokens(text) <= max_tokens
 
 
 ## Split text into chunks that fit within token limit
 ## Tries to split on natural boundaries (newlines, sentences)
 static func chunk_text(text: String, max_tokens_per_chunk: int) -> PackedStringArray:
+	var chunks := _chunk_text_chars(text, int(max_tokens_per_chunk * CHARS_PER_TOKEN_ESTIMATE))
+	if tokenizer == null:
+		return chunks
+	
+	# Character budgets are only an estimate; re-split any chunk whose exact
+	# count is over, scaling the character budget by how far over it is
+	var exact: PackedStringArray = []
+	for chunk in chunks:
+		var tokens := count_tokens(chunk)
+		if tokens <= max_tokens_per_chunk or chunk.length() <= 1:
+			exact.append(chunk)
+			continue
+		var max_chars := maxi(1, int(chunk.length() * 0.95 * max_tokens_per_chunk / tokens))
+		exact.append_array(_split_to_token_budget(chunk, max_tokens_per_chunk, max_chars))
+	return exact
+
+
+## Re-split an oversized chunk with a smaller character budget until every
+## piece is within the exact token budget
+static func _split_to_token_budget(text: String, max_tokens_per_chunk: int, max_chars: int) -> PackedStringArray:
+	var result: PackedStringArray = []
+	for piece in _chunk_text_chars(text, max_chars):
+		var tokens := count_tokens(piece)
+		if tokens <= max_tokens_per_chunk or piece.length() <= 1 or piece == text:
+			result.append(piece)
+		else:
+			var smaller := maxi(1, int(piece.length() * 0.95 * max_tokens_per_chunk / tokens))
+			result.append_array(_split_to_token_budget(piece, max_tokens_per_chunk, smaller))
+	return result
+
+
+static func _chunk_text_chars(text: String, max_chars: int) -> PackedStringArray:
 	var chunks: PackedStringArray = []
 	
 	if text.is_empty():
 		return chunks
 	
-	var max_chars = int(max_tokens_per_chunk * CHARS_PER_TOKEN_ESTIMATE)
-	
 	# If it fits in one chunk, return as-is
 	if text.length() <= max_chars:
 		chunks.append(text)
@@ -130,19 +172,23 @@ static func _force_split(text: String, max_chars: int) -> PackedStringArray:
 ## Preserves function/class boundaries where possible
 static func chunk_code(code: String, max_tokens_per_chunk: int, language: String = "") -> Array[Dictionary]:
 	var chunks: Array[Dictionary] = []
-	var max_chars = int(max_tokens_per_chunk * CHARS_PER_TOKEN_ESTIMATE)
+	# With a tokenizer lines are measured in exact tokens, otherwise in chars
+	var budget = max_tokens_per_chunk if tokenizer != null else int(max_tokens_per_chunk * CHARS_PER_TOKEN_ESTIMATE)
 	
 	# Split by lines for code
 	var lines = code.split("\n")
 	var current_chunk = ""
+	var current_cost = 0
 	var chunk_start_line = 1
 	var current_line = 1
 	
 	for line in lines:
 		var line_with_newline = line + "\n"
+		var line_cost = count_tokens(line_with_newline) if tokenizer != null else line_with_newline.length()
 		
-		if current_chunk.length() + line_with_newline.length() <= max_chars:
+		if current_cost + line_cost <= budget:
 			current_chunk += line_with_newline
+			current_cost += line_cost
 		else:
 			if not current_chunk.is_empty():
 				chunks.append({
@@ -150,10 +196,11 @@ static func chunk_code(code: String, max_tokens_per_chunk: int, language: String
 					"start_line": chunk_start_line,
 					"end_line": current_line - 1,
 					"language": language,
-					"tokens_estimate": estimate_tokens(current_chunk)
+					"tokens_estimate": count_tokens(current_chunk)
 				})
 			
 			current_chunk = line_with_newline
+			current_cost = line_cost
 			chunk_start_line = current_line
 		
 		current_line += 1
@@ -164,7 +211,7 @@ static func chunk_code(code: String, max_tokens_per_chunk: int, language: String
 			"start_line": chunk_start_line,
 			"end_line": current_line - 1,
 			"language": language,
-			"tokens_estimate": estimate_tokens(current_chunk)
+			"tokens_estimate": count_tokens(current_chunk)
 		})
 	
 	return chunks
@@ -190,7 +237,7 @@ static func build_context(
 	
 	for source in sources:
 		var content = source.get("content", "")
-		var tokens = estimate_tokens(content)
+		var tokens = count_tokens(content)
 		
 		if result.tokens_used + tokens <= available_tokens:
 			# Format based on type
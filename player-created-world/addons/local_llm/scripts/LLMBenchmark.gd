@@ -5,6 +5,8 @@
 extends RefCounted
 class_name LLMBenchmark
 
+const PROTOCOL := preload("res://shared/scripts/protocol/Protocol.gd")
+
 ## Benchmark result structure
 class BenchmarkResult:
 	var model_id: String = ""
@@ -61,6 +63,22 @@ const BENCHMARK_PROMPT = "Write a function that calculates the Fibonacci sequenc
 ## Short prompt for quick testing
 const QUICK_BENCHMARK_PROMPT = "Write a hello world function in Python with a docstring."
 
+## Edit-style prompts whose answers repeat much of their input, the case
+## prompt-lookup decoding drafts well
+const LOOKUP_DECODING_PROMPTS = [
+	"Add type hints to this function and return the complete function:\n\ndef spawn_wave(enemies, count, delay):\n\tfor i in range(count):\n\t\tfor enemy in enemies:\n\t\t\tenemy.spawn(delay * i)\n\treturn len(enemies) * count\n",
+	"Rename the variable hp to health everywhere and return the full script:\n\nvar hp = 100\n\nfunc take_damage(amount):\n\thp -= amount\n\tif hp <= 0:\n\t\tdie()\n\nfunc heal(amount):\n\thp = min(hp + amount, 100)\n"
+]
+
+## Draft settings tried by calibrate_lookup_decoding()
+const LOOKUP_DECODING_CANDIDATES = [
+	{"ngram": 2, "draft_max": 4},
+	{"ngram": 2, "draft_max": 8},
+	{"ngram": 3, "draft_max": 8},
+	{"ngram": 3, "draft_max": 16},
+	{"ngram": 4, "draft_max": 16}
+]
+
 
 ## Run a benchmark on the currently loaded model
 static func run_benchmark(
@@ -85,7 +103,7 @@ static func run_benchmark(
 	
 	# Select prompt
 	var prompt = QUICK_BENCHMARK_PROMPT if use_quick_prompt else BENCHMARK_PROMPT
-	result.prompt_tokens = LLMContextManager.estimate_tokens(prompt)
+	result.prompt_tokens = LLMContextManager.count_tokens(prompt)
 	
 	# Start timing
 	var start_time = Time.get_ticks_usec()
@@ -199,6 +217,469 @@ static func format_suite_results(suite_results: Dictionary) -> String:
 	return "\n".join(lines)
 
 
+## Compare the two ways a game server could stream a generation to a thin
+## client: binary varint token-ID frames (what LLMRelay sends) against JSON
+## text deltas. Runs one real generation, records what each frame would carry
+## (one frame per process frame, like one per network tick), then measures
+## wire bytes per token and encode time per stream for both formats.
+static func run_stream_encoding_benchmark(
+	service: Node,  # LocalLLMService
+	max_tokens: int = 200,
+	repeats: int = 50
+) -> Dictionary:
+	if not service.is_model_loaded():
+		return {"success": false, "error": "No model loaded"}
+	
+	var handle = service.generate_streaming({
+		"prompt": BENCHMARK_PROMPT,
+		"max_tokens": max_tokens,
+		"temperature": 0.0,
+		"collect_token_ids": true
+	})
+	if handle == null:
+		return {"success": false, "error": "Failed to start generation"}
+	
+	# Capture per-tick batches: token IDs and the matching text delta
+	var id_batches: Array[PackedInt32Array] = []
+	var text_batches: PackedStringArray = []
+	var emitted := 0
+	var finished := false
+	while not finished:
+		await Engine.get_main_loop().process_frame
+		finished = handle.get_status() >= 2
+		var ids: PackedInt32Array = handle.take_token_ids()
+		var text: String = handle.get_full_text()
+		if ids.is_empty() and not finished:
+			continue
+		id_batches.append(ids)
+		text_batches.append(text.substr(emitted))
+		emitted = text.length()
+	
+	if handle.get_status() != 2:
+		return {"success": false, "error": handle.get_error_message()}
+	
+	var n_tokens := 0
+	for ids in id_batches:
+		n_tokens += ids.size()
+	var last := id_batches.size() - 1
+	
+	var binary_bytes := 0
+	var start := Time.get_ticks_usec()
+	for r in range(repeats):
+		binary_bytes = 0
+		for i in range(id_batches.size()):
+			var flags := PROTOCOL.LLM_FRAME_FINAL if i == last else 0
+			binary_bytes += PROTOCOL.encode_token_frame(1, i, id_batches[i], flags).size()
+	var binary_usec := float(Time.get_ticks_usec() - start) / repeats
+	
+	var json_bytes := 0
+	start = Time.get_ticks_usec()
+	for r in range(repeats):
+		json_bytes = 0
+		for i in range(text_batches.size()):
+			var message := {"type": PROTOCOL.ServerMsg.LLM_TOKENS, "request_id": 1, "seq": i, "text": text_batches[i], "final": i == last}
+			json_bytes += JSON.stringify(message).to_utf8_buffer().size()
+	var json_usec := float(Time.get_ticks_usec() - start) / repeats
+	
+	return {
+		"success": true,
+		"tokens": n_tokens,
+		"frames": id_batches.size(),
+		"binary_bytes_per_token": float(binary_bytes) / maxi(n_tokens, 1),
+		"json_bytes_per_token": float(json_bytes) / maxi(n_tokens, 1),
+		"binary_encode_usec_per_stream": binary_usec,
+		"json_encode_usec_per_stream": json_usec,
+		"bandwidth_ratio": float(json_bytes) / maxi(binary_bytes, 1)
+	}
+
+
+## Compare "output": "text" against "output": "tokens" on the same greedy
+## generation. Runs alternate so thermal drift hits both modes alike, and the
+## fastest run of each counts. The difference in microseconds per token is
+## the String conversion and per-token signal that token mode skips.
+static func run_output_mode_benchmark(
+	service: Node,  # LocalLLMService
+	max_tokens: int = 200,
+	runs: int = 3
+) -> Dictionary:
+	if not service.is_model_loaded():
+		return {"success": false, "error": "No model loaded"}
+	
+	var best := {"text": INF, "tokens": INF}
+	var n_tokens := {"text": 0, "tokens": 0}
+	for r in range(runs):
+		for mode in ["text", "tokens"]:
+			var handle = service.generate_streaming({
+				"prompt": BENCHMARK_PROMPT,
+				"max_tokens": max_tokens,
+				"temperature": 0.0,
+				"output": mode,
+				"cache": false
+			})
+			if handle == null:
+				return {"success": false, "error": "Failed to start generation"}
+			while handle.get_status() < 2:
+				await Engine.get_main_loop().process_frame
+			if handle.get_status() != 2:
+				return {"success": false, "error": handle.get_error_message()}
+			var tokens: int = handle.get_tokens_generated()
+			if tokens > 0:
+				best[mode] = minf(best[mode], handle.get_elapsed_seconds() * 1000000.0 / tokens)
+				n_tokens[mode] = tokens
+	
+	return {
+		"success": true,
+		"tokens": n_tokens.text,
+		"text_usec_per_token": best.text,
+		"tokens_usec_per_token": best.tokens,
+		"saved_usec_per_token": best.text - best.tokens
+	}
+
+
+## Per-token cost of the same greedy generation with the whole vocabulary
+## and with the sampler restricted to the vocabulary trim (set_vocab_trim),
+## plus the trim's coverage of the benchmark prompt and its output. speedup
+## is the whole step; only its sampling part changes.
+static func run_vocab_trim_benchmark(
+	service: Node,  # LocalLLMService
+	max_tokens: int = 200,
+	runs: int = 3
+) -> Dictionary:
+	if not service.is_model_loaded():
+		return {"success": false, "error": "No model loaded"}
+	if not service.get_vocab_stats().get("trim", {}).get("enabled", false):
+		return {"success": false, "error": "No vocabulary trim configured"}
+	
+	var best := {"full": INF, "trimmed": INF}
+	var output := ""
+	for r in range(runs):
+		for mode in ["full", "trimmed"]:
+			var handle = service.generate_streaming({
+				"prompt": BENCHMARK_PROMPT,
+				"max_tokens": max_tokens,
+				"temperature": 0.0,
+				"vocab_trim": mode == "trimmed",
+				"cache": false
+			})
+			if handle == null:
+				return {"success": false, "error": "Failed to start generation"}
+			while handle.get_status() < 2:
+				await Engine.get_main_loop().process_frame
+			if handle.get_status() != 2:
+				return {"success": false, "error": handle.get_error_message()}
+			var tokens: int = handle.get_tokens_generated()
+			if tokens > 0:
+				best[mode] = minf(best[mode], handle.get_elapsed_seconds() * 1000000.0 / tokens)
+			if mode == "full":
+				output = handle.get_full_text()
+	
+	var stats: Dictionary = service.get_vocab_stats()
+	var coverage: Dictionary = service.measure_vocab_coverage(PackedStringArray([BENCHMARK_PROMPT, output]))
+	return {
+		"success": true,
+		"kept": stats.trim.kept,
+		"full_usec_per_token": best.full,
+		"trimmed_usec_per_token": best.trimmed,
+		"speedup": best.full / best.trimmed if best.trimmed > 0.0 else 0.0,
+		"sampler_speedup": stats.sampler_speedup,
+		"coverage": coverage.get("coverage", 0.0),
+		"live_coverage": stats.live_coverage
+	}
+
+
+## Pick the prompt-lookup ngram and draft_max for the loaded model: time the
+## prompts without it, then with every candidate, and keep the fastest one
+## if it beats the baseline (otherwise lookup decoding is turned off).
+## The choice is stored in the settings for the next load.
+static func calibrate_lookup_decoding(
+	service: Node,  # LocalLLMService
+	prompts: Array = LOOKUP_DECODING_PROMPTS,
+	candidates: Array = LOOKUP_DECODING_CANDIDATES,
+	max_tokens: int = 200
+) -> Dictionary:
+	if not service.is_model_loaded():
+		return {"success": false, "error": "No model loaded"}
+	var model_id: String = service.get_loaded_model_id()
+	
+	var baseline: Dictionary = await _time_prompts(service, prompts, max_tokens, false)
+	if not baseline.success:
+		return baseline
+	
+	var results := []
+	var best := {}
+	var best_speedup := 1.0
+	for candidate in candidates:
+		var config: Dictionary = candidate.duplicate()
+		config["enabled"] = true
+		service.set_lookup_decoding(model_id, config)
+		var before: Dictionary = service.get_lookup_decoding_stats()
+		var run: Dictionary = await _time_prompts(service, prompts, max_tokens, true)
+		if not run.success:
+			return run
+		var after: Dictionary = service.get_lookup_decoding_stats()
+		var drafted: int = after.drafted - before.drafted
+		var speedup: float = baseline.usec_per_token / run.usec_per_token if run.usec_per_token > 0.0 else 0.0
+		results.append({
+			"ngram": config.ngram,
+			"draft_max": config.draft_max,
+			"usec_per_token": run.usec_per_token,
+			"acceptance_rate": float(after.accepted - before.accepted) / drafted if drafted > 0 else 0.0,
+			"speedup": speedup
+		})
+		if speedup > best_speedup:
+			best_speedup = speedup
+			best = config
+	
+	service.set_lookup_decoding(model_id, best if not best.is_empty() else {"enabled": false})
+	return {
+		"success": true,
+		"model_id": model_id,
+		"baseline_usec_per_token": baseline.usec_per_token,
+		"results": results,
+		"best": best,
+		"speedup": best_speedup
+	}
+
+
+## Greedy runs of every prompt; time per generated token over all of them
+static func _time_prompts(service: Node, prompts: Array, max_tokens: int, lookup_decoding: bool) -> Dictionary:
+	var seconds := 0.0
+	var tokens := 0
+	for prompt in prompts:
+		var handle = service.generate_streaming({
+			"prompt": prompt,
+			"max_tokens": max_tokens,
+			"temperature": 0.0,
+			"lookup_decoding": lookup_decoding,
+			"cache": false
+		})
+		if handle == null:
+			return {"success": false, "error": "Failed to start generation"}
+		while handle.get_status() < 2:
+			await Engine.get_main_loop().process_frame
+		if handle.get_status() != 2:
+			return {"success": false, "error": handle.get_error_message()}
+		seconds += handle.get_elapsed_seconds()
+		tokens += handle.get_tokens_generated()
+	return {"success": true, "usec_per_token": seconds * 1000000.0 / tokens if tokens > 0 else 0.0}
+
+
+## Agreement between composed example KV and a full prefill. Every case
+## ({ prompt, examples: [names], system_prompt }) runs greedily with
+## "compose_examples" on, then off; the outputs are compared token by token
+## (agreement = shared prefix / longer output) and the time to first token
+## and tokens spliced are reported per case and overall. The examples must
+## be registered with the service first.
+static func run_example_agreement(
+	service: Node,  # LocalLLMService
+	cases: Array,
+	max_tokens: int = 64
+) -> Dictionary:
+	if not service.is_model_loaded():
+		return {"success": false, "error": "No model loaded"}
+	
+	var rows := []
+	var exact := 0
+	var agreement_sum := 0.0
+	var ttft_sum := {"composed": 0.0, "full": 0.0}
+	var spliced_total := 0
+	for test_case in cases:
+		var outputs := {}
+		var ttft := {}
+		var before: Dictionary = service.get_example_stats()
+		for mode in ["composed", "full"]:
+			var handle = service.generate_streaming({
+				"prompt": test_case.get("prompt", ""),
+				"system_prompt": test_case.get("system_prompt", ""),
+				"examples": test_case.get("examples", []),
+				"compose_examples": mode == "composed",
+				"max_tokens": max_tokens,
+				"temperature": 0.0,
+				"output": "both",
+				"cache": false
+			})
+			if handle == null:
+				return {"success": false, "error": "Failed to start generation"}
+			while handle.get_status() < 2:
+				await Engine.get_main_loop().process_frame
+			if handle.get_status() != 2:
+				return {"success": false, "error": handle.get_error_message()}
+			outputs[mode] = handle.get_tokens()
+			ttft[mode] = handle.get_time_to_first_token()
+		var spliced: int = service.get_example_stats().tokens_spliced - before.get("tokens_spliced", 0)
+		
+		var composed: PackedInt32Array = outputs.composed
+		var full: PackedInt32Array = outputs.full
+		var shared := 0
+		while shared < mini(composed.size(), full.size()) and composed[shared] == full[shared]:
+			shared += 1
+		var longest := maxi(composed.size(), full.size())
+		var agreement: float = float(shared) / longest if longest > 0 else 1.0
+		if composed == full:
+			exact += 1
+		agreement_sum += agreement
+		ttft_sum.composed += ttft.composed
+		ttft_sum.full += ttft.full
+		spliced_total += spliced
+		rows.append({
+			"examples": test_case.get("examples", []),
+			"exact": composed == full,
+			"agreement": agreement,
+			"tokens_spliced": spliced,
+			"composed_ttft": ttft.composed,
+			"full_ttft": ttft.full
+		})
+	
+	var n := maxi(cases.size(), 1)
+	return {
+		"success": true,
+		"cases": rows,
+		"exact_match_rate": float(exact) / n,
+		"mean_agreement": agreement_sum / n,
+		"tokens_spliced": spliced_total,
+		"composed_ttft": ttft_sum.composed / n,
+		"full_ttft": ttft_sum.full / n
+	}
+
+
+## score_batch() throughput at several batch widths. A context sized for the
+## widest batch is created for the run and destroyed afterwards; one warm-up
+## item leaves the instruction resident, then every width scores the same
+## items, and items per second and decodes are reported.
+static func run_score_batch_benchmark(
+	service: Node,  # LocalLLMService
+	instruction: String,
+	items: PackedStringArray,
+	labels: PackedStringArray,
+	batch_sizes: Array = [1, 4, 8, 16],
+	n_ctx: int = 4096
+) -> Dictionary:
+	if not service.is_model_loaded():
+		return {"success": false, "error": "No model loaded"}
+	var widest: int = batch_sizes.max()
+	if not service.create_context("score_benchmark", {"n_ctx": n_ctx, "n_seq_max": widest}):
+		return {"success": false, "error": "Failed to create a context with n_seq_max %d" % widest}
+	
+	var rows := []
+	var error := ""
+	var runs: Array = [0] + batch_sizes
+	for batch_size in runs:
+		var handle = service.score_batch(instruction, items.slice(0, 1) if batch_size == 0 else items, labels, {
+			"context": "score_benchmark",
+			"batch_size": batch_size
+		})
+		if handle == null:
+			error = "Failed to start scoring"
+			break
+		while handle.get_status() < 2:
+			await Engine.get_main_loop().process_frame
+		if handle.get_status() != 2:
+			error = handle.get_error_message()
+			break
+		if batch_size == 0:
+			continue
+		var progress: Dictionary = handle.get_progress()
+		rows.append({
+			"batch_size": batch_size,
+			"items_per_second": progress.get("items_per_second", 0.0),
+			"decodes": progress.get("decodes", 0),
+			"skipped": progress.get("skipped", 0),
+			"wall_ms": progress.get("wall_ms", 0.0)
+		})
+	service.destroy_context("score_benchmark")
+	
+	if not error.is_empty():
+		return {"success": false, "error": error}
+	var base: float = rows[0].items_per_second if not rows.is_empty() else 0.0
+	for row in rows:
+		row["speedup"] = row.items_per_second / base if base > 0.0 else 0.0
+	return {"success": true, "items": items.size(), "labels": labels.size(), "results": rows}
+
+
+## rerank() throughput: the same query and documents reranked `iterations`
+## times (after one warm-up), reporting pairs per second and decodes per run.
+## With `generate_prompt` set, a generation streams on the same context during
+## the runs to show how reranking interleaves with it.
+static func run_rerank_benchmark(
+	service: Node,  # LocalLLMService
+	query: String,
+	documents: PackedStringArray,
+	iterations: int = 5,
+	generate_prompt: String = ""
+) -> Dictionary:
+	if not service.is_model_loaded():
+		return {"success": false, "error": "No model loaded"}
+	
+	var generation = null
+	if not generate_prompt.is_empty():
+		generation = service.generate_streaming({"prompt": generate_prompt, "max_tokens": 256, "cache": false})
+	
+	var runs := []
+	var error := ""
+	for i in iterations + 1:
+		var handle = service.rerank(query, documents)
+		if handle == null:
+			error = "Failed to start reranking (is a reranker loaded?)"
+			break
+		while handle.get_status() < 2:
+			await Engine.get_main_loop().process_frame
+		if handle.get_status() != 2:
+			error = handle.get_error_message()
+			break
+		if i > 0:
+			runs.append(handle.get_progress())
+	
+	if generation != null:
+		generation.request_cancel()
+	if not error.is_empty():
+		return {"success": false, "error": error}
+	
+	var pairs_per_second := 0.0
+	var wall_ms := 0.0
+	for run in runs:
+		pairs_per_second += run.pairs_per_second
+		wall_ms += run.wall_ms
+	var n := maxi(runs.size(), 1)
+	return {
+		"success": true,
+		"pairs": documents.size(),
+		"decodes": runs[0].decodes if not runs.is_empty() else 0,
+		"truncated": runs[0].truncated if not runs.is_empty() else 0,
+		"pairs_per_second": pairs_per_second / n,
+		"wall_ms": wall_ms / n,
+		"interleaved": generation != null
+	}
+
+
+## Measure LLMTokenizer load cost and tokenization throughput, single-threaded
+## and with every core sharing one instance
+static func run_tokenizer_benchmark(tokenizer, iterations: int = 20) -> Dictionary:  # tokenizer: LLMTokenizer
+	if tokenizer == null or not tokenizer.is_open():
+		return {"success": false, "error": "Tokenizer not open"}
+	
+	# ~40 KB of mixed prose and code, closer to real context than one prompt
+	var text := ""
+	for i in range(100):
+		text += BENCHMARK_PROMPT + "\n" + QUICK_BENCHMARK_PROMPT + "\nfunc f_%d(x):\n\treturn x * %d\n" % [i, i]
+	
+	var threads := OS.get_processor_count()
+	var single: Dictionary = tokenizer.benchmark_throughput(text, iterations, 1)
+	var multi: Dictionary = tokenizer.benchmark_throughput(text, iterations, threads)
+	var stats: Dictionary = tokenizer.get_stats()
+	
+	return {
+		"success": true,
+		"load_ms": stats.get("load_ms", 0.0),
+		"rss_delta_bytes": stats.get("rss_delta_bytes", -1),
+		"vocab_size": stats.get("vocab_size", 0),
+		"tokens_per_second": single.get("tokens_per_second", 0.0),
+		"mb_per_second": single.get("mb_per_second", 0.0),
+		"threads": threads,
+		"tokens_per_second_all_threads": multi.get("tokens_per_second", 0.0),
+		"scaling": multi.get("tokens_per_second", 0.0) / maxf(single.get("tokens_per_second", 0.0), 1.0)
+	}
+
+
 ## Print system info for benchmark context
 static func get_system_info() -> String:
 	var lines: PackedStringArray = []
@@ -21,6 +21,13 @@ const ModelRegistry = preload("res://addons/local_llm/scripts/ModelRegistry.gd")
 const ModelExtractor = preload("res://addons/local_llm/scripts/ModelExtractor.gd")
 const LocalLLMSettings = preload("res://addons/local_llm/scripts/LocalLLMSettings.gd")
 
+## Request histograms behind get_capacity_advice(), kept across sessions
+const USAGE_HISTOGRAMS_PATH = "user://local_llm_usage.json"
+
+## GGUF header summaries of the registered model files, keyed by path, size,
+## mtime and inode so warm starts only stat the files
+const MODEL_CATALOG_PATH = "user://local_llm_catalog.bin"
+
 ## Emitted when a model starts loading
 signal model_loading(model_id: String)
 
@@ -48,6 +55,8 @@ var _registry: ModelRegistry
 var _extractor: ModelExtractor
 var _settings: LocalLLMSettings
 var _provider  # LlamaCppProvider - dynamically typed to handle missing extension
+var _tokenizers: Dictionary = {}  # model_id -> LLMTokenizer (vocabulary only)
+var _catalog_stats: Dictionary = {}  # last LLMModelCatalog.scan() timings
 var _is_ready: bool = false
 var _init_error: String = ""
 var _extension_available: bool = false
@@ -84,12 +93,15 @@ func _ready() -> void:
 			_init_error = "Failed to create LlamaCppProvider instance"
 			_log_error(_init_error)
 			return
+		_load_usage_histograms()
 	
 	# Load model registry
 	var err = _registry.load_registry()
 	if err != OK:
 		_log_warning("No models.json found - no embedded models available")
 		_debug_log("H2", "registry_load_failed", {"error_code": err})
+	elif _extension_available:
+		_refresh_model_catalog()
 	
 	_is_ready = _extension_available
 	
@@ -116,6 +128,7 @@ func _ready() -> void:
 func _exit_tree() -> void:
 	if _provider != null and _provider.is_loaded():
 		_provider.unload_model()
+	_save_usage_histograms()
 	if _settings != null:
 		_settings.save_settings()
 
@@ -147,6 +160,30 @@ func _auto_load_default_model() -> void:
 	await load_model(model_id)
 
 
+func _refresh_model_catalog() -> void:
+	var ids: Array[String] = []
+	var paths := PackedStringArray()
+	for model in _registry.list_models():
+		# The extracted copy if there is one; in the editor the PCK path is a
+		# regular file too. Models still packed in an export are skipped.
+		var path := _extractor.get_cached_path(model)
+		if path.is_empty():
+			path = model.get("file_path_in_pck", "")
+		if path.is_empty():
+			continue
+		ids.append(model.id)
+		paths.append(path)
+	if paths.is_empty():
+		return
+	
+	var catalog = ClassDB.instantiate("LLMModelCatalog")
+	_catalog_stats = catalog.scan(paths, MODEL_CATALOG_PATH)
+	var entries := {}
+	for i in ids.size():
+		entries[ids[i]] = catalog.get_entry(paths[i])
+	_registry.apply_catalog(entries)
+
+
 # ============================================================================
 # PUBLIC API
 # ============================================================================
@@ -171,6 +208,20 @@ func get_registry() -> ModelRegistry:
 	return _registry
 
 
+## Timings of the startup model catalog scan: files, hits, misses, load_ms
+## (warm load: catalog read + stats), scan_ms (header parsing), total_ms
+func get_catalog_stats() -> Dictionary:
+	return _catalog_stats
+
+
+## Process-wide engine state: providers, contexts, threads vs cores, and the
+## pooled models with how many providers share each
+func get_engine_stats() -> Dictionary:
+	if not Engine.has_singleton("LLMEngine"):
+		return {}
+	return Engine.get_singleton("LLMEngine").get_stats()
+
+
 ## Get current settings
 func get_settings() -> LocalLLMSettings:
 	return _settings
@@ -187,6 +238,117 @@ func get_status() -> Dictionary:
 	return _provider.get_status()
 
 
+## Per-component memory breakdown (weights mapped/resident, KV per context,
+## compute buffers, caches, process RSS/PSS). Cheap enough to poll at 1 Hz.
+func get_memory_report() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_memory_report()
+
+
+## Keep KV sequences that contexts evict compressed in RAM (and spilled to
+## disk past host_budget_mb) so returning sessions skip their prefill.
+## Keys: host_budget_mb (0 = off), disk_budget_mb, min_tokens, spill_dir.
+func configure_kv_tiering(config: Dictionary) -> void:
+	if _provider == null:
+		return
+	_provider.configure_kv_tiering(config)
+
+
+## Per-tier entries, bytes, compression ratio, restores and restore cost
+func get_kv_tier_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_kv_tier_stats()
+
+
+## Restrict sampling to tokens whose text lies in the given Unicode ranges
+## for every request that does not pass "vocab_trim": false. Kept in the
+## settings so later loads use it too; {} turns it off.
+## Returns n_vocab, kept and kept_fraction for the loaded model.
+func set_vocab_trim(config: Dictionary) -> Dictionary:
+	_settings.vocab_trim = config
+	_settings.save_settings()
+	if _provider == null:
+		return {}
+	return _provider.set_vocab_trim(config)
+
+
+## Share of the tokens of sample texts that the vocabulary trim keeps
+func measure_vocab_coverage(texts: PackedStringArray) -> Dictionary:
+	if _provider == null or not _provider.is_loaded():
+		return {}
+	return _provider.measure_vocab_coverage(texts)
+
+
+## Sampler restriction stats: sampling cost per token with the full
+## vocabulary and with a candidate set
+func get_vocab_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_vocab_stats()
+
+
+## Turn prompt-lookup decoding on or off for a model (experimental) and
+## keep the setting. Config: enabled, ngram, draft_max.
+func set_lookup_decoding(model_id: String, config: Dictionary) -> void:
+	_settings.lookup_decoding[model_id] = config
+	_settings.save_settings()
+	if _provider != null:
+		_provider.set_lookup_decoding(model_id, config)
+
+
+## Acceptance rate, tokens per decode and speedup of lookup decoding
+func get_lookup_decoding_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_lookup_decoding_stats()
+
+
+## Register a few-shot example that requests can list under "examples".
+## Its KV is computed once and moved into place in every prompt using it.
+## Registrations outlive model loads; the KV is rebuilt per model.
+func register_example(example_name: String, text: String) -> void:
+	if _provider == null:
+		return
+	_provider.register_example(example_name, text)
+
+
+func unregister_example(example_name: String) -> void:
+	if _provider == null:
+		return
+	_provider.unregister_example(example_name)
+
+
+func get_example_names() -> PackedStringArray:
+	if _provider == null:
+		return PackedStringArray()
+	return _provider.get_example_names()
+
+
+## Prefill saved by composing examples, block precomputes and prefill time
+## of composed versus full requests
+func get_example_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_example_stats()
+
+
+## Profile the next n_steps decode steps of a context op by op. Read the
+## result with get_op_profile() once "collecting" turns false.
+func start_op_profile(n_steps: int = 32, context_name: String = "default") -> bool:
+	if _provider == null or not _provider.is_loaded():
+		return false
+	return _provider.start_op_profile(n_steps, context_name)
+
+
+## Time per op type, shape and layer, ranked, plus llama.cpp's CPU features
+func get_op_profile(context_name: String = "default", top_n: int = 20) -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_op_profile(context_name, top_n)
+
+
 ## Check if a model is currently loaded
 func is_model_loaded() -> bool:
 	return _provider != null and _provider.is_loaded()
@@ -281,6 +443,10 @@ func load_model(model_id: String) -> Dictionary:
 		model_unloaded.emit()
 	
 	# Load the model
+	_provider.elastic_kv_min_ctx = _settings.elastic_kv_min_ctx
+	_provider.set_vocab_trim(_settings.vocab_trim)
+	if _settings.lookup_decoding.has(model_id):
+		_provider.set_lookup_decoding(model_id, _settings.lookup_decoding[model_id])
 	var success = _provider.load_model(
 		model_path, 
 		model_id, 
@@ -293,6 +459,9 @@ func load_model(model_id: String) -> Dictionary:
 		_debug_log("H5", "load_model_success", {"model_id": model_id})
 		_settings.selected_model_id = model_id
 		_settings.save_settings()
+		LLMContextManager.tokenizer = get_tokenizer(model_id)
+		for context_name in _settings.extra_contexts:
+			create_context(context_name, _settings.extra_contexts[context_name])
 		model_loaded.emit(model_id)
 		_log("Model loaded successfully: %s" % model_id)
 		return {"success": true}
@@ -351,6 +520,119 @@ func unload_model() -> void:
 		_provider.unload_model()
 		model_unloaded.emit()
 		_log("Model unloaded")
+		_save_usage_histograms()
+
+
+## Add a context over the loaded model's weights (no second copy of the
+## model). Requests with "context": name run on it in parallel with the
+## default context. config: n_ctx, n_seq_max, type_k, type_v, n_threads.
+func create_context(context_name: String, config: Dictionary = {}) -> bool:
+	if _provider == null or not _provider.is_loaded():
+		return false
+	if not _provider.create_context(context_name, config):
+		_log_warning("Failed to create context: %s" % context_name)
+		return false
+	return true
+
+
+## Free a context added with create_context()
+func destroy_context(context_name: String) -> bool:
+	if _provider == null:
+		return false
+	return _provider.destroy_context(context_name)
+
+
+## Let a context's KV cache start at n_ctx_min cells and follow demand up to
+## its n_ctx (0 = fixed size again). Resize counts, stall times and average
+## memory saved are under get_context_info().contexts[name].elastic.
+func set_context_elastic(context_name: String, n_ctx_min: int) -> bool:
+	if _provider == null:
+		return false
+	return _provider.set_context_elastic(context_name, n_ctx_min)
+
+
+## Names of the live contexts, "default" included
+func get_context_names() -> PackedStringArray:
+	if _provider == null:
+		return PackedStringArray()
+	return _provider.get_context_names()
+
+
+## Shared weight bytes and per-context KV bytes and load
+func get_context_info() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_context_info()
+
+
+## Recommend n_ctx, n_seq_max and KV cache type for the loaded model, based on
+## the prompt/output lengths observed for it so far. Apply the result by
+## setting get_settings().context_length and reloading the model.
+## memory_budget_bytes = 0 uses available memory plus the current KV cache.
+func get_capacity_advice(target_rejection_rate: float = 0.01, memory_budget_bytes: int = 0) -> Dictionary:
+	if _provider == null:
+		return {"error": "Provider not initialized"}
+	return _provider.get_capacity_advice(target_rejection_rate, memory_budget_bytes)
+
+
+func _load_usage_histograms() -> void:
+	if not FileAccess.file_exists(USAGE_HISTOGRAMS_PATH):
+		return
+	var file = FileAccess.open(USAGE_HISTOGRAMS_PATH, FileAccess.READ)
+	if file == null:
+		return
+	var data = JSON.parse_string(file.get_as_text())
+	file.close()
+	if data is Dictionary:
+		_provider.set_usage_histograms(data)
+	else:
+		_log_warning("Ignoring unreadable usage histograms")
+
+
+func _save_usage_histograms() -> void:
+	if _provider == null:
+		return
+	var file = FileAccess.open(USAGE_HISTOGRAMS_PATH, FileAccess.WRITE)
+	if file == null:
+		_log_warning("Failed to save usage histograms: %s" % error_string(FileAccess.get_open_error()))
+		return
+	file.store_string(JSON.stringify(_provider.get_usage_histograms()))
+	file.close()
+
+
+## Declare the models upcoming work will need, in the order it will need them
+## (e.g. the remaining llm.chat nodes of a workflow). The provider warms or
+## preloads them in the background so the later load_model() is near-instant.
+## Models that have not been extracted from the PCK yet are skipped.
+func declare_upcoming_models(model_ids: PackedStringArray) -> void:
+	if _provider == null:
+		return
+	
+	var paths: PackedStringArray = []
+	for model_id in model_ids:
+		var model_info = _registry.get_model(model_id)
+		if model_info == null or model_info.is_empty():
+			continue
+		var path = _extractor.get_cached_path(model_info)
+		if path.is_empty():
+			_log("Not prefetching %s: not extracted yet" % model_id)
+			continue
+		if not paths.has(path):
+			paths.append(path)
+	
+	# Same 10% headroom rule as load_model()
+	var budget := 0
+	if _settings.background_preload:
+		budget = int(_provider.get_available_memory() * 0.9)
+	
+	_provider.declare_upcoming_models(paths, budget)
+
+
+## Get prefetch statistics (hit rate, load time hidden, standby models)
+func get_prefetch_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_prefetch_stats()
 
 
 ## Generate text (blocking, returns full result)
@@ -380,8 +662,192 @@ func generate_streaming(request: Dictionary):  # -> LLMGenerationHandle or null
 		_log_error("No model loaded")
 		return null
 	
-	# Apply default settings
-	var full_request = {
+	var full_request = _build_request(request)
+	
+	var handle = _provider.generate(full_request)
+	
+	if handle != null:
+		generation_started.emit(handle.get_id())
+		
+		# Connect signals for service-level events
+		handle.completed.connect(func(text): generation_completed.emit(handle.get_id(), text))
+		handle.error.connect(func(err): generation_failed.emit(handle.get_id(), err))
+	
+	return handle
+
+
+## Summarize a text longer than the context window (returns handle immediately).
+## Chunk summaries run in parallel, as many as fit the chosen context's
+## n_ctx; give them room with e.g. create_context("summarize", {"n_ctx": 16384}).
+## The handle emits progress({stage, completed, total, ...}) per chunk and
+## streams the final summary. Returns null if no model is loaded.
+func summarize_long(text: String, instructions: String = "", options: Dictionary = {}):  # -> LLMGenerationHandle or null
+	if _provider == null or not _provider.is_loaded():
+		_log_error("No model loaded")
+		return null
+	
+	var params = _build_request(options)
+	params.erase("prompt")
+	params["max_tokens"] = options.get("max_tokens", 512)
+	for key in ["chunk_tokens", "chunk_max_tokens", "reduce_instructions"]:
+		if options.has(key):
+			params[key] = options[key]
+	
+	var handle = _provider.summarize_long(text, instructions, params)
+	if handle != null:
+		generation_started.emit(handle.get_id())
+		handle.completed.connect(func(summary): generation_completed.emit(handle.get_id(), summary))
+		handle.error.connect(func(err): generation_failed.emit(handle.get_id(), err))
+	return handle
+
+
+## Classify many short items (chat lines, item names, ...) under one
+## instruction, e.g. score_batch("Is this message toxic?", lines, ["yes", "no"]).
+## Once the handle completes, get_scores() holds one probability per label
+## for every item, row-major. Rounds of up to options.batch_size items run as
+## parallel sequences; give the context room with
+## create_context("score", {"n_ctx": 4096, "n_seq_max": 16}).
+## Returns null if no model is loaded.
+func score_batch(instruction: String, items: PackedStringArray, labels: PackedStringArray, options: Dictionary = {}):  # -> LLMGenerationHandle or null
+	if _provider == null or not _provider.is_loaded():
+		_log_error("No model loaded")
+		return null
+	
+	var params := {}
+	for key in ["context", "batch_size"]:
+		if options.has(key):
+			params[key] = options[key]
+	
+	var handle = _provider.score_batch(instruction, items, labels, params)
+	if handle != null:
+		generation_started.emit(handle.get_id())
+		handle.completed.connect(func(text): generation_completed.emit(handle.get_id(), text))
+		handle.error.connect(func(err): generation_failed.emit(handle.get_id(), err))
+	return handle
+
+
+## Compile a prompt with {{name}} slots (in the prompt or the system prompt)
+## for the loaded model. Fixed text is tokenized once; per request only the
+## slot values are, and template.make_request(values, options) yields a
+## request with "prompt_tokens" for generate_streaming(). warm() keeps the
+## text before the first slot in the KV cache. Compile again after loading
+## another model. Returns null if no model is loaded.
+func compile_prompt_template(prompt: String, system_prompt: String = ""):  # -> LLMPromptTemplate or null
+	if _provider == null or not _provider.is_loaded():
+		_log_error("No model loaded")
+		return null
+	return _provider.compile_prompt_template(prompt, system_prompt)
+
+
+## Items per second of score_batch() by batch width
+func get_score_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_score_stats()
+
+
+## Load a GGUF reranker (cross-encoder with rank pooling) by registry id or
+## absolute path. It runs next to the generation model in its own small
+## context; config: n_ctx (2048), n_seq_max (8 pairs per decode).
+func load_reranker(model: String, config: Dictionary = {}) -> Dictionary:
+	if _provider == null:
+		return {"success": false, "error": "Provider not initialized - extension not loaded"}
+	
+	var path := model
+	if not model.is_absolute_path():
+		var model_info = _registry.get_model(model)
+		if model_info == null or model_info.is_empty():
+			return {"success": false, "error": "Model not found: %s" % model}
+		var extract_result = await _extractor.ensure_extracted(model_info)
+		if not extract_result.success:
+			return {"success": false, "error": extract_result.error}
+		path = extract_result.path
+	
+	if not _provider.load_reranker(path, config):
+		return {"success": false, "error": "Failed to load reranker: %s" % path}
+	return {"success": true, "path": path}
+
+
+func unload_reranker() -> void:
+	if _provider != null:
+		_provider.unload_reranker()
+
+
+## Order retrieved candidates (e.g. example spells) by relevance to the query
+## before spending context tokens on them. Once the handle completes,
+## get_scores() has one score per document and get_progress().order the
+## document indices from most to least relevant. The job queues on
+## options.context like a generation. Returns null without a model and reranker.
+func rerank(query: String, documents: PackedStringArray, options: Dictionary = {}):  # -> LLMGenerationHandle or null
+	if _provider == null or not _provider.is_loaded() or not _provider.is_reranker_loaded():
+		_log_error("No model or reranker loaded")
+		return null
+	
+	var params := {}
+	if options.has("context"):
+		params["context"] = options.context
+	
+	var handle = _provider.rerank(query, documents, params)
+	if handle != null:
+		generation_started.emit(handle.get_id())
+		handle.completed.connect(func(text): generation_completed.emit(handle.get_id(), text))
+		handle.error.connect(func(err): generation_failed.emit(handle.get_id(), err))
+	return handle
+
+
+## Pairs per second and truncation counts of rerank()
+func get_rerank_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_rerank_stats()
+
+
+## Register a request the player is likely to make soon (e.g. while a form
+## is open). The provider computes it while otherwise idle and drops the work
+## the moment a real request arrives. Greedy requests (temperature 0) are
+## completed ahead of time; anything else, or "mode": "prefill", only warms
+## the prompt prefix. An empty prompt warms just the system prompt.
+## Returns an id, or "" if nothing was queued.
+func register_speculative_request(request: Dictionary) -> String:
+	if _provider == null or not _provider.is_loaded():
+		return ""
+	
+	var full_request = _build_request(request)
+	full_request["mode"] = request.get("mode", "complete")
+	return _provider.register_speculative_request(full_request)
+
+
+## Drop speculative requests that have not started yet
+func clear_speculative_requests() -> void:
+	if _provider != null:
+		_provider.clear_speculative_requests()
+
+
+## Get speculative precompute statistics (useful vs wasted, cache hits)
+func get_speculative_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_speculative_stats()
+
+
+## Names usable in a request's "logits_processors" list
+func get_logits_processor_names() -> PackedStringArray:
+	if _provider == null:
+		return PackedStringArray()
+	return _provider.get_logits_processor_names()
+
+
+## Get per-processor time per token ({ name: { tokens, total_ms, ns_per_token } })
+func get_logits_processor_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_logits_processor_stats()
+
+
+## Apply default settings. Shared by real and speculative requests so both
+## resolve to the same cache key.
+func _build_request(request: Dictionary) -> Dictionary:
+	var built := {
 		"prompt": request.get("prompt", ""),
 		"system_prompt": request.get("system_prompt", ""),
 		"max_tokens": request.get("max_tokens", _settings.max_tokens_default),
@@ -391,32 +857,122 @@ func generate_streaming(request: Dictionary):  # -> LLMGenerationHandle or null
 		"repeat_penalty": request.get("repeat_penalty", 1.1),
 		"stop_sequences": request.get("stop_sequences", PackedStringArray()),
 		"seed": request.get("seed", -1),
+		"logits_processors": request.get("logits_processors", []),
+		"collect_token_ids": request.get("collect_token_ids", false),
+		"output": request.get("output", "both" if request.get("collect_token_ids", false) else "text"),
+		"cache": request.get("cache", true),
+		"candidate_tokens": request.get("candidate_tokens", PackedInt32Array()),
+		"vocab_trim": request.get("vocab_trim", true),
+		"context": request.get("context", "default"),
 		"stream": request.get("stream", true)
 	}
+	# Absent means the model's own lookup decoding setting
+	if request.has("lookup_decoding"):
+		built["lookup_decoding"] = request.lookup_decoding
+	if request.has("prompt_tokens"):
+		built["prompt_tokens"] = request.prompt_tokens
+	if request.has("examples"):
+		built["examples"] = PackedStringArray(request.examples)
+		built["compose_examples"] = request.get("compose_examples", true)
+		if request.has("example_recompute"):
+			built["example_recompute"] = request.example_recompute
+	return built
+
+
+## Tokenizer for model_id that needs no weights: exact token counts before
+## (or without) load_model(), and decoding of token IDs streamed by a game
+## server. Reads the registry entry's optional "vocab_path" (a vocab-only GGUF
+## of a few MB) or else the extracted model file. Returns null if neither is
+## available locally.
+func get_tokenizer(model_id: String):  # -> LLMTokenizer or null
+	if not _extension_available:
+		return null
+	if _tokenizers.has(model_id):
+		return _tokenizers[model_id]
 	
-	var handle = _provider.generate(full_request)
+	var model_info = _registry.get_model(model_id)
+	if model_info == null or model_info.is_empty():
+		_log_warning("No tokenizer for unknown model: %s" % model_id)
+		return null
+	var path: String = model_info.get("vocab_path", "")
+	if not path.is_empty():
+		path = _materialize_vocab_file(path)
+	else:
+		path = _extractor.get_cached_path(model_info)
+	if path.is_empty():
+		_log_warning("No tokenizer for %s: model not extracted and no vocab_path" % model_id)
+		return null
 	
+	# Called through ClassDB so this script still parses without the extension
+	var tokenizer = ClassDB.class_call_static("LLMTokenizer", "open", path)
+	if tokenizer == null:
+		return null
+	_tokenizers[model_id] = tokenizer
+	return tokenizer
+
+
+## llama.cpp needs a real file; vocab files packed in the PCK are small
+## enough to copy out whole
+func _materialize_vocab_file(path: String) -> String:
+	# Outside exported builds res:// is a plain directory
+	if not path.begins_with("res://") or not OS.has_feature("template"):
+		return ProjectSettings.globalize_path(path)
+	var cache_path := "user://llm_vocab".path_join(path.get_file())
+	if not FileAccess.file_exists(cache_path):
+		DirAccess.make_dir_recursive_absolute("user://llm_vocab")
+		var data := FileAccess.get_file_as_bytes(path)
+		var file := FileAccess.open(cache_path, FileAccess.WRITE)
+		if data.is_empty() or file == null:
+			_log_warning("Failed to copy vocabulary file: %s" % path)
+			return ""
+		file.store_buffer(data)
+		file.close()
+	return ProjectSettings.globalize_path(cache_path)
+
+
+## Cancel an ongoing generation
+func cancel_generation(handle_id: String) -> void:
+	if _provider != null:
+		_provider.cancel(handle_id)
+
+
+## Continue a cancelled or failed generation from its last good token
+## (within the grace period of set_resume_policy). The returned handle
+## delivers the output so far as one chunk, then streams the rest.
+func resume_generation(handle_id: String):  # -> LLMGenerationHandle or null
+	if _provider == null or not _provider.is_loaded():
+		_log_error("No model loaded")
+		return null
+	
+	var handle = _provider.resume(handle_id)
 	if handle != null:
 		generation_started.emit(handle.get_id())
-		
-		# Connect signals for service-level events
 		handle.completed.connect(func(text): generation_completed.emit(handle.get_id(), text))
 		handle.error.connect(func(err): generation_failed.emit(handle.get_id(), err))
-	
 	return handle
 
 
-## Cancel an ongoing generation
-func cancel_generation(handle_id: String) -> void:
+func can_resume_generation(handle_id: String) -> bool:
+	return _provider != null and _provider.can_resume(handle_id)
+
+
+## Keys: grace_seconds (60, 0 = never keep), keep_kv (false), max_entries (8)
+func set_resume_policy(config: Dictionary) -> void:
 	if _provider != null:
-		_provider.cancel(handle_id)
+		_provider.set_resume_policy(config)
+
+
+## Salvaged and resumed generations and the output tokens they saved
+func get_resume_stats() -> Dictionary:
+	if _provider == null:
+		return {}
+	return _provider.get_resume_stats()
 
 
-## Estimate token count for a string (rough estimate)
+## Token count for a string: exact once a model has been loaded (see
+## LLMContextManager.tokenizer), otherwise ~4 characters per token
 func estimate_tokens(text: String) -> int:
-	# Rough estimate: ~4 characters per token for English
-	# This is imprecise but useful for planning
-	return max(1, text.length() / 4)
+	return max(1, LLMContextManager.count_tokens(text))
 
 
 ## Get recommended thread count for this system
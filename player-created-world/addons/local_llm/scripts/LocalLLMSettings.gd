@@ -31,6 +31,32 @@ var temperature_default: float = 0.0
 ## Top-p default
 var top_p_default: float = 0.9
 
+## Whether models declared as upcoming (e.g. by a workflow) may be fully loaded
+## in the background. Uses extra RAM; when false their files are only read
+## ahead into the OS page cache.
+var background_preload: bool = false
+
+## Start the default context's KV cache at this many cells and grow it toward
+## context_length only when a request needs the room (0 = allocate
+## context_length up front). Saves memory when most requests are short.
+var elastic_kv_min_ctx: int = 0
+
+## Additional contexts created over the loaded model's weights, by name:
+## { "chat": { "n_ctx": 2048, "type_k": "q8_0", "type_v": "q8_0" } }.
+## Requests select one with "context"; the rest use "default".
+var extra_contexts: Dictionary = {}
+
+## Vocabulary trim applied when a model loads: { "preset": "latin" } or
+## { "ranges": [[first, last], ...] } of Unicode code points. Requests then
+## sample only tokens inside it unless they pass "vocab_trim": false.
+## Empty = whole vocabulary.
+var vocab_trim: Dictionary = {}
+
+## Prompt-lookup decoding per model id: { "model": { "enabled": true,
+## "ngram": 3, "draft_max": 8 } }, usually written by
+## LLMBenchmark.calibrate_lookup_decoding().
+var lookup_decoding: Dictionary = {}
+
 
 ## Load settings from disk
 func load_settings() -> void:
@@ -82,6 +108,24 @@ func load_settings() -> void:
 	if data.has("top_p_default") and (data["top_p_default"] is int or data["top_p_default"] is float):
 		top_p_default = float(data["top_p_default"])
 	
+	if data.has("background_preload") and data["background_preload"] is bool:
+		background_preload = data["background_preload"]
+	
+	if data.has("elastic_kv_min_ctx") and (data["elastic_kv_min_ctx"] is int or data["elastic_kv_min_ctx"] is float):
+		elastic_kv_min_ctx = int(data["elastic_kv_min_ctx"])
+	
+	if data.has("extra_contexts") and data["extra_contexts"] is Dictionary:
+		extra_contexts = data["extra_contexts"]
+	
+	if data.has("vocab_trim") and data["vocab_trim"] is Dictionary:
+		vocab_trim = data["vocab_trim"]
+	
+	if data.has("lookup_decoding") and data["lookup_decoding"] is Dictionary:
+		lookup_decoding = data["lookup_decoding"]
+	elif data.has("self_speculation") and data["self_speculation"] is Dictionary:
+		# Saved before the feature was renamed
+		lookup_decoding = data["self_speculation"]
+	
 	print("[LocalLLM] Settings loaded")
 
 
@@ -95,7 +139,12 @@ func save_settings() -> void:
 		"max_tokens_default": max_tokens_default,
 		"auto_load_last_model": auto_load_last_model,
 		"temperature_default": temperature_default,
-		"top_p_default": top_p_default
+		"top_p_default": top_p_default,
+		"background_preload": background_preload,
+		"elastic_kv_min_ctx": elastic_kv_min_ctx,
+		"extra_contexts": extra_contexts,
+		"vocab_trim": vocab_trim,
+		"lookup_decoding": lookup_decoding
 	}
 	
 	var json_text = JSON.stringify(data, "\t")
@@ -121,6 +170,11 @@ func reset_to_defaults() -> void:
 	auto_load_last_model = false
 	temperature_default = 0.0
 	top_p_default = 0.9
+	background_preload = false
+	elastic_kv_min_ctx = 0
+	extra_contexts = {}
+	vocab_trim = {}
+	lookup_decoding = {}
 	save_settings()
 
 
@@ -134,5 +188,10 @@ func to_dict() -> Dictionary:
 		"max_tokens_default": max_tokens_default,
 		"auto_load_last_model": auto_load_last_model,
 		"temperature_default": temperature_default,
-		"top_p_default": top_p_default
+		"top_p_default": top_p_default,
+		"background_preload": background_preload,
+		"elastic_kv_min_ctx": elastic_kv_min_ctx,
+		"extra_contexts": extra_contexts,
+		"vocab_trim": vocab_trim,
+		"lookup_decoding": lookup_decoding
 	}
@@ -167,6 +167,29 @@ func has_model(model_id: String) -> bool:
 	return _models.has(model_id)
 
 
+## Merge header data from the native model catalog (LLMModelCatalog) into
+## the registry. entries maps model id -> catalog entry; models whose file
+## could not be read keep their hand-maintained values.
+func apply_catalog(entries: Dictionary) -> void:
+	for model_id in entries:
+		if not _models.has(model_id):
+			continue
+		var entry: Dictionary = entries[model_id]
+		if entry.is_empty() or entry.has("error"):
+			continue
+		
+		var info: Dictionary = _models[model_id]
+		var listed_size: int = info.get("size_bytes", 0)
+		if listed_size != entry.size_bytes:
+			push_warning("[LocalLLM] Model '%s': models.json lists %d bytes, file has %d" % [
+				model_id, listed_size, entry.size_bytes
+			])
+			info["size_bytes"] = entry.size_bytes
+		if info.get("quantization", "unknown") == "unknown":
+			info["quantization"] = entry.quantization
+		info["gguf"] = entry
+
+
 ## Get load error message
 func get_load_error() -> String:
 	return _load_error
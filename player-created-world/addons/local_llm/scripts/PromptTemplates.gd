@@ -150,6 +150,14 @@ static func build_prompt(template_name: String, user_content: String) -> Diction
 	}
 
 
+## Compiled counterpart of build_prompt(): the preset system prompt is
+## tokenized once, and only the {{slots}} of user_template are tokenized per
+## request. Fill with template.make_request({"prompt": ...}) and pass the
+## result to generate_streaming(). Returns null if no model is loaded.
+static func compile(service: Node, template_name: String, user_template: String = "{{prompt}}"):  # -> LLMPromptTemplate or null
+	return service.compile_prompt_template(user_template, get_template(template_name))
+
+
 ## Format code for inclusion in a prompt
 static func format_code_block(code: String, language: String = "") -> String:
 	if language.is_empty():
@@ -0,0 +1,449 @@
+#include "eval_runner.h"
+
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define LOCAL_LLM_RUSAGE 1
+#endif
+
+namespace godot {
+
+// n_ctx of the provider's "default" context; the runner only uses its own
+// "eval<N>" contexts, so this one is kept as small as possible
+static const int EVAL_DEFAULT_CONTEXT = 256;
+
+// How often the runner thread polls handles and speculative counters
+static const int EVAL_POLL_MS = 1;
+
+// A speculative prefill that has not finished by then is left running
+static const double EVAL_SPECULATIVE_TIMEOUT_S = 60.0;
+
+// User and system CPU time of the whole process, -1 where unavailable
+static double process_cpu_seconds() {
+#ifdef LOCAL_LLM_RUSAGE
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1.0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#else
+    return -1.0;
+#endif
+}
+
+static bool is_finished(const Ref<LLMGenerationHandle>& p_handle) {
+    LLMGenerationHandle::Status status = p_handle->get_status();
+    return status != LLMGenerationHandle::STATUS_PENDING && status != LLMGenerationHandle::STATUS_RUNNING;
+}
+
+void LLMEvalRunner::_bind_methods() {
+    ADD_SIGNAL(MethodInfo("configuration_finished", PropertyInfo(Variant::DICTIONARY, "row")));
+    ADD_SIGNAL(MethodInfo("finished", PropertyInfo(Variant::ARRAY, "results")));
+
+    ClassDB::bind_method(D_METHOD("start", "prompts", "matrix"), &LLMEvalRunner::start);
+    ClassDB::bind_method(D_METHOD("cancel"), &LLMEvalRunner::cancel);
+    ClassDB::bind_method(D_METHOD("is_running"), &LLMEvalRunner::is_running);
+    ClassDB::bind_method(D_METHOD("get_progress"), &LLMEvalRunner::get_progress);
+    ClassDB::bind_method(D_METHOD("get_results"), &LLMEvalRunner::get_results);
+    ClassDB::bind_method(D_METHOD("format_table"), &LLMEvalRunner::format_table);
+
+    // Internal deferred methods
+    ClassDB::bind_method(D_METHOD("_emit_configuration_finished_deferred", "row"), &LLMEvalRunner::_emit_configuration_finished_deferred);
+    ClassDB::bind_method(D_METHOD("_emit_finished_deferred", "results"), &LLMEvalRunner::_emit_finished_deferred);
+}
+
+LLMEvalRunner::LLMEvalRunner() {
+}
+
+LLMEvalRunner::~LLMEvalRunner() {
+    m_cancel.store(true, std::memory_order_release);
+    if (m_thread && m_thread->joinable()) {
+        m_thread->join();
+    }
+}
+
+bool LLMEvalRunner::start(const Array& p_prompts, const Dictionary& p_matrix) {
+    if (m_running.load(std::memory_order_acquire)) {
+        return false;
+    }
+    if (m_thread && m_thread->joinable()) {
+        m_thread->join();
+    }
+
+    m_prompts.clear();
+    for (int i = 0; i < p_prompts.size(); i++) {
+        Variant entry = p_prompts[i];
+        EvalPrompt prompt;
+        if (entry.get_type() == Variant::DICTIONARY) {
+            Dictionary dict = entry;
+            prompt.prompt = dict.get("prompt", "");
+            prompt.system_prompt = dict.get("system_prompt", "");
+            prompt.max_tokens = dict.get("max_tokens", p_matrix.get("max_tokens", 512));
+        } else {
+            prompt.prompt = entry;
+            prompt.max_tokens = p_matrix.get("max_tokens", 512);
+        }
+        if (!prompt.prompt.is_empty()) {
+            m_prompts.push_back(prompt);
+        }
+    }
+
+    Array models = p_matrix.get("models", Array());
+    Array kv_types = p_matrix.get("kv_types", Array());
+    Array speculative = p_matrix.get("speculative", Array());
+    Array concurrency = p_matrix.get("concurrency", Array());
+    if (kv_types.is_empty()) {
+        kv_types.push_back("f16");
+    }
+    if (speculative.is_empty()) {
+        speculative.push_back("off");
+    }
+    if (concurrency.is_empty()) {
+        concurrency.push_back(1);
+    }
+
+    // Model-major order so every model is loaded once
+    m_configs.clear();
+    for (int m = 0; m < models.size(); m++) {
+        Variant model = models[m];
+        EvalConfig config;
+        if (model.get_type() == Variant::DICTIONARY) {
+            Dictionary dict = model;
+            config.model_path = dict.get("path", "");
+            config.model_id = dict.get("id", config.model_path.get_file());
+        } else {
+            config.model_path = model;
+            config.model_id = config.model_path.get_file();
+        }
+        for (int k = 0; k < kv_types.size(); k++) {
+            for (int s = 0; s < speculative.size(); s++) {
+                for (int c = 0; c < concurrency.size(); c++) {
+                    config.kv_type = kv_types[k];
+                    config.speculative = speculative[s];
+                    config.concurrency = std::max(1, static_cast<int>(concurrency[c]));
+                    m_configs.push_back(config);
+                }
+            }
+        }
+    }
+    if (m_prompts.empty() || m_configs.empty()) {
+        return false;
+    }
+
+    m_validator = p_matrix.get("validator", "");
+    m_validator_args = p_matrix.get("validator_args", PackedStringArray());
+    if (m_validator_args.is_empty()) {
+        m_validator_args.push_back("{file}");
+    }
+    m_output_dir = p_matrix.get("output_dir", "user://eval_matrix");
+    m_n_ctx = p_matrix.get("n_ctx", 4096);
+    m_n_threads = p_matrix.get("n_threads", 0);
+    if (m_n_threads <= 0) {
+        m_n_threads = std::max(1, OS::get_singleton()->get_processor_count() / 2);
+    }
+    m_n_gpu_layers = p_matrix.get("n_gpu_layers", 0);
+    m_temperature = p_matrix.get("temperature", 0.0f);
+
+    // Draft settings for "lookup" rows; the requests turn it on and off
+    m_lookup_decoding = p_matrix.get("lookup_decoding", Dictionary());
+
+    m_cancel.store(false, std::memory_order_release);
+    m_configs_done.store(0, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_result_mutex);
+        m_results = Array();
+    }
+
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::make_unique<std::thread>(&LLMEvalRunner::_run, this);
+    return true;
+}
+
+void LLMEvalRunner::cancel() {
+    m_cancel.store(true, std::memory_order_release);
+}
+
+bool LLMEvalRunner::is_running() const {
+    return m_running.load(std::memory_order_acquire);
+}
+
+float LLMEvalRunner::get_progress() const {
+    if (m_configs.empty()) {
+        return 0.0f;
+    }
+    return static_cast<float>(m_configs_done.load(std::memory_order_acquire)) / m_configs.size();
+}
+
+Array LLMEvalRunner::get_results() {
+    std::lock_guard<std::mutex> lock(m_result_mutex);
+    return m_results.duplicate();
+}
+
+void LLMEvalRunner::_run() {
+    DirAccess::make_dir_recursive_absolute(ProjectSettings::get_singleton()->globalize_path(m_output_dir));
+
+    m_provider.instantiate();
+    m_provider->set_n_threads(m_n_threads);
+    m_provider->set_n_gpu_layers(m_n_gpu_layers);
+    for (const EvalConfig& config : m_configs) {
+        m_provider->set_lookup_decoding(config.model_id, m_lookup_decoding);
+    }
+
+    String loaded_path;
+    for (size_t i = 0; i < m_configs.size() && !m_cancel.load(std::memory_order_acquire); i++) {
+        const EvalConfig& config = m_configs[i];
+        Dictionary row;
+        if (config.model_path != loaded_path) {
+            loaded_path = "";
+            if (m_provider->load_model(config.model_path, config.model_id, EVAL_DEFAULT_CONTEXT, m_n_threads, m_n_gpu_layers)) {
+                loaded_path = config.model_path;
+            }
+        }
+        if (loaded_path.is_empty()) {
+            row["model"] = config.model_id;
+            row["kv_type"] = config.kv_type;
+            row["speculative"] = config.speculative;
+            row["concurrency"] = config.concurrency;
+            row["error"] = "Failed to load model: " + config.model_path;
+        } else {
+            row = _run_config(config, static_cast<int>(i));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_result_mutex);
+            m_results.push_back(row);
+        }
+        m_configs_done.fetch_add(1, std::memory_order_acq_rel);
+        call_deferred("_emit_configuration_finished_deferred", row);
+    }
+
+    m_provider->unload_model();
+    m_provider.unref();
+
+    m_running.store(false, std::memory_order_release);
+    call_deferred("_emit_finished_deferred", get_results());
+}
+
+Dictionary LLMEvalRunner::_run_config(const EvalConfig& p_config, int p_index) {
+    Dictionary row;
+    row["model"] = p_config.model_id;
+    row["kv_type"] = p_config.kv_type;
+    row["speculative"] = p_config.speculative;
+    row["concurrency"] = p_config.concurrency;
+    row["requests"] = static_cast<int64_t>(m_prompts.size());
+
+    if (p_config.speculative != "off" && p_config.speculative != "prefill" && p_config.speculative != "lookup") {
+        row["error"] = "Unknown speculative mode: " + p_config.speculative;
+        return row;
+    }
+
+    // One context per concurrent request, splitting the thread budget
+    const int concurrency = p_config.concurrency;
+    std::vector<String> contexts;
+    for (int j = 0; j < concurrency; j++) {
+        String name = "eval" + String::num_int64(j);
+        Dictionary context_config;
+        context_config["n_ctx"] = m_n_ctx;
+        context_config["type_k"] = p_config.kv_type;
+        context_config["type_v"] = p_config.kv_type;
+        context_config["n_threads"] = std::max(1, m_n_threads / concurrency);
+        if (!m_provider->create_context(name, context_config)) {
+            row["error"] = "Failed to create context " + name + " (" + p_config.kv_type + ")";
+            break;
+        }
+        contexts.push_back(name);
+    }
+
+    const bool lookup_decoding = p_config.speculative == "lookup";
+    m_provider->reset_lookup_decoding_stats();
+
+    std::vector<EvalSample> samples(m_prompts.size());
+    double cpu_start = process_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+
+    // Waves of one request per context
+    for (size_t first = 0; !row.has("error") && first < m_prompts.size(); first += concurrency) {
+        if (m_cancel.load(std::memory_order_acquire)) {
+            row["error"] = "Cancelled";
+            break;
+        }
+        size_t n = std::min(static_cast<size_t>(concurrency), m_prompts.size() - first);
+
+        // Warm the system prompt while the contexts are idle, as the game
+        // does while the player is still typing
+        if (p_config.speculative == "prefill") {
+            Dictionary stats = m_provider->get_speculative_stats();
+            int64_t target = static_cast<int64_t>(stats.get("completed", 0)) + static_cast<int64_t>(stats.get("preempted", 0));
+            for (size_t j = 0; j < n; j++) {
+                Dictionary request;
+                request["system_prompt"] = m_prompts[first + j].system_prompt;
+                request["prompt"] = "";
+                request["mode"] = "prefill";
+                request["context"] = contexts[j];
+                if (!m_provider->register_speculative_request(request).is_empty()) {
+                    target++;
+                }
+            }
+            _wait_for_speculative(target);
+        }
+
+        std::vector<Ref<LLMGenerationHandle>> handles;
+        for (size_t j = 0; j < n; j++) {
+            const EvalPrompt& prompt = m_prompts[first + j];
+            Dictionary request;
+            request["prompt"] = prompt.prompt;
+            request["system_prompt"] = prompt.system_prompt;
+            request["max_tokens"] = prompt.max_tokens;
+            request["temperature"] = m_temperature;
+            request["cache"] = false;
+            request["context"] = contexts[j];
+            request["lookup_decoding"] = lookup_decoding;
+            handles.push_back(m_provider->generate(request));
+        }
+        for (size_t j = 0; j < n; j++) {
+            while (!is_finished(handles[j])) {
+                if (m_cancel.load(std::memory_order_acquire)) {
+                    handles[j]->request_cancel();
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(EVAL_POLL_MS));
+            }
+            EvalSample& sample = samples[first + j];
+            sample.completed = handles[j]->get_status() == LLMGenerationHandle::STATUS_COMPLETED;
+            sample.text = handles[j]->get_full_text();
+            sample.tokens = handles[j]->get_tokens_generated();
+            sample.ttft = handles[j]->get_time_to_first_token();
+        }
+    }
+
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double cpu_end = process_cpu_seconds();
+    for (const String& name : contexts) {
+        m_provider->destroy_context(name);
+    }
+
+    // Validation runs outside the timed section
+    int64_t completed = 0;
+    int64_t passed = 0;
+    int64_t tokens = 0;
+    int64_t ttft_count = 0;
+    double ttft_total = 0.0;
+    double ttft_max = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        const EvalSample& sample = samples[i];
+        if (!sample.completed) {
+            continue;
+        }
+        completed++;
+        tokens += sample.tokens;
+        if (sample.ttft >= 0.0) {
+            ttft_count++;
+            ttft_total += sample.ttft;
+            ttft_max = std::max(ttft_max, sample.ttft);
+        }
+        String output;
+        String name = String::num_int64(p_index) + "_" + String::num_int64(static_cast<int64_t>(i));
+        if (_validate(sample.text, name, output)) {
+            passed++;
+        }
+    }
+
+    row["completed"] = completed;
+    row["passed"] = passed;
+    row["pass_rate"] = samples.empty() ? 0.0 : static_cast<double>(passed) / samples.size();
+    row["tokens"] = tokens;
+    row["tokens_per_second"] = wall_s > 0.0 ? tokens / wall_s : 0.0;
+    row["ttft_ms"] = ttft_count > 0 ? ttft_total / ttft_count * 1000.0 : -1.0;
+    row["ttft_ms_max"] = ttft_max * 1000.0;
+    row["wall_s"] = wall_s;
+    row["cpu_s"] = cpu_start >= 0.0 && cpu_end >= 0.0 ? cpu_end - cpu_start : -1.0;
+    if (lookup_decoding) {
+        Dictionary stats = m_provider->get_lookup_decoding_stats();
+        row["acceptance_rate"] = stats["acceptance_rate"];
+        row["tokens_per_decode"] = stats["tokens_per_decode"];
+    }
+    return row;
+}
+
+bool LLMEvalRunner::_wait_for_speculative(int64_t p_target) {
+    auto start = std::chrono::steady_clock::now();
+    while (!m_cancel.load(std::memory_order_acquire)) {
+        Dictionary stats = m_provider->get_speculative_stats();
+        if (static_cast<int64_t>(stats.get("completed", 0)) + static_cast<int64_t>(stats.get("preempted", 0)) >= p_target) {
+            return true;
+        }
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > EVAL_SPECULATIVE_TIMEOUT_S) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(EVAL_POLL_MS));
+    }
+    return false;
+}
+
+bool LLMEvalRunner::_validate(const String& p_text, const String& p_name, String& r_output) {
+    if (m_validator.is_empty()) {
+        return true;
+    }
+
+    // The validator reads the output from a file; "{file}" in its arguments
+    // is replaced with the absolute path
+    String path = m_output_dir.path_join(p_name + ".txt");
+    Ref<FileAccess> file = FileAccess::open(path, FileAccess::WRITE);
+    if (file.is_null()) {
+        r_output = "Failed to write " + path;
+        return false;
+    }
+    file->store_string(p_text);
+    file->close();
+
+    String absolute = ProjectSettings::get_singleton()->globalize_path(path);
+    PackedStringArray args;
+    for (int i = 0; i < m_validator_args.size(); i++) {
+        args.push_back(m_validator_args[i].replace("{file}", absolute));
+    }
+    Array output;
+    int exit_code = OS::get_singleton()->execute(m_validator, args, output, true);
+    if (!output.is_empty()) {
+        r_output = output[0];
+    }
+    return exit_code == 0;
+}
+
+String LLMEvalRunner::format_table() {
+    Array results = get_results();
+    String table = "| model | kv | speculative | concurrency | pass rate | tok/s | TTFT ms | CPU s |\n";
+    table += "|---|---|---|---|---|---|---|---|\n";
+    for (int i = 0; i < results.size(); i++) {
+        Dictionary row = results[i];
+        String prefix = "| " + String(row.get("model", "")) + " | " + String(row.get("kv_type", "")) + " | " +
+                        String(row.get("speculative", "")) + " | " + String::num_int64(row.get("concurrency", 1)) + " | ";
+        if (row.has("error")) {
+            table += prefix + String(row["error"]) + " | | | |\n";
+            continue;
+        }
+        table += prefix +
+                 String::num(static_cast<double>(row["pass_rate"]) * 100.0, 1) + "% | " +
+                 String::num(row["tokens_per_second"], 1) + " | " +
+                 String::num(row["ttft_ms"], 0) + " | " +
+                 String::num(row["cpu_s"], 1) + " |\n";
+    }
+    return table;
+}
+
+void LLMEvalRunner::_emit_configuration_finished_deferred(const Dictionary& p_row) {
+    emit_signal("configuration_finished", p_row);
+}
+
+void LLMEvalRunner::_emit_finished_deferred(const Array& p_results) {
+    emit_signal("finished", p_results);
+}
+
+} // namespace godot
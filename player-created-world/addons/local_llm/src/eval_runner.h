@@ -0,0 +1,125 @@
+#ifndef EVAL_RUNNER_H
+#define EVAL_RUNNER_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include "llama_cpp_provider.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace godot {
+
+/// Runs a prompt suite across a matrix of models, KV cache types,
+/// speculative modes and concurrency levels on a private LlamaCppProvider,
+/// and reports pass rate (via an external validator command), tokens/sec,
+/// time to first token and process CPU-seconds per configuration.
+///
+/// Concurrency c runs c contexts over the same weights, each with 1/c of
+/// the threads, so every configuration spends the same CPU budget.
+class LLMEvalRunner : public RefCounted {
+    GDCLASS(LLMEvalRunner, RefCounted);
+
+protected:
+    static void _bind_methods();
+
+private:
+    struct EvalPrompt {
+        String prompt;
+        String system_prompt;
+        int max_tokens = 512;
+    };
+
+    struct EvalConfig {
+        String model_id;
+        String model_path;
+        String kv_type;
+        String speculative;
+        int concurrency = 1;
+    };
+
+    // One finished request, validated after the timed part of the run
+    struct EvalSample {
+        String text;
+        int tokens = 0;
+        double ttft = -1.0;
+        bool completed = false;
+    };
+
+    Ref<LlamaCppProvider> m_provider;
+    std::vector<EvalPrompt> m_prompts;
+    std::vector<EvalConfig> m_configs;
+    String m_validator;
+    PackedStringArray m_validator_args;
+    String m_output_dir;
+    int m_n_ctx = 4096;
+    int m_n_threads = 0;
+    int m_n_gpu_layers = 0;
+    float m_temperature = 0.0f;
+    Dictionary m_lookup_decoding;
+
+    std::unique_ptr<std::thread> m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_cancel{false};
+    std::atomic<int> m_configs_done{0};
+
+    std::mutex m_result_mutex;
+    Array m_results;
+
+    void _run();
+    Dictionary _run_config(const EvalConfig& p_config, int p_index);
+    bool _wait_for_speculative(int64_t p_target);
+    bool _validate(const String& p_text, const String& p_name, String& r_output);
+
+public:
+    LLMEvalRunner();
+    ~LLMEvalRunner();
+
+    /// Start the matrix in the background. Emits configuration_finished per
+    /// row and finished once.
+    /// @param prompts Strings or { prompt, system_prompt, max_tokens }
+    /// @param matrix models (paths or { id, path }), kv_types (["f16"]),
+    ///        speculative (["off"]; "prefill" warms each prompt's system
+    ///        prompt on an idle context before it is sent, "lookup" decodes
+    ///        with prompt-lookup drafts, per lookup_decoding: { ngram,
+    ///        draft_max }), concurrency ([1]),
+    ///        n_ctx (4096), n_threads (0 = recommended), n_gpu_layers (0),
+    ///        temperature (0.0), validator (command; empty = every completed
+    ///        request passes), validator_args (["{file}"]), output_dir
+    ///        ("user://eval_matrix")
+    /// @return false if a run is already in progress or the input is empty
+    bool start(const Array& prompts, const Dictionary& matrix);
+
+    /// Stop after the current wave of requests
+    void cancel();
+
+    bool is_running() const;
+
+    /// Fraction of configurations finished (0.0 to 1.0)
+    float get_progress() const;
+
+    /// One row per configuration: model, kv_type, speculative, concurrency,
+    /// requests, completed, passed, pass_rate, tokens, tokens_per_second,
+    /// ttft_ms, ttft_ms_max, wall_s, cpu_s, error; acceptance_rate and
+    /// tokens_per_decode for "lookup" rows
+    Array get_results();
+
+    /// get_results() as a Markdown table
+    String format_table();
+
+    // Called via call_deferred from the runner thread
+    void _emit_configuration_finished_deferred(const Dictionary& p_row);
+    void _emit_finished_deferred(const Array& p_results);
+};
+
+} // namespace godot
+
+#endif // EVAL_RUNNER_H
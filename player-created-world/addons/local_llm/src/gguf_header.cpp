@@ -0,0 +1,266 @@
+#include "gguf_header.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace godot {
+
+// GGUF metadata value types (gguf_type in ggml)
+enum GGUFValueType : uint32_t {
+    GGUF_VALUE_UINT8 = 0,
+    GGUF_VALUE_INT8 = 1,
+    GGUF_VALUE_UINT16 = 2,
+    GGUF_VALUE_INT16 = 3,
+    GGUF_VALUE_UINT32 = 4,
+    GGUF_VALUE_INT32 = 5,
+    GGUF_VALUE_FLOAT32 = 6,
+    GGUF_VALUE_BOOL = 7,
+    GGUF_VALUE_STRING = 8,
+    GGUF_VALUE_ARRAY = 9,
+    GGUF_VALUE_UINT64 = 10,
+    GGUF_VALUE_INT64 = 11,
+    GGUF_VALUE_FLOAT64 = 12,
+};
+
+static const uint32_t GGUF_MAGIC = 0x46554747; // "GGUF" little-endian
+
+// Bounds-checked little-endian reader. A read past the buffer leaves
+// m_short set; a length that runs past the end of the file (p_limit) leaves
+// m_invalid set, since more bytes cannot help. Lengths are compared against
+// the remaining bytes so corrupt 64-bit values cannot wrap the cursor.
+class GGUFCursor {
+public:
+    GGUFCursor(const uint8_t* p_data, size_t p_size, uint64_t p_limit) :
+            m_data(p_data), m_size(p_size), m_limit(std::max<uint64_t>(p_limit, p_size)) {}
+
+    template <typename T>
+    bool read(T& r_value) {
+        if (!_fits(sizeof(T))) {
+            return false;
+        }
+        std::memcpy(&r_value, m_data + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return true;
+    }
+
+    bool read_string(std::string& r_value) {
+        uint64_t len = 0;
+        if (!read(len) || !_fits(len)) {
+            return false;
+        }
+        r_value.assign(reinterpret_cast<const char*>(m_data + m_pos), len);
+        m_pos += len;
+        return true;
+    }
+
+    bool skip(uint64_t p_bytes) {
+        if (!_fits(p_bytes)) {
+            return false;
+        }
+        m_pos += p_bytes;
+        return true;
+    }
+
+    void invalidate() { m_invalid = true; }
+
+    size_t position() const { return m_pos; }
+    bool ok() const { return !m_short && !m_invalid; }
+    bool is_short() const { return m_short; }
+    bool is_invalid() const { return m_invalid; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    uint64_t m_limit;
+    size_t m_pos = 0;
+    bool m_short = false;
+    bool m_invalid = false;
+
+    bool _fits(uint64_t p_bytes) {
+        if (!ok()) {
+            return false;
+        }
+        if (p_bytes > m_limit - m_pos) {
+            m_invalid = true;
+            return false;
+        }
+        if (p_bytes > m_size - m_pos) {
+            m_short = true;
+            return false;
+        }
+        return true;
+    }
+};
+
+static int gguf_scalar_size(uint32_t p_type) {
+    switch (p_type) {
+        case GGUF_VALUE_UINT8:
+        case GGUF_VALUE_INT8:
+        case GGUF_VALUE_BOOL:
+            return 1;
+        case GGUF_VALUE_UINT16:
+        case GGUF_VALUE_INT16:
+            return 2;
+        case GGUF_VALUE_UINT32:
+        case GGUF_VALUE_INT32:
+        case GGUF_VALUE_FLOAT32:
+            return 4;
+        case GGUF_VALUE_UINT64:
+        case GGUF_VALUE_INT64:
+        case GGUF_VALUE_FLOAT64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+static bool read_scalar(GGUFCursor& p_cursor, uint32_t p_type, Variant& r_value) {
+    switch (p_type) {
+        case GGUF_VALUE_UINT8: { uint8_t v = 0; p_cursor.read(v); r_value = static_cast<int64_t>(v); } break;
+        case GGUF_VALUE_INT8: { int8_t v = 0; p_cursor.read(v); r_value = static_cast<int64_t>(v); } break;
+        case GGUF_VALUE_UINT16: { uint16_t v = 0; p_cursor.read(v); r_value = static_cast<int64_t>(v); } break;
+        case GGUF_VALUE_INT16: { int16_t v = 0; p_cursor.read(v); r_value = static_cast<int64_t>(v); } break;
+        case GGUF_VALUE_UINT32: { uint32_t v = 0; p_cursor.read(v); r_value = static_cast<int64_t>(v); } break;
+        case GGUF_VALUE_INT32: { int32_t v = 0; p_cursor.read(v); r_value = static_cast<int64_t>(v); } break;
+        case GGUF_VALUE_UINT64: { uint64_t v = 0; p_cursor.read(v); r_value = static_cast<int64_t>(v); } break;
+        case GGUF_VALUE_INT64: { int64_t v = 0; p_cursor.read(v); r_value = v; } break;
+        case GGUF_VALUE_FLOAT32: { float v = 0; p_cursor.read(v); r_value = static_cast<double>(v); } break;
+        case GGUF_VALUE_FLOAT64: { double v = 0; p_cursor.read(v); r_value = v; } break;
+        case GGUF_VALUE_BOOL: { uint8_t v = 0; p_cursor.read(v); r_value = v != 0; } break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+GGUFParseResult parse_gguf_header(
+    const uint8_t* p_data,
+    size_t p_size,
+    uint64_t p_file_size,
+    GGUFHeader& r_header,
+    String& r_error
+) {
+    GGUFCursor cursor(p_data, p_size, p_file_size);
+    r_header = GGUFHeader();
+
+    uint32_t magic = 0;
+    uint64_t n_tensors = 0;
+    uint64_t n_kv = 0;
+    cursor.read(magic);
+    cursor.read(r_header.version);
+    cursor.read(n_tensors);
+    cursor.read(n_kv);
+    if (cursor.is_invalid()) {
+        r_error = "Truncated GGUF file";
+        return GGUF_PARSE_INVALID;
+    }
+    if (cursor.is_short()) {
+        return GGUF_PARSE_NEED_MORE;
+    }
+    if (magic != GGUF_MAGIC) {
+        r_error = "Not a GGUF file";
+        return GGUF_PARSE_INVALID;
+    }
+    if (r_header.version < 2) {
+        r_error = "Unsupported GGUF version " + String::num_int64(r_header.version);
+        return GGUF_PARSE_INVALID;
+    }
+
+    for (uint64_t i = 0; i < n_kv && cursor.ok(); i++) {
+        std::string key;
+        uint32_t type = 0;
+        cursor.read_string(key);
+        cursor.read(type);
+
+        if (type == GGUF_VALUE_STRING) {
+            std::string value;
+            cursor.read_string(value);
+            r_header.metadata[String::utf8(key.c_str())] = String::utf8(value.c_str(), value.size());
+        } else if (type == GGUF_VALUE_ARRAY) {
+            uint32_t elem_type = 0;
+            uint64_t count = 0;
+            cursor.read(elem_type);
+            cursor.read(count);
+            if (elem_type == GGUF_VALUE_STRING) {
+                for (uint64_t j = 0; j < count && cursor.ok(); j++) {
+                    uint64_t len = 0;
+                    cursor.read(len);
+                    cursor.skip(len);
+                }
+            } else {
+                int elem_size = gguf_scalar_size(elem_type);
+                if (elem_size == 0) {
+                    r_error = "Invalid GGUF array type for " + String::utf8(key.c_str());
+                    return GGUF_PARSE_INVALID;
+                }
+                if (count > UINT64_MAX / elem_size) {
+                    cursor.invalidate();
+                } else {
+                    cursor.skip(count * elem_size);
+                }
+            }
+            r_header.metadata[String::utf8(key.c_str())] = static_cast<int64_t>(count);
+        } else {
+            Variant value;
+            if (!read_scalar(cursor, type, value)) {
+                r_error = "Invalid GGUF value type for " + String::utf8(key.c_str());
+                return GGUF_PARSE_INVALID;
+            }
+            r_header.metadata[String::utf8(key.c_str())] = value;
+        }
+    }
+
+    r_header.tensors.reserve(std::min<uint64_t>(n_tensors, 1 << 16));
+    for (uint64_t i = 0; i < n_tensors && cursor.ok(); i++) {
+        GGUFTensorRange tensor;
+        uint32_t n_dims = 0;
+        uint32_t type = 0;
+        cursor.read_string(tensor.name);
+        cursor.read(n_dims);
+        cursor.skip(static_cast<uint64_t>(n_dims) * sizeof(uint64_t));
+        cursor.read(type);
+        cursor.read(tensor.offset);
+        r_header.tensors.push_back(std::move(tensor));
+    }
+    if (cursor.is_invalid()) {
+        r_error = "GGUF header declares data past the end of the file";
+        return GGUF_PARSE_INVALID;
+    }
+    if (cursor.is_short()) {
+        return GGUF_PARSE_NEED_MORE;
+    }
+
+    int64_t alignment = r_header.metadata.get("general.alignment", 32);
+    if (alignment <= 0 || (alignment & (alignment - 1)) != 0) {
+        r_error = "Invalid GGUF alignment";
+        return GGUF_PARSE_INVALID;
+    }
+    r_header.alignment = static_cast<uint32_t>(alignment);
+    r_header.data_offset = (cursor.position() + alignment - 1) & ~static_cast<uint64_t>(alignment - 1);
+
+    // Sizes follow from the distance to the next tensor, which avoids
+    // needing ggml's per-type block size table here
+    std::sort(r_header.tensors.begin(), r_header.tensors.end(),
+              [](const GGUFTensorRange& a, const GGUFTensorRange& b) { return a.offset < b.offset; });
+    if (r_header.data_offset > p_file_size) {
+        r_error = "GGUF tensor data out of range";
+        return GGUF_PARSE_INVALID;
+    }
+    const uint64_t data_bytes = p_file_size - r_header.data_offset;
+    for (size_t i = 0; i < r_header.tensors.size(); i++) {
+        GGUFTensorRange& tensor = r_header.tensors[i];
+        // Offsets are relative to the data section; compare before adding
+        // so a corrupt offset cannot wrap around
+        uint64_t next = i + 1 < r_header.tensors.size() ? r_header.tensors[i + 1].offset : data_bytes;
+        if (tensor.offset > next || next > data_bytes) {
+            r_error = "GGUF tensor data out of range: " + String::utf8(tensor.name.c_str());
+            return GGUF_PARSE_INVALID;
+        }
+        tensor.size = next - tensor.offset;
+        tensor.offset += r_header.data_offset;
+    }
+
+    return GGUF_PARSE_OK;
+}
+
+} // namespace godot
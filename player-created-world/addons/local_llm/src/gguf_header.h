@@ -0,0 +1,54 @@
+#ifndef GGUF_HEADER_H
+#define GGUF_HEADER_H
+
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace godot {
+
+/// Location of one tensor's data within a GGUF file.
+struct GGUFTensorRange {
+    std::string name;
+    uint64_t offset = 0; // absolute file offset
+    uint64_t size = 0;   // bytes, up to the next tensor (includes padding)
+};
+
+/// The parts of a GGUF header the extension needs without loading the model.
+struct GGUFHeader {
+    uint32_t version = 0;
+    uint32_t alignment = 32;
+    uint64_t data_offset = 0;
+    /// Scalar and string metadata; arrays are recorded as their length
+    Dictionary metadata;
+    std::vector<GGUFTensorRange> tensors;
+};
+
+enum GGUFParseResult {
+    GGUF_PARSE_OK,
+    GGUF_PARSE_NEED_MORE, // header extends past the buffer; retry with more bytes
+    GGUF_PARSE_INVALID,
+};
+
+/// Largest header callers grow their read buffer to. Real headers, large
+/// tokenizer vocabularies included, stay well below this.
+static const uint64_t GGUF_MAX_HEADER_BYTES = 64ull * 1024 * 1024;
+
+/// Parse a GGUF header from the first p_size bytes of a file of p_file_size
+/// bytes. Tensor ranges are returned sorted by offset. A length or offset
+/// that points past p_file_size is GGUF_PARSE_INVALID, not NEED_MORE.
+GGUFParseResult parse_gguf_header(
+    const uint8_t* p_data,
+    size_t p_size,
+    uint64_t p_file_size,
+    GGUFHeader& r_header,
+    String& r_error
+);
+
+} // namespace godot
+
+#endif // GGUF_HEADER_H
@@ -0,0 +1,334 @@
+#include "kv_tier_store.h"
+
+#include <godot_cpp/classes/dir_access.hpp>
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace godot {
+
+static size_t common_prefix(const std::vector<int32_t>& p_a, const std::vector<int32_t>& p_b) {
+    size_t n = 0;
+    while (n < p_a.size() && n < p_b.size() && p_a[n] == p_b[n]) {
+        n++;
+    }
+    return n;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point p_start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - p_start).count();
+}
+
+void KvTierStore::configure(int64_t p_host_budget, int64_t p_disk_budget, int p_min_tokens, const String& p_spill_dir) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_host_budget = std::max<int64_t>(0, p_host_budget);
+        m_disk_budget = std::max<int64_t>(0, p_disk_budget);
+        m_min_tokens = std::max(1, p_min_tokens);
+        m_spill_dir = p_spill_dir;
+        if (m_disk_budget > 0) {
+            DirAccess::make_dir_recursive_absolute(m_spill_dir);
+        }
+        _enforce_budgets(lock);
+    }
+    _delete_dead_files();
+    if (p_host_budget <= 0) {
+        clear();
+    }
+}
+
+bool KvTierStore::is_enabled() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_host_budget > 0;
+}
+
+int KvTierStore::get_min_tokens() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_min_tokens;
+}
+
+void KvTierStore::put(const String& p_cache_types, const std::vector<int32_t>& p_tokens, const std::vector<uint8_t>& p_state) {
+    if (!is_enabled() || static_cast<int>(p_tokens.size()) < get_min_tokens() || p_state.empty()) {
+        return;
+    }
+
+    // Compress outside the lock; other contexts may be restoring meanwhile
+    auto start = std::chrono::steady_clock::now();
+    PackedByteArray raw;
+    raw.resize(p_state.size());
+    memcpy(raw.ptrw(), p_state.data(), p_state.size());
+
+    Entry entry;
+    entry.cache_types = p_cache_types;
+    entry.tokens = p_tokens;
+    entry.data = raw.compress(FileAccess::COMPRESSION_FASTLZ);
+    entry.raw_bytes = static_cast<int64_t>(p_state.size());
+    entry.stored_bytes = entry.data.size();
+    double ms = elapsed_ms(start);
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool covered = false;
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            if (it->cache_types != p_cache_types) {
+                ++it;
+                continue;
+            }
+            size_t common = common_prefix(it->tokens, p_tokens);
+            if (common == p_tokens.size()) {
+                // A stored sequence already covers this one
+                covered = true;
+                break;
+            }
+            if (common == it->tokens.size()) {
+                auto stale = it++;
+                _remove(stale);
+                continue;
+            }
+            ++it;
+        }
+
+        if (!covered) {
+            entry.stamp = m_next_stamp++;
+            m_entries.push_front(std::move(entry));
+            m_saves++;
+            m_save_ms += ms;
+            _enforce_budgets(lock);
+        }
+    }
+    _delete_dead_files();
+}
+
+std::list<KvTierStore::Entry>::const_iterator KvTierStore::_find_best(
+        const String& p_cache_types, const std::vector<int32_t>& p_prompt, size_t& r_common) const {
+    auto best = m_entries.end();
+    r_common = 0;
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->cache_types != p_cache_types) {
+            continue;
+        }
+        size_t common = common_prefix(it->tokens, p_prompt);
+        if (common > r_common) {
+            r_common = common;
+            best = it;
+        }
+    }
+    return best;
+}
+
+size_t KvTierStore::best_match(const String& p_cache_types, const std::vector<int32_t>& p_prompt) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t common = 0;
+    _find_best(p_cache_types, p_prompt, common);
+    return common;
+}
+
+bool KvTierStore::take(const String& p_cache_types, const std::vector<int32_t>& p_prompt,
+                       std::vector<int32_t>& r_tokens, std::vector<uint8_t>& r_state, Tier& r_tier) {
+    // Unlink the entry under the lock, then decompress (and read the spill
+    // file) without it
+    std::list<Entry> taken;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t common = 0;
+        auto found = _find_best(p_cache_types, p_prompt, common);
+        if (found == m_entries.end()) {
+            return false;
+        }
+        taken.splice(taken.begin(), m_entries, found);
+    }
+    Entry& entry = taken.front();
+
+    PackedByteArray raw;
+    if (entry.tier == TIER_HOST) {
+        raw = entry.data.decompress(entry.raw_bytes, FileAccess::COMPRESSION_FASTLZ);
+    } else {
+        Ref<FileAccess> file = FileAccess::open(entry.file, FileAccess::READ);
+        if (file.is_valid()) {
+            raw = file->get_buffer(file->get_length()).decompress(entry.raw_bytes, FileAccess::COMPRESSION_ZSTD);
+            file->close();
+        }
+        DirAccess::remove_absolute(entry.file);
+    }
+
+    bool ok = raw.size() == entry.raw_bytes;
+    if (ok) {
+        r_tokens = std::move(entry.tokens);
+        r_state.resize(raw.size());
+        memcpy(r_state.data(), raw.ptr(), raw.size());
+        r_tier = entry.tier;
+    } else {
+        UtilityFunctions::print("[LocalLLM] WARNING: Dropping unreadable KV tier entry");
+    }
+    return ok;
+}
+
+void KvTierStore::report_restore(Tier p_tier, size_t p_tokens, double p_ms) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RestoreTotals& totals = m_restores[p_tier];
+    totals.count++;
+    totals.tokens += static_cast<int64_t>(p_tokens);
+    totals.ms += p_ms;
+}
+
+void KvTierStore::clear() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_entries.empty()) {
+            _remove(m_entries.begin());
+        }
+        m_generation++;
+    }
+    _delete_dead_files();
+}
+
+KvTierStore::TierTotals KvTierStore::_totals(Tier p_tier) const {
+    TierTotals totals;
+    for (const Entry& entry : m_entries) {
+        if (entry.tier == p_tier) {
+            totals.entries++;
+            totals.bytes += entry.stored_bytes;
+            totals.raw_bytes += entry.raw_bytes;
+        }
+    }
+    return totals;
+}
+
+void KvTierStore::_enforce_budgets(std::unique_lock<std::mutex>& p_lock) {
+    // Caller holds m_mutex. Least recently used entries go first: host
+    // entries move to disk (recompressed with zstd, which is slower but
+    // smaller), disk entries are dropped.
+    std::list<Entry> spilling;
+    std::vector<String> paths;
+    int64_t host_bytes = _totals(TIER_HOST).bytes;
+    for (auto it = m_entries.end(); host_bytes > m_host_budget && it != m_entries.begin();) {
+        --it;
+        if (it->tier != TIER_HOST) {
+            continue;
+        }
+        host_bytes -= it->stored_bytes;
+        auto victim = it++;
+        if (m_disk_budget <= 0) {
+            _remove(victim);
+            m_drops++;
+            continue;
+        }
+        // Unlinked while it is recompressed; take() and best_match() skip it
+        spilling.splice(spilling.end(), m_entries, victim);
+        paths.push_back(m_spill_dir.path_join(String::num_int64(m_next_file++) + ".kv"));
+    }
+
+    if (!spilling.empty()) {
+        const int64_t generation = m_generation;
+        p_lock.unlock();
+        size_t index = 0;
+        for (auto it = spilling.begin(); it != spilling.end(); index++) {
+            PackedByteArray packed = it->data.decompress(it->raw_bytes, FileAccess::COMPRESSION_FASTLZ)
+                                         .compress(FileAccess::COMPRESSION_ZSTD);
+            Ref<FileAccess> file = FileAccess::open(paths[index], FileAccess::WRITE);
+            if (file.is_null()) {
+                it = spilling.erase(it);
+                continue;
+            }
+            file->store_buffer(packed);
+            file->close();
+            it->tier = TIER_DISK;
+            it->file = paths[index];
+            it->data = PackedByteArray();
+            it->stored_bytes = packed.size();
+            ++it;
+        }
+        p_lock.lock();
+
+        m_drops += static_cast<int64_t>(paths.size() - spilling.size());
+        m_spills += static_cast<int64_t>(spilling.size());
+        while (!spilling.empty()) {
+            if (generation == m_generation) {
+                _insert(std::move(spilling.front()));
+            } else {
+                // The store was cleared meanwhile
+                m_dead_files.push_back(spilling.front().file);
+            }
+            spilling.pop_front();
+        }
+    }
+
+    int64_t disk_bytes = _totals(TIER_DISK).bytes;
+    for (auto it = m_entries.end(); disk_bytes > m_disk_budget && it != m_entries.begin();) {
+        --it;
+        if (it->tier != TIER_DISK) {
+            continue;
+        }
+        disk_bytes -= it->stored_bytes;
+        auto dropped = it++;
+        _remove(dropped);
+        m_drops++;
+    }
+}
+
+void KvTierStore::_insert(Entry&& p_entry) {
+    // Back in recency order, behind every newer entry
+    auto it = m_entries.begin();
+    while (it != m_entries.end() && it->stamp > p_entry.stamp) {
+        ++it;
+    }
+    m_entries.insert(it, std::move(p_entry));
+}
+
+void KvTierStore::_remove(std::list<Entry>::iterator p_it) {
+    if (p_it->tier == TIER_DISK && !p_it->file.is_empty()) {
+        m_dead_files.push_back(p_it->file);
+    }
+    m_entries.erase(p_it);
+}
+
+void KvTierStore::_delete_dead_files() {
+    std::vector<String> files;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        files.swap(m_dead_files);
+    }
+    for (const String& file : files) {
+        DirAccess::remove_absolute(file);
+    }
+}
+
+Dictionary KvTierStore::get_stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Dictionary stats;
+    stats["enabled"] = m_host_budget > 0;
+    const char* tier_names[2] = { "host", "disk" };
+    const int64_t budgets[2] = { m_host_budget, m_disk_budget };
+    Dictionary restores;
+    Dictionary restore_ms;
+    int64_t tokens_restored = 0;
+    for (int tier = TIER_HOST; tier <= TIER_DISK; tier++) {
+        TierTotals totals = _totals(static_cast<Tier>(tier));
+        Dictionary info;
+        info["entries"] = totals.entries;
+        info["bytes"] = totals.bytes;
+        info["raw_bytes"] = totals.raw_bytes;
+        info["ratio"] = totals.bytes > 0 ? static_cast<double>(totals.raw_bytes) / totals.bytes : 0.0;
+        info["budget"] = budgets[tier];
+        stats[tier_names[tier]] = info;
+
+        const RestoreTotals& restored = m_restores[tier];
+        restores[tier_names[tier]] = restored.count;
+        restore_ms[tier_names[tier]] = restored.tokens > 0 ? restored.ms * 1000.0 / restored.tokens : 0.0;
+        tokens_restored += restored.tokens;
+    }
+    stats["saves"] = m_saves;
+    stats["save_ms"] = m_save_ms;
+    stats["spills"] = m_spills;
+    stats["drops"] = m_drops;
+    stats["restores"] = restores;
+    stats["restore_ms_per_1k_tokens"] = restore_ms;
+    stats["tokens_restored"] = tokens_restored;
+    return stats;
+}
+
+} // namespace godot
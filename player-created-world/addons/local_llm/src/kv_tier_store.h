@@ -0,0 +1,110 @@
+#ifndef KV_TIER_STORE_H
+#define KV_TIER_STORE_H
+
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <vector>
+
+namespace godot {
+
+/// Off-context storage for KV sequences a context had to evict. Saved state
+/// is compressed with FastLZ and kept in host RAM; when the host tier is
+/// over budget the least recently used entries are recompressed with zstd
+/// and spilled to files, and past the disk budget they are dropped.
+/// Thread-safe: every context of a provider shares one store. Compression
+/// and file I/O run outside the lock, so one context spilling or restoring
+/// does not hold up the others.
+class KvTierStore {
+public:
+    enum Tier {
+        TIER_HOST,
+        TIER_DISK
+    };
+
+    /// Budgets in bytes of compressed data; a zero host budget disables the
+    /// store. p_min_tokens is the shortest sequence worth saving.
+    void configure(int64_t p_host_budget, int64_t p_disk_budget, int p_min_tokens, const String& p_spill_dir);
+    bool is_enabled() const;
+    int get_min_tokens() const;
+
+    /// Save the state of a sequence holding p_tokens. p_cache_types tells
+    /// contexts with different KV cache types apart; their states are not
+    /// interchangeable. An entry whose tokens are a prefix of p_tokens is
+    /// replaced.
+    void put(const String& p_cache_types, const std::vector<int32_t>& p_tokens, const std::vector<uint8_t>& p_state);
+
+    /// Length of the longest common prefix between p_prompt and any stored
+    /// entry of p_cache_types (0 if none)
+    size_t best_match(const String& p_cache_types, const std::vector<int32_t>& p_prompt) const;
+
+    /// Remove the entry best_match() found and return its decompressed state.
+    /// Call report_restore() once the state is back in a context.
+    bool take(const String& p_cache_types, const std::vector<int32_t>& p_prompt,
+              std::vector<int32_t>& r_tokens, std::vector<uint8_t>& r_state, Tier& r_tier);
+    void report_restore(Tier p_tier, size_t p_tokens, double p_ms);
+
+    /// Drop every entry and delete spilled files (the model is going away)
+    void clear();
+
+    /// enabled, host / disk: { entries, bytes, raw_bytes, ratio, budget },
+    /// saves, save_ms, spills, drops, restores: { host, disk },
+    /// restore_ms_per_1k_tokens: { host, disk }, tokens_restored
+    Dictionary get_stats() const;
+
+private:
+    struct Entry {
+        String cache_types;
+        std::vector<int32_t> tokens;
+        int64_t stamp = 0; // put order; entries are kept newest first
+        Tier tier = TIER_HOST;
+        PackedByteArray data; // host tier
+        String file;          // disk tier
+        int64_t raw_bytes = 0;
+        int64_t stored_bytes = 0;
+    };
+
+    struct TierTotals {
+        int64_t entries = 0;
+        int64_t bytes = 0;
+        int64_t raw_bytes = 0;
+    };
+
+    struct RestoreTotals {
+        int64_t count = 0;
+        int64_t tokens = 0;
+        double ms = 0.0;
+    };
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_entries; // most recently used first
+    int64_t m_host_budget = 0;
+    int64_t m_disk_budget = 0;
+    int m_min_tokens = 256;
+    String m_spill_dir;
+    int64_t m_next_file = 0;
+    int64_t m_next_stamp = 0;
+    int64_t m_generation = 0; // bumped by clear(); stale spills are dropped
+    std::vector<String> m_dead_files; // deleted once the lock is released
+
+    int64_t m_saves = 0;
+    double m_save_ms = 0.0;
+    int64_t m_spills = 0;
+    int64_t m_drops = 0;
+    RestoreTotals m_restores[2];
+
+    std::list<Entry>::const_iterator _find_best(const String& p_cache_types, const std::vector<int32_t>& p_prompt, size_t& r_common) const;
+    TierTotals _totals(Tier p_tier) const;
+    void _enforce_budgets(std::unique_lock<std::mutex>& p_lock);
+    void _insert(Entry&& p_entry);
+    void _remove(std::list<Entry>::iterator p_it);
+    void _delete_dead_files();
+};
+
+} // namespace godot
+
+#endif // KV_TIER_STORE_H
@@ -1,17 +1,243 @@
 #include "llama_cpp_provider.h"
 
 #include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/json.hpp>
 #include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/core/object.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
 // llama.cpp headers
 #include "llama.h"
+#include "memory_introspection.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <iterator>
 
 namespace godot {
 
+// Read size used when warming the page cache for an upcoming model
+static const int64_t PREFETCH_CHUNK_BYTES = 8 * 1024 * 1024;
+
+// Speculative prefill runs in small chunks so an interactive request never
+// waits for more than a few tokens' worth of decode before preempting it
+static const int SPECULATIVE_PREFILL_CHUNK = 32;
+
+// Bounds for the completion cache and the speculative queue
+static const int COMPLETION_CACHE_MAX_ENTRIES = 64;
+static const int SPECULATIVE_QUEUE_MAX = 16;
+
+// summarize_long(): chunk size when the caller does not pick one, the
+// smallest chunk worth a map step, how far back from a chunk end a paragraph
+// or sentence break may move the cut (1/N of the chunk), and the number of
+// map levels before giving up on an input whose summaries do not shrink
+static const int SUMMARIZE_DEFAULT_CHUNK_TOKENS = 1024;
+static const int SUMMARIZE_MIN_CHUNK_TOKENS = 64;
+static const int SUMMARIZE_BOUNDARY_DIVISOR = 8;
+static const int SUMMARIZE_MAX_LEVELS = 4;
+static const int SUMMARIZE_DEFAULT_MAX_TOKENS = 512;
+static const int SUMMARIZE_DEFAULT_CHUNK_MAX_TOKENS = 256;
+
+// Most chunk sequences a summarization wave decodes side by side. Every
+// context reserves that many sequence ids whatever its n_seq_max, since a
+// unified cache costs no cells per sequence; n_ctx sets the actual width.
+static const int SUMMARIZE_MAX_PARALLEL = 8;
+static const char* SUMMARIZE_DEFAULT_INSTRUCTIONS =
+    "Summarize the following text concisely. Keep names, numbers and decisions.";
+static const char* SUMMARIZE_DEFAULT_REDUCE_INSTRUCTIONS =
+    "The following are summaries of consecutive parts of one document. "
+    "Combine them into a single coherent summary.";
+
+// Elastic KV: cells reserved beyond what is needed when growing, allocation
+// granularity (llama.cpp pads n_ctx to 256) and how many consecutive small
+// requests it takes before a context shrinks
+static const int ELASTIC_GROW_HEADROOM = 256;
+static const int ELASTIC_STEP = 256;
+static const int ELASTIC_SHRINK_WINDOW = 8;
+
+// Prompt-lookup decoding: upper bounds for the lookup n-gram and the tokens drafted
+// per verify batch
+static const int LOOKUP_DECODING_MAX_NGRAM = 8;
+static const int LOOKUP_DECODING_MAX_DRAFT = 32;
+
+// Example composition: tokens at the start of every block evaluated in place
+// unless the request sets "example_recompute"
+static const int EXAMPLE_RECOMPUTE_TOKENS = 4;
+
+// Reranker context defaults: cells (also the longest pair) and pairs per decode
+static const int RERANKER_DEFAULT_N_CTX = 2048;
+static const int RERANKER_DEFAULT_SEQ_MAX = 8;
+
+static int round_up_cells(int p_cells) {
+    return (std::max(p_cells, 1) + ELASTIC_STEP - 1) / ELASTIC_STEP * ELASTIC_STEP;
+}
+
+// Name of the context load_model() creates; requests without "context" use it
+static const char* DEFAULT_CONTEXT = "default";
+
+static bool ends_with_any(const std::string& p_text, const std::vector<std::string>& p_suffixes) {
+    for (const std::string& suffix : p_suffixes) {
+        if (!suffix.empty() && p_text.size() >= suffix.size() &&
+                p_text.compare(p_text.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// KV cache element types accepted by create_context()
+struct KvCacheType {
+    const char* name;
+    ggml_type type;
+    double bytes_per_element;
+};
+static const KvCacheType KV_CACHE_TYPES[] = {
+    { "f16", GGML_TYPE_F16, 2.0 },
+    { "q8_0", GGML_TYPE_Q8_0, 34.0 / 32.0 },
+    { "q4_0", GGML_TYPE_Q4_0, 18.0 / 32.0 },
+};
+
+static const KvCacheType* find_kv_cache_type(const String& p_name) {
+    for (const KvCacheType& type : KV_CACHE_TYPES) {
+        if (p_name == type.name) {
+            return &type;
+        }
+    }
+    return nullptr;
+}
+
+// Unicode ranges behind the set_vocab_trim() presets
+struct CodepointRange {
+    int32_t first;
+    int32_t last;
+};
+static const CodepointRange VOCAB_TRIM_ASCII[] = { { 0x00, 0x7F } };
+static const CodepointRange VOCAB_TRIM_LATIN[] = {
+    { 0x00, 0x24F },   // Basic Latin through Latin Extended-B
+    { 0x2000, 0x206F }, // General Punctuation
+    { 0x20A0, 0x20CF }, // Currency Symbols
+};
+
+static bool overlaps_any(int32_t p_first, int32_t p_last, const std::vector<CodepointRange>& p_ranges) {
+    for (const CodepointRange& range : p_ranges) {
+        if (p_first <= range.last && p_last >= range.first) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether every character of a token's text lies in p_ranges. Byte-level
+// vocabularies split rare characters across tokens; a sequence cut off at
+// the end of a piece is kept if any character it could start is allowed,
+// and a piece starting mid-sequence if the ranges go past ASCII at all.
+static bool piece_in_ranges(const std::string& p_piece, const std::vector<CodepointRange>& p_ranges) {
+    size_t i = 0;
+    while (i < p_piece.size()) {
+        unsigned char lead = p_piece[i];
+        size_t len = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        if (len == 0) {
+            if (!overlaps_any(0x80, 0x10FFFF, p_ranges)) {
+                return false;
+            }
+            i++;
+            continue;
+        }
+        
+        int32_t codepoint = len == 1 ? lead : lead & (0xFF >> (len + 1));
+        size_t k = 1;
+        for (; k < len && i + k < p_piece.size(); k++) {
+            unsigned char next = p_piece[i + k];
+            if ((next & 0xC0) != 0x80) {
+                return false;
+            }
+            codepoint = (codepoint << 6) | (next & 0x3F);
+        }
+        int missing_bits = static_cast<int>(len - k) * 6;
+        int32_t first = codepoint << missing_bits;
+        if (!overlaps_any(first, first | ((1 << missing_bits) - 1), p_ranges)) {
+            return false;
+        }
+        i += k;
+    }
+    return true;
+}
+
+// Candidate sets always include the end-of-generation tokens
+static void add_end_tokens(const llama_vocab* p_vocab, std::vector<int32_t>& r_ids) {
+    for (llama_token id : { llama_vocab_eos(p_vocab), llama_vocab_eot(p_vocab) }) {
+        if (id != LLAMA_TOKEN_NULL) {
+            r_ids.push_back(id);
+        }
+    }
+    std::sort(r_ids.begin(), r_ids.end());
+    r_ids.erase(std::unique(r_ids.begin(), r_ids.end()), r_ids.end());
+}
+
+// llama_sampler_sample() restricted to p_ids: only the listed logits are copied
+// and the chain runs over a few entries instead of the whole vocabulary
+static llama_token sample_candidates(llama_sampler* p_sampler, llama_context* p_ctx, int32_t p_idx,
+                                     const std::vector<int32_t>& p_ids, std::vector<llama_token_data>& r_scratch) {
+    const float* logits = llama_get_logits_ith(p_ctx, p_idx);
+    r_scratch.resize(p_ids.size());
+    for (size_t i = 0; i < p_ids.size(); i++) {
+        r_scratch[i] = { p_ids[i], logits[p_ids[i]], 0.0f };
+    }
+    llama_token_data_array candidates = { r_scratch.data(), r_scratch.size(), -1, false };
+    llama_sampler_apply(p_sampler, &candidates);
+    llama_token token = candidates.data[candidates.selected].id;
+    llama_sampler_accept(p_sampler, token);
+    return token;
+}
+
+// Prompt-lookup drafts: the tokens that followed the most
+// recent earlier occurrence of the last p_ngram tokens of prompt and output
+static void draft_from_history(const std::vector<int32_t>& p_history, int p_ngram, int p_max, std::vector<int32_t>& r_draft) {
+    r_draft.clear();
+    size_t n = p_history.size();
+    if (p_max <= 0 || p_ngram <= 0 || n <= static_cast<size_t>(p_ngram)) {
+        return;
+    }
+    const int32_t* tail = p_history.data() + n - p_ngram;
+    for (size_t start = n - p_ngram; start-- > 0;) {
+        if (std::equal(tail, tail + p_ngram, p_history.data() + start)) {
+            size_t from = start + p_ngram;
+            size_t count = std::min(static_cast<size_t>(p_max), n - from);
+            r_draft.assign(p_history.begin() + from, p_history.begin() + from + count);
+            return;
+        }
+    }
+}
+
+static size_t common_prefix(const std::vector<int32_t>& p_a, const std::vector<int32_t>& p_b) {
+    size_t n = 0;
+    while (n < p_a.size() && n < p_b.size() && p_a[n] == p_b[n]) {
+        n++;
+    }
+    return n;
+}
+
+// llama.cpp reports compute buffer sizes only through its log; capture them
+// while a context is being created on this thread
+static thread_local int64_t* t_compute_buffer_bytes = nullptr;
+
+static void llama_log_callback(ggml_log_level p_level, const char* p_text, void* p_user_data) {
+    (void)p_level;
+    (void)p_user_data;
+    if (t_compute_buffer_bytes != nullptr) {
+        const char* found = strstr(p_text, "compute buffer size =");
+        double mib = 0.0;
+        if (found != nullptr && sscanf(found, "compute buffer size = %lf", &mib) == 1) {
+            *t_compute_buffer_bytes += static_cast<int64_t>(mib * 1024.0 * 1024.0);
+        }
+    }
+    // Same output as llama.cpp's default logger
+    fputs(p_text, stderr);
+    fflush(stderr);
+}
+
 // Helper function to add a token to a batch (replaces removed llama_batch_add)
 static void batch_add(
     struct llama_batch & batch,
@@ -30,6 +256,17 @@ static void batch_add(
     batch.n_tokens++;
 }
 
+// Tokenize with any model's vocabulary, without special tokens (the
+// reranker has its own vocabulary)
+static std::vector<int32_t> tokenize_with(const llama_vocab* p_vocab, const String& p_text) {
+    CharString text_utf8 = p_text.utf8();
+    int n_tokens = -llama_tokenize(p_vocab, text_utf8.get_data(), text_utf8.length(), nullptr, 0, false, false);
+    std::vector<int32_t> tokens(std::max(0, n_tokens));
+    int actual = llama_tokenize(p_vocab, text_utf8.get_data(), text_utf8.length(), tokens.data(), tokens.size(), false, false);
+    tokens.resize(std::max(0, actual));
+    return tokens;
+}
+
 void LlamaCppProvider::_bind_methods() {
     // Methods
     ClassDB::bind_method(D_METHOD("is_loaded"), &LlamaCppProvider::is_loaded);
@@ -40,8 +277,46 @@ void LlamaCppProvider::_bind_methods() {
     );
     ClassDB::bind_method(D_METHOD("unload_model"), &LlamaCppProvider::unload_model);
     ClassDB::bind_method(D_METHOD("generate", "request"), &LlamaCppProvider::generate);
+    ClassDB::bind_method(
+        D_METHOD("summarize_long", "text", "instructions", "params"),
+        &LlamaCppProvider::summarize_long, DEFVAL(String()), DEFVAL(Dictionary())
+    );
+    ClassDB::bind_method(
+        D_METHOD("score_batch", "instruction", "items", "labels", "params"),
+        &LlamaCppProvider::score_batch, DEFVAL(Dictionary())
+    );
+    ClassDB::bind_method(D_METHOD("get_score_stats"), &LlamaCppProvider::get_score_stats);
+    ClassDB::bind_method(
+        D_METHOD("compile_prompt_template", "prompt", "system_prompt"),
+        &LlamaCppProvider::compile_prompt_template, DEFVAL(String())
+    );
+    ClassDB::bind_method(D_METHOD("reset_score_stats"), &LlamaCppProvider::reset_score_stats);
+    ClassDB::bind_method(D_METHOD("load_reranker", "model_path", "config"), &LlamaCppProvider::load_reranker, DEFVAL(Dictionary()));
+    ClassDB::bind_method(D_METHOD("unload_reranker"), &LlamaCppProvider::unload_reranker);
+    ClassDB::bind_method(D_METHOD("is_reranker_loaded"), &LlamaCppProvider::is_reranker_loaded);
+    ClassDB::bind_method(
+        D_METHOD("rerank", "query", "documents", "params"),
+        &LlamaCppProvider::rerank, DEFVAL(Dictionary())
+    );
+    ClassDB::bind_method(D_METHOD("get_rerank_stats"), &LlamaCppProvider::get_rerank_stats);
     ClassDB::bind_method(D_METHOD("cancel", "handle_id"), &LlamaCppProvider::cancel);
+    ClassDB::bind_method(D_METHOD("resume", "handle_id"), &LlamaCppProvider::resume);
+    ClassDB::bind_method(D_METHOD("can_resume", "handle_id"), &LlamaCppProvider::can_resume);
+    ClassDB::bind_method(D_METHOD("set_resume_policy", "config"), &LlamaCppProvider::set_resume_policy);
+    ClassDB::bind_method(D_METHOD("get_resume_stats"), &LlamaCppProvider::get_resume_stats);
+    ClassDB::bind_method(D_METHOD("create_context", "name", "config"), &LlamaCppProvider::create_context, DEFVAL(Dictionary()));
+    ClassDB::bind_method(D_METHOD("destroy_context", "name"), &LlamaCppProvider::destroy_context);
+    ClassDB::bind_method(D_METHOD("set_context_elastic", "name", "n_ctx_min"), &LlamaCppProvider::set_context_elastic);
+    ClassDB::bind_method(D_METHOD("get_context_names"), &LlamaCppProvider::get_context_names);
+    ClassDB::bind_method(D_METHOD("start_op_profile", "n_steps", "context"), &LlamaCppProvider::start_op_profile, DEFVAL(32), DEFVAL("default"));
+    ClassDB::bind_method(D_METHOD("stop_op_profile", "context"), &LlamaCppProvider::stop_op_profile, DEFVAL("default"));
+    ClassDB::bind_method(D_METHOD("get_op_profile", "context", "top_n"), &LlamaCppProvider::get_op_profile, DEFVAL("default"), DEFVAL(20));
+    ClassDB::bind_method(D_METHOD("get_context_info"), &LlamaCppProvider::get_context_info);
+    ClassDB::bind_method(D_METHOD("detokenize", "token_ids"), &LlamaCppProvider::detokenize);
     ClassDB::bind_method(D_METHOD("get_status"), &LlamaCppProvider::get_status);
+    ClassDB::bind_method(D_METHOD("get_memory_report"), &LlamaCppProvider::get_memory_report);
+    ClassDB::bind_method(D_METHOD("configure_kv_tiering", "config"), &LlamaCppProvider::configure_kv_tiering);
+    ClassDB::bind_method(D_METHOD("get_kv_tier_stats"), &LlamaCppProvider::get_kv_tier_stats);
     ClassDB::bind_method(D_METHOD("get_backend_type"), &LlamaCppProvider::get_backend_type);
     ClassDB::bind_method(D_METHOD("estimate_memory_usage", "model_path"), &LlamaCppProvider::estimate_memory_usage);
     ClassDB::bind_method(D_METHOD("get_available_memory"), &LlamaCppProvider::get_available_memory);
@@ -51,6 +326,37 @@ void LlamaCppProvider::_bind_methods() {
     ClassDB::bind_method(D_METHOD("get_n_threads"), &LlamaCppProvider::get_n_threads);
     ClassDB::bind_method(D_METHOD("set_n_gpu_layers", "layers"), &LlamaCppProvider::set_n_gpu_layers);
     ClassDB::bind_method(D_METHOD("get_n_gpu_layers"), &LlamaCppProvider::get_n_gpu_layers);
+    ClassDB::bind_method(D_METHOD("set_elastic_kv_min_ctx", "cells"), &LlamaCppProvider::set_elastic_kv_min_ctx);
+    ClassDB::bind_method(D_METHOD("get_elastic_kv_min_ctx"), &LlamaCppProvider::get_elastic_kv_min_ctx);
+    ClassDB::bind_method(
+        D_METHOD("declare_upcoming_models", "model_paths", "memory_budget_bytes"),
+        &LlamaCppProvider::declare_upcoming_models, DEFVAL(0)
+    );
+    ClassDB::bind_method(D_METHOD("get_prefetch_stats"), &LlamaCppProvider::get_prefetch_stats);
+    ClassDB::bind_method(D_METHOD("register_speculative_request", "request"), &LlamaCppProvider::register_speculative_request);
+    ClassDB::bind_method(D_METHOD("clear_speculative_requests"), &LlamaCppProvider::clear_speculative_requests);
+    ClassDB::bind_method(D_METHOD("get_speculative_stats"), &LlamaCppProvider::get_speculative_stats);
+    ClassDB::bind_method(D_METHOD("get_logits_processor_names"), &LlamaCppProvider::get_logits_processor_names);
+    ClassDB::bind_method(D_METHOD("get_logits_processor_stats"), &LlamaCppProvider::get_logits_processor_stats);
+    ClassDB::bind_method(D_METHOD("reset_logits_processor_stats"), &LlamaCppProvider::reset_logits_processor_stats);
+    ClassDB::bind_method(D_METHOD("set_vocab_trim", "config"), &LlamaCppProvider::set_vocab_trim);
+    ClassDB::bind_method(D_METHOD("measure_vocab_coverage", "texts"), &LlamaCppProvider::measure_vocab_coverage);
+    ClassDB::bind_method(D_METHOD("get_vocab_stats"), &LlamaCppProvider::get_vocab_stats);
+    ClassDB::bind_method(D_METHOD("reset_vocab_stats"), &LlamaCppProvider::reset_vocab_stats);
+    ClassDB::bind_method(D_METHOD("set_lookup_decoding", "model_id", "config"), &LlamaCppProvider::set_lookup_decoding);
+    ClassDB::bind_method(D_METHOD("get_lookup_decoding", "model_id"), &LlamaCppProvider::get_lookup_decoding);
+    ClassDB::bind_method(D_METHOD("get_lookup_decoding_stats"), &LlamaCppProvider::get_lookup_decoding_stats);
+    ClassDB::bind_method(D_METHOD("reset_lookup_decoding_stats"), &LlamaCppProvider::reset_lookup_decoding_stats);
+    ClassDB::bind_method(D_METHOD("register_example", "name", "text"), &LlamaCppProvider::register_example);
+    ClassDB::bind_method(D_METHOD("unregister_example", "name"), &LlamaCppProvider::unregister_example);
+    ClassDB::bind_method(D_METHOD("clear_examples"), &LlamaCppProvider::clear_examples);
+    ClassDB::bind_method(D_METHOD("get_example_names"), &LlamaCppProvider::get_example_names);
+    ClassDB::bind_method(D_METHOD("get_example_stats"), &LlamaCppProvider::get_example_stats);
+    ClassDB::bind_method(D_METHOD("reset_example_stats"), &LlamaCppProvider::reset_example_stats);
+    ClassDB::bind_method(D_METHOD("get_capacity_advice", "target_rejection_rate", "memory_budget_bytes"), &LlamaCppProvider::get_capacity_advice, DEFVAL(0.01f), DEFVAL(0));
+    ClassDB::bind_method(D_METHOD("get_usage_histograms"), &LlamaCppProvider::get_usage_histograms);
+    ClassDB::bind_method(D_METHOD("set_usage_histograms", "histograms"), &LlamaCppProvider::set_usage_histograms);
+    ClassDB::bind_method(D_METHOD("reset_usage_histograms", "model_id"), &LlamaCppProvider::reset_usage_histograms, DEFVAL(""));
 
     // Enums
     BIND_ENUM_CONSTANT(BACKEND_CPU);
@@ -62,11 +368,14 @@ void LlamaCppProvider::_bind_methods() {
     // Properties
     ADD_PROPERTY(PropertyInfo(Variant::INT, "n_threads"), "set_n_threads", "get_n_threads");
     ADD_PROPERTY(PropertyInfo(Variant::INT, "n_gpu_layers"), "set_n_gpu_layers", "get_n_gpu_layers");
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "elastic_kv_min_ctx"), "set_elastic_kv_min_ctx", "get_elastic_kv_min_ctx");
 }
 
 LlamaCppProvider::LlamaCppProvider() {
-    // Initialize llama backend
-    llama_backend_init();
+    // The llama backend itself is owned by LLMEngine
+    LLMEngine::provider_created();
+    static std::once_flag log_once;
+    std::call_once(log_once, []() { llama_log_set(llama_log_callback, nullptr); });
     
     // Detect recommended thread count
     m_n_threads = get_recommended_threads();
@@ -86,21 +395,11 @@ LlamaCppProvider::LlamaCppProvider() {
 }
 
 LlamaCppProvider::~LlamaCppProvider() {
-    // Ensure worker thread is stopped
-    if (m_worker_running.load(std::memory_order_acquire)) {
-        {
-            std::lock_guard<std::mutex> lock(m_handle_mutex);
-            if (m_current_handle.is_valid()) {
-                m_current_handle->request_cancel();
-            }
-        }
-        if (m_worker_thread && m_worker_thread->joinable()) {
-            m_worker_thread->join();
-        }
-    }
-    
+    // Stops every context's worker thread
+    _stop_prefetch_thread();
     unload_model();
-    llama_backend_free();
+    unload_reranker();
+    LLMEngine::provider_destroyed();
     
     log_info("LlamaCppProvider destroyed");
 }
@@ -118,7 +417,7 @@ void LlamaCppProvider::log_warning(const String& p_message) const {
 }
 
 bool LlamaCppProvider::is_loaded() const {
-    return m_model != nullptr && m_ctx != nullptr;
+    return m_model != nullptr && m_context_length > 0;
 }
 
 String LlamaCppProvider::get_loaded_model_id() const {
@@ -151,27 +450,34 @@ bool LlamaCppProvider::load_model(
     llama_model_params model_params = llama_model_default_params();
     model_params.n_gpu_layers = n_gpu_layers;
     
-    // Load model
-    CharString path_utf8 = model_path.utf8();
-    m_model = llama_model_load_from_file(path_utf8.get_data(), model_params);
+    // Share the copy another provider already has; otherwise adopt a model
+    // the prefetcher loaded in the background, or load it now
+    m_shared_model = LLMEngine::acquire_model(model_path, n_gpu_layers, [&]() {
+        llama_model* model = _adopt_prefetched_model(model_path, n_gpu_layers);
+        if (model == nullptr) {
+            CharString path_utf8 = model_path.utf8();
+            model = llama_model_load_from_file(path_utf8.get_data(), model_params);
+        }
+        return model;
+    });
+    m_model = m_shared_model ? m_shared_model->model : nullptr;
     
     if (m_model == nullptr) {
         log_error("Failed to load model from: " + model_path);
         return false;
     }
     
-    // Setup context params
-    llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = context_length;
-    ctx_params.n_threads = n_threads;
-    ctx_params.n_threads_batch = n_threads;
-    
-    // Create context
-    m_ctx = llama_init_from_model(m_model, ctx_params);
+    // Create the default context
+    Dictionary config;
+    config["n_ctx"] = context_length;
+    config["n_threads"] = n_threads;
+    config["n_ctx_min"] = m_elastic_kv_min_ctx;
+    String error;
+    std::unique_ptr<ContextLane> lane = _create_lane(DEFAULT_CONTEXT, config, error);
     
-    if (m_ctx == nullptr) {
-        log_error("Failed to create context for model");
-        llama_model_free(m_model);
+    if (!lane) {
+        log_error("Failed to create context for model: " + error);
+        m_shared_model.reset();
         m_model = nullptr;
         return false;
     }
@@ -179,9 +485,20 @@ bool LlamaCppProvider::load_model(
     m_loaded_model_id = model_id;
     m_loaded_model_path = model_path;
     m_context_length = context_length;
+    {
+        Ref<FileAccess> file = FileAccess::open(model_path, FileAccess::READ);
+        m_loaded_model_file_bytes = file.is_valid() ? static_cast<int64_t>(file->get_length()) : 0;
+    }
     m_n_threads = n_threads;
     m_n_gpu_layers = n_gpu_layers;
     
+    _apply_vocab_trim();
+    _start_worker_thread(*lane);
+    {
+        std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+        m_lanes[DEFAULT_CONTEXT] = std::move(lane);
+    }
+    
     log_info("Model loaded successfully: " + model_id + 
              " (ctx=" + String::num_int64(context_length) + 
              ", threads=" + String::num_int64(n_threads) + 
@@ -191,31 +508,45 @@ bool LlamaCppProvider::load_model(
 }
 
 void LlamaCppProvider::unload_model() {
-    // Wait for any ongoing generation
-    if (m_worker_running.load(std::memory_order_acquire)) {
-        {
-            std::lock_guard<std::mutex> lock(m_handle_mutex);
-            if (m_current_handle.is_valid()) {
-                m_current_handle->request_cancel();
-            }
-        }
-        if (m_worker_thread && m_worker_thread->joinable()) {
-            m_worker_thread->join();
-        }
+    // Wait for any ongoing generation, then free every context
+    std::map<String, std::unique_ptr<ContextLane>> lanes;
+    {
+        std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+        lanes.swap(m_lanes);
     }
-    
-    if (m_ctx != nullptr) {
-        llama_free(m_ctx);
-        m_ctx = nullptr;
+    for (auto& entry : lanes) {
+        _destroy_lane(std::move(entry.second));
     }
     
-    if (m_model != nullptr) {
-        llama_model_free(m_model);
-        m_model = nullptr;
+    // Cached completions, token pieces and tiered KV belong to the model
+    // going away
+    _discard_speculative_artifacts();
+    m_token_pieces.clear();
+    m_kv_tier.clear();
+    {
+        std::lock_guard<std::mutex> vocab_lock(m_vocab_mutex);
+        m_vocab_trim.reset();
+    }
+    {
+        std::lock_guard<std::mutex> resume_lock(m_resume_mutex);
+        m_salvaged.clear();
+    }
+    {
+        std::lock_guard<std::mutex> examples_lock(m_examples_mutex);
+        for (auto& entry : m_examples) {
+            auto text_only = std::make_shared<ExampleBlock>();
+            text_only->text = entry.second->text;
+            entry.second = text_only;
+        }
     }
     
+    // Freed by the engine once no other provider uses it
+    m_shared_model.reset();
+    m_model = nullptr;
+    
     m_loaded_model_id = "";
     m_loaded_model_path = "";
+    m_loaded_model_file_bytes = 0;
     m_context_length = 0;
     
     log_info("Model unloaded");
@@ -281,6 +612,30 @@ String LlamaCppProvider::token_to_string(int32_t p_token) const {
     return String::utf8(buf, n);
 }
 
+String LlamaCppProvider::detokenize(const PackedInt32Array& p_token_ids) const {
+    if (m_model == nullptr || p_token_ids.is_empty()) {
+        return "";
+    }
+    
+    const llama_vocab* vocab = llama_model_get_vocab(m_model);
+    
+    // Pieces are joined as bytes first so multi-byte characters split
+    // across tokens decode correctly
+    std::vector<char> buf(p_token_ids.size() * 8 + 16);
+    int32_t n = llama_detokenize(vocab, p_token_ids.ptr(), p_token_ids.size(),
+                                 buf.data(), buf.size(), false, false);
+    if (n < 0) {
+        buf.resize(-n);
+        n = llama_detokenize(vocab, p_token_ids.ptr(), p_token_ids.size(),
+                             buf.data(), buf.size(), false, false);
+    }
+    if (n < 0) {
+        return "";
+    }
+    
+    return String::utf8(buf.data(), n);
+}
+
 bool LlamaCppProvider::check_stop_sequences(const String& p_generated, const PackedStringArray& p_stop_seqs) const {
     for (int i = 0; i < p_stop_seqs.size(); i++) {
         if (p_generated.ends_with(p_stop_seqs[i])) {
@@ -300,226 +655,3658 @@ Ref<LLMGenerationHandle> LlamaCppProvider::generate(const Dictionary& request) {
         return handle;
     }
     
-    // Check if generation is already in progress
-    {
-        std::lock_guard<std::mutex> lock(m_handle_mutex);
-        if (m_worker_running.load(std::memory_order_acquire)) {
-            handle->set_status(LLMGenerationHandle::STATUS_ERROR);
-            handle->call_deferred("_emit_error_deferred", "Generation already in progress");
-            return handle;
-        }
-    }
-    
     // Parse request
-    String prompt = request.get("prompt", "");
-    String system_prompt = request.get("system_prompt", "");
-    int max_tokens = request.get("max_tokens", 256);
-    float temperature = request.get("temperature", 0.7f);
-    float top_p = request.get("top_p", 0.9f);
-    int top_k = request.get("top_k", 40);
-    float repeat_penalty = request.get("repeat_penalty", 1.1f);
-    PackedStringArray stop_sequences = request.get("stop_sequences", PackedStringArray());
-    int seed = request.get("seed", -1);
-    
-    if (prompt.is_empty()) {
+    GenerationJob job;
+    job.request = _parse_request(request);
+    job.handle = handle;
+    
+    if (job.request.prompt.is_empty() && job.request.prompt_tokens.empty()) {
         handle->set_status(LLMGenerationHandle::STATUS_ERROR);
         handle->call_deferred("_emit_error_deferred", "Empty prompt");
         return handle;
     }
     
-    handle->set_model_id(m_loaded_model_id);
-    handle->start();
-    
-    {
-        std::lock_guard<std::mutex> lock(m_handle_mutex);
-        m_current_handle = handle;
+    String processor_error;
+    if (!_validate_logits_processors(job.request.logits_processors, processor_error)) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", processor_error);
+        return handle;
     }
     
-    m_worker_running.store(true, std::memory_order_release);
+    String output_error;
+    if (!_setup_output(handle, request, output_error)) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", output_error);
+        return handle;
+    }
     
-    // Ensure previous thread is joined
-    if (m_worker_thread && m_worker_thread->joinable()) {
-        m_worker_thread->join();
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    String admit_error;
+    ContextLane* lane = _admit_request(request.get("context", DEFAULT_CONTEXT), admit_error);
+    if (lane == nullptr) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", admit_error);
+        return handle;
     }
     
-    // Start generation in background thread
-    m_worker_thread = std::make_unique<std::thread>(
-        &LlamaCppProvider::_generation_thread_func, this,
-        handle, prompt, system_prompt, max_tokens,
-        temperature, top_p, top_k, repeat_penalty,
-        stop_sequences, seed
-    );
+    handle->set_model_id(m_loaded_model_id);
+    handle->start();
+    
+    // Deterministic requests may already be answered (possibly by idle-time
+    // precomputation); serve those without touching the worker. Cached
+    // entries hold text only, so token-ID consumers always decode.
+    String cache_key = handle->is_collecting_token_ids() ? String() : _completion_cache_key(job.request);
+    String cached_text;
+    int cached_tokens = 0;
+    if (!cache_key.is_empty() && _lookup_completion(cache_key, cached_text, cached_tokens)) {
+        handle->append_token(cached_text, cached_tokens);
+        handle->complete(cached_text);
+        return handle;
+    }
     
+    _enqueue_interactive(*lane, job);
     return handle;
 }
 
-void LlamaCppProvider::_generation_thread_func(
-    Ref<LLMGenerationHandle> p_handle,
-    String p_prompt,
-    String p_system_prompt,
-    int p_max_tokens,
-    float p_temperature,
-    float p_top_p,
-    int p_top_k,
-    float p_repeat_penalty,
-    PackedStringArray p_stop_sequences,
-    int p_seed
-) {
-    // Build full prompt with system prompt if provided
-    String full_prompt = p_prompt;
-    if (!p_system_prompt.is_empty()) {
-        // Use a simple chat format - can be extended for model-specific templates
-        full_prompt = "<|im_start|>system\n" + p_system_prompt + "<|im_end|>\n" +
-                      "<|im_start|>user\n" + p_prompt + "<|im_end|>\n" +
-                      "<|im_start|>assistant\n";
-    }
-    
-    // Tokenize prompt
-    std::vector<int32_t> tokens = tokenize(full_prompt, true);
+Ref<LLMGenerationHandle> LlamaCppProvider::summarize_long(const String& text, const String& instructions, const Dictionary& params) {
+    Ref<LLMGenerationHandle> handle;
+    handle.instantiate();
     
-    if (tokens.empty()) {
-        p_handle->fail("Failed to tokenize prompt");
-        m_worker_running.store(false, std::memory_order_release);
-        return;
+    if (!is_loaded()) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", "No model loaded");
+        return handle;
     }
-    
-    // Check if prompt fits in context
-    if (static_cast<int>(tokens.size()) >= m_context_length) {
-        p_handle->fail("Prompt too long for context window");
-        m_worker_running.store(false, std::memory_order_release);
-        return;
+    if (text.is_empty()) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", "Empty text");
+        return handle;
     }
     
-    // Clear memory (replaces llama_kv_cache_clear)
-    llama_memory_clear(llama_get_memory(m_ctx), true);
-    
-    // Create batch for prompt evaluation
-    llama_batch batch = llama_batch_init(tokens.size(), 0, 1);
+    GenerationJob job;
+    job.request = _parse_request(params);
+    job.request.max_tokens = params.get("max_tokens", SUMMARIZE_DEFAULT_MAX_TOKENS);
+    job.handle = handle;
+    job.summarize = true;
+    SummarizeRequest& summary = job.summarize_request;
+    summary.text = text;
+    summary.instructions = instructions.is_empty() ? String(SUMMARIZE_DEFAULT_INSTRUCTIONS) : instructions;
+    summary.reduce_instructions = params.get("reduce_instructions", SUMMARIZE_DEFAULT_REDUCE_INSTRUCTIONS);
+    summary.chunk_tokens = params.get("chunk_tokens", 0);
+    summary.chunk_max_tokens = std::max(16, static_cast<int>(params.get("chunk_max_tokens", SUMMARIZE_DEFAULT_CHUNK_MAX_TOKENS)));
     
-    for (size_t i = 0; i < tokens.size(); i++) {
-        batch_add(batch, tokens[i], i, { 0 }, false);
+    String output_error;
+    if (!_setup_output(handle, params, output_error)) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", output_error);
+        return handle;
     }
     
-    // Mark last token for logits
-    batch.logits[batch.n_tokens - 1] = true;
-    
-    // Evaluate prompt
-    if (llama_decode(m_ctx, batch) != 0) {
-        llama_batch_free(batch);
-        p_handle->fail("Failed to evaluate prompt");
-        m_worker_running.store(false, std::memory_order_release);
-        return;
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    String admit_error;
+    ContextLane* lane = _admit_request(params.get("context", DEFAULT_CONTEXT), admit_error);
+    if (lane == nullptr) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", admit_error);
+        return handle;
     }
     
-    llama_batch_free(batch);
+    handle->set_model_id(m_loaded_model_id);
+    handle->start();
+    _enqueue_interactive(*lane, job);
+    return handle;
+}
+
+Ref<LLMPromptTemplate> LlamaCppProvider::compile_prompt_template(const String& prompt, const String& system_prompt) {
+    if (!is_loaded()) {
+        log_error("compile_prompt_template: no model loaded");
+        return Ref<LLMPromptTemplate>();
+    }
     
-    // Setup sampler chain
-    llama_sampler* sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    // Formatted exactly like a generate() request, slots kept as text
+    GenerationRequest request;
+    request.prompt = prompt;
+    request.system_prompt = system_prompt;
+    Ref<LLMPromptTemplate> prompt_template;
+    prompt_template.instantiate();
+    prompt_template->compile(Ref<LlamaCppProvider>(this), m_loaded_model_id, _format_prompt(request, false));
+    return prompt_template;
+}
+
+Ref<LLMGenerationHandle> LlamaCppProvider::score_batch(const String& instruction, const PackedStringArray& items,
+                                                       const PackedStringArray& labels, const Dictionary& params) {
+    Ref<LLMGenerationHandle> handle;
+    handle.instantiate();
     
-    // Add samplers in order
-    llama_sampler_chain_add(sampler, llama_sampler_init_top_k(p_top_k));
-    llama_sampler_chain_add(sampler, llama_sampler_init_top_p(p_top_p, 1));
-    llama_sampler_chain_add(sampler, llama_sampler_init_temp(p_temperature));
-    llama_sampler_chain_add(sampler, llama_sampler_init_dist(p_seed >= 0 ? p_seed : LLAMA_DEFAULT_SEED));
+    String error;
+    if (!is_loaded()) {
+        error = "No model loaded";
+    } else if (instruction.is_empty()) {
+        error = "Empty instruction";
+    } else if (items.is_empty()) {
+        error = "No items to score";
+    } else if (labels.size() < 2) {
+        error = "score_batch needs at least two labels";
+    }
+    if (!error.is_empty()) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", error);
+        return handle;
+    }
     
-    // Generation loop
-    String generated_text;
-    int n_cur = tokens.size();
+    GenerationJob job;
+    job.request = _parse_request(params);
+    job.handle = handle;
+    job.score = true;
+    ScoreRequest& score = job.score_request;
+    score.instruction = instruction;
+    score.items = items;
+    score.labels = labels;
+    score.batch_size = std::max(0, static_cast<int>(params.get("batch_size", 0)));
     
-    for (int i = 0; i < p_max_tokens; i++) {
-        // Check for cancellation
-        if (p_handle->is_cancel_requested()) {
-            llama_sampler_free(sampler);
-            p_handle->mark_cancelled();
-            m_worker_running.store(false, std::memory_order_release);
-            return;
-        }
-        
-        // Sample next token
-        llama_token new_token = llama_sampler_sample(sampler, m_ctx, -1);
-        
-        // Check for EOS
-        const llama_vocab* vocab = llama_model_get_vocab(m_model);
-        if (llama_token_is_eog(vocab, new_token)) {
-            break;
-        }
-        
-        // Convert token to string
-        String token_str = token_to_string(new_token);
-        generated_text += token_str;
-        
-        // Emit token
-        p_handle->append_token(token_str);
-        
-        // Check stop sequences
-        if (check_stop_sequences(generated_text, p_stop_sequences)) {
-            break;
-        }
-        
-        // Prepare next batch
-        llama_batch next_batch = llama_batch_init(1, 0, 1);
-        batch_add(next_batch, new_token, n_cur, { 0 }, true);
-        n_cur++;
-        
-        // Evaluate
-        if (llama_decode(m_ctx, next_batch) != 0) {
-            llama_batch_free(next_batch);
-            llama_sampler_free(sampler);
-            p_handle->fail("Decode failed during generation");
-            m_worker_running.store(false, std::memory_order_release);
-            return;
-        }
-        
-        llama_batch_free(next_batch);
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    String admit_error;
+    ContextLane* lane = _admit_request(params.get("context", DEFAULT_CONTEXT), admit_error);
+    if (lane == nullptr) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", admit_error);
+        return handle;
     }
     
-    llama_sampler_free(sampler);
-    
-    // Complete
-    p_handle->complete(generated_text);
-    m_worker_running.store(false, std::memory_order_release);
+    handle->set_model_id(m_loaded_model_id);
+    handle->start();
+    _enqueue_interactive(*lane, job);
+    return handle;
 }
 
-void LlamaCppProvider::cancel(const String& handle_id) {
-    std::lock_guard<std::mutex> lock(m_handle_mutex);
-    if (m_current_handle.is_valid() && m_current_handle->get_id() == handle_id) {
-        m_current_handle->request_cancel();
+Dictionary LlamaCppProvider::get_score_stats() {
+    std::lock_guard<std::mutex> lock(m_score_mutex);
+    Dictionary stats;
+    for (const auto& entry : m_score_stats) {
+        const ScoreStats& s = entry.second;
+        Dictionary width;
+        width["jobs"] = s.jobs;
+        width["items"] = s.items;
+        width["skipped"] = s.skipped;
+        width["decodes"] = s.decodes;
+        width["seconds"] = s.seconds;
+        width["items_per_second"] = s.seconds > 0.0 ? s.items / s.seconds : 0.0;
+        stats[entry.first] = width;
     }
+    return stats;
 }
 
-Dictionary LlamaCppProvider::get_status() const {
-    Dictionary status;
+void LlamaCppProvider::reset_score_stats() {
+    std::lock_guard<std::mutex> lock(m_score_mutex);
+    m_score_stats.clear();
+}
+
+bool LlamaCppProvider::load_reranker(const String& model_path, const Dictionary& config) {
+    unload_reranker();
+    if (!FileAccess::file_exists(model_path)) {
+        log_error("Reranker file not found: " + model_path);
+        return false;
+    }
     
-    status["loaded"] = is_loaded();
-    status["model_id"] = m_loaded_model_id;
-    status["model_path"] = m_loaded_model_path;
-    status["context_length"] = m_context_length;
-    status["n_threads"] = m_n_threads;
-    status["n_gpu_layers"] = m_n_gpu_layers;
-    status["generating"] = m_worker_running.load(std::memory_order_acquire);
+    const int n_gpu_layers = config.get("n_gpu_layers", m_n_gpu_layers);
+    std::shared_ptr<SharedModel> shared = LLMEngine::acquire_model(model_path, n_gpu_layers, [&]() {
+        llama_model_params model_params = llama_model_default_params();
+        model_params.n_gpu_layers = n_gpu_layers;
+        CharString path_utf8 = model_path.utf8();
+        return llama_model_load_from_file(path_utf8.get_data(), model_params);
+    });
+    if (!shared) {
+        log_error("Failed to load reranker from: " + model_path);
+        return false;
+    }
     
-    String backend_name;
-    switch (m_backend_type) {
-        case BACKEND_CPU: backend_name = "CPU"; break;
-        case BACKEND_CUDA: backend_name = "CUDA"; break;
-        case BACKEND_METAL: backend_name = "Metal"; break;
-        case BACKEND_VULKAN: backend_name = "Vulkan"; break;
-        default: backend_name = "Unknown"; break;
+    // Encoder-only rerankers attend both ways, so a pair has to be evaluated
+    // in one ubatch: n_batch and n_ubatch are the whole context
+    const int n_ctx = std::max(64, static_cast<int>(config.get("n_ctx", RERANKER_DEFAULT_N_CTX)));
+    const int n_seq_max = std::max(1, static_cast<int>(config.get("n_seq_max", RERANKER_DEFAULT_SEQ_MAX)));
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = n_ctx;
+    ctx_params.n_batch = n_ctx;
+    ctx_params.n_ubatch = n_ctx;
+    ctx_params.n_seq_max = n_seq_max;
+    ctx_params.kv_unified = true;
+    ctx_params.n_threads = m_n_threads;
+    ctx_params.n_threads_batch = m_n_threads;
+    ctx_params.embeddings = true;
+    ctx_params.pooling_type = LLAMA_POOLING_TYPE_RANK;
+    llama_context* ctx = llama_init_from_model(shared->model, ctx_params);
+    if (ctx == nullptr) {
+        log_error("Failed to create reranker context for: " + model_path);
+        return false;
+    }
+    if (llama_pooling_type(ctx) != LLAMA_POOLING_TYPE_RANK) {
+        log_error("Not a reranker (no rank pooling): " + model_path);
+        llama_free(ctx);
+        return false;
     }
-    status["backend"] = backend_name;
     
-    return status;
+    std::shared_ptr<Reranker> reranker = std::make_shared<Reranker>();
+    reranker->model = shared;
+    reranker->ctx = ctx;
+    reranker->path = model_path;
+    reranker->threads = m_n_threads;
+    reranker->seq_max = n_seq_max;
+    LLMEngine::context_opened(reranker->threads);
+    
+    // Replaces one a concurrent load_reranker() installed first
+    std::lock_guard<std::mutex> lock(m_reranker_mutex);
+    m_reranker = reranker;
+    log_info("Reranker loaded: " + model_path + " (ctx=" + String::num_int64(llama_n_ctx(ctx)) +
+             ", seq_max=" + String::num_int64(n_seq_max) + ")");
+    return true;
 }
 
-LlamaCppProvider::BackendType LlamaCppProvider::get_backend_type() const {
-    return m_backend_type;
+LlamaCppProvider::Reranker::~Reranker() {
+    if (ctx != nullptr) {
+        llama_free(ctx);
+        LLMEngine::context_closed(threads);
+    }
 }
 
-int64_t LlamaCppProvider::estimate_memory_usage(const String& model_path) const {
-    // Rough estimation: file size + ~20% overhead for context
-    // More accurate would require parsing GGUF metadata
-    if (!FileAccess::file_exists(model_path)) {
-        return -1;
+void LlamaCppProvider::unload_reranker() {
+    // A running job keeps its reference and frees the context when it ends
+    std::shared_ptr<Reranker> reranker;
+    {
+        std::lock_guard<std::mutex> lock(m_reranker_mutex);
+        reranker = std::move(m_reranker);
+    }
+    if (reranker) {
+        log_info("Reranker unloaded: " + reranker->path);
+    }
+}
+
+bool LlamaCppProvider::is_reranker_loaded() {
+    std::lock_guard<std::mutex> lock(m_reranker_mutex);
+    return m_reranker != nullptr;
+}
+
+Ref<LLMGenerationHandle> LlamaCppProvider::rerank(const String& query, const PackedStringArray& documents, const Dictionary& params) {
+    Ref<LLMGenerationHandle> handle;
+    handle.instantiate();
+    
+    String error;
+    if (!is_loaded()) {
+        error = "No model loaded";
+    } else if (!is_reranker_loaded()) {
+        error = "No reranker loaded";
+    } else if (query.is_empty()) {
+        error = "Empty query";
+    } else if (documents.is_empty()) {
+        error = "No documents to rerank";
+    }
+    if (!error.is_empty()) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", error);
+        return handle;
+    }
+    
+    GenerationJob job;
+    job.handle = handle;
+    job.rerank = true;
+    job.rerank_request.query = query;
+    job.rerank_request.documents = documents;
+    
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    String admit_error;
+    ContextLane* lane = _admit_request(params.get("context", DEFAULT_CONTEXT), admit_error);
+    if (lane == nullptr) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", admit_error);
+        return handle;
+    }
+    
+    handle->set_model_id(m_loaded_model_id);
+    handle->start();
+    _enqueue_interactive(*lane, job);
+    return handle;
+}
+
+Dictionary LlamaCppProvider::get_rerank_stats() {
+    std::lock_guard<std::mutex> lock(m_reranker_mutex);
+    const RerankStats& s = m_rerank_stats;
+    Dictionary stats;
+    stats["reranker"] = m_reranker ? m_reranker->path : String();
+    stats["jobs"] = s.jobs;
+    stats["pairs"] = s.pairs;
+    stats["truncated"] = s.truncated;
+    stats["decodes"] = s.decodes;
+    stats["seconds"] = s.seconds;
+    stats["pairs_per_second"] = s.seconds > 0.0 ? s.pairs / s.seconds : 0.0;
+    return stats;
+}
+
+LlamaCppProvider::ContextLane* LlamaCppProvider::_admit_request(const String& p_context, String& r_error) {
+    ContextLane* lane = _find_lane(p_context);
+    if (lane == nullptr) {
+        r_error = "Unknown context: " + p_context;
+        return nullptr;
+    }
+    
+    // Each context admits n_seq_max requests at a time (running + queued)
+    int active = lane->interactive_active.load(std::memory_order_acquire);
+    bool busy = active >= lane->n_seq_max;
+    _record_usage(*lane, [active, busy](ModelUsageStats& stats) { stats.record_arrival(active + 1, busy); });
+    if (busy) {
+        lane->rejected_busy.fetch_add(1, std::memory_order_relaxed);
+        r_error = "Generation already in progress";
+        return nullptr;
+    }
+    lane->requests.fetch_add(1, std::memory_order_relaxed);
+    return lane;
+}
+
+void LlamaCppProvider::_enqueue_interactive(ContextLane& p_lane, const GenerationJob& p_job) {
+    p_lane.interactive_active.fetch_add(1, std::memory_order_acq_rel);
+    
+    // Queue for the worker; a running speculative job sees the pending flag
+    // and yields after its current decode step
+    {
+        std::lock_guard<std::mutex> lock(p_lane.job_mutex);
+        p_lane.interactive_jobs.push_back(p_job);
+        p_lane.interactive_pending.store(true, std::memory_order_release);
+    }
+    p_lane.job_cv.notify_one();
+}
+
+LlamaCppProvider::GenerationRequest LlamaCppProvider::_parse_request(const Dictionary& p_request) {
+    GenerationRequest parsed;
+    parsed.prompt = p_request.get("prompt", "");
+    parsed.system_prompt = p_request.get("system_prompt", "");
+    parsed.max_tokens = p_request.get("max_tokens", 256);
+    parsed.temperature = p_request.get("temperature", 0.7f);
+    parsed.top_p = p_request.get("top_p", 0.9f);
+    parsed.top_k = p_request.get("top_k", 40);
+    parsed.repeat_penalty = p_request.get("repeat_penalty", 1.1f);
+    parsed.stop_sequences = p_request.get("stop_sequences", PackedStringArray());
+    parsed.seed = p_request.get("seed", -1);
+    parsed.logits_processors = p_request.get("logits_processors", Array());
+    parsed.use_cache = p_request.get("cache", true);
+    PackedInt32Array candidates = p_request.get("candidate_tokens", PackedInt32Array());
+    for (int i = 0; i < candidates.size(); i++) {
+        parsed.candidate_tokens.push_back(candidates[i]);
+    }
+    std::sort(parsed.candidate_tokens.begin(), parsed.candidate_tokens.end());
+    parsed.candidate_tokens.erase(std::unique(parsed.candidate_tokens.begin(), parsed.candidate_tokens.end()),
+                                  parsed.candidate_tokens.end());
+    parsed.vocab_trim = p_request.get("vocab_trim", true);
+    if (p_request.has("lookup_decoding")) {
+        parsed.lookup_decoding = bool(p_request["lookup_decoding"]) ? 1 : 0;
+    }
+    parsed.examples = p_request.get("examples", PackedStringArray());
+    parsed.compose_examples = p_request.get("compose_examples", true);
+    parsed.example_recompute = std::max(0, static_cast<int>(p_request.get("example_recompute", EXAMPLE_RECOMPUTE_TOKENS)));
+    PackedInt32Array prompt_tokens = p_request.get("prompt_tokens", PackedInt32Array());
+    parsed.prompt_tokens.assign(prompt_tokens.ptr(), prompt_tokens.ptr() + prompt_tokens.size());
+    return parsed;
+}
+
+bool LlamaCppProvider::_setup_output(const Ref<LLMGenerationHandle>& p_handle, const Dictionary& p_request, String& r_error) {
+    // "collect_token_ids" predates "output" and means text plus IDs
+    bool collect = p_request.get("collect_token_ids", false);
+    String output = p_request.get("output", collect ? "both" : "text");
+    LLMGenerationHandle::OutputMode mode;
+    if (output == "text") {
+        mode = LLMGenerationHandle::OUTPUT_TEXT;
+    } else if (output == "tokens") {
+        mode = LLMGenerationHandle::OUTPUT_TOKENS;
+    } else if (output == "both") {
+        mode = LLMGenerationHandle::OUTPUT_BOTH;
+    } else {
+        r_error = "Unknown output mode: " + output + " (expected text, tokens or both)";
+        return false;
+    }
+    p_handle->set_output_mode(mode);
+    
+    if (mode == LLMGenerationHandle::OUTPUT_TOKENS) {
+        // Looked up by ID so a handle kept after the provider is freed, or
+        // after another model is loaded, decodes to "" instead of garbage
+        uint64_t provider_id = get_instance_id();
+        String model_id = m_loaded_model_id;
+        p_handle->set_detokenizer([provider_id, model_id](const PackedInt32Array& p_ids) {
+            LlamaCppProvider* provider = Object::cast_to<LlamaCppProvider>(ObjectDB::get_instance(provider_id));
+            if (provider == nullptr || provider->get_loaded_model_id() != model_id) {
+                return String();
+            }
+            return provider->detokenize(p_ids);
+        });
+    }
+    return true;
+}
+
+bool LlamaCppProvider::_validate_logits_processors(const Array& p_processors, String& r_error) {
+    for (int i = 0; i < p_processors.size(); i++) {
+        Variant entry = p_processors[i];
+        String name;
+        if (entry.get_type() == Variant::DICTIONARY) {
+            name = Dictionary(entry).get("name", "");
+        } else if (entry.get_type() == Variant::STRING) {
+            name = entry;
+        } else {
+            r_error = "logits_processors entries must be names or dictionaries";
+            return false;
+        }
+        if (!LogitsProcessorRegistry::has_processor(name)) {
+            r_error = "Unknown logits processor: " + name;
+            return false;
+        }
+    }
+    return true;
+}
+
+const std::vector<std::string>& LlamaCppProvider::_get_token_pieces() {
+    // Built once by whichever worker needs it first; unload clears it after
+    // every worker has stopped
+    std::lock_guard<std::mutex> lock(m_token_pieces_mutex);
+    if (m_token_pieces.empty()) {
+        const llama_vocab* vocab = llama_model_get_vocab(m_model);
+        int32_t n_vocab = llama_vocab_n_tokens(vocab);
+        m_token_pieces.resize(n_vocab);
+        
+        char buf[256];
+        for (int32_t id = 0; id < n_vocab; id++) {
+            int n = llama_token_to_piece(vocab, id, buf, sizeof(buf), 0, false);
+            if (n > 0) {
+                m_token_pieces[id].assign(buf, n);
+            }
+        }
+    }
+    return m_token_pieces;
+}
+
+String LlamaCppProvider::_format_prompt(const GenerationRequest& p_request, bool p_prefix_only) {
+    if (p_request.system_prompt.is_empty()) {
+        return p_request.prompt;
+    }
+    
+    // Use a simple chat format - can be extended for model-specific templates
+    String system_part = "<|im_start|>system\n" + p_request.system_prompt + "<|im_end|>\n" +
+                         "<|im_start|>user\n";
+    if (p_prefix_only) {
+        return system_part;
+    }
+    return system_part + p_request.prompt + "<|im_end|>\n" +
+           "<|im_start|>assistant\n";
+}
+
+bool LlamaCppProvider::_tokenize_request(const GenerationRequest& p_request, bool p_prefix_only, std::vector<int32_t>& r_tokens,
+                                         ExamplePlan& r_plan, String& r_error) {
+    if (!p_request.prompt_tokens.empty()) {
+        // Already formatted and tokenized by an LLMPromptTemplate
+        const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(m_model));
+        for (int32_t token : p_request.prompt_tokens) {
+            if (token < 0 || token >= n_vocab) {
+                r_error = "prompt_tokens contains ids outside the vocabulary";
+                return false;
+            }
+        }
+        r_tokens = p_request.prompt_tokens;
+        return true;
+    }
+    if (p_request.examples.is_empty()) {
+        r_tokens = tokenize(_format_prompt(p_request, p_prefix_only), true);
+        return true;
+    }
+    
+    // Examples open the user turn. Each piece is tokenized on its own so a
+    // block has the same tokens wherever it lands, composed or not.
+    String head = p_request.system_prompt.is_empty() ? String() : _format_prompt(p_request, true);
+    String tail;
+    if (!p_prefix_only) {
+        tail = p_request.system_prompt.is_empty() ? p_request.prompt : _format_prompt(p_request, false).substr(head.length());
+    }
+    r_tokens = tokenize(head, true);
+    r_plan.compose = p_request.compose_examples;
+    r_plan.recompute = p_request.example_recompute;
+    {
+        std::lock_guard<std::mutex> lock(m_examples_mutex);
+        for (int i = 0; i < p_request.examples.size(); i++) {
+            auto it = m_examples.find(p_request.examples[i]);
+            if (it == m_examples.end()) {
+                r_error = "Unknown example: " + p_request.examples[i];
+                return false;
+            }
+            ExampleBlock& block = *it->second;
+            if (block.tokens.empty()) {
+                block.tokens = tokenize(block.text, false);
+            }
+            ExampleUse use;
+            use.start = r_tokens.size();
+            use.length = block.tokens.size();
+            use.block = it->second;
+            r_plan.blocks.push_back(use);
+            r_tokens.insert(r_tokens.end(), block.tokens.begin(), block.tokens.end());
+        }
+    }
+    std::vector<int32_t> tail_tokens = tokenize(tail, false);
+    r_tokens.insert(r_tokens.end(), tail_tokens.begin(), tail_tokens.end());
+    return true;
+}
+
+std::unique_ptr<LlamaCppProvider::ContextLane> LlamaCppProvider::_create_lane(
+    const String& p_name,
+    const Dictionary& p_config,
+    String& r_error
+) {
+    std::unique_ptr<ContextLane> lane = std::make_unique<ContextLane>();
+    lane->name = p_name;
+    lane->n_ctx = p_config.get("n_ctx", 2048);
+    lane->n_seq_max = std::max(1, static_cast<int>(p_config.get("n_seq_max", 1)));
+    lane->type_k = p_config.get("type_k", "f16");
+    lane->type_v = p_config.get("type_v", lane->type_k);
+    lane->n_threads = p_config.get("n_threads", m_n_threads);
+    String priority = p_config.get("priority", "interactive");
+    if (priority == "background") {
+        lane->priority = COMPUTE_BACKGROUND;
+    } else if (priority != "interactive") {
+        r_error = "Unknown priority: " + priority + " (expected interactive or background)";
+        return nullptr;
+    }
+    
+    const KvCacheType* type_k = find_kv_cache_type(lane->type_k);
+    const KvCacheType* type_v = find_kv_cache_type(lane->type_v);
+    if (type_k == nullptr || type_v == nullptr) {
+        r_error = "Unknown KV cache type: " + (type_k == nullptr ? lane->type_k : lane->type_v);
+        return nullptr;
+    }
+    if (lane->n_ctx <= 0) {
+        r_error = "n_ctx must be positive";
+        return nullptr;
+    }
+    lane->n_ctx = round_up_cells(lane->n_ctx);
+    
+    int n_ctx_min = p_config.get("n_ctx_min", 0);
+    if (n_ctx_min > 0) {
+        lane->n_ctx_min.store(std::min(round_up_cells(n_ctx_min), lane->n_ctx));
+    }
+    lane->elastic.since = std::chrono::steady_clock::now();
+    lane->elastic.last_change = lane->elastic.since;
+    
+    if (!_init_lane_context(*lane, n_ctx_min > 0 ? lane->n_ctx_min.load() : lane->n_ctx)) {
+        r_error = "llama_init_from_model failed";
+        return nullptr;
+    }
+    return lane;
+}
+
+bool LlamaCppProvider::_init_lane_context(ContextLane& p_lane, int p_n_ctx) {
+    const KvCacheType* type_k = find_kv_cache_type(p_lane.type_k);
+    const KvCacheType* type_v = find_kv_cache_type(p_lane.type_v);
+    
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = p_n_ctx;
+    ctx_params.n_threads = p_lane.n_threads;
+    ctx_params.n_threads_batch = p_lane.n_threads;
+    ctx_params.type_k = type_k->type;
+    ctx_params.type_v = type_v->type;
+    // Generation only uses sequence 0; a unified cache lets it span all of
+    // n_ctx no matter how many sequences the context allows. Summarization
+    // waves use up to SUMMARIZE_MAX_PARALLEL, and sequence n_seq_max is
+    // scratch space for example blocks (see _splice_example).
+    ctx_params.n_seq_max = std::max(p_lane.n_seq_max, SUMMARIZE_MAX_PARALLEL) + 1;
+    ctx_params.kv_unified = true;
+    // llama.cpp only supports a quantized V cache with flash attention
+    if (type_v->type != GGML_TYPE_F16) {
+        ctx_params.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
+    }
+    p_lane.profiler_installed = p_lane.profiler.is_collecting();
+    if (p_lane.profiler_installed) {
+        ctx_params.cb_eval = &OpProfiler::eval_callback;
+        ctx_params.cb_eval_user_data = &p_lane.profiler;
+    }
+    
+    int64_t compute_buffer_bytes = 0;
+    t_compute_buffer_bytes = &compute_buffer_bytes;
+    p_lane.ctx = llama_init_from_model(m_model, ctx_params);
+    t_compute_buffer_bytes = nullptr;
+    p_lane.compute_buffer_bytes.store(compute_buffer_bytes, std::memory_order_relaxed);
+    if (p_lane.ctx == nullptr) {
+        p_lane.n_ctx_alloc.store(0);
+        return false;
+    }
+    p_lane.n_ctx_alloc.store(static_cast<int>(llama_n_ctx(p_lane.ctx)));
+    p_lane.compute_threads = p_lane.n_threads;
+    return true;
+}
+
+bool LlamaCppProvider::_ensure_kv_capacity(ContextLane& p_lane, int p_cells, String& r_error) {
+    int alloc = p_lane.n_ctx_alloc.load(std::memory_order_relaxed);
+    if (p_cells <= alloc && p_lane.ctx != nullptr) {
+        return true;
+    }
+    
+    // Grow geometrically so a long generation resizes only a few times;
+    // without elasticity the context goes straight back to full size
+    int target = p_lane.n_ctx;
+    if (p_lane.n_ctx_min.load(std::memory_order_relaxed) > 0) {
+        target = std::min(p_lane.n_ctx, round_up_cells(std::max(p_cells, alloc * 2)));
+    }
+    if (target <= alloc && p_lane.ctx != nullptr) {
+        // Already at n_ctx; decode reports a full cache as before
+        return true;
+    }
+    return _resize_kv(p_lane, target, r_error);
+}
+
+bool LlamaCppProvider::_resize_kv(ContextLane& p_lane, int p_n_ctx, String& r_error) {
+    auto start = std::chrono::steady_clock::now();
+    int old_alloc = p_lane.n_ctx_alloc.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(p_lane.elastic_mutex);
+        std::chrono::duration<double> held = start - p_lane.elastic.last_change;
+        p_lane.elastic.saved_cell_seconds += (p_lane.n_ctx - old_alloc) * held.count();
+        p_lane.elastic.last_change = start;
+    }
+    
+    // Save the resident sequence. Cells past the new size are dropped; the
+    // rest is still a valid prefix for the next prompt.
+    std::vector<uint8_t> state;
+    if (p_lane.ctx != nullptr) {
+        llama_memory_t mem = llama_get_memory(p_lane.ctx);
+        size_t keep = std::min(p_lane.kv_tokens.size(), static_cast<size_t>(p_n_ctx));
+        if (keep < p_lane.kv_tokens.size()) {
+            if (!llama_memory_seq_rm(mem, 0, keep, -1)) {
+                keep = 0;
+            }
+            p_lane.kv_tokens.resize(keep);
+        }
+        if (!p_lane.kv_tokens.empty()) {
+            state.resize(llama_state_seq_get_size(p_lane.ctx, 0));
+            if (llama_state_seq_get_data(p_lane.ctx, state.data(), state.size(), 0) != state.size()) {
+                state.clear();
+            }
+        }
+        // Free first so the old and new caches never coexist
+        llama_free(p_lane.ctx);
+        p_lane.ctx = nullptr;
+    }
+    
+    bool resized = _init_lane_context(p_lane, p_n_ctx);
+    if (!resized) {
+        r_error = "Failed to allocate a KV cache of " + String::num_int64(p_n_ctx) + " cells";
+        log_warning("Context " + p_lane.name + ": " + r_error);
+        // Back at the old size the saved sequence still fits, so the next
+        // prompt keeps its prefix; only a context that is gone loses it
+        if (old_alloc <= 0 || !_init_lane_context(p_lane, old_alloc)) {
+            state.clear();
+        }
+    }
+    
+    if (p_lane.ctx == nullptr || state.empty() || llama_state_seq_set_data(p_lane.ctx, state.data(), state.size(), 0) == 0) {
+        p_lane.kv_tokens.clear();
+    }
+    p_lane.kv_cells_used.store(static_cast<int>(p_lane.kv_tokens.size()), std::memory_order_relaxed);
+    if (p_lane.spec_region_start >= 0 && p_lane.spec_region_end > static_cast<int>(p_lane.kv_tokens.size())) {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        m_speculative_stats.wasted++;
+        p_lane.spec_region_start = -1;
+    }
+    
+    double stall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    int new_alloc = p_lane.n_ctx_alloc.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(p_lane.elastic_mutex);
+        if (!resized) {
+            p_lane.elastic.failures++;
+        } else if (new_alloc > old_alloc) {
+            p_lane.elastic.grows++;
+        } else if (new_alloc < old_alloc) {
+            p_lane.elastic.shrinks++;
+        }
+        if (!resized || new_alloc != old_alloc) {
+            p_lane.elastic.stall_ms_total += stall_ms;
+            p_lane.elastic.stall_ms_max = std::max(p_lane.elastic.stall_ms_max, stall_ms);
+        }
+    }
+    p_lane.recent_peaks.clear();
+    
+    if (resized && new_alloc != old_alloc) {
+        log_info("Context " + p_lane.name + " KV cache " + String::num_int64(old_alloc) + " -> " +
+                 String::num_int64(new_alloc) + " cells (" + String::num(stall_ms, 1) + " ms, " +
+                 String::num_int64(p_lane.kv_tokens.size()) + " restored)");
+    }
+    return resized;
+}
+
+void LlamaCppProvider::_maybe_shrink_kv(ContextLane& p_lane, int p_peak_cells) {
+    int n_ctx_min = p_lane.n_ctx_min.load(std::memory_order_relaxed);
+    if (n_ctx_min <= 0) {
+        p_lane.recent_peaks.clear();
+        return;
+    }
+    
+    p_lane.recent_peaks.push_back(p_peak_cells);
+    if (static_cast<int>(p_lane.recent_peaks.size()) > ELASTIC_SHRINK_WINDOW) {
+        p_lane.recent_peaks.erase(p_lane.recent_peaks.begin());
+    }
+    if (static_cast<int>(p_lane.recent_peaks.size()) < ELASTIC_SHRINK_WINDOW) {
+        return;
+    }
+    
+    // Keep room for twice the largest recent request, and only bother when
+    // that at least halves the allocation
+    int largest = *std::max_element(p_lane.recent_peaks.begin(), p_lane.recent_peaks.end());
+    int target = std::max(n_ctx_min, round_up_cells(largest * 2));
+    if (target * 2 > p_lane.n_ctx_alloc.load(std::memory_order_relaxed)) {
+        return;
+    }
+    String error;
+    _resize_kv(p_lane, target, error);
+}
+
+void LlamaCppProvider::_apply_elastic_config(ContextLane& p_lane) {
+    int n_ctx_min = p_lane.n_ctx_min.load(std::memory_order_relaxed);
+    int alloc = p_lane.n_ctx_alloc.load(std::memory_order_relaxed);
+    int target = n_ctx_min > 0
+        ? std::max(n_ctx_min, round_up_cells(static_cast<int>(p_lane.kv_tokens.size()) + ELASTIC_GROW_HEADROOM))
+        : p_lane.n_ctx;
+    target = std::min(target, p_lane.n_ctx);
+    if (target != alloc) {
+        String error;
+        _resize_kv(p_lane, target, error);
+    }
+}
+
+void LlamaCppProvider::_destroy_lane(std::unique_ptr<ContextLane> p_lane) {
+    _stop_worker_thread(*p_lane);
+    LLMEngine::context_closed(p_lane->n_threads);
+    llama_free(p_lane->ctx);
+    p_lane->ctx = nullptr;
+}
+
+LlamaCppProvider::ContextLane* LlamaCppProvider::_find_lane(const String& p_name) const {
+    // Caller holds m_lanes_mutex
+    auto it = m_lanes.find(p_name);
+    return it != m_lanes.end() ? it->second.get() : nullptr;
+}
+
+double LlamaCppProvider::_kv_bytes_per_cell(const String& p_type_k, const String& p_type_v) const {
+    if (m_model == nullptr) {
+        return 0.0;
+    }
+    // K and V for every layer, n_head_kv * head_dim wide each
+    int64_t n_layer = llama_model_n_layer(m_model);
+    int64_t n_head = std::max(1, llama_model_n_head(m_model));
+    int64_t n_head_kv = llama_model_n_head_kv(m_model);
+    int64_t head_dim = llama_model_n_embd(m_model) / n_head;
+    double elements = static_cast<double>(n_layer * n_head_kv * head_dim);
+    
+    const KvCacheType* type_k = find_kv_cache_type(p_type_k);
+    const KvCacheType* type_v = find_kv_cache_type(p_type_v);
+    return elements * ((type_k ? type_k->bytes_per_element : 2.0) + (type_v ? type_v->bytes_per_element : 2.0));
+}
+
+bool LlamaCppProvider::create_context(const String& name, const Dictionary& config) {
+    if (!is_loaded()) {
+        log_error("create_context: no model loaded");
+        return false;
+    }
+    if (name.is_empty()) {
+        log_error("create_context: empty name");
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+        if (_find_lane(name) != nullptr) {
+            log_error("create_context: context already exists: " + name);
+            return false;
+        }
+    }
+    
+    String error;
+    std::unique_ptr<ContextLane> lane = _create_lane(name, config, error);
+    if (!lane) {
+        log_error("Failed to create context " + name + ": " + error);
+        return false;
+    }
+    
+    log_info("Context created: " + name +
+             " (ctx=" + String::num_int64(lane->n_ctx) +
+             ", n_seq_max=" + String::num_int64(lane->n_seq_max) +
+             ", kv=" + lane->type_k + "/" + lane->type_v +
+             ", threads=" + String::num_int64(lane->n_threads) + ")");
+    
+    _start_worker_thread(*lane);
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    m_lanes[name] = std::move(lane);
+    return true;
+}
+
+bool LlamaCppProvider::destroy_context(const String& name) {
+    if (name == DEFAULT_CONTEXT) {
+        log_error("destroy_context: the default context is freed by unload_model()");
+        return false;
+    }
+    
+    std::unique_ptr<ContextLane> lane;
+    {
+        std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+        auto it = m_lanes.find(name);
+        if (it == m_lanes.end()) {
+            return false;
+        }
+        lane = std::move(it->second);
+        m_lanes.erase(it);
+    }
+    _destroy_lane(std::move(lane));
+    log_info("Context destroyed: " + name);
+    return true;
+}
+
+bool LlamaCppProvider::set_context_elastic(const String& name, int n_ctx_min) {
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    ContextLane* lane = _find_lane(name);
+    if (lane == nullptr) {
+        return false;
+    }
+    lane->n_ctx_min.store(n_ctx_min > 0 ? std::min(round_up_cells(n_ctx_min), lane->n_ctx) : 0);
+    
+    // The worker resizes between jobs
+    {
+        std::lock_guard<std::mutex> lock(lane->job_mutex);
+        lane->resize_requested.store(true, std::memory_order_release);
+    }
+    lane->job_cv.notify_one();
+    return true;
+}
+
+bool LlamaCppProvider::start_op_profile(int n_steps, const String& context) {
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    ContextLane* lane = _find_lane(context);
+    if (lane == nullptr) {
+        log_error("start_op_profile: unknown context " + context);
+        return false;
+    }
+    lane->profiler.start(n_steps);
+    {
+        std::lock_guard<std::mutex> lock(lane->job_mutex);
+        lane->rebuild_requested.store(true, std::memory_order_release);
+    }
+    lane->job_cv.notify_one();
+    log_info("Op profile started on " + context + " for " + String::num_int64(n_steps) + " decode steps");
+    return true;
+}
+
+void LlamaCppProvider::stop_op_profile(const String& context) {
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    ContextLane* lane = _find_lane(context);
+    if (lane == nullptr) {
+        return;
+    }
+    lane->profiler.stop();
+    {
+        std::lock_guard<std::mutex> lock(lane->job_mutex);
+        lane->rebuild_requested.store(true, std::memory_order_release);
+    }
+    lane->job_cv.notify_one();
+}
+
+Dictionary LlamaCppProvider::get_op_profile(const String& context, int top_n) const {
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    ContextLane* lane = _find_lane(context);
+    if (lane == nullptr) {
+        return Dictionary();
+    }
+    Dictionary profile = lane->profiler.to_dict(top_n);
+    profile["context"] = context;
+    profile["system_info"] = String(llama_print_system_info());
+    return profile;
+}
+
+PackedStringArray LlamaCppProvider::get_context_names() const {
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    PackedStringArray names;
+    for (const auto& entry : m_lanes) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+Dictionary LlamaCppProvider::get_context_info() const {
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    
+    Dictionary contexts;
+    int64_t kv_bytes_total = 0;
+    for (const auto& entry : m_lanes) {
+        ContextLane& lane = *entry.second;
+        double bytes_per_cell = _kv_bytes_per_cell(lane.type_k, lane.type_v);
+        int n_ctx_alloc = lane.n_ctx_alloc.load(std::memory_order_relaxed);
+        int64_t kv_bytes = static_cast<int64_t>(n_ctx_alloc * bytes_per_cell);
+        kv_bytes_total += kv_bytes;
+        
+        Dictionary context;
+        context["n_ctx"] = lane.n_ctx;
+        context["n_ctx_alloc"] = n_ctx_alloc;
+        context["n_seq_max"] = lane.n_seq_max;
+        context["type_k"] = lane.type_k;
+        context["type_v"] = lane.type_v;
+        context["n_threads"] = lane.n_threads;
+        context["priority"] = lane.priority == COMPUTE_BACKGROUND ? "background" : "interactive";
+        context["kv_bytes"] = kv_bytes;
+        context["kv_bytes_max"] = static_cast<int64_t>(lane.n_ctx * bytes_per_cell);
+        context["active"] = lane.interactive_active.load(std::memory_order_acquire);
+        {
+            std::lock_guard<std::mutex> job_lock(lane.job_mutex);
+            context["queued"] = static_cast<int64_t>(lane.interactive_jobs.size());
+            context["speculative_queued"] = static_cast<int64_t>(lane.speculative_jobs.size());
+        }
+        context["requests"] = lane.requests.load(std::memory_order_relaxed);
+        context["rejected_busy"] = lane.rejected_busy.load(std::memory_order_relaxed);
+        
+        {
+            std::lock_guard<std::mutex> elastic_lock(lane.elastic_mutex);
+            const ElasticStats& stats = lane.elastic;
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - stats.since).count();
+            double saved = stats.saved_cell_seconds +
+                           (lane.n_ctx - n_ctx_alloc) * std::chrono::duration<double>(now - stats.last_change).count();
+            int64_t resizes = stats.grows + stats.shrinks + stats.failures;
+            
+            Dictionary elastic;
+            elastic["n_ctx_min"] = lane.n_ctx_min.load(std::memory_order_relaxed);
+            elastic["grows"] = stats.grows;
+            elastic["shrinks"] = stats.shrinks;
+            elastic["failures"] = stats.failures;
+            elastic["stall_ms_total"] = stats.stall_ms_total;
+            elastic["stall_ms_max"] = stats.stall_ms_max;
+            elastic["stall_ms_avg"] = resizes > 0 ? stats.stall_ms_total / resizes : 0.0;
+            elastic["avg_bytes_saved"] = static_cast<int64_t>(elapsed > 0.0 ? saved / elapsed * bytes_per_cell : 0.0);
+            elastic["bytes_saved"] = static_cast<int64_t>((lane.n_ctx - n_ctx_alloc) * bytes_per_cell);
+            context["elastic"] = elastic;
+        }
+        contexts[entry.first] = context;
+    }
+    
+    Dictionary info;
+    info["model_id"] = m_loaded_model_id;
+    info["weights_bytes"] = m_model != nullptr ? static_cast<int64_t>(llama_model_size(m_model)) : int64_t(0);
+    info["kv_bytes_total"] = kv_bytes_total;
+    info["contexts"] = contexts;
+    return info;
+}
+
+void LlamaCppProvider::_start_worker_thread(ContextLane& p_lane) {
+    p_lane.worker_stop.store(false, std::memory_order_release);
+    p_lane.worker_thread = std::make_unique<std::thread>(&LlamaCppProvider::_worker_thread_func, this, &p_lane);
+    LLMEngine::context_opened(p_lane.n_threads);
+}
+
+void LlamaCppProvider::_stop_worker_thread(ContextLane& p_lane) {
+    if (!p_lane.worker_thread) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(p_lane.handle_mutex);
+        if (p_lane.current_handle.is_valid()) {
+            p_lane.current_handle->request_cancel();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(p_lane.job_mutex);
+        p_lane.worker_stop.store(true, std::memory_order_release);
+    }
+    p_lane.job_cv.notify_all();
+    
+    if (p_lane.worker_thread->joinable()) {
+        p_lane.worker_thread->join();
+    }
+    p_lane.worker_thread.reset();
+    
+    {
+        std::lock_guard<std::mutex> lock(p_lane.handle_mutex);
+        p_lane.current_handle.unref();
+    }
+    
+    // Anything still queued never ran
+    for (GenerationJob& job : p_lane.interactive_jobs) {
+        job.handle->fail("Context freed");
+    }
+    p_lane.interactive_jobs.clear();
+    p_lane.speculative_jobs.clear();
+    p_lane.interactive_pending.store(false, std::memory_order_release);
+    p_lane.interactive_active.store(0, std::memory_order_release);
+    
+    // The KV cache goes away with the context
+    if (p_lane.spec_region_start >= 0) {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        m_speculative_stats.wasted++;
+        p_lane.spec_region_start = -1;
+    }
+    p_lane.kv_tokens.clear();
+    p_lane.kv_cells_used.store(0, std::memory_order_relaxed);
+}
+
+void LlamaCppProvider::_worker_thread_func(ContextLane* p_lane_ptr) {
+    ContextLane& p_lane = *p_lane_ptr;
+    while (true) {
+        GenerationJob job;
+        {
+            std::unique_lock<std::mutex> lock(p_lane.job_mutex);
+            p_lane.job_cv.wait(lock, [&p_lane] {
+                return p_lane.worker_stop.load(std::memory_order_acquire) ||
+                       p_lane.resize_requested.load(std::memory_order_acquire) ||
+                       p_lane.rebuild_requested.load(std::memory_order_acquire) ||
+                       !p_lane.interactive_jobs.empty() || !p_lane.speculative_jobs.empty();
+            });
+            if (p_lane.worker_stop.load(std::memory_order_acquire)) {
+                return;
+            }
+            bool rebuild = p_lane.rebuild_requested.exchange(false, std::memory_order_acq_rel);
+            bool resize = p_lane.resize_requested.exchange(false, std::memory_order_acq_rel);
+            if (rebuild || resize) {
+                lock.unlock();
+                if (rebuild) {
+                    String error;
+                    _resize_kv(p_lane, p_lane.n_ctx_alloc.load(std::memory_order_relaxed), error);
+                }
+                if (resize) {
+                    _apply_elastic_config(p_lane);
+                }
+                continue;
+            }
+            
+            // Interactive work always goes first
+            if (!p_lane.interactive_jobs.empty()) {
+                job = p_lane.interactive_jobs.front();
+                p_lane.interactive_jobs.pop_front();
+                p_lane.interactive_pending.store(!p_lane.interactive_jobs.empty(), std::memory_order_release);
+            } else {
+                job = p_lane.speculative_jobs.front();
+                p_lane.speculative_jobs.pop_front();
+            }
+        }
+        
+        LLMEngine::compute_begin(&p_lane.lease, m_loaded_model_id + "@" + p_lane.name,
+                                 job.speculative ? COMPUTE_SPECULATIVE : p_lane.priority, p_lane.n_threads);
+        if (job.speculative) {
+            _run_speculative_job(p_lane, job);
+        } else {
+            _run_interactive_job(p_lane, job);
+        }
+        LLMEngine::compute_end(&p_lane.lease);
+        
+        // A finished profile takes its eval callback with it
+        if (p_lane.profiler_installed && !p_lane.profiler.is_collecting()) {
+            String error;
+            _resize_kv(p_lane, p_lane.n_ctx_alloc.load(std::memory_order_relaxed), error);
+        }
+    }
+}
+
+bool LlamaCppProvider::_should_preempt(const ContextLane& p_lane) const {
+    return p_lane.interactive_pending.load(std::memory_order_acquire) ||
+           p_lane.worker_stop.load(std::memory_order_acquire);
+}
+
+void LlamaCppProvider::_swap_tiered_kv(ContextLane& p_lane, const std::vector<int32_t>& p_tokens, size_t& r_n_past) {
+    const String cache_types = p_lane.type_k + "/" + p_lane.type_v;
+    const size_t min_tokens = m_kv_tier.get_min_tokens();
+    bool evicting = p_lane.kv_tokens.size() >= r_n_past + min_tokens;
+    bool restoring = m_kv_tier.best_match(cache_types, p_tokens) >= r_n_past + min_tokens;
+    
+    // Save the resident sequence before the prompt overwrites it. Spliced
+    // example KV is not an exact prefill of its tokens and is not kept.
+    // A restore keeps a copy too, to fall back on if it fails.
+    const std::vector<int32_t> resident_tokens = p_lane.kv_tokens;
+    const size_t resident_n_past = r_n_past;
+    std::vector<uint8_t> resident;
+    if ((evicting || restoring) && p_lane.composed_from < 0 && !p_lane.kv_tokens.empty()) {
+        resident.resize(llama_state_seq_get_size(p_lane.ctx, 0));
+        if (llama_state_seq_get_data(p_lane.ctx, resident.data(), resident.size(), 0) != resident.size()) {
+            resident.clear();
+        }
+    }
+    if (evicting && !resident.empty()) {
+        m_kv_tier.put(cache_types, p_lane.kv_tokens, resident);
+    }
+    if (!restoring) {
+        return;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int32_t> tokens;
+    std::vector<uint8_t> state;
+    KvTierStore::Tier tier;
+    if (!m_kv_tier.take(cache_types, p_tokens, tokens, state, tier)) {
+        return;
+    }
+    
+    // Make room before touching the resident sequence; an entry that cannot
+    // be restored goes back to the store
+    String error;
+    if (static_cast<int>(tokens.size()) > p_lane.n_ctx ||
+        !_ensure_kv_capacity(p_lane, static_cast<int>(tokens.size()), error)) {
+        m_kv_tier.put(cache_types, tokens, state);
+        return;
+    }
+    
+    llama_memory_seq_rm(llama_get_memory(p_lane.ctx), 0, -1, -1);
+    p_lane.kv_tokens.clear();
+    p_lane.composed_from = -1;
+    r_n_past = 0;
+    if (llama_state_seq_set_data(p_lane.ctx, state.data(), state.size(), 0) != 0) {
+        p_lane.kv_tokens = std::move(tokens);
+        while (r_n_past < p_lane.kv_tokens.size() && r_n_past < p_tokens.size() &&
+               p_lane.kv_tokens[r_n_past] == p_tokens[r_n_past]) {
+            r_n_past++;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_kv_tier.report_restore(tier, p_lane.kv_tokens.size(), ms);
+    } else {
+        // A partial restore leaves nothing usable behind; put the resident
+        // sequence back so the prompt still reuses its prefix
+        llama_memory_seq_rm(llama_get_memory(p_lane.ctx), 0, -1, -1);
+        m_kv_tier.put(cache_types, tokens, state);
+        if (!resident.empty() && llama_state_seq_set_data(p_lane.ctx, resident.data(), resident.size(), 0) != 0) {
+            p_lane.kv_tokens = resident_tokens;
+            r_n_past = resident_n_past;
+        } else {
+            llama_memory_seq_rm(llama_get_memory(p_lane.ctx), 0, -1, -1);
+        }
+    }
+    p_lane.kv_cells_used.store(static_cast<int>(p_lane.kv_tokens.size()), std::memory_order_relaxed);
+    
+    // Whatever a speculative prefill left resident is gone now
+    if (p_lane.spec_region_start >= 0) {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        m_speculative_stats.wasted++;
+        p_lane.spec_region_start = -1;
+    }
+}
+
+void LlamaCppProvider::_set_sequence_cells(ContextLane& p_lane, int p_total, std::map<int, int>&& p_cells) {
+    std::lock_guard<std::mutex> lock(p_lane.seq_cells_mutex);
+    p_lane.seq_cells = std::move(p_cells);
+    p_lane.kv_cells_used.store(p_total, std::memory_order_relaxed);
+}
+
+bool LlamaCppProvider::_acquire_compute(ContextLane& p_lane, bool p_speculative) {
+    // Only speculative and background steps can park; they give up when
+    // preempted, cancelled or stopped
+    int threads = LLMEngine::compute_step(&p_lane.lease, [this, &p_lane, p_speculative]() {
+        if (p_speculative) {
+            return _should_preempt(p_lane);
+        }
+        std::lock_guard<std::mutex> lock(p_lane.handle_mutex);
+        return p_lane.worker_stop.load(std::memory_order_acquire) ||
+               (p_lane.current_handle.is_valid() && p_lane.current_handle->is_cancel_requested());
+    });
+    if (threads <= 0) {
+        return false;
+    }
+    if (threads != p_lane.compute_threads) {
+        llama_set_n_threads(p_lane.ctx, threads, threads);
+        p_lane.compute_threads = threads;
+    }
+    return true;
+}
+
+void LlamaCppProvider::_run_interactive_job(ContextLane& p_lane, const GenerationJob& p_job) {
+    {
+        std::lock_guard<std::mutex> lock(p_lane.handle_mutex);
+        p_lane.current_handle = p_job.handle;
+    }
+    
+    String text;
+    String error;
+    int n_tokens = 0;
+    GenerationTrace trace;
+    // Requests cancelled while queued never touch the KV cache
+    GenerationOutcome outcome = OUTCOME_CANCELLED;
+    if (!p_job.handle->is_cancel_requested()) {
+        if (p_job.summarize) {
+            outcome = _run_summarize(p_lane, p_job, text, n_tokens, error);
+        } else if (p_job.score) {
+            outcome = _run_score_batch(p_lane, p_job, error);
+        } else if (p_job.rerank) {
+            outcome = _run_rerank(p_lane, p_job, error);
+        } else {
+            outcome = _run_generation(p_lane, p_job, text, n_tokens, error, &trace);
+        }
+    }
+    if (outcome != OUTCOME_COMPLETED && !trace.prefilled && p_job.resume) {
+        // A resume that stopped before its prompt was back keeps what it had
+        trace.prefilled = true;
+        trace.prompt = p_job.resume->prompt;
+        trace.generated = p_job.resume->generated;
+        text = p_job.resume->text;
+    }
+    if (outcome != OUTCOME_COMPLETED && trace.prefilled) {
+        _salvage_generation(p_lane, p_job, trace, text);
+    }
+    
+    switch (outcome) {
+        case OUTCOME_COMPLETED: {
+            // Token-only output has no text to cache
+            bool cacheable = !p_job.summarize && !p_job.score && !p_job.rerank && p_job.handle->get_output_mode() != LLMGenerationHandle::OUTPUT_TOKENS;
+            String cache_key = cacheable ? _completion_cache_key(p_job.request) : String();
+            if (!cache_key.is_empty()) {
+                _store_completion(cache_key, text, n_tokens, false);
+            }
+            p_job.handle->complete(text);
+        } break;
+        case OUTCOME_CANCELLED:
+        case OUTCOME_PREEMPTED:
+            p_job.handle->mark_cancelled();
+            break;
+        case OUTCOME_FAILED:
+            p_job.handle->fail(error);
+            break;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(p_lane.handle_mutex);
+        p_lane.current_handle.unref();
+    }
+    p_lane.interactive_active.fetch_sub(1, std::memory_order_acq_rel);
+    
+    // A summary leaves the cache empty and a scoring job keeps only its
+    // instruction, but both needed all cells they grew to
+    if (outcome != OUTCOME_FAILED) {
+        int peak = p_job.summarize || p_job.score
+            ? p_lane.n_ctx_alloc.load(std::memory_order_relaxed)
+            : static_cast<int>(p_lane.kv_tokens.size());
+        _maybe_shrink_kv(p_lane, peak);
+    }
+}
+
+void LlamaCppProvider::_run_speculative_job(ContextLane& p_lane, const GenerationJob& p_job) {
+    auto start = std::chrono::steady_clock::now();
+    size_t resident_before = p_lane.kv_tokens.size();
+    
+    String text;
+    String error;
+    int n_tokens = 0;
+    GenerationOutcome outcome;
+    if (p_job.prefill_only) {
+        std::vector<int32_t> tokens;
+        ExamplePlan examples;
+        int reused = 0;
+        if (!_tokenize_request(p_job.request, p_job.request.prompt.is_empty(), tokens, examples, error) || tokens.empty()) {
+            outcome = OUTCOME_FAILED;
+        } else {
+            outcome = _prefill(p_lane, tokens, true, reused, error, &examples);
+        }
+    } else {
+        outcome = _run_generation(p_lane, p_job, text, n_tokens, error);
+    }
+    
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    if (outcome == OUTCOME_PREEMPTED) {
+        // Retry once the worker is idle again; the part of the prefix that
+        // was already decoded is usually still resident by then
+        std::lock_guard<std::mutex> lock(p_lane.job_mutex);
+        if (!p_lane.worker_stop.load(std::memory_order_acquire)) {
+            p_lane.speculative_jobs.push_front(p_job);
+        }
+    }
+    
+    if (outcome == OUTCOME_FAILED) {
+        log_warning("Speculative request " + p_job.speculative_id + " failed: " + error);
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        m_speculative_stats.compute_ms += elapsed_ms;
+        if (outcome == OUTCOME_PREEMPTED) {
+            m_speculative_stats.preempted++;
+        } else if (outcome == OUTCOME_COMPLETED) {
+            m_speculative_stats.completed++;
+            if (p_job.prefill_only) {
+                m_speculative_stats.tokens_computed += std::max<int64_t>(0, static_cast<int64_t>(p_lane.kv_tokens.size()) - static_cast<int64_t>(resident_before));
+            } else {
+                m_speculative_stats.tokens_computed += n_tokens;
+            }
+        }
+    }
+    
+    if (outcome == OUTCOME_COMPLETED && !p_job.prefill_only) {
+        String cache_key = _completion_cache_key(p_job.request);
+        if (!cache_key.is_empty()) {
+            _store_completion(cache_key, text, n_tokens, true);
+        }
+    }
+}
+
+LlamaCppProvider::GenerationOutcome LlamaCppProvider::_prefill(
+    ContextLane& p_lane,
+    const std::vector<int32_t>& p_tokens,
+    bool p_speculative,
+    int& r_reused,
+    String& r_error,
+    const ExamplePlan* p_examples
+) {
+    auto prefill_start = std::chrono::steady_clock::now();
+    const bool has_examples = p_examples != nullptr && !p_examples->blocks.empty();
+    const bool composing = has_examples && p_examples->compose;
+    
+    // An elastic context grows before the prompt needs the room; composing
+    // briefly holds one block twice
+    size_t longest_block = 0;
+    if (composing) {
+        for (const ExampleUse& use : p_examples->blocks) {
+            longest_block = std::max(longest_block, use.length);
+        }
+    }
+    if (!_ensure_kv_capacity(p_lane, static_cast<int>(p_tokens.size() + longest_block) + ELASTIC_GROW_HEADROOM, r_error)) {
+        return OUTCOME_FAILED;
+    }
+    
+    // Reuse the longest prefix already resident in sequence 0, but always
+    // re-evaluate the last prompt token so its logits are fresh
+    size_t n_past = 0;
+    while (n_past < p_lane.kv_tokens.size() && n_past < p_tokens.size() && p_lane.kv_tokens[n_past] == p_tokens[n_past]) {
+        n_past++;
+    }
+    // Spliced example KV only serves prompts that compose examples too
+    if (p_lane.composed_from >= 0 && !composing) {
+        n_past = std::min(n_past, static_cast<size_t>(p_lane.composed_from));
+    }
+    if (m_kv_tier.is_enabled()) {
+        _swap_tiered_kv(p_lane, p_tokens, n_past);
+    }
+    llama_memory_t mem = llama_get_memory(p_lane.ctx);
+    if (n_past == p_tokens.size()) {
+        n_past--;
+    }
+    
+    if (!llama_memory_seq_rm(mem, 0, n_past, -1)) {
+        // Some memory types cannot drop a partial range; start over
+        llama_memory_clear(mem, true);
+        n_past = 0;
+    }
+    p_lane.kv_tokens.resize(n_past);
+    p_lane.kv_cells_used.store(static_cast<int>(n_past), std::memory_order_relaxed);
+    if (p_lane.composed_from >= static_cast<int>(n_past)) {
+        p_lane.composed_from = -1;
+    }
+    r_reused = static_cast<int>(n_past);
+    
+    // Account for KV that a speculative prefill left behind
+    if (p_lane.spec_region_start >= 0) {
+        int reused = std::min(static_cast<int>(n_past), p_lane.spec_region_end) - p_lane.spec_region_start;
+        if (!p_speculative) {
+            std::lock_guard<std::mutex> lock(m_cache_mutex);
+            if (reused > 0) {
+                m_speculative_stats.useful++;
+                m_speculative_stats.tokens_reused += reused;
+            } else {
+                m_speculative_stats.wasted++;
+            }
+            p_lane.spec_region_start = -1;
+        } else if (static_cast<int>(n_past) < p_lane.spec_region_end) {
+            std::lock_guard<std::mutex> lock(m_cache_mutex);
+            m_speculative_stats.wasted++;
+            p_lane.spec_region_start = -1;
+        }
+    }
+    int region_start = p_lane.spec_region_start >= 0 ? p_lane.spec_region_start : static_cast<int>(n_past);
+    
+    const int chunk = p_speculative ? SPECULATIVE_PREFILL_CHUNK : static_cast<int>(llama_n_batch(p_lane.ctx));
+    llama_batch batch = llama_batch_init(chunk, 0, 1);
+    
+    auto decode_range = [&](size_t p_from, size_t p_to) {
+        for (size_t start = p_from; start < p_to; start += chunk) {
+            if (p_speculative && _should_preempt(p_lane)) {
+                return OUTCOME_PREEMPTED;
+            }
+            
+            if (!_acquire_compute(p_lane, p_speculative)) {
+                return p_speculative ? OUTCOME_PREEMPTED : OUTCOME_CANCELLED;
+            }
+            
+            size_t end = std::min(start + chunk, p_to);
+            batch.n_tokens = 0;
+            for (size_t i = start; i < end; i++) {
+                batch_add(batch, p_tokens[i], i, { 0 }, i == p_tokens.size() - 1);
+            }
+            
+            if (llama_decode(p_lane.ctx, batch) != 0) {
+                llama_memory_clear(mem, true);
+                p_lane.kv_tokens.clear();
+                p_lane.kv_cells_used.store(0, std::memory_order_relaxed);
+                p_lane.spec_region_start = -1;
+                p_lane.composed_from = -1;
+                r_error = "Failed to evaluate prompt";
+                return OUTCOME_FAILED;
+            }
+            p_lane.kv_tokens.insert(p_lane.kv_tokens.end(), p_tokens.begin() + start, p_tokens.begin() + end);
+            p_lane.kv_cells_used.store(static_cast<int>(p_lane.kv_tokens.size()), std::memory_order_relaxed);
+        }
+        return OUTCOME_COMPLETED;
+    };
+    
+    // Example blocks not yet resident are decoded up to the recompute window
+    // and spliced from there. The prompt's last token is always decoded for
+    // its logits.
+    size_t pos = n_past;
+    GenerationOutcome outcome = OUTCOME_COMPLETED;
+    if (composing) {
+        for (const ExampleUse& use : p_examples->blocks) {
+            size_t from = use.start + p_examples->recompute;
+            size_t to = std::min(use.start + use.length, p_tokens.size() - 1);
+            if (from < pos || from >= to) {
+                continue;
+            }
+            outcome = decode_range(pos, from);
+            if (outcome != OUTCOME_COMPLETED) {
+                break;
+            }
+            pos = from;
+            if (_splice_example(p_lane, use, from, to, p_speculative)) {
+                p_lane.kv_tokens.insert(p_lane.kv_tokens.end(), p_tokens.begin() + from, p_tokens.begin() + to);
+                p_lane.kv_cells_used.store(static_cast<int>(p_lane.kv_tokens.size()), std::memory_order_relaxed);
+                if (p_lane.composed_from < 0) {
+                    p_lane.composed_from = static_cast<int>(from);
+                }
+                pos = to;
+            }
+        }
+    }
+    if (outcome == OUTCOME_COMPLETED) {
+        outcome = decode_range(pos, p_tokens.size());
+    }
+    llama_batch_free(batch);
+    if (outcome != OUTCOME_COMPLETED) {
+        return outcome;
+    }
+    
+    if (p_speculative && static_cast<int>(p_lane.kv_tokens.size()) > region_start) {
+        p_lane.spec_region_start = region_start;
+        p_lane.spec_region_end = static_cast<int>(p_lane.kv_tokens.size());
+    }
+    if (has_examples && !p_speculative) {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - prefill_start).count();
+        std::lock_guard<std::mutex> lock(m_examples_mutex);
+        if (composing) {
+            m_example_stats.composed_requests++;
+            m_example_stats.composed_prefill_ms += ms;
+        } else {
+            m_example_stats.full_requests++;
+            m_example_stats.full_prefill_ms += ms;
+        }
+    }
+    return OUTCOME_COMPLETED;
+}
+
+bool LlamaCppProvider::_splice_example(ContextLane& p_lane, const ExampleUse& p_use, size_t p_from, size_t p_to, bool p_speculative) {
+    llama_memory_t mem = llama_get_memory(p_lane.ctx);
+    const llama_seq_id scratch = p_lane.n_seq_max;
+    const String cache_types = p_lane.type_k + "/" + p_lane.type_v;
+    auto start = std::chrono::steady_clock::now();
+    
+    // Moving a block needs a position shift (RoPE) and room for a second
+    // copy of it next to sequence 0
+    bool fits = static_cast<int>(p_from + p_use.length) <= p_lane.n_ctx_alloc.load(std::memory_order_relaxed);
+    std::shared_ptr<const std::vector<uint8_t>> state;
+    {
+        std::lock_guard<std::mutex> lock(m_examples_mutex);
+        auto it = p_use.block->states.find(cache_types);
+        if (it != p_use.block->states.end()) {
+            state = it->second;
+        }
+    }
+    
+    bool ready = false;
+    if (fits && state && llama_memory_can_shift(mem)) {
+        ready = llama_state_seq_set_data(p_lane.ctx, state->data(), state->size(), scratch) != 0;
+    } else if (fits && llama_memory_can_shift(mem)) {
+        // First use with these cache types: evaluate the block alone from
+        // position 0 in the scratch sequence and keep its state
+        const int n_batch = static_cast<int>(llama_n_batch(p_lane.ctx));
+        llama_batch batch = llama_batch_init(n_batch, 0, 1);
+        ready = true;
+        for (size_t begin = 0; ready && begin < p_use.length; begin += n_batch) {
+            if (!_acquire_compute(p_lane, p_speculative)) {
+                ready = false;
+                break;
+            }
+            batch.n_tokens = 0;
+            for (size_t i = begin; i < std::min(begin + n_batch, p_use.length); i++) {
+                batch_add(batch, p_use.block->tokens[i], i, { scratch }, false);
+            }
+            ready = llama_decode(p_lane.ctx, batch) == 0;
+        }
+        llama_batch_free(batch);
+        
+        if (ready) {
+            auto saved = std::make_shared<std::vector<uint8_t>>(llama_state_seq_get_size(p_lane.ctx, scratch));
+            if (llama_state_seq_get_data(p_lane.ctx, saved->data(), saved->size(), scratch) == saved->size()) {
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                std::lock_guard<std::mutex> lock(m_examples_mutex);
+                p_use.block->states[cache_types] = saved;
+                m_example_stats.precomputes++;
+                m_example_stats.precompute_tokens += static_cast<int64_t>(p_use.length);
+                m_example_stats.precompute_ms += ms;
+            }
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    
+    if (!ready) {
+        llama_memory_seq_rm(mem, scratch, -1, -1);
+        std::lock_guard<std::mutex> lock(m_examples_mutex);
+        m_example_stats.fallbacks++;
+        return false;
+    }
+    
+    // Drop the recompute window (already decoded in place) and anything past
+    // p_to, shift the rest to its prompt position and hand it to sequence 0
+    const llama_pos window = static_cast<llama_pos>(p_from - p_use.start);
+    llama_memory_seq_rm(mem, scratch, 0, window);
+    llama_memory_seq_rm(mem, scratch, static_cast<llama_pos>(p_to - p_use.start), -1);
+    llama_memory_seq_add(mem, scratch, 0, -1, static_cast<llama_pos>(p_use.start));
+    llama_memory_seq_cp(mem, scratch, 0, -1, -1);
+    llama_memory_seq_rm(mem, scratch, -1, -1);
+    
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(m_examples_mutex);
+    m_example_stats.blocks_spliced++;
+    m_example_stats.tokens_spliced += static_cast<int64_t>(p_to - p_from);
+    m_example_stats.tokens_recomputed += window;
+    m_example_stats.splice_ms += ms;
+    return true;
+}
+
+LlamaCppProvider::GenerationOutcome LlamaCppProvider::_run_generation(
+    ContextLane& p_lane,
+    const GenerationJob& p_job,
+    String& r_text,
+    int& r_n_tokens,
+    String& r_error,
+    GenerationTrace* r_trace
+) {
+    const GenerationRequest& request = p_job.request;
+    const bool speculative = p_job.speculative;
+    const SalvagedGeneration* resumed = p_job.resume.get();
+    
+    // Tokenize the prompt with its system prompt and examples
+    std::vector<int32_t> tokens;
+    ExamplePlan examples;
+    bool tokenized = _tokenize_request(request, false, tokens, examples, r_error);
+    if (resumed != nullptr) {
+        // Continue after the last good token. Examples are only composed if
+        // they still tokenize to the same prompt.
+        if (!tokenized || tokens != resumed->prompt) {
+            examples = ExamplePlan();
+        }
+        tokens = resumed->prompt;
+        tokens.insert(tokens.end(), resumed->generated.begin(), resumed->generated.end());
+        r_error = "";
+    } else if (!tokenized) {
+        return OUTCOME_FAILED;
+    }
+    
+    if (tokens.empty()) {
+        r_error = "Failed to tokenize prompt";
+        return OUTCOME_FAILED;
+    }
+    
+    // Check if prompt fits in context
+    if (static_cast<int>(tokens.size()) >= p_lane.n_ctx) {
+        if (!speculative) {
+            int64_t n_prompt = tokens.size();
+            _record_usage(p_lane, [n_prompt](ModelUsageStats& stats) { stats.record_too_long(n_prompt); });
+        }
+        r_error = "Prompt too long for context window";
+        return OUTCOME_FAILED;
+    }
+    
+    // Sampler restriction: sample among the request's candidates, or the
+    // configured trim, instead of the whole vocabulary
+    const llama_vocab* vocab = llama_model_get_vocab(m_model);
+    std::shared_ptr<const std::vector<int32_t>> trim = _get_vocab_trim();
+    std::vector<int32_t> request_candidates;
+    const std::vector<int32_t>* candidates = nullptr;
+    if (!request.candidate_tokens.empty()) {
+        if (request.candidate_tokens.front() < 0 || request.candidate_tokens.back() >= llama_vocab_n_tokens(vocab)) {
+            r_error = "candidate_tokens contains ids outside the vocabulary";
+            return OUTCOME_FAILED;
+        }
+        request_candidates = request.candidate_tokens;
+        add_end_tokens(vocab, request_candidates);
+        candidates = &request_candidates;
+    } else if (request.vocab_trim && trim) {
+        candidates = trim.get();
+    }
+    const std::vector<int32_t>* trim_check = candidates == nullptr && trim ? trim.get() : nullptr;
+    std::vector<llama_token_data> candidate_scratch;
+    
+    // Lookup decoding: draft from the request's own tokens and let the
+    // model verify the draft in one batch. Precompute jobs stay single-token
+    // so they can yield after every step.
+    LookupDecodingConfig lookup_config = _resolve_lookup_decoding(request);
+    const bool lookup_decode = !speculative && lookup_config.enabled;
+    std::vector<int32_t> history;
+    std::vector<int32_t> draft;
+    if (lookup_decode) {
+        history = tokens;
+    }
+    
+    // Instantiate the requested logits processors before spending any decode
+    std::vector<std::unique_ptr<LogitsProcessor>> processors;
+    std::vector<LogitsProcessorTiming> timings(request.logits_processors.size());
+    if (!request.logits_processors.is_empty()) {
+        LogitsProcessorContext processor_context;
+        processor_context.vocab = llama_model_get_vocab(m_model);
+        processor_context.pieces = &_get_token_pieces();
+        
+        for (int i = 0; i < request.logits_processors.size(); i++) {
+            Variant entry = request.logits_processors[i];
+            Dictionary args;
+            if (entry.get_type() == Variant::DICTIONARY) {
+                args = entry;
+            }
+            String name = entry.get_type() == Variant::DICTIONARY ? String(args.get("name", "")) : String(entry);
+            
+            std::unique_ptr<LogitsProcessor> processor = LogitsProcessorRegistry::create(name, args, processor_context, r_error);
+            if (!processor) {
+                return OUTCOME_FAILED;
+            }
+            timings[i].name = name;
+            processors.push_back(std::move(processor));
+        }
+    }
+    
+    // Evaluate prompt, reusing whatever prefix is still resident
+    bool kv_restored = resumed != nullptr && !resumed->kv_state.empty() && _restore_salvaged_kv(p_lane, *resumed, tokens);
+    int reused = 0;
+    GenerationOutcome prefill_outcome = _prefill(p_lane, tokens, speculative, reused, r_error, &examples);
+    if (prefill_outcome != OUTCOME_COMPLETED) {
+        return prefill_outcome;
+    }
+    if (r_trace != nullptr) {
+        r_trace->prefilled = true;
+        r_trace->prompt = resumed != nullptr ? resumed->prompt : tokens;
+        if (resumed != nullptr) {
+            r_trace->generated = resumed->generated;
+        }
+    }
+    if (resumed != nullptr) {
+        std::lock_guard<std::mutex> lock(m_resume_mutex);
+        m_resume_stats.resumes++;
+        m_resume_stats.tokens_salvaged += static_cast<int64_t>(resumed->generated.size());
+        m_resume_stats.tokens_reused += reused;
+        m_resume_stats.kv_restores += kv_restored ? 1 : 0;
+    }
+    
+    // Setup sampler chain
+    llama_sampler* sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    
+    // Add samplers in order. Game constraints come first so truncation
+    // never leaves only banned candidates behind.
+    for (size_t i = 0; i < processors.size(); i++) {
+        llama_sampler_chain_add(sampler, LogitsProcessorRegistry::create_sampler(std::move(processors[i]), &timings[i]));
+    }
+    _add_default_samplers(sampler, request);
+    
+    llama_batch next_batch = llama_batch_init(lookup_decode ? lookup_config.draft_max + 1 : 1, 0, 1);
+    
+    // Token-only output never builds a String per token; stop sequences are
+    // then matched against the raw piece bytes
+    const bool emit_text = speculative || p_job.handle->get_output_mode() != LLMGenerationHandle::OUTPUT_TOKENS;
+    const bool emit_ids = !speculative && p_job.handle->is_collecting_token_ids();
+    const std::vector<std::string>* pieces = nullptr;
+    std::vector<std::string> stop_bytes;
+    std::string generated_bytes;
+    if (!emit_text && !request.stop_sequences.is_empty()) {
+        pieces = &_get_token_pieces();
+        for (int i = 0; i < request.stop_sequences.size(); i++) {
+            stop_bytes.push_back(request.stop_sequences[i].utf8().get_data());
+        }
+    }
+    
+    // Generation loop
+    GenerationOutcome outcome = OUTCOME_COMPLETED;
+    String generated_text;
+    int n_cur = tokens.size();
+    r_n_tokens = 0;
+    
+    // A resumed handle carries the whole output; the salvaged part arrives
+    // as one chunk and goes through the sampler chain so stateful processors
+    // pick up where they were
+    int n_resumed = 0;
+    if (resumed != nullptr) {
+        n_resumed = static_cast<int>(resumed->generated.size());
+        r_n_tokens = n_resumed;
+        for (int32_t id : resumed->generated) {
+            llama_sampler_accept(sampler, id);
+            if (emit_ids) {
+                p_job.handle->append_token_id(id);
+            }
+            if (pieces != nullptr) {
+                generated_bytes += (*pieces)[id];
+            }
+        }
+        if (emit_text && n_resumed > 0) {
+            generated_text = resumed->text;
+            p_job.handle->append_token(generated_text, n_resumed);
+        }
+    }
+    int64_t n_samples = 0;
+    int64_t sample_ns = 0;
+    int64_t trim_misses = 0;
+    int64_t n_decodes = 0;
+    int64_t n_verify_decodes = 0;
+    int64_t n_drafted = 0;
+    int64_t n_accepted = 0;
+    auto loop_start = std::chrono::steady_clock::now();
+    
+    auto sample_at = [&](int32_t p_idx) {
+        auto sample_start = std::chrono::steady_clock::now();
+        llama_token token = candidates != nullptr
+            ? sample_candidates(sampler, p_lane.ctx, p_idx, *candidates, candidate_scratch)
+            : llama_sampler_sample(sampler, p_lane.ctx, p_idx);
+        sample_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sample_start).count();
+        n_samples++;
+        if (trim_check != nullptr && !std::binary_search(trim_check->begin(), trim_check->end(), token)) {
+            trim_misses++;
+        }
+        return token;
+    };
+    
+    // Tokens sampled by the last verify batch, in order. All but the last
+    // are already in the KV cache.
+    std::deque<llama_token> verified;
+    
+    for (int i = n_resumed; i < request.max_tokens; i++) {
+        // Check for cancellation or preemption
+        if (speculative ? _should_preempt(p_lane) : p_job.handle->is_cancel_requested()) {
+            outcome = speculative ? OUTCOME_PREEMPTED : OUTCOME_CANCELLED;
+            break;
+        }
+        
+        // Sample next token, unless verification already did
+        llama_token new_token;
+        bool in_kv = false;
+        if (!verified.empty()) {
+            new_token = verified.front();
+            verified.pop_front();
+            in_kv = !verified.empty();
+        } else {
+            new_token = sample_at(-1);
+        }
+        
+        // Check for EOS
+        if (llama_token_is_eog(vocab, new_token)) {
+            break;
+        }
+        
+        r_n_tokens++;
+        if (emit_ids) {
+            p_job.handle->append_token_id(new_token);
+        }
+        if (r_trace != nullptr) {
+            r_trace->generated.push_back(new_token);
+        }
+        
+        // Convert, emit and check stop sequences
+        bool stop = false;
+        if (emit_text) {
+            String token_str = token_to_string(new_token);
+            generated_text += token_str;
+            if (!speculative) {
+                p_job.handle->append_token(token_str);
+            }
+            stop = check_stop_sequences(generated_text, request.stop_sequences);
+        } else if (pieces != nullptr) {
+            generated_bytes += (*pieces)[new_token];
+            stop = ends_with_any(generated_bytes, stop_bytes);
+        }
+        if (stop) {
+            break;
+        }
+        if (lookup_decode) {
+            history.push_back(new_token);
+        }
+        if (in_kv) {
+            continue;
+        }
+        
+        // Draft what follows, bounded by the tokens still wanted and the
+        // context size
+        draft.clear();
+        if (lookup_decode) {
+            int room = std::min(request.max_tokens - i - 1, p_lane.n_ctx - n_cur - 1);
+            draft_from_history(history, lookup_config.ngram, std::min(lookup_config.draft_max, room), draft);
+        }
+        
+        // Grow an elastic context before the next cell is needed. Only
+        // sequence state moves over; the logits just sampled are not reused.
+        int last_cell = n_cur + static_cast<int>(draft.size());
+        if (last_cell >= p_lane.n_ctx_alloc.load(std::memory_order_relaxed) &&
+                !_ensure_kv_capacity(p_lane, last_cell + ELASTIC_GROW_HEADROOM, r_error)) {
+            outcome = OUTCOME_FAILED;
+            break;
+        }
+        
+        // Prepare next batch: the new token, then the draft
+        next_batch.n_tokens = 0;
+        batch_add(next_batch, new_token, n_cur, { 0 }, true);
+        for (size_t d = 0; d < draft.size(); d++) {
+            batch_add(next_batch, draft[d], n_cur + 1 + static_cast<int>(d), { 0 }, true);
+        }
+        n_cur++;
+        
+        // Evaluate
+        if (!_acquire_compute(p_lane, speculative)) {
+            outcome = speculative ? OUTCOME_PREEMPTED : OUTCOME_CANCELLED;
+            break;
+        }
+        if (llama_decode(p_lane.ctx, next_batch) != 0) {
+            llama_memory_clear(llama_get_memory(p_lane.ctx), true);
+            p_lane.kv_tokens.clear();
+            p_lane.kv_cells_used.store(0, std::memory_order_relaxed);
+            r_error = "Decode failed during generation";
+            outcome = OUTCOME_FAILED;
+            break;
+        }
+        n_decodes++;
+        p_lane.kv_tokens.push_back(new_token);
+        
+        // Verify: sample after each position and keep drafted tokens while
+        // they match. The first mismatch is the model's own next token; its
+        // drafted successors leave the cache.
+        if (!draft.empty()) {
+            n_verify_decodes++;
+            n_drafted += draft.size();
+            size_t matched = 0;
+            for (size_t d = 0; d <= draft.size(); d++) {
+                llama_token token = sample_at(static_cast<int32_t>(d));
+                verified.push_back(token);
+                if (d == draft.size() || token != draft[d]) {
+                    break;
+                }
+                matched++;
+            }
+            n_accepted += matched;
+            p_lane.kv_tokens.insert(p_lane.kv_tokens.end(), draft.begin(), draft.begin() + matched);
+            llama_memory_seq_rm(llama_get_memory(p_lane.ctx), 0, n_cur + static_cast<int>(matched), -1);
+            n_cur += static_cast<int>(matched);
+        }
+        p_lane.kv_cells_used.store(static_cast<int>(p_lane.kv_tokens.size()), std::memory_order_relaxed);
+    }
+    
+    llama_batch_free(next_batch);
+    llama_sampler_free(sampler);
+    
+    int64_t loop_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - loop_start).count();
+    if (!speculative && r_n_tokens > 0) {
+        std::lock_guard<std::mutex> lock(m_lookup_decoding_mutex);
+        LookupDecodingStats& stats = m_lookup_decoding_stats;
+        if (lookup_decode) {
+            stats.requests++;
+            stats.tokens += r_n_tokens;
+            stats.loop_ns += loop_ns;
+            stats.decodes += n_decodes;
+            stats.verify_decodes += n_verify_decodes;
+            stats.drafted += n_drafted;
+            stats.accepted += n_accepted;
+        } else {
+            stats.plain_tokens += r_n_tokens;
+            stats.plain_loop_ns += loop_ns;
+        }
+    }
+    
+    if (!speculative && n_samples > 0) {
+        std::lock_guard<std::mutex> lock(m_vocab_mutex);
+        if (candidates != nullptr) {
+            m_vocab_stats.restricted_tokens += n_samples;
+            m_vocab_stats.restricted_sample_ns += sample_ns;
+            m_vocab_stats.restricted_loop_ns += loop_ns;
+            m_vocab_stats.candidates += n_samples * static_cast<int64_t>(candidates->size());
+        } else {
+            m_vocab_stats.full_tokens += n_samples;
+            m_vocab_stats.full_sample_ns += sample_ns;
+            m_vocab_stats.full_loop_ns += loop_ns;
+        }
+        if (trim_check != nullptr) {
+            m_vocab_stats.trim_checked += n_samples;
+            m_vocab_stats.trim_misses += trim_misses;
+        }
+    }
+    
+    if (!timings.empty()) {
+        std::lock_guard<std::mutex> lock(m_processor_stats_mutex);
+        for (const LogitsProcessorTiming& timing : timings) {
+            LogitsProcessorTiming& total = m_processor_stats[timing.name.utf8().get_data()];
+            total.name = timing.name;
+            total.total_ns += timing.total_ns;
+            total.tokens += timing.tokens;
+        }
+    }
+    
+    if (!speculative && outcome != OUTCOME_FAILED) {
+        int64_t n_prompt = tokens.size();
+        int64_t n_output = r_n_tokens;
+        int64_t peak_cells = p_lane.kv_tokens.size();
+        _record_usage(p_lane, [=](ModelUsageStats& stats) {
+            stats.record_request(n_prompt, n_output, peak_cells, reused);
+        });
+    }
+    
+    r_text = generated_text;
+    return outcome;
+}
+
+void LlamaCppProvider::_add_default_samplers(llama_sampler* p_chain, const GenerationRequest& p_request) {
+    llama_sampler_chain_add(p_chain, llama_sampler_init_top_k(p_request.top_k));
+    llama_sampler_chain_add(p_chain, llama_sampler_init_top_p(p_request.top_p, 1));
+    llama_sampler_chain_add(p_chain, llama_sampler_init_temp(p_request.temperature));
+    llama_sampler_chain_add(p_chain, llama_sampler_init_dist(p_request.seed >= 0 ? p_request.seed : LLAMA_DEFAULT_SEED));
+}
+
+std::vector<std::vector<int32_t>> LlamaCppProvider::_split_tokens(const std::vector<int32_t>& p_tokens, int p_chunk_tokens) const {
+    std::vector<std::vector<int32_t>> chunks;
+    const size_t window = std::max(1, p_chunk_tokens / SUMMARIZE_BOUNDARY_DIVISOR);
+    
+    size_t start = 0;
+    while (start < p_tokens.size()) {
+        size_t end = std::min(start + p_chunk_tokens, p_tokens.size());
+        if (end < p_tokens.size()) {
+            // Prefer ending on a line break, then on a sentence end
+            size_t line_end = 0;
+            size_t sentence_end = 0;
+            for (size_t i = end; i > start + 1 && i + window > end; i--) {
+                String piece = token_to_string(p_tokens[i - 1]);
+                if (piece.find("\n") >= 0) {
+                    line_end = i;
+                    break;
+                }
+                if (sentence_end == 0 && (piece.ends_with(".") || piece.ends_with("!") || piece.ends_with("?"))) {
+                    sentence_end = i;
+                }
+            }
+            if (line_end > 0) {
+                end = line_end;
+            } else if (sentence_end > 0) {
+                end = sentence_end;
+            }
+        }
+        chunks.emplace_back(p_tokens.begin() + start, p_tokens.begin() + end);
+        start = end;
+    }
+    return chunks;
+}
+
+LlamaCppProvider::GenerationOutcome LlamaCppProvider::_run_summarize(
+    ContextLane& p_lane,
+    const GenerationJob& p_job,
+    String& r_text,
+    int& r_n_tokens,
+    String& r_error
+) {
+    const SummarizeRequest& summary = p_job.summarize_request;
+    auto start = std::chrono::steady_clock::now();
+    
+    // The chat template is split around the user turn so every chunk shares
+    // the instruction prefix and ends with the same assistant header
+    GenerationRequest map_request = p_job.request;
+    map_request.system_prompt = summary.instructions;
+    map_request.prompt = "";
+    GenerationRequest reduce_request = map_request;
+    reduce_request.system_prompt = summary.reduce_instructions;
+    
+    String map_prefix_text = _format_prompt(map_request, true);
+    String suffix_text = _format_prompt(map_request, false).substr(map_prefix_text.length());
+    std::vector<int32_t> map_prefix = tokenize(map_prefix_text, true);
+    std::vector<int32_t> reduce_prefix = tokenize(_format_prompt(reduce_request, true), true);
+    std::vector<int32_t> suffix = tokenize(suffix_text, false);
+    
+    // One chunk sequence (with the prefix) must fit the context on its own
+    int fixed = static_cast<int>(std::max(map_prefix.size(), reduce_prefix.size()) + suffix.size());
+    int chunk_tokens = summary.chunk_tokens > 0 ? summary.chunk_tokens : SUMMARIZE_DEFAULT_CHUNK_TOKENS;
+    chunk_tokens = std::min(chunk_tokens, p_lane.n_ctx - fixed - std::max(summary.chunk_max_tokens, p_job.request.max_tokens));
+    if (chunk_tokens < SUMMARIZE_MIN_CHUNK_TOKENS) {
+        r_error = "Context too small to summarize in chunks";
+        return OUTCOME_FAILED;
+    }
+    
+    std::vector<int32_t> tokens = tokenize(summary.text, false);
+    const int64_t n_input = tokens.size();
+    
+    Dictionary progress;
+    progress["input_tokens"] = n_input;
+    progress["chunk_tokens"] = chunk_tokens;
+    int levels = 0;
+    int64_t map_sequences = 0;
+    int map_tokens = 0;
+    int max_parallel = 1;
+    
+    // Map: summarize every chunk, then summarize the joined summaries again
+    // until they fit in one chunk
+    while (static_cast<int>(tokens.size()) > chunk_tokens) {
+        if (levels >= SUMMARIZE_MAX_LEVELS) {
+            r_error = "Summaries still exceed one chunk after " + String::num_int64(levels) + " levels";
+            return OUTCOME_FAILED;
+        }
+        
+        std::vector<std::vector<int32_t>> inputs = _split_tokens(tokens, chunk_tokens);
+        for (std::vector<int32_t>& input : inputs) {
+            input.insert(input.end(), suffix.begin(), suffix.end());
+        }
+        progress["stage"] = "map";
+        progress["level"] = levels;
+        
+        std::vector<String> summaries;
+        GenerationOutcome outcome = _run_parallel_sequences(
+            p_lane, p_job, map_prefix, inputs, summary.chunk_max_tokens, false, progress, summaries, map_tokens, r_error);
+        if (outcome != OUTCOME_COMPLETED) {
+            return outcome;
+        }
+        map_sequences += inputs.size();
+        max_parallel = std::max(max_parallel, static_cast<int>(progress.get("parallel", 1)));
+        levels++;
+        
+        String joined;
+        for (const String& part : summaries) {
+            joined += (joined.is_empty() ? "" : "\n\n") + part;
+        }
+        std::vector<int32_t> next = tokenize(joined, false);
+        if (next.size() >= tokens.size()) {
+            r_error = "Chunk summaries are not shorter than their input; lower chunk_max_tokens";
+            return OUTCOME_FAILED;
+        }
+        tokens = std::move(next);
+    }
+    
+    // Reduce (or, for a short input, the only summary) streams to the handle
+    std::vector<std::vector<int32_t>> inputs(1, tokens);
+    inputs[0].insert(inputs[0].end(), suffix.begin(), suffix.end());
+    progress["stage"] = levels > 0 ? "reduce" : "summarize";
+    progress["level"] = levels;
+    
+    std::vector<String> outputs;
+    r_n_tokens = 0;
+    GenerationOutcome outcome = _run_parallel_sequences(
+        p_lane, p_job, levels > 0 ? reduce_prefix : map_prefix, inputs, p_job.request.max_tokens, true, progress, outputs, r_n_tokens, r_error);
+    if (outcome != OUTCOME_COMPLETED) {
+        return outcome;
+    }
+    r_text = outputs[0];
+    
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    progress["stage"] = "done";
+    progress["levels"] = levels;
+    progress["map_sequences"] = map_sequences;
+    progress["map_tokens"] = map_tokens;
+    progress["parallel"] = max_parallel;
+    progress["wall_ms"] = wall_ms;
+    p_job.handle->report_progress(progress);
+    
+    int64_t n_output = r_n_tokens;
+    int64_t peak_cells = p_lane.n_ctx_alloc.load(std::memory_order_relaxed);
+    _record_usage(p_lane, [=](ModelUsageStats& stats) {
+        stats.record_request(n_input, n_output, peak_cells, 0);
+    });
+    
+    log_info("Summarized " + String::num_int64(n_input) + " tokens: " +
+             String::num_int64(map_sequences) + " chunk summaries over " + String::num_int64(levels) +
+             " levels, " + String::num_int64(max_parallel) + " in parallel, " + String::num(wall_ms, 0) + " ms");
+    return OUTCOME_COMPLETED;
+}
+
+LlamaCppProvider::GenerationOutcome LlamaCppProvider::_run_score_batch(
+    ContextLane& p_lane,
+    const GenerationJob& p_job,
+    String& r_error
+) {
+    const ScoreRequest& score = p_job.score_request;
+    auto start = std::chrono::steady_clock::now();
+    
+    // Same split of the chat template as _run_summarize: the instruction
+    // prefix is shared, every item is followed by the assistant header
+    GenerationRequest request = p_job.request;
+    request.system_prompt = score.instruction;
+    request.prompt = "";
+    String prefix_text = _format_prompt(request, true);
+    std::vector<int32_t> prefix = tokenize(prefix_text, true);
+    std::vector<int32_t> suffix = tokenize(_format_prompt(request, false).substr(prefix_text.length()), false);
+    
+    // A label is decided by its first token, so those must all differ
+    std::vector<llama_token> label_tokens;
+    for (int l = 0; l < score.labels.size(); l++) {
+        std::vector<int32_t> ids = tokenize(score.labels[l], false);
+        if (ids.empty()) {
+            r_error = "Empty label";
+            return OUTCOME_FAILED;
+        }
+        for (int k = 0; k < l; k++) {
+            if (label_tokens[k] == ids[0]) {
+                r_error = "Labels \"" + score.labels[k] + "\" and \"" + score.labels[l] + "\" start with the same token";
+                return OUTCOME_FAILED;
+            }
+        }
+        label_tokens.push_back(ids[0]);
+    }
+    
+    // The instruction stays in sequence 0, so the next job with the same
+    // instruction reuses it like any other prompt prefix
+    int reused = 0;
+    GenerationOutcome outcome = _prefill(p_lane, prefix, false, reused, r_error);
+    if (outcome != OUTCOME_COMPLETED) {
+        return outcome;
+    }
+    
+    // Items run in sequences 1..n_seq_max (the last one is the scratch
+    // sequence, idle outside of a prefill)
+    const int n_prefix = static_cast<int>(prefix.size());
+    const int n_items = score.items.size();
+    const int n_labels = static_cast<int>(label_tokens.size());
+    const int width = std::clamp(score.batch_size > 0 ? score.batch_size : p_lane.n_seq_max, 1, p_lane.n_seq_max);
+    const int n_batch = static_cast<int>(llama_n_batch(p_lane.ctx));
+    llama_memory_t mem = llama_get_memory(p_lane.ctx);
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+    
+    PackedFloat32Array scores;
+    scores.resize(static_cast<int64_t>(n_items) * n_labels);
+    scores.fill(0.0f);
+    int64_t skipped = 0;
+    int64_t decodes = 0;
+    
+    Dictionary progress;
+    progress["stage"] = "score";
+    progress["total"] = n_items;
+    progress["completed"] = 0;
+    progress["batch_size"] = width;
+    p_job.handle->report_progress(progress);
+    
+    auto drop_items = [&]() {
+        for (int s = 1; s <= width; s++) {
+            llama_memory_seq_rm(mem, s, -1, -1);
+        }
+        _set_sequence_cells(p_lane, n_prefix, {});
+    };
+    
+    struct Slot {
+        int item;
+        std::vector<int32_t> tokens;
+    };
+    int next = 0;
+    while (next < n_items) {
+        // A round takes as many items as there are sequences and cells
+        std::vector<Slot> round;
+        int cells = n_prefix;
+        while (next < n_items && static_cast<int>(round.size()) < width) {
+            std::vector<int32_t> tokens = tokenize(score.items[next], false);
+            tokens.insert(tokens.end(), suffix.begin(), suffix.end());
+            const int n_tokens = static_cast<int>(tokens.size());
+            if (n_prefix + n_tokens > p_lane.n_ctx) {
+                skipped++;
+                next++;
+                continue;
+            }
+            if (cells + n_tokens > p_lane.n_ctx) {
+                break;
+            }
+            cells += n_tokens;
+            round.push_back({ next++, std::move(tokens) });
+        }
+        if (round.empty()) {
+            continue;
+        }
+        if (!_ensure_kv_capacity(p_lane, cells, r_error)) {
+            llama_batch_free(batch);
+            return OUTCOME_FAILED;
+        }
+        mem = llama_get_memory(p_lane.ctx);
+        std::map<int, int> round_cells;
+        for (size_t s = 0; s < round.size(); s++) {
+            llama_memory_seq_cp(mem, 0, static_cast<llama_seq_id>(s + 1), -1, -1);
+            round_cells[static_cast<int>(s + 1)] = static_cast<int>(round[s].tokens.size());
+        }
+        _set_sequence_cells(p_lane, cells, std::move(round_cells));
+        
+        // Pack the round into as few decodes as n_batch allows; only the
+        // last token of each item needs logits
+        size_t slot = 0;
+        size_t fed = 0;
+        while (slot < round.size()) {
+            if (!_acquire_compute(p_lane, false)) {
+                llama_batch_free(batch);
+                drop_items();
+                return OUTCOME_CANCELLED;
+            }
+            
+            std::vector<std::pair<size_t, int>> outputs; // (slot, batch index)
+            batch.n_tokens = 0;
+            while (slot < round.size() && batch.n_tokens < n_batch) {
+                const std::vector<int32_t>& tokens = round[slot].tokens;
+                size_t take = std::min(tokens.size() - fed, static_cast<size_t>(n_batch - batch.n_tokens));
+                for (size_t k = 0; k < take; k++) {
+                    size_t t = fed + k;
+                    bool last = t == tokens.size() - 1;
+                    if (last) {
+                        outputs.emplace_back(slot, batch.n_tokens);
+                    }
+                    batch_add(batch, tokens[t], n_prefix + static_cast<llama_pos>(t), { static_cast<llama_seq_id>(slot + 1) }, last);
+                }
+                fed += take;
+                if (fed == tokens.size()) {
+                    slot++;
+                    fed = 0;
+                }
+            }
+            
+            if (llama_decode(p_lane.ctx, batch) != 0) {
+                llama_batch_free(batch);
+                drop_items();
+                r_error = "Decode failed while scoring";
+                return OUTCOME_FAILED;
+            }
+            decodes++;
+            
+            // Softmax over the label tokens only
+            for (const auto& output : outputs) {
+                const float* logits = llama_get_logits_ith(p_lane.ctx, output.second);
+                float* row = scores.ptrw() + static_cast<int64_t>(round[output.first].item) * n_labels;
+                float max_logit = logits[label_tokens[0]];
+                for (int l = 1; l < n_labels; l++) {
+                    max_logit = std::max(max_logit, logits[label_tokens[l]]);
+                }
+                float sum = 0.0f;
+                for (int l = 0; l < n_labels; l++) {
+                    row[l] = std::exp(logits[label_tokens[l]] - max_logit);
+                    sum += row[l];
+                }
+                for (int l = 0; l < n_labels; l++) {
+                    row[l] /= sum;
+                }
+            }
+        }
+        
+        drop_items();
+        progress["completed"] = next;
+        p_job.handle->report_progress(progress);
+    }
+    llama_batch_free(batch);
+    p_lane.kv_cells_used.store(static_cast<int>(p_lane.kv_tokens.size()), std::memory_order_relaxed);
+    p_job.handle->set_scores(scores);
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const int64_t n_scored = n_items - skipped;
+    {
+        std::lock_guard<std::mutex> lock(m_score_mutex);
+        ScoreStats& stats = m_score_stats[width];
+        stats.jobs++;
+        stats.items += n_scored;
+        stats.skipped += skipped;
+        stats.decodes += decodes;
+        stats.seconds += seconds;
+    }
+    
+    progress["stage"] = "done";
+    progress["skipped"] = skipped;
+    progress["decodes"] = decodes;
+    progress["prefix_reused"] = reused;
+    progress["items_per_second"] = seconds > 0.0 ? n_scored / seconds : 0.0;
+    progress["wall_ms"] = seconds * 1000.0;
+    p_job.handle->report_progress(progress);
+    
+    log_info("Scored " + String::num_int64(n_scored) + " items against " + String::num_int64(n_labels) +
+             " labels, " + String::num_int64(width) + " per round, " + String::num_int64(decodes) + " decodes, " +
+             String::num(seconds * 1000.0, 0) + " ms");
+    return OUTCOME_COMPLETED;
+}
+
+LlamaCppProvider::GenerationOutcome LlamaCppProvider::_run_rerank(
+    ContextLane& p_lane,
+    const GenerationJob& p_job,
+    String& r_error
+) {
+    const RerankRequest& request = p_job.rerank_request;
+    auto start = std::chrono::steady_clock::now();
+    
+    std::shared_ptr<Reranker> reranker;
+    {
+        std::lock_guard<std::mutex> lock(m_reranker_mutex);
+        reranker = m_reranker;
+    }
+    if (!reranker) {
+        r_error = "No reranker loaded";
+        return OUTCOME_FAILED;
+    }
+    std::lock_guard<std::mutex> use_lock(reranker->use_mutex);
+    llama_context* ctx = reranker->ctx;
+    const llama_vocab* vocab = llama_model_get_vocab(reranker->model->model);
+    const int n_batch = static_cast<int>(llama_n_batch(ctx));
+    
+    // Cross-encoder input: [BOS] query [EOS] [SEP] document [EOS], with the
+    // special tokens the model's vocabulary asks for
+    std::vector<int32_t> head;
+    if (llama_vocab_get_add_bos(vocab)) {
+        head.push_back(llama_vocab_bos(vocab));
+    }
+    std::vector<int32_t> query = tokenize_with(vocab, request.query);
+    head.insert(head.end(), query.begin(), query.end());
+    if (llama_vocab_get_add_eos(vocab)) {
+        head.push_back(llama_vocab_eos(vocab));
+    }
+    if (llama_vocab_get_add_sep(vocab)) {
+        head.push_back(llama_vocab_sep(vocab));
+    }
+    const int tail = llama_vocab_get_add_eos(vocab) ? 1 : 0;
+    const int room = n_batch - static_cast<int>(head.size()) - tail;
+    if (room <= 0) {
+        r_error = "Query does not fit the reranker context";
+        return OUTCOME_FAILED;
+    }
+    
+    const int n_docs = request.documents.size();
+    std::vector<std::vector<int32_t>> pairs(n_docs);
+    int64_t truncated = 0;
+    for (int d = 0; d < n_docs; d++) {
+        std::vector<int32_t> document = tokenize_with(vocab, request.documents[d]);
+        if (static_cast<int>(document.size()) > room) {
+            document.resize(room);
+            truncated++;
+        }
+        pairs[d] = head;
+        pairs[d].insert(pairs[d].end(), document.begin(), document.end());
+        if (tail > 0) {
+            pairs[d].push_back(llama_vocab_eos(vocab));
+        }
+    }
+    
+    PackedFloat32Array scores;
+    scores.resize(n_docs);
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+    llama_memory_t mem = llama_get_memory(ctx);
+    int64_t decodes = 0;
+    
+    // Pack whole pairs, one sequence each, until the batch or the sequences
+    // run out; the pooled score of every sequence comes out of one decode
+    int next = 0;
+    while (next < n_docs) {
+        if (!_acquire_compute(p_lane, false)) {
+            llama_batch_free(batch);
+            if (mem != nullptr) {
+                llama_memory_clear(mem, true);
+            }
+            return OUTCOME_CANCELLED;
+        }
+        llama_set_n_threads(ctx, p_lane.compute_threads, p_lane.compute_threads);
+        
+        const int first = next;
+        batch.n_tokens = 0;
+        while (next < n_docs && next - first < reranker->seq_max &&
+               batch.n_tokens + static_cast<int>(pairs[next].size()) <= n_batch) {
+            const llama_seq_id seq = next - first;
+            for (size_t t = 0; t < pairs[next].size(); t++) {
+                batch_add(batch, pairs[next][t], static_cast<llama_pos>(t), { seq }, true);
+            }
+            next++;
+        }
+        
+        bool ok = llama_decode(ctx, batch) == 0;
+        for (int d = first; ok && d < next; d++) {
+            const float* score = llama_get_embeddings_seq(ctx, d - first);
+            ok = score != nullptr;
+            if (ok) {
+                scores.set(d, score[0]);
+            }
+        }
+        if (mem != nullptr) {
+            llama_memory_clear(mem, true);
+        }
+        if (!ok) {
+            llama_batch_free(batch);
+            r_error = "Reranker decode failed";
+            return OUTCOME_FAILED;
+        }
+        decodes++;
+    }
+    llama_batch_free(batch);
+    
+    PackedInt32Array order;
+    {
+        std::vector<int32_t> indices(n_docs);
+        for (int d = 0; d < n_docs; d++) {
+            indices[d] = d;
+        }
+        std::stable_sort(indices.begin(), indices.end(), [&scores](int32_t a, int32_t b) {
+            return scores[a] > scores[b];
+        });
+        order.resize(n_docs);
+        memcpy(order.ptrw(), indices.data(), indices.size() * sizeof(int32_t));
+    }
+    p_job.handle->set_scores(scores);
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    {
+        std::lock_guard<std::mutex> lock(m_reranker_mutex);
+        m_rerank_stats.jobs++;
+        m_rerank_stats.pairs += n_docs;
+        m_rerank_stats.truncated += truncated;
+        m_rerank_stats.decodes += decodes;
+        m_rerank_stats.seconds += seconds;
+    }
+    
+    Dictionary progress;
+    progress["stage"] = "done";
+    progress["pairs"] = n_docs;
+    progress["truncated"] = truncated;
+    progress["decodes"] = decodes;
+    progress["order"] = order;
+    progress["pairs_per_second"] = seconds > 0.0 ? n_docs / seconds : 0.0;
+    progress["wall_ms"] = seconds * 1000.0;
+    p_job.handle->report_progress(progress);
+    return OUTCOME_COMPLETED;
+}
+
+LlamaCppProvider::GenerationOutcome LlamaCppProvider::_run_parallel_sequences(
+    ContextLane& p_lane,
+    const GenerationJob& p_job,
+    const std::vector<int32_t>& p_prefix,
+    const std::vector<std::vector<int32_t>>& p_inputs,
+    int p_max_tokens,
+    bool p_stream,
+    Dictionary& r_progress,
+    std::vector<String>& r_outputs,
+    int& r_n_tokens,
+    String& r_error
+) {
+    const int n_prefix = static_cast<int>(p_prefix.size());
+    size_t longest = 0;
+    for (const std::vector<int32_t>& input : p_inputs) {
+        longest = std::max(longest, input.size());
+    }
+    
+    // Sequences share the prefix cells; each needs room for its own input
+    // and output on top. As many run at once as the context allows.
+    const int per_sequence = static_cast<int>(longest) + p_max_tokens;
+    if (n_prefix + per_sequence > p_lane.n_ctx) {
+        r_error = "Summarization chunk does not fit the context";
+        return OUTCOME_FAILED;
+    }
+    int n_parallel = std::min(SUMMARIZE_MAX_PARALLEL, static_cast<int>(p_inputs.size()));
+    n_parallel = std::max(1, std::min(n_parallel, (p_lane.n_ctx - n_prefix) / per_sequence));
+    
+    if (!_ensure_kv_capacity(p_lane, n_prefix + n_parallel * per_sequence, r_error)) {
+        return OUTCOME_FAILED;
+    }
+    
+    // Whatever sequence 0 held is gone after this job; offer it to the tier
+    // store first, as a prompt that evicts it would
+    if (m_kv_tier.is_enabled() && p_lane.composed_from < 0 && !p_lane.kv_tokens.empty() &&
+        static_cast<int>(p_lane.kv_tokens.size()) >= m_kv_tier.get_min_tokens()) {
+        std::vector<uint8_t> resident(llama_state_seq_get_size(p_lane.ctx, 0));
+        if (llama_state_seq_get_data(p_lane.ctx, resident.data(), resident.size(), 0) == resident.size()) {
+            m_kv_tier.put(p_lane.type_k + "/" + p_lane.type_v, p_lane.kv_tokens, resident);
+        }
+    }
+    llama_memory_t mem = llama_get_memory(p_lane.ctx);
+    llama_memory_clear(mem, true);
+    p_lane.kv_tokens.clear();
+    p_lane.kv_cells_used.store(0, std::memory_order_relaxed);
+    if (p_lane.spec_region_start >= 0) {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        m_speculative_stats.wasted++;
+        p_lane.spec_region_start = -1;
+    }
+    
+    const int n_batch = static_cast<int>(llama_n_batch(p_lane.ctx));
+    llama_batch batch = llama_batch_init(n_batch, 0, n_parallel);
+    
+    std::vector<llama_seq_id> all_sequences(n_parallel);
+    for (int s = 0; s < n_parallel; s++) {
+        all_sequences[s] = s;
+    }
+    for (int start = 0; start < n_prefix; start += n_batch) {
+        batch.n_tokens = 0;
+        for (int i = start; i < std::min(start + n_batch, n_prefix); i++) {
+            batch_add(batch, p_prefix[i], i, all_sequences, false);
+        }
+        if (!_acquire_compute(p_lane, false)) {
+            llama_batch_free(batch);
+            llama_memory_clear(mem, true);
+            return OUTCOME_CANCELLED;
+        }
+        if (llama_decode(p_lane.ctx, batch) != 0) {
+            llama_batch_free(batch);
+            llama_memory_clear(mem, true);
+            r_error = "Failed to evaluate summarization prompt";
+            return OUTCOME_FAILED;
+        }
+    }
+    
+    struct Sequence {
+        int input = -1;                 // index into p_inputs, -1 when idle
+        std::vector<int32_t> pending;   // tokens still to decode
+        size_t fed = 0;
+        int n_past = 0;
+        int n_generated = 0;
+        int logits_index = -1;
+        String text;
+        llama_sampler* sampler = nullptr;
+    };
+    std::vector<Sequence> sequences(n_parallel);
+    
+    r_outputs.assign(p_inputs.size(), String());
+    r_progress["completed"] = 0;
+    r_progress["total"] = static_cast<int64_t>(p_inputs.size());
+    r_progress["parallel"] = n_parallel;
+    p_job.handle->report_progress(r_progress);
+    
+    const llama_vocab* vocab = llama_model_get_vocab(m_model);
+    GenerationOutcome outcome = OUTCOME_COMPLETED;
+    size_t next_input = 0;
+    size_t completed = 0;
+    
+    while (completed < p_inputs.size()) {
+        if (p_job.handle->is_cancel_requested()) {
+            outcome = OUTCOME_CANCELLED;
+            break;
+        }
+        
+        // Idle sequences pick up the next input
+        for (int s = 0; s < n_parallel && next_input < p_inputs.size(); s++) {
+            Sequence& sequence = sequences[s];
+            if (sequence.input >= 0) {
+                continue;
+            }
+            sequence.input = static_cast<int>(next_input++);
+            sequence.pending = p_inputs[sequence.input];
+            sequence.fed = 0;
+            sequence.n_past = n_prefix;
+            sequence.n_generated = 0;
+            sequence.text = "";
+            if (sequence.sampler == nullptr) {
+                sequence.sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
+                _add_default_samplers(sequence.sampler, p_job.request);
+            } else {
+                llama_sampler_reset(sequence.sampler);
+            }
+        }
+        
+        // One shared batch: a token for every generating sequence first,
+        // then as much of the pending inputs as still fits
+        batch.n_tokens = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int s = 0; s < n_parallel && batch.n_tokens < n_batch; s++) {
+                Sequence& sequence = sequences[s];
+                bool generating = sequence.n_generated > 0;
+                if (sequence.input < 0 || sequence.fed >= sequence.pending.size() || generating != (pass == 0)) {
+                    continue;
+                }
+                size_t take = std::min(sequence.pending.size() - sequence.fed, static_cast<size_t>(n_batch - batch.n_tokens));
+                for (size_t k = 0; k < take; k++) {
+                    bool last = sequence.fed + k == sequence.pending.size() - 1;
+                    batch_add(batch, sequence.pending[sequence.fed + k], sequence.n_past++, { s }, last);
+                    if (last) {
+                        sequence.logits_index = batch.n_tokens - 1;
+                    }
+                }
+                sequence.fed += take;
+            }
+        }
+        
+        if (!_acquire_compute(p_lane, false)) {
+            outcome = OUTCOME_CANCELLED;
+            break;
+        }
+        if (llama_decode(p_lane.ctx, batch) != 0) {
+            r_error = "Decode failed during summarization";
+            outcome = OUTCOME_FAILED;
+            break;
+        }
+        int cells = n_prefix;
+        std::map<int, int> sequence_cells;
+        for (int s = 0; s < n_parallel; s++) {
+            int own = sequences[s].input >= 0 ? sequences[s].n_past - n_prefix : 0;
+            cells += own;
+            if (s > 0 && own > 0) {
+                sequence_cells[s] = own;
+            }
+        }
+        _set_sequence_cells(p_lane, cells, std::move(sequence_cells));
+        
+        // Sample every sequence whose last token was just decoded
+        for (int s = 0; s < n_parallel; s++) {
+            Sequence& sequence = sequences[s];
+            if (sequence.logits_index < 0) {
+                continue;
+            }
+            llama_token token = llama_sampler_sample(sequence.sampler, p_lane.ctx, sequence.logits_index);
+            sequence.logits_index = -1;
+            
+            bool done = llama_token_is_eog(vocab, token);
+            if (!done) {
+                String piece = token_to_string(token);
+                sequence.text += piece;
+                sequence.n_generated++;
+                r_n_tokens++;
+                if (p_stream) {
+                    if (p_job.handle->is_collecting_token_ids()) {
+                        p_job.handle->append_token_id(token);
+                    }
+                    if (p_job.handle->get_output_mode() != LLMGenerationHandle::OUTPUT_TOKENS) {
+                        p_job.handle->append_token(piece);
+                    }
+                }
+                done = sequence.n_generated >= p_max_tokens ||
+                       check_stop_sequences(sequence.text, p_job.request.stop_sequences);
+                sequence.pending.assign(1, token);
+                sequence.fed = 0;
+            }
+            
+            if (done) {
+                r_outputs[sequence.input] = sequence.text.strip_edges();
+                sequence.input = -1;
+                sequence.n_generated = 0;
+                llama_memory_seq_rm(mem, s, n_prefix, -1);
+                completed++;
+                r_progress["completed"] = static_cast<int64_t>(completed);
+                p_job.handle->report_progress(r_progress);
+            }
+        }
+    }
+    
+    for (Sequence& sequence : sequences) {
+        if (sequence.sampler != nullptr) {
+            llama_sampler_free(sequence.sampler);
+        }
+    }
+    llama_batch_free(batch);
+    llama_memory_clear(mem, true);
+    _set_sequence_cells(p_lane, 0, {});
+    return outcome;
+}
+
+String LlamaCppProvider::register_speculative_request(const Dictionary& request) {
+    if (!is_loaded()) {
+        return "";
+    }
+    
+    GenerationJob job;
+    job.request = _parse_request(request);
+    job.speculative = true;
+    
+    // Only deterministic requests produce a result worth caching; for the
+    // rest (and for an empty prompt) warming the prefix is all we can do
+    String mode = request.get("mode", "complete");
+    const bool has_prompt = !job.request.prompt.is_empty() || !job.request.prompt_tokens.empty();
+    job.prefill_only = mode == "prefill" || !has_prompt || _completion_cache_key(job.request).is_empty();
+    if (!has_prompt && job.request.system_prompt.is_empty()) {
+        return "";
+    }
+    String processor_error;
+    if (!_validate_logits_processors(job.request.logits_processors, processor_error)) {
+        log_warning("Speculative request ignored: " + processor_error);
+        return "";
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        // Nothing to precompute if the answer is already cached
+        if (!job.prefill_only) {
+            String key = _completion_cache_key(job.request);
+            for (const CompletionCacheEntry& entry : m_completion_cache) {
+                if (entry.key == key) {
+                    return "";
+                }
+            }
+        }
+        m_speculative_counter++;
+        m_speculative_stats.registered++;
+        job.speculative_id = "spec_" + String::num_int64(m_speculative_counter);
+    }
+    
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    ContextLane* lane = _find_lane(request.get("context", DEFAULT_CONTEXT));
+    if (lane == nullptr) {
+        log_warning("Speculative request ignored: unknown context " + String(request.get("context", "")));
+        return "";
+    }
+    {
+        std::lock_guard<std::mutex> lock(lane->job_mutex);
+        // Re-registering the same request only moves it to the back
+        for (auto it = lane->speculative_jobs.begin(); it != lane->speculative_jobs.end(); ++it) {
+            if (it->prefill_only == job.prefill_only &&
+                    it->request.prompt == job.request.prompt &&
+                    it->request.system_prompt == job.request.system_prompt &&
+                    it->request.prompt_tokens == job.request.prompt_tokens) {
+                lane->speculative_jobs.erase(it);
+                break;
+            }
+        }
+        if (static_cast<int>(lane->speculative_jobs.size()) >= SPECULATIVE_QUEUE_MAX) {
+            lane->speculative_jobs.pop_front();
+        }
+        lane->speculative_jobs.push_back(job);
+    }
+    lane->job_cv.notify_one();
+    
+    return job.speculative_id;
+}
+
+void LlamaCppProvider::clear_speculative_requests() {
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    for (auto& entry : m_lanes) {
+        std::lock_guard<std::mutex> lock(entry.second->job_mutex);
+        entry.second->speculative_jobs.clear();
+    }
+}
+
+Dictionary LlamaCppProvider::get_speculative_stats() {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    
+    Dictionary stats;
+    stats["registered"] = m_speculative_stats.registered;
+    stats["completed"] = m_speculative_stats.completed;
+    stats["preempted"] = m_speculative_stats.preempted;
+    stats["useful"] = m_speculative_stats.useful;
+    stats["wasted"] = m_speculative_stats.wasted;
+    
+    int64_t settled = m_speculative_stats.useful + m_speculative_stats.wasted;
+    stats["useful_ratio"] = settled > 0 ? static_cast<double>(m_speculative_stats.useful) / settled : 0.0;
+    stats["tokens_computed"] = m_speculative_stats.tokens_computed;
+    stats["tokens_reused"] = m_speculative_stats.tokens_reused;
+    stats["compute_ms"] = m_speculative_stats.compute_ms;
+    stats["completion_cache_entries"] = static_cast<int64_t>(m_completion_cache.size());
+    stats["completion_cache_hits"] = m_speculative_stats.cache_hits;
+    stats["completion_cache_lookups"] = m_speculative_stats.cache_lookups;
+    
+    int64_t queued = 0;
+    {
+        std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+        for (auto& entry : m_lanes) {
+            std::lock_guard<std::mutex> job_lock(entry.second->job_mutex);
+            queued += static_cast<int64_t>(entry.second->speculative_jobs.size());
+        }
+    }
+    stats["queued"] = queued;
+    
+    return stats;
+}
+
+PackedStringArray LlamaCppProvider::get_logits_processor_names() const {
+    return LogitsProcessorRegistry::get_processor_names();
+}
+
+Dictionary LlamaCppProvider::get_logits_processor_stats() {
+    std::lock_guard<std::mutex> lock(m_processor_stats_mutex);
+    
+    Dictionary stats;
+    for (const auto& entry : m_processor_stats) {
+        const LogitsProcessorTiming& timing = entry.second;
+        Dictionary processor;
+        processor["tokens"] = timing.tokens;
+        processor["total_ms"] = timing.total_ns / 1e6;
+        processor["ns_per_token"] = timing.tokens > 0 ? static_cast<double>(timing.total_ns) / timing.tokens : 0.0;
+        stats[timing.name] = processor;
+    }
+    return stats;
+}
+
+void LlamaCppProvider::reset_logits_processor_stats() {
+    std::lock_guard<std::mutex> lock(m_processor_stats_mutex);
+    m_processor_stats.clear();
+}
+
+std::shared_ptr<const std::vector<int32_t>> LlamaCppProvider::_get_vocab_trim() const {
+    std::lock_guard<std::mutex> lock(m_vocab_mutex);
+    return m_vocab_trim;
+}
+
+void LlamaCppProvider::_apply_vocab_trim() {
+    Dictionary config;
+    {
+        std::lock_guard<std::mutex> lock(m_vocab_mutex);
+        config = m_vocab_trim_config.duplicate();
+        m_vocab_trim.reset();
+    }
+    if (config.is_empty() || m_model == nullptr) {
+        return;
+    }
+    
+    std::vector<CodepointRange> ranges;
+    String preset = config.get("preset", "");
+    if (preset == "ascii") {
+        ranges.assign(std::begin(VOCAB_TRIM_ASCII), std::end(VOCAB_TRIM_ASCII));
+    } else if (preset == "latin") {
+        ranges.assign(std::begin(VOCAB_TRIM_LATIN), std::end(VOCAB_TRIM_LATIN));
+    } else if (!preset.is_empty()) {
+        log_warning("Unknown vocab trim preset: " + preset + " (expected ascii or latin)");
+    }
+    Array extra = config.get("ranges", Array());
+    for (int i = 0; i < extra.size(); i++) {
+        Array range = extra[i];
+        if (range.size() == 2) {
+            ranges.push_back({ static_cast<int32_t>(range[0]), static_cast<int32_t>(range[1]) });
+        }
+    }
+    if (ranges.empty()) {
+        log_warning("Vocab trim has no ranges; using the whole vocabulary");
+        return;
+    }
+    
+    // Special tokens have no text and are always kept
+    const std::vector<std::string>& pieces = _get_token_pieces();
+    auto kept = std::make_shared<std::vector<int32_t>>();
+    for (size_t id = 0; id < pieces.size(); id++) {
+        if (piece_in_ranges(pieces[id], ranges)) {
+            kept->push_back(static_cast<int32_t>(id));
+        }
+    }
+    add_end_tokens(llama_model_get_vocab(m_model), *kept);
+    log_info("Vocab trim keeps " + String::num_int64(kept->size()) + " of " + String::num_int64(pieces.size()) + " tokens");
+    
+    std::lock_guard<std::mutex> lock(m_vocab_mutex);
+    m_vocab_trim = kept;
+}
+
+Dictionary LlamaCppProvider::set_vocab_trim(const Dictionary& config) {
+    std::lock_guard<std::mutex> model_lock(m_model_mutex);
+    {
+        std::lock_guard<std::mutex> lock(m_vocab_mutex);
+        m_vocab_trim_config = config.duplicate(true);
+    }
+    _apply_vocab_trim();
+    
+    Dictionary result;
+    if (m_model == nullptr) {
+        return result;
+    }
+    int64_t n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(m_model));
+    std::shared_ptr<const std::vector<int32_t>> trim = _get_vocab_trim();
+    int64_t kept = trim ? static_cast<int64_t>(trim->size()) : n_vocab;
+    result["n_vocab"] = n_vocab;
+    result["kept"] = kept;
+    result["kept_fraction"] = n_vocab > 0 ? static_cast<double>(kept) / n_vocab : 0.0;
+    return result;
+}
+
+Dictionary LlamaCppProvider::measure_vocab_coverage(const PackedStringArray& texts) {
+    Dictionary result;
+    if (m_model == nullptr) {
+        return result;
+    }
+    std::shared_ptr<const std::vector<int32_t>> trim = _get_vocab_trim();
+    int64_t total = 0;
+    int64_t covered = 0;
+    for (int i = 0; i < texts.size(); i++) {
+        std::vector<int32_t> tokens = tokenize(texts[i], false);
+        total += tokens.size();
+        for (int32_t id : tokens) {
+            if (!trim || std::binary_search(trim->begin(), trim->end(), id)) {
+                covered++;
+            }
+        }
+    }
+    result["tokens"] = total;
+    result["covered"] = covered;
+    result["coverage"] = total > 0 ? static_cast<double>(covered) / total : 1.0;
+    return result;
+}
+
+Dictionary LlamaCppProvider::get_vocab_stats() {
+    std::lock_guard<std::mutex> lock(m_vocab_mutex);
+    const VocabStats& s = m_vocab_stats;
+    
+    Dictionary trim;
+    trim["enabled"] = m_vocab_trim != nullptr;
+    trim["kept"] = m_vocab_trim ? static_cast<int64_t>(m_vocab_trim->size()) : 0;
+    trim["config"] = m_vocab_trim_config;
+    
+    auto mode = [](int64_t p_tokens, int64_t p_sample_ns, int64_t p_loop_ns) {
+        Dictionary entry;
+        entry["tokens"] = p_tokens;
+        entry["sample_us_per_token"] = p_tokens > 0 ? p_sample_ns / 1000.0 / p_tokens : 0.0;
+        entry["us_per_token"] = p_tokens > 0 ? p_loop_ns / 1000.0 / p_tokens : 0.0;
+        return entry;
+    };
+    Dictionary full = mode(s.full_tokens, s.full_sample_ns, s.full_loop_ns);
+    Dictionary restricted = mode(s.restricted_tokens, s.restricted_sample_ns, s.restricted_loop_ns);
+    restricted["avg_candidates"] = s.restricted_tokens > 0 ? static_cast<double>(s.candidates) / s.restricted_tokens : 0.0;
+    
+    double full_sample = full["sample_us_per_token"];
+    double restricted_sample = restricted["sample_us_per_token"];
+    
+    Dictionary stats;
+    stats["trim"] = trim;
+    stats["full"] = full;
+    stats["sampler_restricted"] = restricted;
+    // Only the sampler's share of a step shrinks; every logit is still computed
+    stats["sampler_speedup"] = restricted_sample > 0.0 && full_sample > 0.0 ? full_sample / restricted_sample : 0.0;
+    stats["live_coverage"] = s.trim_checked > 0 ? 1.0 - static_cast<double>(s.trim_misses) / s.trim_checked : 1.0;
+    return stats;
+}
+
+void LlamaCppProvider::reset_vocab_stats() {
+    std::lock_guard<std::mutex> lock(m_vocab_mutex);
+    m_vocab_stats = VocabStats();
+}
+
+LlamaCppProvider::LookupDecodingConfig LlamaCppProvider::_resolve_lookup_decoding(const GenerationRequest& p_request) {
+    std::lock_guard<std::mutex> lock(m_lookup_decoding_mutex);
+    LookupDecodingConfig config;
+    auto it = m_lookup_decoding_configs.find(m_loaded_model_id);
+    if (it != m_lookup_decoding_configs.end()) {
+        config = it->second;
+    }
+    if (p_request.lookup_decoding >= 0) {
+        config.enabled = p_request.lookup_decoding > 0;
+    }
+    return config;
+}
+
+void LlamaCppProvider::set_lookup_decoding(const String& model_id, const Dictionary& config) {
+    LookupDecodingConfig parsed;
+    parsed.enabled = config.get("enabled", true);
+    parsed.ngram = std::clamp(static_cast<int>(config.get("ngram", parsed.ngram)), 1, LOOKUP_DECODING_MAX_NGRAM);
+    parsed.draft_max = std::clamp(static_cast<int>(config.get("draft_max", parsed.draft_max)), 1, LOOKUP_DECODING_MAX_DRAFT);
+    std::lock_guard<std::mutex> lock(m_lookup_decoding_mutex);
+    m_lookup_decoding_configs[model_id] = parsed;
+}
+
+Dictionary LlamaCppProvider::get_lookup_decoding(const String& model_id) {
+    std::lock_guard<std::mutex> lock(m_lookup_decoding_mutex);
+    LookupDecodingConfig config;
+    auto it = m_lookup_decoding_configs.find(model_id);
+    if (it != m_lookup_decoding_configs.end()) {
+        config = it->second;
+    }
+    Dictionary result;
+    result["enabled"] = config.enabled;
+    result["ngram"] = config.ngram;
+    result["draft_max"] = config.draft_max;
+    return result;
+}
+
+Dictionary LlamaCppProvider::get_lookup_decoding_stats() {
+    std::lock_guard<std::mutex> lock(m_lookup_decoding_mutex);
+    const LookupDecodingStats& s = m_lookup_decoding_stats;
+    double us_per_token = s.tokens > 0 ? s.loop_ns / 1000.0 / s.tokens : 0.0;
+    double plain_us_per_token = s.plain_tokens > 0 ? s.plain_loop_ns / 1000.0 / s.plain_tokens : 0.0;
+    
+    Dictionary stats;
+    stats["requests"] = s.requests;
+    stats["tokens"] = s.tokens;
+    stats["drafted"] = s.drafted;
+    stats["accepted"] = s.accepted;
+    stats["acceptance_rate"] = s.drafted > 0 ? static_cast<double>(s.accepted) / s.drafted : 0.0;
+    stats["decodes"] = s.decodes;
+    stats["verify_decodes"] = s.verify_decodes;
+    stats["tokens_per_decode"] = s.decodes > 0 ? static_cast<double>(s.tokens) / s.decodes : 0.0;
+    stats["us_per_token"] = us_per_token;
+    stats["plain_tokens"] = s.plain_tokens;
+    stats["plain_us_per_token"] = plain_us_per_token;
+    stats["speedup"] = us_per_token > 0.0 && plain_us_per_token > 0.0 ? plain_us_per_token / us_per_token : 0.0;
+    return stats;
+}
+
+void LlamaCppProvider::reset_lookup_decoding_stats() {
+    std::lock_guard<std::mutex> lock(m_lookup_decoding_mutex);
+    m_lookup_decoding_stats = LookupDecodingStats();
+}
+
+void LlamaCppProvider::register_example(const String& name, const String& text) {
+    if (name.is_empty() || text.is_empty()) {
+        log_error("register_example needs a name and a text");
+        return;
+    }
+    auto block = std::make_shared<ExampleBlock>();
+    block->text = text;
+    std::lock_guard<std::mutex> lock(m_examples_mutex);
+    m_examples[name] = block;
+}
+
+void LlamaCppProvider::unregister_example(const String& name) {
+    std::lock_guard<std::mutex> lock(m_examples_mutex);
+    m_examples.erase(name);
+}
+
+void LlamaCppProvider::clear_examples() {
+    std::lock_guard<std::mutex> lock(m_examples_mutex);
+    m_examples.clear();
+}
+
+PackedStringArray LlamaCppProvider::get_example_names() const {
+    std::lock_guard<std::mutex> lock(m_examples_mutex);
+    PackedStringArray names;
+    for (const auto& entry : m_examples) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
+Dictionary LlamaCppProvider::get_example_stats() {
+    std::lock_guard<std::mutex> lock(m_examples_mutex);
+    const ExampleStats& s = m_example_stats;
+    int64_t state_bytes = 0;
+    for (const auto& entry : m_examples) {
+        for (const auto& state : entry.second->states) {
+            state_bytes += static_cast<int64_t>(state.second->size());
+        }
+    }
+    
+    Dictionary stats;
+    stats["examples"] = static_cast<int64_t>(m_examples.size());
+    stats["composed_requests"] = s.composed_requests;
+    stats["full_requests"] = s.full_requests;
+    stats["composed_prefill_ms"] = s.composed_requests > 0 ? s.composed_prefill_ms / s.composed_requests : 0.0;
+    stats["full_prefill_ms"] = s.full_requests > 0 ? s.full_prefill_ms / s.full_requests : 0.0;
+    stats["blocks_spliced"] = s.blocks_spliced;
+    stats["tokens_spliced"] = s.tokens_spliced;
+    stats["tokens_recomputed"] = s.tokens_recomputed;
+    stats["precomputes"] = s.precomputes;
+    stats["precompute_tokens"] = s.precompute_tokens;
+    stats["precompute_ms"] = s.precompute_ms;
+    stats["splice_ms"] = s.splice_ms;
+    stats["fallbacks"] = s.fallbacks;
+    stats["state_bytes"] = state_bytes;
+    return stats;
+}
+
+void LlamaCppProvider::reset_example_stats() {
+    std::lock_guard<std::mutex> lock(m_examples_mutex);
+    m_example_stats = ExampleStats();
+}
+
+void LlamaCppProvider::_record_usage(const ContextLane& p_lane, const std::function<void(ModelUsageStats&)>& p_record) {
+    // Extra contexts serve differently shaped requests; keep them out of
+    // the model's own histograms
+    String key = p_lane.name == DEFAULT_CONTEXT ? m_loaded_model_id : m_loaded_model_id + "@" + p_lane.name;
+    std::lock_guard<std::mutex> lock(m_usage_mutex);
+    p_record(m_usage_stats[key.utf8().get_data()]);
+}
+
+Dictionary LlamaCppProvider::get_capacity_advice(float target_rejection_rate, int64_t memory_budget_bytes) {
+    Dictionary advice;
+    if (!is_loaded()) {
+        advice["error"] = "No model loaded";
+        return advice;
+    }
+    
+    ModelUsageStats stats;
+    {
+        std::lock_guard<std::mutex> lock(m_usage_mutex);
+        auto it = m_usage_stats.find(m_loaded_model_id.utf8().get_data());
+        if (it == m_usage_stats.end() || it->second.peak_kv_cells.total() <= 0.0) {
+            advice["error"] = "No requests observed for " + m_loaded_model_id + " yet";
+            return advice;
+        }
+        stats = it->second;
+    }
+    
+    // K plus V elements per cell; the type decides bytes per element
+    double elements_per_cell = _kv_bytes_per_cell("f16", "f16") / 2.0;
+    const KvCacheType* kv_types = KV_CACHE_TYPES;
+    
+    // What the default context's cache types cost today
+    double current_kv_bytes = 0.0;
+    {
+        std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+        auto it = m_lanes.find(DEFAULT_CONTEXT);
+        if (it != m_lanes.end()) {
+            current_kv_bytes = m_context_length * _kv_bytes_per_cell(it->second->type_k, it->second->type_v);
+        }
+    }
+    double budget = memory_budget_bytes > 0
+        ? static_cast<double>(memory_budget_bytes)
+        : static_cast<double>(get_available_memory()) + current_kv_bytes;
+    
+    // Contexts are sized in steps of 256 cells
+    const int64_t step = 256;
+    int64_t n_ctx_train = llama_model_n_ctx_train(m_model);
+    int64_t needed = stats.peak_kv_cells.quantile(1.0 - target_rejection_rate);
+    int64_t n_ctx = std::clamp<int64_t>((needed + step - 1) / step * step, 512, std::max<int64_t>(n_ctx_train, 512));
+    int64_t n_seq_max = std::max<int64_t>(1, stats.concurrency.quantile(1.0 - target_rejection_rate));
+    
+    const KvCacheType* chosen = nullptr;
+    for (const KvCacheType& type : KV_CACHE_TYPES) {
+        if (n_ctx * n_seq_max * elements_per_cell * type.bytes_per_element <= budget) {
+            chosen = &type;
+            break;
+        }
+    }
+    bool fits = chosen != nullptr;
+    if (!fits) {
+        // Nothing fits at the target; shrink the context to what the
+        // smallest KV type allows and report the resulting rejection rate
+        chosen = &kv_types[std::size(KV_CACHE_TYPES) - 1];
+        double per_ctx = n_seq_max * elements_per_cell * chosen->bytes_per_element;
+        n_ctx = std::max<int64_t>(0, static_cast<int64_t>(budget / per_ctx) / step * step);
+    }
+    double kv_bytes = n_ctx * n_seq_max * elements_per_cell * chosen->bytes_per_element;
+    
+    advice["model_id"] = m_loaded_model_id;
+    advice["n_ctx"] = n_ctx;
+    advice["n_seq_max"] = n_seq_max;
+    advice["kv_type"] = chosen->name;
+    advice["kv_bytes"] = static_cast<int64_t>(kv_bytes);
+    advice["fits_budget"] = fits;
+    advice["memory_budget_bytes"] = static_cast<int64_t>(budget);
+    advice["expected_rejection_rate"] = stats.peak_kv_cells.fraction_above(n_ctx);
+    advice["current_n_ctx"] = m_context_length;
+    advice["current_kv_bytes"] = static_cast<int64_t>(current_kv_bytes);
+    advice["current_rejection_rate"] = stats.peak_kv_cells.fraction_above(m_context_length);
+    advice["samples"] = stats.peak_kv_cells.total();
+    advice["prompt_tokens_p50"] = stats.prompt_tokens.quantile(0.5);
+    advice["prompt_tokens_p95"] = stats.prompt_tokens.quantile(0.95);
+    advice["output_tokens_p50"] = stats.output_tokens.quantile(0.5);
+    advice["output_tokens_p95"] = stats.output_tokens.quantile(0.95);
+    advice["prefix_reuse_mean"] = stats.prefix_reuse.mean() / 100.0;
+    advice["rejected_too_long"] = stats.rejected_too_long;
+    advice["rejected_busy"] = stats.rejected_busy;
+    return advice;
+}
+
+Dictionary LlamaCppProvider::get_usage_histograms() {
+    std::lock_guard<std::mutex> lock(m_usage_mutex);
+    Dictionary histograms;
+    for (const auto& entry : m_usage_stats) {
+        if (!entry.first.empty()) {
+            histograms[String::utf8(entry.first.c_str())] = entry.second.to_dict();
+        }
+    }
+    return histograms;
+}
+
+void LlamaCppProvider::set_usage_histograms(const Dictionary& histograms) {
+    std::lock_guard<std::mutex> lock(m_usage_mutex);
+    Array keys = histograms.keys();
+    for (int64_t i = 0; i < keys.size(); i++) {
+        String model_id = keys[i];
+        m_usage_stats[model_id.utf8().get_data()].from_dict(histograms[keys[i]]);
+    }
+}
+
+void LlamaCppProvider::reset_usage_histograms(const String& model_id) {
+    std::lock_guard<std::mutex> lock(m_usage_mutex);
+    if (model_id.is_empty()) {
+        m_usage_stats.clear();
+    } else {
+        m_usage_stats.erase(model_id.utf8().get_data());
+    }
+}
+
+String LlamaCppProvider::_completion_cache_key(const GenerationRequest& p_request) const {
+    // Sampling is only reproducible when it is greedy
+    if (p_request.temperature > 0.0f || !p_request.use_cache) {
+        return "";
+    }
+    
+    String key = m_loaded_model_id + "\x1f" + p_request.system_prompt + "\x1f" + p_request.prompt +
+                 "\x1f" + String::num_int64(p_request.max_tokens);
+    for (int i = 0; i < p_request.stop_sequences.size(); i++) {
+        key += "\x1f" + p_request.stop_sequences[i];
+    }
+    if (!p_request.logits_processors.is_empty()) {
+        key += "\x1f" + JSON::stringify(p_request.logits_processors, "", true);
+    }
+    if (!p_request.candidate_tokens.empty()) {
+        key += "\x1f";
+        for (int32_t id : p_request.candidate_tokens) {
+            key += String::num_int64(id) + ",";
+        }
+    } else if (p_request.vocab_trim) {
+        std::lock_guard<std::mutex> lock(m_vocab_mutex);
+        if (m_vocab_trim) {
+            key += "\x1ftrim:" + JSON::stringify(m_vocab_trim_config, "", true);
+        }
+    }
+    if (!p_request.prompt_tokens.empty()) {
+        key += "\x1ftokens:";
+        for (int32_t id : p_request.prompt_tokens) {
+            key += String::num_int64(id) + ",";
+        }
+    }
+    if (!p_request.examples.is_empty()) {
+        // Composed KV may sample differently from a full prefill
+        key += p_request.compose_examples ? "\x1f" "composed:" + String::num_int64(p_request.example_recompute)
+                                          : String("\x1f" "full");
+        std::lock_guard<std::mutex> lock(m_examples_mutex);
+        for (int i = 0; i < p_request.examples.size(); i++) {
+            auto it = m_examples.find(p_request.examples[i]);
+            key += "\x1f" + (it != m_examples.end() ? it->second->text : String());
+        }
+    }
+    return key;
+}
+
+bool LlamaCppProvider::_lookup_completion(const String& p_key, String& r_text, int& r_n_tokens) {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    m_speculative_stats.cache_lookups++;
+    
+    for (auto it = m_completion_cache.begin(); it != m_completion_cache.end(); ++it) {
+        if (it->key != p_key) {
+            continue;
+        }
+        CompletionCacheEntry entry = *it;
+        if (entry.speculative) {
+            m_speculative_stats.useful++;
+            m_speculative_stats.tokens_reused += entry.n_tokens;
+            entry.speculative = false;
+        }
+        // Move to the back so eviction is least-recently-used
+        m_completion_cache.erase(it);
+        m_completion_cache.push_back(entry);
+        m_speculative_stats.cache_hits++;
+        r_text = entry.text;
+        r_n_tokens = entry.n_tokens;
+        return true;
+    }
+    return false;
+}
+
+void LlamaCppProvider::_store_completion(const String& p_key, const String& p_text, int p_n_tokens, bool p_speculative) {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    
+    for (auto it = m_completion_cache.begin(); it != m_completion_cache.end(); ++it) {
+        if (it->key == p_key) {
+            m_completion_cache.erase(it);
+            break;
+        }
+    }
+    while (static_cast<int>(m_completion_cache.size()) >= COMPLETION_CACHE_MAX_ENTRIES) {
+        if (m_completion_cache.front().speculative) {
+            m_speculative_stats.wasted++;
+        }
+        m_completion_cache.pop_front();
+    }
+    
+    CompletionCacheEntry entry;
+    entry.key = p_key;
+    entry.text = p_text;
+    entry.n_tokens = p_n_tokens;
+    entry.speculative = p_speculative;
+    m_completion_cache.push_back(entry);
+}
+
+void LlamaCppProvider::_discard_speculative_artifacts() {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    for (const CompletionCacheEntry& entry : m_completion_cache) {
+        if (entry.speculative) {
+            m_speculative_stats.wasted++;
+        }
+    }
+    m_completion_cache.clear();
+}
+
+void LlamaCppProvider::cancel(const String& handle_id) {
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    for (auto& entry : m_lanes) {
+        ContextLane& lane = *entry.second;
+        {
+            std::lock_guard<std::mutex> lock(lane.handle_mutex);
+            if (lane.current_handle.is_valid() && lane.current_handle->get_id() == handle_id) {
+                lane.current_handle->request_cancel();
+                return;
+            }
+        }
+        // Queued requests are skipped when the worker reaches them
+        std::lock_guard<std::mutex> lock(lane.job_mutex);
+        for (GenerationJob& job : lane.interactive_jobs) {
+            if (job.handle->get_id() == handle_id) {
+                job.handle->request_cancel();
+                return;
+            }
+        }
+    }
+}
+
+Ref<LLMGenerationHandle> LlamaCppProvider::resume(const String& handle_id) {
+    Ref<LLMGenerationHandle> handle;
+    handle.instantiate();
+    
+    if (!is_loaded()) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", "No model loaded");
+        return handle;
+    }
+    
+    std::shared_ptr<const SalvagedGeneration> salvaged;
+    {
+        std::lock_guard<std::mutex> lock(m_resume_mutex);
+        _prune_salvaged();
+        auto it = m_salvaged.find(handle_id);
+        if (it != m_salvaged.end()) {
+            salvaged = it->second;
+            m_salvaged.erase(it);
+        }
+    }
+    if (!salvaged || salvaged->model_id != m_loaded_model_id) {
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", "Nothing to resume for " + handle_id);
+        return handle;
+    }
+    
+    GenerationJob job;
+    job.request = salvaged->request;
+    job.handle = handle;
+    job.resume = salvaged;
+    
+    static const char* output_names[] = { "text", "tokens", "both" };
+    Dictionary output;
+    output["output"] = output_names[salvaged->output_mode];
+    String output_error;
+    _setup_output(handle, output, output_error);
+    
+    std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+    String admit_error;
+    ContextLane* lane = _admit_request(salvaged->context, admit_error);
+    if (lane == nullptr) {
+        // Still resumable once the context has room again
+        {
+            std::lock_guard<std::mutex> lock(m_resume_mutex);
+            m_salvaged[handle_id] = salvaged;
+        }
+        handle->set_status(LLMGenerationHandle::STATUS_ERROR);
+        handle->call_deferred("_emit_error_deferred", admit_error);
+        return handle;
+    }
+    
+    handle->set_model_id(m_loaded_model_id);
+    handle->start();
+    _enqueue_interactive(*lane, job);
+    return handle;
+}
+
+bool LlamaCppProvider::can_resume(const String& handle_id) {
+    std::lock_guard<std::mutex> lock(m_resume_mutex);
+    _prune_salvaged();
+    auto it = m_salvaged.find(handle_id);
+    return it != m_salvaged.end() && it->second->model_id == m_loaded_model_id;
+}
+
+void LlamaCppProvider::set_resume_policy(const Dictionary& config) {
+    ResumePolicy policy;
+    policy.grace_seconds = std::max(0.0, static_cast<double>(config.get("grace_seconds", policy.grace_seconds)));
+    policy.keep_kv = config.get("keep_kv", policy.keep_kv);
+    policy.max_entries = std::max(1, static_cast<int>(config.get("max_entries", policy.max_entries)));
+    
+    std::lock_guard<std::mutex> lock(m_resume_mutex);
+    m_resume_policy = policy;
+    if (policy.grace_seconds <= 0.0) {
+        m_salvaged.clear();
+    }
+    _prune_salvaged();
+}
+
+Dictionary LlamaCppProvider::get_resume_stats() {
+    std::lock_guard<std::mutex> lock(m_resume_mutex);
+    _prune_salvaged();
+    const ResumeStats& s = m_resume_stats;
+    
+    Dictionary stats;
+    stats["salvaged"] = s.salvaged;
+    stats["kv_kept"] = s.kv_kept;
+    stats["expired"] = s.expired;
+    stats["pending"] = static_cast<int64_t>(m_salvaged.size());
+    stats["resumes"] = s.resumes;
+    stats["tokens_salvaged"] = s.tokens_salvaged;
+    stats["tokens_reused"] = s.tokens_reused;
+    stats["kv_restores"] = s.kv_restores;
+    return stats;
+}
+
+void LlamaCppProvider::_salvage_generation(ContextLane& p_lane, const GenerationJob& p_job, const GenerationTrace& p_trace, const String& p_text) {
+    ResumePolicy policy;
+    {
+        std::lock_guard<std::mutex> lock(m_resume_mutex);
+        policy = m_resume_policy;
+    }
+    if (policy.grace_seconds <= 0.0) {
+        return;
+    }
+    
+    auto salvaged = std::make_shared<SalvagedGeneration>();
+    salvaged->model_id = m_loaded_model_id;
+    salvaged->context = p_lane.name;
+    salvaged->request = p_job.request;
+    salvaged->output_mode = p_job.handle->get_output_mode();
+    salvaged->prompt = p_trace.prompt;
+    salvaged->generated = p_trace.generated;
+    salvaged->text = p_text;
+    salvaged->expires = std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(policy.grace_seconds));
+    
+    // A cancelled request leaves its sequence resident; a failed decode
+    // cleared it
+    if (policy.keep_kv && !p_lane.kv_tokens.empty()) {
+        salvaged->kv_state.resize(llama_state_seq_get_size(p_lane.ctx, 0));
+        if (llama_state_seq_get_data(p_lane.ctx, salvaged->kv_state.data(), salvaged->kv_state.size(), 0) == salvaged->kv_state.size()) {
+            salvaged->kv_tokens = p_lane.kv_tokens;
+            salvaged->composed_from = p_lane.composed_from;
+        } else {
+            salvaged->kv_state.clear();
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(m_resume_mutex);
+    m_salvaged[p_job.handle->get_id()] = salvaged;
+    m_resume_stats.salvaged++;
+    m_resume_stats.kv_kept += salvaged->kv_state.empty() ? 0 : 1;
+    _prune_salvaged();
+}
+
+void LlamaCppProvider::_prune_salvaged() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = m_salvaged.begin(); it != m_salvaged.end();) {
+        if (it->second->expires <= now) {
+            it = m_salvaged.erase(it);
+            m_resume_stats.expired++;
+        } else {
+            ++it;
+        }
+    }
+    // Over the limit, the entries closest to expiry go first
+    while (static_cast<int>(m_salvaged.size()) > m_resume_policy.max_entries) {
+        auto oldest = m_salvaged.begin();
+        for (auto it = m_salvaged.begin(); it != m_salvaged.end(); ++it) {
+            if (it->second->expires < oldest->second->expires) {
+                oldest = it;
+            }
+        }
+        m_salvaged.erase(oldest);
+        m_resume_stats.expired++;
+    }
+}
+
+bool LlamaCppProvider::_restore_salvaged_kv(ContextLane& p_lane, const SalvagedGeneration& p_salvaged, const std::vector<int32_t>& p_tokens) {
+    // Only worth it when the context lost more of the sequence than the
+    // snapshot covers
+    if (common_prefix(p_salvaged.kv_tokens, p_tokens) <= common_prefix(p_lane.kv_tokens, p_tokens)) {
+        return false;
+    }
+    String error;
+    if (static_cast<int>(p_salvaged.kv_tokens.size()) > p_lane.n_ctx ||
+            !_ensure_kv_capacity(p_lane, static_cast<int>(p_salvaged.kv_tokens.size()), error)) {
+        return false;
+    }
+    
+    llama_memory_seq_rm(llama_get_memory(p_lane.ctx), 0, -1, -1);
+    p_lane.kv_tokens.clear();
+    p_lane.composed_from = -1;
+    bool restored = llama_state_seq_set_data(p_lane.ctx, p_salvaged.kv_state.data(), p_salvaged.kv_state.size(), 0) != 0;
+    if (restored) {
+        p_lane.kv_tokens = p_salvaged.kv_tokens;
+        p_lane.composed_from = p_salvaged.composed_from;
+    }
+    p_lane.kv_cells_used.store(static_cast<int>(p_lane.kv_tokens.size()), std::memory_order_relaxed);
+    
+    // Whatever a speculative prefill left resident is gone now
+    if (p_lane.spec_region_start >= 0) {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        m_speculative_stats.wasted++;
+        p_lane.spec_region_start = -1;
+    }
+    return restored;
+}
+
+Dictionary LlamaCppProvider::get_status() const {
+    Dictionary status;
+    
+    status["loaded"] = is_loaded();
+    status["model_id"] = m_loaded_model_id;
+    status["model_path"] = m_loaded_model_path;
+    status["context_length"] = m_context_length;
+    status["n_threads"] = m_n_threads;
+    status["n_gpu_layers"] = m_n_gpu_layers;
+    bool generating = false;
+    PackedStringArray contexts;
+    {
+        std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+        for (const auto& entry : m_lanes) {
+            generating = generating || entry.second->interactive_active.load(std::memory_order_acquire) > 0;
+            contexts.push_back(entry.first);
+        }
+    }
+    status["generating"] = generating;
+    status["contexts"] = contexts;
+    
+    String backend_name;
+    switch (m_backend_type) {
+        case BACKEND_CPU: backend_name = "CPU"; break;
+        case BACKEND_CUDA: backend_name = "CUDA"; break;
+        case BACKEND_METAL: backend_name = "Metal"; break;
+        case BACKEND_VULKAN: backend_name = "Vulkan"; break;
+        default: backend_name = "Unknown"; break;
+    }
+    status["backend"] = backend_name;
+    
+    return status;
+}
+
+void LlamaCppProvider::configure_kv_tiering(const Dictionary& config) {
+    int64_t host_mb = config.get("host_budget_mb", 0);
+    int64_t disk_mb = config.get("disk_budget_mb", 0);
+    String spill_dir = config.get("spill_dir", "user://kv_tier");
+    m_kv_tier.configure(host_mb * 1024 * 1024, disk_mb * 1024 * 1024, config.get("min_tokens", 256), spill_dir);
+    log_info("KV tiering " + (host_mb > 0 ? "on: host " + String::num_int64(host_mb) + " MB, disk " +
+             String::num_int64(disk_mb) + " MB" : String("off")));
+}
+
+Dictionary LlamaCppProvider::get_kv_tier_stats() const {
+    return m_kv_tier.get_stats();
+}
+
+Dictionary LlamaCppProvider::get_memory_report() {
+    auto start = std::chrono::steady_clock::now();
+    Dictionary report;
+    
+    Dictionary weights;
+    weights["model_id"] = m_loaded_model_id;
+    weights["model_bytes"] = m_model != nullptr ? static_cast<int64_t>(llama_model_size(m_model)) : int64_t(0);
+    if (!m_loaded_model_path.is_empty()) {
+        // Without mmap (or once a GPU holds every layer) nothing is mapped
+        // and the weights live in anonymous memory instead
+        MappedFileResidency residency = query_mapped_file_residency(m_loaded_model_path);
+        weights["file_bytes"] = m_loaded_model_file_bytes;
+        weights["mapped_bytes"] = residency.mapped;
+        weights["resident_bytes"] = residency.resident;
+        weights["resident_fraction"] = residency.mapped > 0 ? static_cast<double>(residency.resident) / residency.mapped : 0.0;
+    }
+    report["weights"] = weights;
+    
+    Dictionary kv_contexts;
+    int64_t kv_total = 0;
+    int64_t kv_used = 0;
+    int64_t compute_total = 0;
+    {
+        std::lock_guard<std::mutex> lanes_lock(m_lanes_mutex);
+        for (const auto& entry : m_lanes) {
+            ContextLane& lane = *entry.second;
+            double bytes_per_cell = _kv_bytes_per_cell(lane.type_k, lane.type_v);
+            int64_t total = static_cast<int64_t>(lane.n_ctx_alloc.load(std::memory_order_relaxed) * bytes_per_cell);
+            int64_t compute = lane.compute_buffer_bytes.load(std::memory_order_relaxed);
+            
+            // Summarization and batch scoring fill sequences 1..n next to
+            // sequence 0; cells they share with it are counted there
+            Dictionary sequences;
+            int cells_used = 0;
+            {
+                std::lock_guard<std::mutex> lock(lane.seq_cells_mutex);
+                cells_used = lane.kv_cells_used.load(std::memory_order_relaxed);
+                int own = cells_used;
+                for (const auto& seq : lane.seq_cells) {
+                    sequences[seq.first] = static_cast<int64_t>(seq.second * bytes_per_cell);
+                    own -= seq.second;
+                }
+                sequences[0] = static_cast<int64_t>(std::max(own, 0) * bytes_per_cell);
+            }
+            int64_t used = static_cast<int64_t>(cells_used * bytes_per_cell);
+            
+            Dictionary context;
+            context["total_bytes"] = total;
+            context["used_bytes"] = used;
+            context["used_cells"] = cells_used;
+            context["sequences"] = sequences;
+            context["compute_buffer_bytes"] = compute;
+            kv_contexts[entry.first] = context;
+            kv_total += total;
+            kv_used += used;
+            compute_total += compute;
+        }
+    }
+    Dictionary kv;
+    kv["total_bytes"] = kv_total;
+    kv["used_bytes"] = kv_used;
+    kv["contexts"] = kv_contexts;
+    report["kv"] = kv;
+    report["compute_buffer_bytes"] = compute_total;
+    Dictionary tier = m_kv_tier.get_stats();
+    report["kv_tier_host_bytes"] = Dictionary(tier["host"])["bytes"];
+    
+    int64_t completion_bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_cache_mutex);
+        for (const CompletionCacheEntry& entry : m_completion_cache) {
+            completion_bytes += sizeof(CompletionCacheEntry) +
+                                (entry.key.length() + entry.text.length()) * static_cast<int64_t>(sizeof(char32_t));
+        }
+        report["completion_cache_entries"] = static_cast<int64_t>(m_completion_cache.size());
+    }
+    report["completion_cache_bytes"] = completion_bytes;
+    
+    int64_t pieces_bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_token_pieces_mutex);
+        for (const std::string& piece : m_token_pieces) {
+            pieces_bytes += sizeof(std::string) + (piece.capacity() > 15 ? piece.capacity() : 0);
+        }
+    }
+    report["token_pieces_bytes"] = pieces_bytes;
+    
+    int64_t standby_bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+        for (const StandbyModel& standby : m_standby_models) {
+            standby_bytes += standby.size_bytes;
+        }
+    }
+    report["standby_model_bytes"] = standby_bytes;
+    
+    ProcessMemoryUsage usage = read_process_memory_usage();
+    Dictionary process;
+    process["rss_bytes"] = usage.rss;
+    process["pss_bytes"] = usage.pss;
+    process["pss_anon_bytes"] = usage.pss_anon;
+    process["pss_file_bytes"] = usage.pss_file;
+    process["swap_bytes"] = usage.swap;
+    report["process"] = process;
+    
+    report["report_usec"] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+LlamaCppProvider::BackendType LlamaCppProvider::get_backend_type() const {
+    return m_backend_type;
+}
+
+int64_t LlamaCppProvider::estimate_memory_usage(const String& model_path) const {
+    // Rough estimation: file size + ~20% overhead for context
+    // More accurate would require parsing GGUF metadata
+    if (!FileAccess::file_exists(model_path)) {
+        return -1;
     }
     
     Ref<FileAccess> file = FileAccess::open(model_path, FileAccess::READ);
@@ -574,4 +4361,338 @@ int LlamaCppProvider::get_n_gpu_layers() const {
     return m_n_gpu_layers;
 }
 
+void LlamaCppProvider::set_elastic_kv_min_ctx(int p_cells) {
+    m_elastic_kv_min_ctx = std::max(0, p_cells);
+}
+
+int LlamaCppProvider::get_elastic_kv_min_ctx() const {
+    return m_elastic_kv_min_ctx;
+}
+
+void LlamaCppProvider::declare_upcoming_models(const PackedStringArray& model_paths, int64_t memory_budget_bytes) {
+    // A load or unload may be running on another thread
+    String loaded_path;
+    int64_t loaded_size = 0;
+    {
+        std::lock_guard<std::mutex> model_lock(m_model_mutex);
+        loaded_path = m_loaded_model_path;
+        loaded_size = m_model != nullptr ? static_cast<int64_t>(llama_model_size(m_model)) : 0;
+    }
+    
+    // Resolve file sizes up front so the prefetch lock is never held across I/O
+    std::vector<PrefetchTask> candidates;
+    for (int i = 0; i < model_paths.size(); i++) {
+        const String& path = model_paths[i];
+        if (path == loaded_path) {
+            continue;
+        }
+        Ref<FileAccess> file = FileAccess::open(path, FileAccess::READ);
+        if (!file.is_valid()) {
+            log_warning("Cannot prefetch missing model: " + path);
+            continue;
+        }
+        PrefetchTask task;
+        task.path = path;
+        task.size_bytes = file->get_length();
+        task.n_gpu_layers = m_n_gpu_layers;
+        candidates.push_back(task);
+    }
+    
+    std::vector<llama_model*> released;
+    {
+        std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+        m_prefetch_stats.declarations++;
+        
+        auto is_declared = [&candidates](const String& p_path) {
+            for (const PrefetchTask& task : candidates) {
+                if (task.path == p_path) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        
+        // Release standby models the new plan no longer needs
+        int64_t budget_used = loaded_size;
+        for (auto it = m_standby_models.begin(); it != m_standby_models.end();) {
+            if (!is_declared(it->path)) {
+                released.push_back(it->model);
+                it = m_standby_models.erase(it);
+            } else {
+                budget_used += it->size_bytes;
+                ++it;
+            }
+        }
+        m_page_cache_entries.erase(
+            std::remove_if(m_page_cache_entries.begin(), m_page_cache_entries.end(),
+                [&is_declared](const PageCacheEntry& p_entry) { return !is_declared(p_entry.path); }),
+            m_page_cache_entries.end()
+        );
+        
+        // Abort an in-flight prefetch that is no longer wanted
+        if (!m_prefetch_inflight.path.is_empty()) {
+            if (is_declared(m_prefetch_inflight.path)) {
+                if (m_prefetch_inflight.full_load) {
+                    budget_used += m_prefetch_inflight.size_bytes;
+                }
+            } else {
+                m_prefetch_epoch.fetch_add(1);
+            }
+        }
+        
+        m_prefetch_queue.clear();
+        m_prefetch_declared.clear();
+        for (PrefetchTask& task : candidates) {
+            m_prefetch_declared.push_back(task.path);
+            
+            bool already_resident = task.path == m_prefetch_inflight.path;
+            for (const StandbyModel& standby : m_standby_models) {
+                already_resident = already_resident || standby.path == task.path;
+            }
+            if (already_resident) {
+                continue;
+            }
+            
+            // Full background loads go in declaration order until the budget
+            // is spent; everything after that only gets its pages warmed
+            task.full_load = memory_budget_bytes > 0 && budget_used + task.size_bytes <= memory_budget_bytes;
+            if (task.full_load) {
+                budget_used += task.size_bytes;
+            }
+            m_prefetch_queue.push_back(task);
+        }
+        
+        if (!m_prefetch_queue.empty() && !m_prefetch_thread) {
+            m_prefetch_stop = false;
+            m_prefetch_thread = std::make_unique<std::thread>(&LlamaCppProvider::_prefetch_thread_func, this);
+        }
+    }
+    m_prefetch_cv.notify_all();
+    
+    for (llama_model* model : released) {
+        llama_model_free(model);
+    }
+    if (!released.empty()) {
+        log_info("Released " + String::num_int64(released.size()) + " standby model(s) no longer declared");
+    }
+}
+
+Dictionary LlamaCppProvider::get_prefetch_stats() {
+    std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+    
+    Dictionary stats;
+    stats["declarations"] = m_prefetch_stats.declarations;
+    stats["page_cache_prefetches"] = m_prefetch_stats.page_cache_prefetches;
+    stats["background_loads"] = m_prefetch_stats.background_loads;
+    stats["standby_hits"] = m_prefetch_stats.standby_hits;
+    stats["page_cache_hits"] = m_prefetch_stats.page_cache_hits;
+    stats["misses"] = m_prefetch_stats.misses;
+    
+    int64_t hits = m_prefetch_stats.standby_hits + m_prefetch_stats.page_cache_hits;
+    int64_t lookups = hits + m_prefetch_stats.misses;
+    stats["hit_rate"] = lookups > 0 ? static_cast<double>(hits) / lookups : 0.0;
+    stats["load_time_hidden_ms"] = m_prefetch_stats.load_time_hidden_ms;
+    stats["page_cache_read_ms"] = m_prefetch_stats.page_cache_read_ms;
+    stats["bytes_read"] = m_prefetch_stats.bytes_read;
+    
+    PackedStringArray standby;
+    for (const StandbyModel& model : m_standby_models) {
+        standby.push_back(model.path);
+    }
+    stats["standby_models"] = standby;
+    stats["inflight_model"] = m_prefetch_inflight.path;
+    stats["pending"] = static_cast<int64_t>(m_prefetch_queue.size());
+    
+    return stats;
+}
+
+void LlamaCppProvider::_prefetch_thread_func() {
+    while (true) {
+        PrefetchTask task;
+        uint64_t epoch = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_prefetch_mutex);
+            m_prefetch_cv.wait(lock, [this] { return m_prefetch_stop || !m_prefetch_queue.empty(); });
+            if (m_prefetch_stop) {
+                return;
+            }
+            task = m_prefetch_queue.front();
+            m_prefetch_queue.pop_front();
+            m_prefetch_inflight = task;
+            epoch = m_prefetch_epoch.load();
+        }
+        
+        if (task.full_load) {
+            _prefetch_full_load(task, epoch);
+        } else {
+            _prefetch_page_cache(task, epoch);
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+            m_prefetch_inflight = PrefetchTask();
+        }
+        m_prefetch_cv.notify_all();
+    }
+}
+
+void LlamaCppProvider::_prefetch_page_cache(const PrefetchTask& p_task, uint64_t p_epoch) {
+    auto start = std::chrono::steady_clock::now();
+    
+    Ref<FileAccess> file = FileAccess::open(p_task.path, FileAccess::READ);
+    if (!file.is_valid()) {
+        log_warning("Prefetch could not open: " + p_task.path);
+        return;
+    }
+    
+    // Sequential reads pull the file into the OS page cache, so the later
+    // mmap in llama_model_load_from_file faults in from RAM instead of disk
+    int64_t bytes_read = 0;
+    bool aborted = false;
+    while (bytes_read < p_task.size_bytes) {
+        if (m_prefetch_epoch.load() != p_epoch) {
+            aborted = true;
+            break;
+        }
+        PackedByteArray chunk = file->get_buffer(PREFETCH_CHUNK_BYTES);
+        if (chunk.is_empty()) {
+            break;
+        }
+        bytes_read += chunk.size();
+    }
+    file->close();
+    
+    double read_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+    m_prefetch_stats.bytes_read += bytes_read;
+    if (!aborted) {
+        m_prefetch_stats.page_cache_prefetches++;
+        PageCacheEntry entry;
+        entry.path = p_task.path;
+        entry.read_ms = read_ms;
+        m_page_cache_entries.push_back(entry);
+    }
+}
+
+void LlamaCppProvider::_prefetch_full_load(const PrefetchTask& p_task, uint64_t p_epoch) {
+    auto start = std::chrono::steady_clock::now();
+    
+    struct AbortCheck {
+        std::atomic<uint64_t>* epoch;
+        uint64_t expected;
+    } abort_check = { &m_prefetch_epoch, p_epoch };
+    
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = p_task.n_gpu_layers;
+    // Returning false from the progress callback aborts the load, which is how
+    // a superseded declaration stops paying for a model nobody will use
+    model_params.progress_callback = [](float, void* p_user_data) -> bool {
+        AbortCheck* check = static_cast<AbortCheck*>(p_user_data);
+        return check->epoch->load() == check->expected;
+    };
+    model_params.progress_callback_user_data = &abort_check;
+    
+    CharString path_utf8 = p_task.path.utf8();
+    llama_model* model = llama_model_load_from_file(path_utf8.get_data(), model_params);
+    if (model == nullptr) {
+        if (m_prefetch_epoch.load() == p_epoch) {
+            log_warning("Background load failed: " + p_task.path);
+        }
+        return;
+    }
+    
+    double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    {
+        std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+        bool still_declared = false;
+        for (const String& path : m_prefetch_declared) {
+            still_declared = still_declared || path == p_task.path;
+        }
+        if (still_declared && !m_prefetch_stop) {
+            StandbyModel standby;
+            standby.path = p_task.path;
+            standby.model = model;
+            standby.n_gpu_layers = p_task.n_gpu_layers;
+            standby.size_bytes = p_task.size_bytes;
+            standby.load_ms = load_ms;
+            m_standby_models.push_back(standby);
+            m_prefetch_stats.background_loads++;
+            model = nullptr;
+        }
+    }
+    
+    if (model != nullptr) {
+        llama_model_free(model);
+        return;
+    }
+    log_info("Background-loaded standby model: " + p_task.path +
+             " (" + String::num(load_ms, 0) + " ms)");
+}
+
+llama_model* LlamaCppProvider::_adopt_prefetched_model(const String& p_path, int p_n_gpu_layers) {
+    std::unique_lock<std::mutex> lock(m_prefetch_mutex);
+    
+    // Waiting for an in-flight background load of this very model is never
+    // slower than starting a second load of it from scratch
+    double waited_ms = 0.0;
+    if (m_prefetch_inflight.full_load && m_prefetch_inflight.path == p_path &&
+            m_prefetch_inflight.n_gpu_layers == p_n_gpu_layers) {
+        log_info("Waiting for in-flight background load: " + p_path);
+        auto wait_start = std::chrono::steady_clock::now();
+        m_prefetch_cv.wait(lock, [this, &p_path] { return m_prefetch_inflight.path != p_path; });
+        waited_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wait_start).count();
+    }
+    
+    for (auto it = m_standby_models.begin(); it != m_standby_models.end(); ++it) {
+        if (it->path == p_path && it->n_gpu_layers == p_n_gpu_layers) {
+            llama_model* model = it->model;
+            m_prefetch_stats.standby_hits++;
+            m_prefetch_stats.load_time_hidden_ms += std::max(0.0, it->load_ms - waited_ms);
+            m_standby_models.erase(it);
+            log_info("Adopted standby model: " + p_path);
+            return model;
+        }
+    }
+    
+    for (auto it = m_page_cache_entries.begin(); it != m_page_cache_entries.end(); ++it) {
+        if (it->path == p_path) {
+            // How much of the read the mmap skipped is not measured, so
+            // this is not counted as hidden load time
+            m_prefetch_stats.page_cache_hits++;
+            m_prefetch_stats.page_cache_read_ms += it->read_ms;
+            m_page_cache_entries.erase(it);
+            return nullptr;
+        }
+    }
+    
+    // Only count misses once someone has started declaring upcoming models
+    if (m_prefetch_stats.declarations > 0) {
+        m_prefetch_stats.misses++;
+    }
+    return nullptr;
+}
+
+void LlamaCppProvider::_stop_prefetch_thread() {
+    {
+        std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+        m_prefetch_stop = true;
+        m_prefetch_queue.clear();
+        m_prefetch_epoch.fetch_add(1);
+    }
+    m_prefetch_cv.notify_all();
+    
+    if (m_prefetch_thread && m_prefetch_thread->joinable()) {
+        m_prefetch_thread->join();
+    }
+    m_prefetch_thread.reset();
+    
+    for (StandbyModel& standby : m_standby_models) {
+        llama_model_free(standby.model);
+    }
+    m_standby_models.clear();
+    m_page_cache_entries.clear();
+}
+
 } // namespace godot
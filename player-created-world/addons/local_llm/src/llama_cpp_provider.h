@@ -5,17 +5,31 @@
 #include <godot_cpp/classes/thread.hpp>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
 #include <godot_cpp/variant/packed_string_array.hpp>
 #include <godot_cpp/variant/string.hpp>
 #include <godot_cpp/variant/typed_array.hpp>
 
+#include "kv_tier_store.h"
+#include "llm_engine.h"
 #include "llm_generation_handle.h"
+#include "llm_prompt_template.h"
+#include "logits_processor.h"
+#include "op_profiler.h"
+#include "usage_histograms.h"
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <vector>
 
 // Forward declarations for llama.cpp
 struct llama_model;
@@ -42,49 +56,527 @@ protected:
     static void _bind_methods();
 
 private:
-    // llama.cpp state
+    // llama.cpp state. The model is pooled by LLMEngine and shared with any
+    // other provider that loaded the same file; m_model caches the pointer.
+    std::shared_ptr<SharedModel> m_shared_model;
     llama_model* m_model = nullptr;
-    llama_context* m_ctx = nullptr;
     
     // Model info
     String m_loaded_model_id;
     String m_loaded_model_path;
-    int m_context_length = 0;
+    int64_t m_loaded_model_file_bytes = 0;
+    int m_context_length = 0; // n_ctx of the "default" context
     int m_n_threads = 4;
     int m_n_gpu_layers = 0;
+    int m_elastic_kv_min_ctx = 0;
+    
+    // Parsed generation parameters for one request
+    struct GenerationRequest {
+        String prompt;
+        String system_prompt;
+        int max_tokens = 256;
+        float temperature = 0.7f;
+        float top_p = 0.9f;
+        int top_k = 40;
+        float repeat_penalty = 1.1f;
+        PackedStringArray stop_sequences;
+        int seed = -1;
+        Array logits_processors; // names or { "name": ..., args... }
+        bool use_cache = true; // "cache": false skips the completion cache
+        std::vector<int32_t> candidate_tokens; // sorted; empty = whole vocabulary
+        bool vocab_trim = true; // "vocab_trim": false ignores set_vocab_trim()
+        int lookup_decoding = -1; // -1 = the model's setting, 0 = off, 1 = on
+        PackedStringArray examples; // register_example() names, in prompt order
+        bool compose_examples = true; // false = prefill the examples in full
+        int example_recompute = 0; // tokens per block evaluated in place
+        std::vector<int32_t> prompt_tokens; // LLMPromptTemplate::fill(); replaces the prompt text
+    };
+    
+    // Input of a summarize_long() job; sampling parameters and the final
+    // max_tokens come from the job's GenerationRequest
+    struct SummarizeRequest {
+        String text;
+        String instructions;
+        String reduce_instructions;
+        int chunk_tokens = 0; // 0 = default, capped to what fits the context
+        int chunk_max_tokens = 256;
+    };
+    
+    // Input of a score_batch() job
+    struct ScoreRequest {
+        String instruction;
+        PackedStringArray items;
+        PackedStringArray labels;
+        int batch_size = 0; // 0 = the context's n_seq_max
+    };
+    
+    // Input of a rerank() job
+    struct RerankRequest {
+        String query;
+        PackedStringArray documents;
+    };
+    
+    // A cancelled or failed request kept for resume(): its prompt and output
+    // up to the last good token, and with keep_kv the sequence it left in
+    // the context
+    struct SalvagedGeneration {
+        String model_id;
+        String context;
+        GenerationRequest request;
+        LLMGenerationHandle::OutputMode output_mode = LLMGenerationHandle::OUTPUT_TEXT;
+        std::vector<int32_t> prompt;
+        std::vector<int32_t> generated;
+        String text; // of generated (empty for token-only output)
+        std::vector<int32_t> kv_tokens;
+        std::vector<uint8_t> kv_state;
+        int composed_from = -1;
+        std::chrono::steady_clock::time_point expires;
+    };
+    
+    // What a generation got through, filled in once its prompt is evaluated
+    struct GenerationTrace {
+        bool prefilled = false;
+        std::vector<int32_t> prompt;
+        std::vector<int32_t> generated;
+    };
+    
+    // A unit of work for the worker thread. Interactive jobs carry the
+    // caller's handle; speculative jobs run only while the queue is otherwise
+    // idle and are preempted as soon as an interactive job arrives.
+    struct GenerationJob {
+        GenerationRequest request;
+        Ref<LLMGenerationHandle> handle;
+        String speculative_id;
+        bool speculative = false;
+        bool prefill_only = false;
+        bool summarize = false;
+        SummarizeRequest summarize_request;
+        bool score = false;
+        ScoreRequest score_request;
+        bool rerank = false;
+        RerankRequest rerank_request;
+        std::shared_ptr<const SalvagedGeneration> resume; // continue this output
+    };
+    
+    enum GenerationOutcome {
+        OUTCOME_COMPLETED,
+        OUTCOME_CANCELLED,
+        OUTCOME_PREEMPTED,
+        OUTCOME_FAILED
+    };
     
-    // Thread management
-    std::unique_ptr<std::thread> m_worker_thread;
-    std::atomic<bool> m_worker_running{false};
     std::mutex m_model_mutex;
     
-    // Current generation
-    Ref<LLMGenerationHandle> m_current_handle;
-    std::mutex m_handle_mutex;
+    // One llama_context over the shared model weights. Every lane has its
+    // own KV cache, worker thread and job queues, so a small chat context
+    // never waits behind a long-context one. load_model() creates "default";
+    // create_context() adds more. Requests pick a lane with "context".
+    // Resize history of an elastic context (see set_context_elastic)
+    struct ElasticStats {
+        int64_t grows = 0;
+        int64_t shrinks = 0;
+        int64_t failures = 0;
+        double stall_ms_total = 0.0;
+        double stall_ms_max = 0.0;
+        // Cells below n_ctx, integrated over time up to last_change
+        double saved_cell_seconds = 0.0;
+        std::chrono::steady_clock::time_point since;
+        std::chrono::steady_clock::time_point last_change;
+    };
+    
+    struct ContextLane {
+        String name;
+        llama_context* ctx = nullptr;
+        int n_ctx = 0;          // upper bound; the allocation may be smaller
+        int n_seq_max = 1;      // interactive requests admitted at once
+        String type_k = "f16";
+        String type_v = "f16";
+        int n_threads = 4;
+        ComputePriority priority = COMPUTE_INTERACTIVE; // of its requests
+        
+        // Share of the engine's thread budget while a job runs; the context
+        // is switched to the granted thread count before each decode
+        ComputeLease lease;
+        int compute_threads = 0; // worker thread only
+        
+        // Thread management
+        std::unique_ptr<std::thread> worker_thread;
+        std::atomic<int> interactive_active{0}; // running + queued
+        std::atomic<bool> worker_stop{false};
+        std::atomic<bool> interactive_pending{false};
+        std::mutex job_mutex;
+        std::condition_variable job_cv;
+        std::deque<GenerationJob> interactive_jobs;
+        std::deque<GenerationJob> speculative_jobs;
+        
+        // Current generation
+        Ref<LLMGenerationHandle> current_handle;
+        std::mutex handle_mutex;
+        
+        // Tokens whose KV is resident in sequence 0 (worker thread only). New
+        // prompts reuse the longest common prefix instead of clearing the cache.
+        std::vector<int32_t> kv_tokens;
+        std::atomic<int> kv_cells_used{0}; // every sequence, for other threads
+        // Cells of sequences 1..n beyond what they share with sequence 0,
+        // while summarization or batch scoring runs them
+        std::mutex seq_cells_mutex;
+        std::map<int, int> seq_cells;
+        std::atomic<int64_t> compute_buffer_bytes{0};
+        
+        // KV range of sequence 0 produced by a speculative prefill that no
+        // interactive request has consumed yet (worker thread only)
+        int spec_region_start = -1;
+        int spec_region_end = -1;
+        
+        // First cell of sequence 0 holding spliced example KV, -1 if none.
+        // Cells from there on are only reused by requests that compose
+        // examples themselves (worker thread only).
+        int composed_from = -1;
+        
+        std::atomic<int64_t> requests{0};
+        std::atomic<int64_t> rejected_busy{0};
+        
+        // Elastic KV: with n_ctx_min > 0 the worker allocates n_ctx_alloc
+        // cells, grows them toward n_ctx on demand and shrinks them after a
+        // run of small requests
+        std::atomic<int> n_ctx_min{0};
+        std::atomic<int> n_ctx_alloc{0};
+        std::atomic<bool> resize_requested{false};
+        std::vector<int> recent_peaks; // worker thread only
+        ElasticStats elastic;
+        std::mutex elastic_mutex;
+        
+        // Op profiling: the eval callback is only part of the context while
+        // a profile runs; the worker rebuilds the context to add or drop it
+        OpProfiler profiler;
+        bool profiler_installed = false; // worker thread only
+        std::atomic<bool> rebuild_requested{false};
+    };
+    std::map<String, std::unique_ptr<ContextLane>> m_lanes;
+    mutable std::mutex m_lanes_mutex;
+    
+    // Sequences evicted from any context, compressed off-context until a
+    // prompt that shares more of them comes back (off by default)
+    KvTierStore m_kv_tier;
+    
+    // Completion cache for deterministic (temperature <= 0) requests
+    struct CompletionCacheEntry {
+        String key;
+        String text;
+        int n_tokens = 0;
+        bool speculative = false;
+    };
+    struct SpeculativeStats {
+        int64_t registered = 0;
+        int64_t completed = 0;
+        int64_t preempted = 0;
+        int64_t useful = 0;
+        int64_t wasted = 0;
+        int64_t tokens_computed = 0;
+        int64_t tokens_reused = 0;
+        int64_t cache_hits = 0;
+        int64_t cache_lookups = 0;
+        double compute_ms = 0.0;
+    };
+    std::deque<CompletionCacheEntry> m_completion_cache;
+    SpeculativeStats m_speculative_stats;
+    int64_t m_speculative_counter = 0;
+    std::mutex m_cache_mutex;
+    
+    // Logits processors: token text table shared by processor factories
+    // (built on first use per model) and accumulated per-processor timing
+    std::vector<std::string> m_token_pieces;
+    std::mutex m_token_pieces_mutex;
+    std::map<std::string, LogitsProcessorTiming> m_processor_stats;
+    std::mutex m_processor_stats_mutex;
+    
+    // Sampler restriction: the set_vocab_trim() token set for
+    // the loaded model (null when off) and per-token cost of each mode.
+    // Requests hold a reference to the set they started with.
+    struct VocabStats {
+        int64_t full_tokens = 0;
+        int64_t full_sample_ns = 0;
+        int64_t full_loop_ns = 0;
+        int64_t restricted_tokens = 0;
+        int64_t restricted_sample_ns = 0;
+        int64_t restricted_loop_ns = 0;
+        int64_t candidates = 0;    // summed over restricted tokens
+        int64_t trim_checked = 0;  // full-vocabulary tokens sampled while a trim was set
+        int64_t trim_misses = 0;   // ...that the trim would have excluded
+    };
+    Dictionary m_vocab_trim_config;
+    std::shared_ptr<const std::vector<int32_t>> m_vocab_trim;
+    VocabStats m_vocab_stats;
+    mutable std::mutex m_vocab_mutex;
+    void _apply_vocab_trim();
+    std::shared_ptr<const std::vector<int32_t>> _get_vocab_trim() const;
+    
+    // Prompt-lookup decoding: draft settings per model id and counters
+    // over every request, with and without it
+    struct LookupDecodingConfig {
+        bool enabled = false;
+        int ngram = 3;      // tokens matched to find a continuation
+        int draft_max = 8;  // tokens drafted per verify batch
+    };
+    struct LookupDecodingStats {
+        int64_t requests = 0;
+        int64_t tokens = 0;
+        int64_t loop_ns = 0;
+        int64_t decodes = 0;
+        int64_t verify_decodes = 0;
+        int64_t drafted = 0;
+        int64_t accepted = 0;
+        int64_t plain_tokens = 0;
+        int64_t plain_loop_ns = 0;
+    };
+    std::map<String, LookupDecodingConfig> m_lookup_decoding_configs;
+    LookupDecodingStats m_lookup_decoding_stats;
+    std::mutex m_lookup_decoding_mutex;
+    LookupDecodingConfig _resolve_lookup_decoding(const GenerationRequest& p_request);
+    
+    // Few-shot example blocks (see register_example). Token ids and the KV
+    // of each block, evaluated alone from position 0, are built on first use
+    // per model and KV cache type; unload keeps only the texts. Jobs hold a
+    // reference, so re-registering a name never affects a running prefill.
+    struct ExampleBlock {
+        String text;
+        std::vector<int32_t> tokens;
+        std::map<String, std::shared_ptr<const std::vector<uint8_t>>> states; // by "type_k/type_v"
+    };
+    struct ExampleUse {
+        size_t start = 0; // index of the block's first token in the prompt
+        size_t length = 0;
+        std::shared_ptr<ExampleBlock> block;
+    };
+    struct ExamplePlan {
+        std::vector<ExampleUse> blocks;
+        bool compose = true;
+        int recompute = 0;
+    };
+    struct ExampleStats {
+        int64_t composed_requests = 0;
+        int64_t full_requests = 0;
+        double composed_prefill_ms = 0.0;
+        double full_prefill_ms = 0.0;
+        int64_t blocks_spliced = 0;
+        int64_t tokens_spliced = 0;
+        int64_t tokens_recomputed = 0;
+        int64_t precomputes = 0;
+        int64_t precompute_tokens = 0;
+        double precompute_ms = 0.0;
+        double splice_ms = 0.0;
+        int64_t fallbacks = 0;
+    };
+    std::map<String, std::shared_ptr<ExampleBlock>> m_examples;
+    ExampleStats m_example_stats;
+    mutable std::mutex m_examples_mutex;
+    bool _tokenize_request(const GenerationRequest& p_request, bool p_prefix_only, std::vector<int32_t>& r_tokens,
+                           ExamplePlan& r_plan, String& r_error);
+    
+    // Resumable generations by handle id (see set_resume_policy)
+    struct ResumePolicy {
+        double grace_seconds = 60.0; // 0 = nothing is kept
+        bool keep_kv = false;
+        int max_entries = 8;
+    };
+    struct ResumeStats {
+        int64_t salvaged = 0;
+        int64_t kv_kept = 0;
+        int64_t expired = 0;
+        int64_t resumes = 0;
+        int64_t tokens_salvaged = 0;  // output tokens resumes did not generate again
+        int64_t tokens_reused = 0;    // resumed tokens already in the KV cache
+        int64_t kv_restores = 0;
+    };
+    ResumePolicy m_resume_policy;
+    std::map<String, std::shared_ptr<const SalvagedGeneration>> m_salvaged;
+    ResumeStats m_resume_stats;
+    std::mutex m_resume_mutex;
+    void _salvage_generation(ContextLane& p_lane, const GenerationJob& p_job, const GenerationTrace& p_trace, const String& p_text);
+    void _prune_salvaged(); // caller holds m_resume_mutex
+    bool _restore_salvaged_kv(ContextLane& p_lane, const SalvagedGeneration& p_salvaged, const std::vector<int32_t>& p_tokens);
+    
+    // score_batch() throughput per batch width
+    struct ScoreStats {
+        int64_t jobs = 0;
+        int64_t items = 0;
+        int64_t skipped = 0;
+        int64_t decodes = 0;
+        double seconds = 0.0;
+    };
+    std::map<int, ScoreStats> m_score_stats;
+    std::mutex m_score_mutex;
+    
+    // Cross-encoder reranker (see load_reranker). Its context is separate
+    // from the lanes', but rerank jobs run on a lane's worker and take their
+    // threads from that lane's compute lease. A job holds a reference and
+    // the reranker's use_mutex while it scores, so unloading never waits for
+    // it; the context is freed with the last reference.
+    struct Reranker {
+        std::shared_ptr<SharedModel> model;
+        llama_context* ctx = nullptr;
+        String path;
+        int threads = 0;
+        int seq_max = 0;
+        std::mutex use_mutex; // one job at a time on ctx
+        
+        ~Reranker();
+    };
+    struct RerankStats {
+        int64_t jobs = 0;
+        int64_t pairs = 0;
+        int64_t truncated = 0;
+        int64_t decodes = 0;
+        double seconds = 0.0;
+    };
+    std::shared_ptr<Reranker> m_reranker;
+    RerankStats m_rerank_stats;
+    std::mutex m_reranker_mutex;
+    
+    // Observed request shape per model id, for get_capacity_advice()
+    std::map<std::string, ModelUsageStats> m_usage_stats;
+    std::mutex m_usage_mutex;
+    void _record_usage(const ContextLane& p_lane, const std::function<void(ModelUsageStats&)>& p_record);
     
     // Backend detection
     BackendType m_backend_type = BACKEND_CPU;
     
+    // Predictive model prefetching (see declare_upcoming_models).
+    // A background thread either warms the OS page cache for a model file or
+    // fully loads it into a standby slot that load_model() can adopt.
+    struct StandbyModel {
+        String path;
+        llama_model* model = nullptr;
+        int n_gpu_layers = 0;
+        int64_t size_bytes = 0;
+        double load_ms = 0.0;
+    };
+    struct PageCacheEntry {
+        String path;
+        double read_ms = 0.0;
+    };
+    struct PrefetchTask {
+        String path;
+        int64_t size_bytes = 0;
+        int n_gpu_layers = 0;
+        bool full_load = false;
+    };
+    struct PrefetchStats {
+        int64_t declarations = 0;
+        int64_t page_cache_prefetches = 0;
+        int64_t background_loads = 0;
+        int64_t standby_hits = 0;
+        int64_t page_cache_hits = 0;
+        int64_t misses = 0;
+        int64_t bytes_read = 0;
+        double load_time_hidden_ms = 0.0;  // standby adoptions only
+        double page_cache_read_ms = 0.0;    // read-ahead of models later loaded
+    };
+    
+    std::unique_ptr<std::thread> m_prefetch_thread;
+    std::mutex m_prefetch_mutex;
+    std::condition_variable m_prefetch_cv;
+    std::deque<PrefetchTask> m_prefetch_queue;
+    std::vector<StandbyModel> m_standby_models;
+    std::vector<PageCacheEntry> m_page_cache_entries;
+    std::vector<String> m_prefetch_declared;
+    PrefetchTask m_prefetch_inflight;
+    bool m_prefetch_stop = false;
+    std::atomic<uint64_t> m_prefetch_epoch{0};
+    PrefetchStats m_prefetch_stats;
+    
+    void _prefetch_thread_func();
+    void _prefetch_page_cache(const PrefetchTask& p_task, uint64_t p_epoch);
+    void _prefetch_full_load(const PrefetchTask& p_task, uint64_t p_epoch);
+    llama_model* _adopt_prefetched_model(const String& p_path, int p_n_gpu_layers);
+    void _stop_prefetch_thread();
+    
     // Logging helper
     void log_info(const String& p_message) const;
     void log_error(const String& p_message) const;
     void log_warning(const String& p_message) const;
     
-    // Internal generation loop
-    void _generation_thread_func(
-        Ref<LLMGenerationHandle> p_handle,
-        String p_prompt,
-        String p_system_prompt,
+    // Context lanes
+    std::unique_ptr<ContextLane> _create_lane(const String& p_name, const Dictionary& p_config, String& r_error);
+    void _destroy_lane(std::unique_ptr<ContextLane> p_lane);
+    ContextLane* _find_lane(const String& p_name) const;
+    double _kv_bytes_per_cell(const String& p_type_k, const String& p_type_v) const;
+    bool _init_lane_context(ContextLane& p_lane, int p_n_ctx);
+    
+    // Elastic KV (worker thread only)
+    bool _ensure_kv_capacity(ContextLane& p_lane, int p_cells, String& r_error);
+    bool _resize_kv(ContextLane& p_lane, int p_n_ctx, String& r_error);
+    void _set_sequence_cells(ContextLane& p_lane, int p_total, std::map<int, int>&& p_cells);
+    void _maybe_shrink_kv(ContextLane& p_lane, int p_peak_cells);
+    void _apply_elastic_config(ContextLane& p_lane);
+    
+    // Worker thread and generation
+    void _start_worker_thread(ContextLane& p_lane);
+    void _stop_worker_thread(ContextLane& p_lane);
+    void _worker_thread_func(ContextLane* p_lane);
+    void _run_interactive_job(ContextLane& p_lane, const GenerationJob& p_job);
+    void _run_speculative_job(ContextLane& p_lane, const GenerationJob& p_job);
+    GenerationOutcome _run_generation(
+        ContextLane& p_lane,
+        const GenerationJob& p_job,
+        String& r_text,
+        int& r_n_tokens,
+        String& r_error,
+        GenerationTrace* r_trace = nullptr
+    );
+    GenerationOutcome _prefill(ContextLane& p_lane, const std::vector<int32_t>& p_tokens, bool p_speculative, int& r_reused,
+                               String& r_error, const ExamplePlan* p_examples = nullptr);
+    bool _splice_example(ContextLane& p_lane, const ExampleUse& p_use, size_t p_from, size_t p_to, bool p_speculative);
+    static void _add_default_samplers(llama_sampler* p_chain, const GenerationRequest& p_request);
+    
+    // Admission and queueing of interactive jobs (caller holds m_lanes_mutex)
+    ContextLane* _admit_request(const String& p_context, String& r_error);
+    void _enqueue_interactive(ContextLane& p_lane, const GenerationJob& p_job);
+    
+    // Map-reduce summarization (worker thread only)
+    GenerationOutcome _run_summarize(
+        ContextLane& p_lane,
+        const GenerationJob& p_job,
+        String& r_text,
+        int& r_n_tokens,
+        String& r_error
+    );
+    GenerationOutcome _run_parallel_sequences(
+        ContextLane& p_lane,
+        const GenerationJob& p_job,
+        const std::vector<int32_t>& p_prefix,
+        const std::vector<std::vector<int32_t>>& p_inputs,
         int p_max_tokens,
-        float p_temperature,
-        float p_top_p,
-        int p_top_k,
-        float p_repeat_penalty,
-        PackedStringArray p_stop_sequences,
-        int p_seed
+        bool p_stream,
+        Dictionary& r_progress,
+        std::vector<String>& r_outputs,
+        int& r_n_tokens,
+        String& r_error
     );
     
-    // Tokenization helpers
+    // Batched classification (worker thread only)
+    GenerationOutcome _run_score_batch(ContextLane& p_lane, const GenerationJob& p_job, String& r_error);
+    GenerationOutcome _run_rerank(ContextLane& p_lane, const GenerationJob& p_job, String& r_error);
+    std::vector<std::vector<int32_t>> _split_tokens(const std::vector<int32_t>& p_tokens, int p_chunk_tokens) const;
+    bool _should_preempt(const ContextLane& p_lane) const;
+    void _swap_tiered_kv(ContextLane& p_lane, const std::vector<int32_t>& p_tokens, size_t& r_n_past);
+    bool _acquire_compute(ContextLane& p_lane, bool p_speculative);
+    
+    // Request parsing and completion cache helpers
+    static GenerationRequest _parse_request(const Dictionary& p_request);
+    bool _setup_output(const Ref<LLMGenerationHandle>& p_handle, const Dictionary& p_request, String& r_error);
+    static String _format_prompt(const GenerationRequest& p_request, bool p_prefix_only);
+    String _completion_cache_key(const GenerationRequest& p_request) const;
+    bool _lookup_completion(const String& p_key, String& r_text, int& r_n_tokens);
+    void _store_completion(const String& p_key, const String& p_text, int p_n_tokens, bool p_speculative);
+    void _discard_speculative_artifacts();
+    
+    // Logits processor helpers
+    static bool _validate_logits_processors(const Array& p_processors, String& r_error);
+    const std::vector<std::string>& _get_token_pieces();
+    
+    // Tokenization helpers (LLMPromptTemplate tokenizes its segments here)
+    friend class LLMPromptTemplate;
     std::vector<int32_t> tokenize(const String& p_text, bool p_add_bos) const;
     String token_to_string(int32_t p_token) const;
     
@@ -126,12 +618,163 @@ public:
     /// @return LLMGenerationHandle for tracking and cancellation
     Ref<LLMGenerationHandle> generate(const Dictionary& request);
     
-    /// Cancel an ongoing generation by handle ID
+    /// Summarize a text longer than the context window. The text is split
+    /// into chunks of exact token counts, the chunk summaries run as parallel
+    /// sequences in shared batches (as many as fit n_ctx, up to 8) and their
+    /// concatenation is summarized again, recursively if it is still too long.
+    /// The handle reports "progress" per finished chunk and streams the final
+    /// summary as tokens.
+    /// @param instructions System prompt for the chunk summaries
+    /// @param params context, chunk_tokens (1024), chunk_max_tokens (256),
+    ///        max_tokens (512, final summary), reduce_instructions, and the
+    ///        sampling keys of generate()
+    Ref<LLMGenerationHandle> summarize_long(const String& text, const String& instructions, const Dictionary& params);
+    
+    /// Compile a prompt with {{name}} slots (in either part) for the loaded
+    /// model. The returned template fills in slot values as token IDs for
+    /// the "prompt_tokens" request key, so generate() skips formatting and
+    /// tokenizing the prompt. Null if no model is loaded.
+    Ref<LLMPromptTemplate> compile_prompt_template(const String& prompt, const String& system_prompt);
+    
+    /// Classify many short items under one instruction. The instruction is
+    /// evaluated once and stays resident; each round copies it into up to
+    /// batch_size sequences and packs their items into shared decodes. Every
+    /// label is scored by the probability of its first token after the
+    /// assistant header, normalized over the labels. On completion
+    /// get_scores() holds items.size() * labels.size() values, row-major;
+    /// items too long for the context score 0 and count as "skipped".
+    /// @param params context, batch_size (the context's n_seq_max)
+    Ref<LLMGenerationHandle> score_batch(const String& instruction, const PackedStringArray& items,
+                                         const PackedStringArray& labels, const Dictionary& params);
+    
+    /// Per batch width: jobs, items, skipped, decodes, seconds and
+    /// items_per_second
+    Dictionary get_score_stats();
+    void reset_score_stats();
+    
+    /// Load a GGUF cross-encoder (bge-reranker, jina-reranker, ...) for
+    /// rerank(). It gets its own small context with rank pooling next to the
+    /// generation model, and stays loaded across load_model() calls.
+    /// @param config n_ctx (2048, also the longest query + document pair),
+    ///        n_seq_max (8, pairs per decode), n_gpu_layers (provider default)
+    bool load_reranker(const String& model_path, const Dictionary& config);
+    void unload_reranker();
+    bool is_reranker_loaded();
+    
+    /// Relevance of every document to the query, higher is more relevant.
+    /// Query-document pairs run as separate sequences packed into as few
+    /// decodes as the reranker context allows; the job is queued on a
+    /// generation context's worker like any request, so it interleaves with
+    /// generation there. On completion get_scores() holds one score per
+    /// document and get_progress().order the indices from best to worst.
+    /// Documents too long for the context are truncated ("truncated").
+    /// @param params context (which worker runs the job)
+    Ref<LLMGenerationHandle> rerank(const String& query, const PackedStringArray& documents, const Dictionary& params);
+    
+    /// reranker path, jobs, pairs, truncated, decodes, seconds and
+    /// pairs_per_second
+    Dictionary get_rerank_stats();
+    
+    /// Cancel an ongoing or queued generation by handle ID
     void cancel(const String& handle_id);
     
+    /// Continue a cancelled or failed generation from its last good token.
+    /// The new handle first delivers the salvaged output as one chunk, then
+    /// streams the rest up to the original max_tokens. The prompt and output
+    /// are only evaluated again if the context no longer holds them (or the
+    /// sequence kept with keep_kv). Greedy requests continue exactly as they
+    /// would have; sampled ones draw new random numbers.
+    Ref<LLMGenerationHandle> resume(const String& handle_id);
+    
+    /// Whether resume() still has the handle's output
+    bool can_resume(const String& handle_id);
+    
+    /// How long cancelled and failed outputs stay resumable.
+    /// @param config grace_seconds (60, 0 = off), keep_kv (false: also
+    ///        snapshot the context's sequence so other requests cannot evict
+    ///        it), max_entries (8, the oldest go first)
+    void set_resume_policy(const Dictionary& config);
+    
+    /// salvaged, kv_kept, expired, pending, resumes, tokens_salvaged (output
+    /// not generated again), tokens_reused (resumed tokens still in the KV
+    /// cache) and kv_restores
+    Dictionary get_resume_stats();
+    
+    /// Create another context over the loaded model's weights. Requests with
+    /// "context": name run on it, in parallel with the other contexts.
+    /// @param config n_ctx (2048), n_seq_max (1, requests admitted at once),
+    ///        type_k / type_v ("f16", "q8_0", "q4_0"; quantized V turns on
+    ///        flash attention), n_threads (provider default), priority
+    ///        ("interactive" or "background"; background requests only get
+    ///        cores interactive work leaves free)
+    /// @return false if no model is loaded, the name is taken or the context
+    ///         could not be allocated
+    bool create_context(const String& name, const Dictionary& config);
+    
+    /// Free a context created with create_context(). Its running and queued
+    /// requests are cancelled. The "default" context cannot be destroyed.
+    bool destroy_context(const String& name);
+    
+    /// Let a context's KV cache follow demand: it starts at n_ctx_min cells,
+    /// grows in steps (reallocating the context and restoring the resident
+    /// sequence) up to the context's n_ctx, and shrinks again after a run of
+    /// requests that used at most half of it. 0 goes back to a fixed n_ctx.
+    /// Also accepted as "n_ctx_min" in create_context()'s config.
+    bool set_context_elastic(const String& name, int n_ctx_min);
+    
+    /// Time every graph node of the next n_steps decode steps on a context,
+    /// by op type, shape and layer. The context is rebuilt (keeping its
+    /// sequence) to install the eval callback and again once done, so there
+    /// is no cost when no profile runs. Profiled steps run several times
+    /// slower because the graph is computed one node at a time.
+    bool start_op_profile(int n_steps = 32, const String& context = "default");
+    
+    /// End a running profile early
+    void stop_op_profile(const String& context = "default");
+    
+    /// Ranked by_op / by_shape / by_layer tables (name, count, total_ms,
+    /// ms_per_step, avg_us, max_us, share) plus steps, collecting and the
+    /// CPU features llama.cpp was built with (system_info)
+    Dictionary get_op_profile(const String& context = "default", int top_n = 20) const;
+    
+    /// Names of the live contexts, "default" included
+    PackedStringArray get_context_names() const;
+    
+    /// Memory and load per context: weights_bytes (shared, counted once),
+    /// kv_bytes_total and, under "contexts", n_ctx, n_ctx_alloc, n_seq_max,
+    /// type_k, type_v, n_threads, kv_bytes, kv_bytes_max, active, queued,
+    /// requests, rejected_busy and "elastic" (n_ctx_min, grows, shrinks,
+    /// failures, stall_ms_total/max/avg, avg_bytes_saved, bytes_saved)
+    Dictionary get_context_info() const;
+    
+    /// Decode token IDs (e.g. from LLMGenerationHandle.take_token_ids) to text
+    String detokenize(const PackedInt32Array& p_token_ids) const;
+    
     /// Get provider status information
     Dictionary get_status() const;
     
+    /// Where the process memory goes, cheap enough to poll every second:
+    /// weights (file_bytes, mapped_bytes, resident_bytes via mincore),
+    /// kv (total_bytes, used_bytes, per context and per sequence),
+    /// compute_buffer_bytes, kv_tier_host_bytes, completion_cache_bytes,
+    /// token_pieces_bytes, standby_model_bytes and process (rss, pss,
+    /// pss_anon, pss_file, swap from /proc/self/smaps_rollup; -1 elsewhere)
+    Dictionary get_memory_report();
+    
+    /// Keep evicted KV sequences (chat sessions, pinned prefixes, paused
+    /// jobs) warm outside the context. When a prompt replaces at least
+    /// min_tokens of a context's resident sequence, that sequence is saved
+    /// compressed; a later prompt sharing at least min_tokens more with a
+    /// saved sequence than with the resident one restores it instead of
+    /// prefilling again.
+    /// @param config host_budget_mb (0 = off), disk_budget_mb (0 = never
+    ///        spill), min_tokens (256), spill_dir ("user://kv_tier")
+    void configure_kv_tiering(const Dictionary& config);
+    
+    /// Entries, bytes and compression ratio per tier (host, disk), saves,
+    /// spills, drops, restores and restore_ms_per_1k_tokens per tier
+    Dictionary get_kv_tier_stats() const;
+    
     /// Get detected backend type
     BackendType get_backend_type() const;
     
@@ -156,6 +799,123 @@ public:
     // GPU layers accessors
     void set_n_gpu_layers(int p_layers);
     int get_n_gpu_layers() const;
+    
+    /// n_ctx_min for the default context of the next load_model()
+    /// (0 = allocate context_length up front, see set_context_elastic)
+    void set_elastic_kv_min_ctx(int p_cells);
+    int get_elastic_kv_min_ctx() const;
+    
+    /// Declare the models that upcoming work (e.g. the remaining nodes of a
+    /// workflow) is going to need, in the order they will be needed.
+    /// Models that fit within memory_budget_bytes (together with the loaded
+    /// model) are fully loaded into a standby pool in the background; the rest
+    /// are read ahead into the OS page cache. Standby models not in the new set
+    /// are released.
+    /// @param model_paths Absolute paths to GGUF files
+    /// @param memory_budget_bytes Budget for standby models (0 = page cache only)
+    void declare_upcoming_models(const PackedStringArray& model_paths, int64_t memory_budget_bytes);
+    
+    /// Get prefetch hit rate, hidden load time and standby pool contents.
+    /// load_time_hidden_ms counts standby adoptions only; page-cache hits
+    /// report their read-ahead time as page_cache_read_ms instead.
+    Dictionary get_prefetch_stats();
+    
+    /// Register a probable future request to precompute while the worker is
+    /// idle. Accepts the same dictionary as generate(), plus "mode":
+    /// "complete" (default) stores the full result in the completion cache,
+    /// "prefill" only warms the prompt prefix in the KV cache. An empty prompt
+    /// with "prefill" warms just the system prompt. Non-deterministic requests
+    /// (temperature > 0) are always treated as "prefill".
+    /// @return Speculative request ID, or empty string if nothing was queued
+    String register_speculative_request(const Dictionary& request);
+    
+    /// Drop all queued speculative requests
+    void clear_speculative_requests();
+    
+    /// Get useful vs. wasted precompute counts and completion cache stats
+    Dictionary get_speculative_stats();
+    
+    /// Names usable in the request's "logits_processors" list
+    PackedStringArray get_logits_processor_names() const;
+    
+    /// Get per-processor time per token, accumulated over all requests
+    Dictionary get_logits_processor_stats();
+    
+    /// Reset the accumulated processor timing
+    void reset_logits_processor_stats();
+    
+    /// Persistent vocabulary trim, kept for models loaded later. Requests
+    /// then sample only among tokens whose text lies in the given Unicode
+    /// ranges (special tokens are always kept), unless they pass
+    /// "vocab_trim": false. An empty config turns the trim off.
+    /// @param config preset ("ascii" or "latin") and/or ranges: [[first, last], ...]
+    /// @return n_vocab, kept, kept_fraction for the loaded model ({} if none)
+    Dictionary set_vocab_trim(const Dictionary& config);
+    
+    /// Tokenize sample texts and count how many of their tokens the trim
+    /// keeps: tokens, covered, coverage
+    Dictionary measure_vocab_coverage(const PackedStringArray& texts);
+    
+    /// Sampler restriction stats: sampling and step cost per token with the
+    /// whole vocabulary (full) and with a candidate set (sampler_restricted),
+    /// sampler_speedup, and how often full-vocabulary requests picked a
+    /// token outside the trim (live_coverage). The model still computes
+    /// every logit either way.
+    Dictionary get_vocab_stats();
+    void reset_vocab_stats();
+    
+    /// Prompt-lookup decoding for a model (experimental). The worker
+    /// drafts the next tokens from the request's own prompt and output (the
+    /// continuation of the last earlier occurrence of the final ngram tokens)
+    /// and the model verifies the whole draft in one batch, keeping every
+    /// token it would have sampled anyway. Needs no draft model and no extra
+    /// memory. Requests override the setting with "lookup_decoding".
+    /// @param config enabled (true), ngram (3), draft_max (8)
+    void set_lookup_decoding(const String& model_id, const Dictionary& config);
+    Dictionary get_lookup_decoding(const String& model_id);
+    
+    /// drafted, accepted, acceptance_rate, decodes, tokens_per_decode,
+    /// us_per_token vs plain_us_per_token of requests without it, speedup
+    Dictionary get_lookup_decoding_stats();
+    void reset_lookup_decoding_stats();
+    
+    /// Few-shot examples as reusable KV blocks. Requests list names under
+    /// "examples"; the texts open the user turn in that order, and instead of
+    /// prefilling a block again its KV (evaluated once per model and KV cache
+    /// type, alone from position 0) is shifted to where the block lands. The
+    /// first "example_recompute" tokens of each block (default 4) are still
+    /// evaluated in place so the block boundary sees the preceding text; the
+    /// rest of the block only attended within itself, which approximates a
+    /// full prefill. "compose_examples": false prefills the same tokens
+    /// exactly. Re-registering a name replaces its text and cached KV.
+    void register_example(const String& name, const String& text);
+    void unregister_example(const String& name);
+    void clear_examples();
+    PackedStringArray get_example_names() const;
+    
+    /// composed_requests, full_requests, avg prefill_ms of each, blocks_spliced,
+    /// tokens_spliced (prefill saved), tokens_recomputed, precomputes,
+    /// precompute_tokens, precompute_ms, splice_ms, fallbacks and state_bytes
+    /// of the cached block KV
+    Dictionary get_example_stats();
+    void reset_example_stats();
+    
+    /// Recommend n_ctx, n_seq_max and KV cache type for the loaded model from
+    /// the request histograms observed for it.
+    /// @param target_rejection_rate Acceptable fraction of requests that
+    ///        would not fit the recommended context
+    /// @param memory_budget_bytes KV cache budget (0 = available memory plus
+    ///        the current KV cache)
+    Dictionary get_capacity_advice(float target_rejection_rate = 0.01f, int64_t memory_budget_bytes = 0);
+    
+    /// Histograms for every model seen, for persistence across sessions
+    Dictionary get_usage_histograms();
+    
+    /// Restore histograms saved by get_usage_histograms()
+    void set_usage_histograms(const Dictionary& histograms);
+    
+    /// Forget observed usage for one model, or all models if empty
+    void reset_usage_histograms(const String& model_id = "");
 };
 
 } // namespace godot
@@ -0,0 +1,301 @@
+#include "llm_engine.h"
+
+#include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/variant/array.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include "llama.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace godot {
+
+static LLMEngine* s_singleton = nullptr;
+
+// Pooled models keyed by (path, n_gpu_layers); entries expire with their
+// last client, like the vocabularies shared by LLMTokenizer
+static std::mutex s_models_mutex;
+static std::map<std::pair<String, int>, std::weak_ptr<SharedModel>> s_models;
+static int64_t s_model_loads = 0;
+static int64_t s_model_shares = 0;
+
+static std::atomic<int> s_providers{0};
+static std::atomic<int> s_contexts{0};
+static std::atomic<int> s_threads{0};
+
+// Compute arbiter. Parked steps poll their abort predicate at this interval.
+static const int COMPUTE_PARK_POLL_MS = 5;
+static std::mutex s_compute_mutex;
+static std::condition_variable s_compute_cv;
+static std::vector<ComputeLease*> s_leases;
+static int s_thread_budget = 0;
+static int64_t s_compute_steps = 0;
+static int64_t s_compute_resizes = 0;
+static int64_t s_oversubscription_events = 0;
+static int64_t s_parked_steps = 0;
+static double s_parked_ms = 0.0;
+
+static const char* priority_name(ComputePriority p_priority) {
+    switch (p_priority) {
+        case COMPUTE_SPECULATIVE: return "speculative";
+        case COMPUTE_BACKGROUND: return "background";
+        case COMPUTE_INTERACTIVE: return "interactive";
+    }
+    return "";
+}
+
+// Caller holds s_compute_mutex. Highest priority first; within a priority
+// the remaining cores are water-filled, so no lease gets more than it asked
+// for and small requests leave the rest to larger ones.
+static int partition_share(const ComputeLease* p_lease) {
+    int remaining = s_thread_budget;
+    for (int priority = COMPUTE_INTERACTIVE; priority >= COMPUTE_SPECULATIVE; priority--) {
+        std::vector<const ComputeLease*> group;
+        for (const ComputeLease* lease : s_leases) {
+            if (lease->priority == priority) {
+                group.push_back(lease);
+            }
+        }
+        std::sort(group.begin(), group.end(), [](const ComputeLease* a, const ComputeLease* b) {
+            return a->requested < b->requested;
+        });
+        for (size_t i = 0; i < group.size(); i++) {
+            int fair = remaining / static_cast<int>(group.size() - i);
+            int share = std::min(group[i]->requested, fair);
+            remaining -= share;
+            if (group[i] == p_lease) {
+                return share;
+            }
+        }
+    }
+    return 0;
+}
+
+SharedModel::~SharedModel() {
+    if (model != nullptr) {
+        llama_model_free(model);
+        UtilityFunctions::print("[LocalLLM] Released shared model: ", path);
+    }
+}
+
+void LLMEngine::_bind_methods() {
+    ClassDB::bind_method(D_METHOD("get_stats"), &LLMEngine::get_stats);
+    ClassDB::bind_method(D_METHOD("set_thread_budget", "threads"), &LLMEngine::set_thread_budget);
+    ClassDB::bind_method(D_METHOD("get_thread_budget"), &LLMEngine::get_thread_budget);
+
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "thread_budget"), "set_thread_budget", "get_thread_budget");
+}
+
+LLMEngine* LLMEngine::get_singleton() {
+    return s_singleton;
+}
+
+void LLMEngine::initialize() {
+    llama_backend_init();
+    // Same physical-core estimate as LlamaCppProvider::get_recommended_threads,
+    // without its cap: the budget covers every context together
+    s_thread_budget = std::max(1, OS::get_singleton()->get_processor_count() / 2);
+    s_singleton = memnew(LLMEngine);
+    Engine::get_singleton()->register_singleton("LLMEngine", s_singleton);
+}
+
+void LLMEngine::shutdown() {
+    if (s_singleton != nullptr) {
+        Engine::get_singleton()->unregister_singleton("LLMEngine");
+        memdelete(s_singleton);
+        s_singleton = nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(s_models_mutex);
+        s_models.clear();
+    }
+    llama_backend_free();
+}
+
+std::shared_ptr<SharedModel> LLMEngine::acquire_model(const String& p_path, int p_n_gpu_layers, const ModelLoader& p_loader) {
+    const std::pair<String, int> key(p_path, p_n_gpu_layers);
+    {
+        std::lock_guard<std::mutex> lock(s_models_mutex);
+        std::shared_ptr<SharedModel> shared = s_models[key].lock();
+        if (shared) {
+            s_model_shares++;
+            UtilityFunctions::print("[LocalLLM] Sharing loaded model: ", p_path);
+            return shared;
+        }
+    }
+
+    // Loading takes seconds; other models may be acquired meanwhile
+    auto start = std::chrono::steady_clock::now();
+    llama_model* model = p_loader();
+    if (model == nullptr) {
+        return nullptr;
+    }
+
+    auto shared = std::make_shared<SharedModel>();
+    shared->path = p_path;
+    shared->n_gpu_layers = p_n_gpu_layers;
+    shared->model = model;
+    shared->size_bytes = static_cast<int64_t>(llama_model_size(model));
+    shared->load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(s_models_mutex);
+    std::shared_ptr<SharedModel> existing = s_models[key].lock();
+    if (existing) {
+        // Another provider finished loading the same file first
+        s_model_shares++;
+        return existing;
+    }
+    s_models[key] = shared;
+    s_model_loads++;
+    return shared;
+}
+
+void LLMEngine::context_opened(int p_n_threads) {
+    s_contexts.fetch_add(1, std::memory_order_relaxed);
+    s_threads.fetch_add(p_n_threads, std::memory_order_relaxed);
+}
+
+void LLMEngine::context_closed(int p_n_threads) {
+    s_contexts.fetch_sub(1, std::memory_order_relaxed);
+    s_threads.fetch_sub(p_n_threads, std::memory_order_relaxed);
+}
+
+void LLMEngine::compute_begin(ComputeLease* p_lease, const String& p_name, ComputePriority p_priority, int p_requested) {
+    std::lock_guard<std::mutex> lock(s_compute_mutex);
+    p_lease->name = p_name;
+    p_lease->priority = p_priority;
+    p_lease->requested = std::max(1, p_requested);
+    p_lease->threads = 0;
+    s_leases.push_back(p_lease);
+}
+
+int LLMEngine::compute_step(ComputeLease* p_lease, const std::function<bool()>& p_abort) {
+    std::unique_lock<std::mutex> lock(s_compute_mutex);
+    s_compute_steps++;
+    
+    int share = partition_share(p_lease);
+    if (share == 0 && p_lease->priority == COMPUTE_INTERACTIVE) {
+        // Never stall a player-facing request; run it on one core over budget
+        share = 1;
+        s_oversubscription_events++;
+    } else if (share == 0) {
+        auto start = std::chrono::steady_clock::now();
+        s_parked_steps++;
+        while (share == 0) {
+            if (p_abort && p_abort()) {
+                break;
+            }
+            s_compute_cv.wait_for(lock, std::chrono::milliseconds(COMPUTE_PARK_POLL_MS));
+            share = partition_share(p_lease);
+        }
+        s_parked_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (share == 0) {
+            return 0;
+        }
+    }
+    
+    if (p_lease->threads != 0 && share != p_lease->threads) {
+        s_compute_resizes++;
+    }
+    p_lease->threads = share;
+    return share;
+}
+
+void LLMEngine::compute_end(ComputeLease* p_lease) {
+    {
+        std::lock_guard<std::mutex> lock(s_compute_mutex);
+        s_leases.erase(std::remove(s_leases.begin(), s_leases.end(), p_lease), s_leases.end());
+        p_lease->threads = 0;
+    }
+    s_compute_cv.notify_all();
+}
+
+void LLMEngine::set_thread_budget(int p_threads) {
+    {
+        std::lock_guard<std::mutex> lock(s_compute_mutex);
+        s_thread_budget = std::max(1, p_threads);
+    }
+    s_compute_cv.notify_all();
+}
+
+int LLMEngine::get_thread_budget() const {
+    std::lock_guard<std::mutex> lock(s_compute_mutex);
+    return s_thread_budget;
+}
+
+void LLMEngine::provider_created() {
+    s_providers.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LLMEngine::provider_destroyed() {
+    s_providers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+Dictionary LLMEngine::get_stats() const {
+    Dictionary stats;
+    int threads = s_threads.load(std::memory_order_relaxed);
+    int cores = OS::get_singleton()->get_processor_count();
+    stats["providers"] = s_providers.load(std::memory_order_relaxed);
+    stats["contexts"] = s_contexts.load(std::memory_order_relaxed);
+    stats["threads"] = threads;
+    stats["cores"] = cores;
+    stats["oversubscribed"] = threads > cores;
+
+    Array models;
+    int64_t resident = 0;
+    std::lock_guard<std::mutex> lock(s_models_mutex);
+    for (auto it = s_models.begin(); it != s_models.end();) {
+        std::shared_ptr<SharedModel> shared = it->second.lock();
+        if (!shared) {
+            it = s_models.erase(it);
+            continue;
+        }
+        Dictionary entry;
+        entry["path"] = shared->path;
+        entry["n_gpu_layers"] = shared->n_gpu_layers;
+        entry["size_bytes"] = shared->size_bytes;
+        entry["load_ms"] = shared->load_ms;
+        // Minus the reference held by this loop
+        entry["clients"] = static_cast<int64_t>(shared.use_count() - 1);
+        models.push_back(entry);
+        resident += shared->size_bytes;
+        ++it;
+    }
+    stats["models"] = models;
+    stats["resident_model_bytes"] = resident;
+    stats["model_loads"] = s_model_loads;
+    stats["model_shares"] = s_model_shares;
+    
+    Dictionary compute;
+    Array leases;
+    {
+        std::lock_guard<std::mutex> compute_lock(s_compute_mutex);
+        compute["budget"] = s_thread_budget;
+        compute["steps"] = s_compute_steps;
+        compute["resizes"] = s_compute_resizes;
+        compute["oversubscription_events"] = s_oversubscription_events;
+        compute["parked_steps"] = s_parked_steps;
+        compute["parked_ms"] = s_parked_ms;
+        for (const ComputeLease* lease : s_leases) {
+            Dictionary entry;
+            entry["name"] = lease->name;
+            entry["priority"] = priority_name(lease->priority);
+            entry["requested"] = lease->requested;
+            entry["threads"] = lease->threads;
+            leases.push_back(entry);
+        }
+    }
+    compute["leases"] = leases;
+    stats["compute"] = compute;
+    return stats;
+}
+
+} // namespace godot
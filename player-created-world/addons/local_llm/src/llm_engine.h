@@ -0,0 +1,105 @@
+#ifndef LLM_ENGINE_H
+#define LLM_ENGINE_H
+
+#include <godot_cpp/classes/object.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <functional>
+#include <memory>
+
+struct llama_model;
+
+namespace godot {
+
+/// A loaded model shared by every provider that opened the same file with
+/// the same GPU offload. Freed when the last provider releases it.
+struct SharedModel {
+    String path;
+    int n_gpu_layers = 0;
+    llama_model* model = nullptr;
+    int64_t size_bytes = 0;
+    double load_ms = 0.0;
+
+    ~SharedModel();
+};
+
+/// Order in which the compute arbiter hands out cores. Speculative work
+/// only runs on cores nobody else wants.
+enum ComputePriority {
+    COMPUTE_SPECULATIVE = 0,
+    COMPUTE_BACKGROUND = 1,
+    COMPUTE_INTERACTIVE = 2
+};
+
+/// One context's claim on the thread budget while it runs a job. Owned by
+/// the context; registered with the engine between compute_begin() and
+/// compute_end().
+struct ComputeLease {
+    String name;
+    ComputePriority priority = COMPUTE_INTERACTIVE;
+    int requested = 0;
+    int threads = 0; // grant for the current decode step
+};
+
+/// Process-wide owner of the llama.cpp backend, the model pool and the
+/// count of live contexts. Created when the extension initializes and
+/// registered as the "LLMEngine" singleton; LlamaCppProvider instances are
+/// clients of it, so a second provider (e.g. the debug scene) opening the
+/// same model shares its weights instead of loading another copy.
+class LLMEngine : public Object {
+    GDCLASS(LLMEngine, Object);
+
+protected:
+    static void _bind_methods();
+
+public:
+    using ModelLoader = std::function<llama_model*()>;
+
+    static LLMEngine* get_singleton();
+
+    /// Backend init and singleton registration (initialize_local_llm_module)
+    static void initialize();
+    /// Backend teardown (uninitialize_local_llm_module)
+    static void shutdown();
+
+    /// The pooled model for (path, n_gpu_layers). p_loader is called only
+    /// when no provider holds it yet; returns null if the loader fails.
+    static std::shared_ptr<SharedModel> acquire_model(const String& p_path, int p_n_gpu_layers, const ModelLoader& p_loader);
+
+    /// Bookkeeping for contexts with a running worker
+    static void context_opened(int p_n_threads);
+    static void context_closed(int p_n_threads);
+
+    /// Compute arbitration. A context registers a lease for the duration of
+    /// a job and calls compute_step() before every decode. Cores go to
+    /// higher priorities first and are split evenly within a priority, so
+    /// partitions change between decode steps as jobs come and go.
+    /// Speculative and background steps that get no core park until one is
+    /// free (or p_abort returns true, which makes compute_step return 0);
+    /// interactive steps always get at least one thread, and the overrun is
+    /// counted as an oversubscription event.
+    static void compute_begin(ComputeLease* p_lease, const String& p_name, ComputePriority p_priority, int p_requested);
+    static int compute_step(ComputeLease* p_lease, const std::function<bool()>& p_abort);
+    static void compute_end(ComputeLease* p_lease);
+
+    /// Cores shared by all decode steps (default: physical core estimate)
+    void set_thread_budget(int p_threads);
+    int get_thread_budget() const;
+
+    /// providers, contexts, threads, cores, oversubscribed (threads > cores),
+    /// model_loads, model_shares, resident_model_bytes, models: one
+    /// { path, n_gpu_layers, size_bytes, load_ms, clients } per pooled model,
+    /// and compute: { budget, steps, resizes, oversubscription_events,
+    /// parked_steps, parked_ms, leases: [{ name, priority, requested, threads }] }
+    Dictionary get_stats() const;
+
+    // Called by LlamaCppProvider's constructor and destructor
+    static void provider_created();
+    static void provider_destroyed();
+};
+
+} // namespace godot
+
+#endif // LLM_ENGINE_H
@@ -4,14 +4,27 @@
 #include <godot_cpp/classes/time.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
+#include <cstring>
+
 namespace godot {
 
+static PackedInt32Array _ids_from(const std::vector<int32_t>& p_ids, size_t p_from) {
+    PackedInt32Array ids;
+    if (p_from < p_ids.size()) {
+        ids.resize(p_ids.size() - p_from);
+        memcpy(ids.ptrw(), p_ids.data() + p_from, (p_ids.size() - p_from) * sizeof(int32_t));
+    }
+    return ids;
+}
+
 void LLMGenerationHandle::_bind_methods() {
     // Signals
     ADD_SIGNAL(MethodInfo("token", PropertyInfo(Variant::STRING, "text_chunk")));
+    ADD_SIGNAL(MethodInfo("token_ids", PropertyInfo(Variant::PACKED_INT32_ARRAY, "ids")));
     ADD_SIGNAL(MethodInfo("completed", PropertyInfo(Variant::STRING, "full_text")));
     ADD_SIGNAL(MethodInfo("error", PropertyInfo(Variant::STRING, "message")));
     ADD_SIGNAL(MethodInfo("cancelled"));
+    ADD_SIGNAL(MethodInfo("progress", PropertyInfo(Variant::DICTIONARY, "info")));
 
     // Getters
     ClassDB::bind_method(D_METHOD("get_id"), &LLMGenerationHandle::get_id);
@@ -22,16 +35,25 @@ void LLMGenerationHandle::_bind_methods() {
     ClassDB::bind_method(D_METHOD("get_tokens_generated"), &LLMGenerationHandle::get_tokens_generated);
     ClassDB::bind_method(D_METHOD("get_elapsed_seconds"), &LLMGenerationHandle::get_elapsed_seconds);
     ClassDB::bind_method(D_METHOD("get_tokens_per_second"), &LLMGenerationHandle::get_tokens_per_second);
+    ClassDB::bind_method(D_METHOD("get_time_to_first_token"), &LLMGenerationHandle::get_time_to_first_token);
     ClassDB::bind_method(D_METHOD("is_cancel_requested"), &LLMGenerationHandle::is_cancel_requested);
+    ClassDB::bind_method(D_METHOD("is_collecting_token_ids"), &LLMGenerationHandle::is_collecting_token_ids);
+    ClassDB::bind_method(D_METHOD("get_output_mode"), &LLMGenerationHandle::get_output_mode);
+    ClassDB::bind_method(D_METHOD("take_token_ids"), &LLMGenerationHandle::take_token_ids);
+    ClassDB::bind_method(D_METHOD("get_tokens"), &LLMGenerationHandle::get_tokens);
+    ClassDB::bind_method(D_METHOD("get_progress"), &LLMGenerationHandle::get_progress);
+    ClassDB::bind_method(D_METHOD("get_scores"), &LLMGenerationHandle::get_scores);
     
     // Actions
     ClassDB::bind_method(D_METHOD("request_cancel"), &LLMGenerationHandle::request_cancel);
     
     // Internal deferred methods
     ClassDB::bind_method(D_METHOD("_emit_token_deferred", "token"), &LLMGenerationHandle::_emit_token_deferred);
+    ClassDB::bind_method(D_METHOD("_emit_token_ids_deferred"), &LLMGenerationHandle::_emit_token_ids_deferred);
     ClassDB::bind_method(D_METHOD("_emit_completed_deferred", "full_text"), &LLMGenerationHandle::_emit_completed_deferred);
     ClassDB::bind_method(D_METHOD("_emit_error_deferred", "error"), &LLMGenerationHandle::_emit_error_deferred);
     ClassDB::bind_method(D_METHOD("_emit_cancelled_deferred"), &LLMGenerationHandle::_emit_cancelled_deferred);
+    ClassDB::bind_method(D_METHOD("_emit_progress_deferred", "info"), &LLMGenerationHandle::_emit_progress_deferred);
 
     // Enum
     BIND_ENUM_CONSTANT(STATUS_PENDING);
@@ -39,6 +61,9 @@ void LLMGenerationHandle::_bind_methods() {
     BIND_ENUM_CONSTANT(STATUS_COMPLETED);
     BIND_ENUM_CONSTANT(STATUS_CANCELLED);
     BIND_ENUM_CONSTANT(STATUS_ERROR);
+    BIND_ENUM_CONSTANT(OUTPUT_TEXT);
+    BIND_ENUM_CONSTANT(OUTPUT_TOKENS);
+    BIND_ENUM_CONSTANT(OUTPUT_BOTH);
 
     // Properties
     ADD_PROPERTY(PropertyInfo(Variant::STRING, "id"), "", "get_id");
@@ -74,7 +99,22 @@ LLMGenerationHandle::Status LLMGenerationHandle::get_status() const {
 }
 
 String LLMGenerationHandle::get_full_text() {
+    PackedInt32Array ids;
+    {
+        std::lock_guard<std::mutex> lock(m_text_mutex);
+        if (m_output_mode != OUTPUT_TOKENS || !m_detokenizer || m_text_token_count == m_token_ids.size()) {
+            return m_full_text;
+        }
+        ids = _ids_from(m_token_ids, 0);
+    }
+    
+    // Decoded from the start: a character may span the previous boundary
+    String text = m_detokenizer(ids);
     std::lock_guard<std::mutex> lock(m_text_mutex);
+    if (static_cast<size_t>(ids.size()) > m_text_token_count) {
+        m_full_text = text;
+        m_text_token_count = ids.size();
+    }
     return m_full_text;
 }
 
@@ -103,10 +143,44 @@ double LLMGenerationHandle::get_tokens_per_second() const {
     return 0.0;
 }
 
+double LLMGenerationHandle::get_time_to_first_token() const {
+    return m_first_token_seconds;
+}
+
 bool LLMGenerationHandle::is_cancel_requested() const {
     return m_cancel_requested.load(std::memory_order_acquire);
 }
 
+bool LLMGenerationHandle::is_collecting_token_ids() const {
+    return m_output_mode != OUTPUT_TEXT;
+}
+
+LLMGenerationHandle::OutputMode LLMGenerationHandle::get_output_mode() const {
+    return m_output_mode;
+}
+
+PackedInt32Array LLMGenerationHandle::take_token_ids() {
+    std::lock_guard<std::mutex> lock(m_text_mutex);
+    PackedInt32Array ids = _ids_from(m_token_ids, m_token_ids_taken);
+    m_token_ids_taken = m_token_ids.size();
+    return ids;
+}
+
+PackedInt32Array LLMGenerationHandle::get_tokens() {
+    std::lock_guard<std::mutex> lock(m_text_mutex);
+    return _ids_from(m_token_ids, 0);
+}
+
+Dictionary LLMGenerationHandle::get_progress() {
+    std::lock_guard<std::mutex> lock(m_text_mutex);
+    return m_progress.duplicate();
+}
+
+PackedFloat32Array LLMGenerationHandle::get_scores() {
+    std::lock_guard<std::mutex> lock(m_text_mutex);
+    return m_scores;
+}
+
 void LLMGenerationHandle::set_id(const String& p_id) {
     m_id = p_id;
 }
@@ -119,27 +193,66 @@ void LLMGenerationHandle::set_status(Status p_status) {
     m_status = p_status;
 }
 
+void LLMGenerationHandle::set_output_mode(OutputMode p_mode) {
+    m_output_mode = p_mode;
+}
+
+void LLMGenerationHandle::set_detokenizer(const Detokenizer& p_detokenizer) {
+    m_detokenizer = p_detokenizer;
+}
+
 void LLMGenerationHandle::start() {
     m_status = STATUS_RUNNING;
     m_start_time = std::chrono::steady_clock::now();
     m_tokens_generated = 0;
+    m_first_token_seconds = -1.0;
     {
         std::lock_guard<std::mutex> lock(m_text_mutex);
         m_full_text = "";
+        m_token_ids.clear();
+        m_token_ids_taken = 0;
+        m_token_ids_emitted = 0;
+        m_text_token_count = 0;
     }
 }
 
-void LLMGenerationHandle::append_token(const String& p_token) {
+void LLMGenerationHandle::append_token(const String& p_token, int p_n_tokens) {
+    if (m_tokens_generated == 0) {
+        m_first_token_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start_time).count();
+    }
     {
         std::lock_guard<std::mutex> lock(m_text_mutex);
         m_full_text += p_token;
     }
-    m_tokens_generated++;
+    m_tokens_generated += p_n_tokens;
     
     // Emit signal on main thread
     call_deferred("_emit_token_deferred", p_token);
 }
 
+void LLMGenerationHandle::append_token_id(int32_t p_token) {
+    bool emit = false;
+    {
+        std::lock_guard<std::mutex> lock(m_text_mutex);
+        m_token_ids.push_back(p_token);
+        emit = !m_token_ids_emit_pending;
+        m_token_ids_emit_pending = true;
+    }
+    
+    if (m_output_mode == OUTPUT_TOKENS) {
+        if (m_tokens_generated == 0) {
+            m_first_token_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start_time).count();
+        }
+        m_tokens_generated++;
+    }
+    
+    // One deferred call per frame: IDs that arrive before it runs ride
+    // along in the same chunk
+    if (emit) {
+        call_deferred("_emit_token_ids_deferred");
+    }
+}
+
 void LLMGenerationHandle::complete(const String& p_full_text) {
     m_status = STATUS_COMPLETED;
     auto now = std::chrono::steady_clock::now();
@@ -148,7 +261,11 @@ void LLMGenerationHandle::complete(const String& p_full_text) {
     
     {
         std::lock_guard<std::mutex> lock(m_text_mutex);
-        m_full_text = p_full_text;
+        // Token-only output stays undecoded until get_full_text()
+        if (m_output_mode != OUTPUT_TOKENS || !p_full_text.is_empty()) {
+            m_full_text = p_full_text;
+            m_text_token_count = m_token_ids.size();
+        }
     }
     
     call_deferred("_emit_completed_deferred", p_full_text);
@@ -173,6 +290,20 @@ void LLMGenerationHandle::mark_cancelled() {
     call_deferred("_emit_cancelled_deferred");
 }
 
+void LLMGenerationHandle::report_progress(const Dictionary& p_progress) {
+    {
+        std::lock_guard<std::mutex> lock(m_text_mutex);
+        m_progress = p_progress.duplicate();
+    }
+    
+    call_deferred("_emit_progress_deferred", p_progress);
+}
+
+void LLMGenerationHandle::set_scores(const PackedFloat32Array& p_scores) {
+    std::lock_guard<std::mutex> lock(m_text_mutex);
+    m_scores = p_scores;
+}
+
 void LLMGenerationHandle::request_cancel() {
     m_cancel_requested.store(true, std::memory_order_release);
     UtilityFunctions::print("[LocalLLM] Cancellation requested for handle: ", m_id);
@@ -182,6 +313,19 @@ void LLMGenerationHandle::_emit_token_deferred(const String& p_token) {
     emit_signal("token", p_token);
 }
 
+void LLMGenerationHandle::_emit_token_ids_deferred() {
+    PackedInt32Array ids;
+    {
+        std::lock_guard<std::mutex> lock(m_text_mutex);
+        ids = _ids_from(m_token_ids, m_token_ids_emitted);
+        m_token_ids_emitted = m_token_ids.size();
+        m_token_ids_emit_pending = false;
+    }
+    if (!ids.is_empty()) {
+        emit_signal("token_ids", ids);
+    }
+}
+
 void LLMGenerationHandle::_emit_completed_deferred(const String& p_full_text) {
     emit_signal("completed", p_full_text);
 }
@@ -194,4 +338,8 @@ void LLMGenerationHandle::_emit_cancelled_deferred() {
     emit_signal("cancelled");
 }
 
+void LLMGenerationHandle::_emit_progress_deferred(const Dictionary& p_progress) {
+    emit_signal("progress", p_progress);
+}
+
 } // namespace godot
@@ -3,11 +3,16 @@
 
 #include <godot_cpp/classes/ref_counted.hpp>
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_float32_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
 #include <godot_cpp/variant/string.hpp>
 
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <mutex>
+#include <vector>
 
 namespace godot {
 
@@ -24,6 +29,16 @@ public:
         STATUS_CANCELLED,
         STATUS_ERROR
     };
+    
+    /// What the worker produces per token. TOKENS skips the per-token string
+    /// conversion; text is decoded from the IDs on first get_full_text().
+    enum OutputMode {
+        OUTPUT_TEXT,
+        OUTPUT_TOKENS,
+        OUTPUT_BOTH
+    };
+    
+    using Detokenizer = std::function<String(const PackedInt32Array&)>;
 
 protected:
     static void _bind_methods();
@@ -33,6 +48,7 @@ private:
     String m_model_id;
     Status m_status = STATUS_PENDING;
     std::chrono::steady_clock::time_point m_start_time;
+    double m_first_token_seconds = -1.0;
     
     String m_full_text;
     String m_error_message;
@@ -42,6 +58,24 @@ private:
     
     int m_tokens_generated = 0;
     double m_elapsed_seconds = 0.0;
+    
+    // Generated token IDs (OUTPUT_TOKENS / OUTPUT_BOTH). take_token_ids()
+    // and the token_ids signal each keep their own read position.
+    OutputMode m_output_mode = OUTPUT_TEXT;
+    std::vector<int32_t> m_token_ids;
+    size_t m_token_ids_taken = 0;
+    size_t m_token_ids_emitted = 0;
+    bool m_token_ids_emit_pending = false;
+    
+    // OUTPUT_TOKENS: m_full_text covers the first m_text_token_count IDs
+    Detokenizer m_detokenizer;
+    size_t m_text_token_count = 0;
+    
+    // Latest progress report of a multi-step job (summarize_long)
+    Dictionary m_progress;
+    
+    // Label probabilities of a score_batch() job, or rerank() scores
+    PackedFloat32Array m_scores;
 
 public:
     LLMGenerationHandle();
@@ -56,32 +90,60 @@ public:
     int get_tokens_generated() const;
     double get_elapsed_seconds() const;
     double get_tokens_per_second() const;
+    /// Seconds from start to the first token; -1 before it arrives
+    double get_time_to_first_token() const;
     bool is_cancel_requested() const;
+    bool is_collecting_token_ids() const;
+    OutputMode get_output_mode() const;
+    
+    /// Token IDs generated since the last call ("output": "tokens" or "both")
+    PackedInt32Array take_token_ids();
+    
+    /// Every token ID generated so far ("output": "tokens" or "both")
+    PackedInt32Array get_tokens();
+    
+    /// Latest progress report (empty for plain generations)
+    Dictionary get_progress();
+    
+    /// score_batch() result: one row of label probabilities per item,
+    /// row-major. rerank() result: one score per document. Empty for
+    /// other jobs.
+    PackedFloat32Array get_scores();
 
     // Setters (called by provider)
     void set_id(const String& p_id);
     void set_model_id(const String& p_model_id);
     void set_status(Status p_status);
+    void set_output_mode(OutputMode p_mode);
+    void set_detokenizer(const Detokenizer& p_detokenizer);
     void start();
     
     // Called from worker thread - thread-safe
-    void append_token(const String& p_token);
+    // p_n_tokens > 1 when a cached completion is delivered as one chunk
+    void append_token(const String& p_token, int p_n_tokens = 1);
+    // Records the ID; counts as the generated token in OUTPUT_TOKENS mode
+    void append_token_id(int32_t p_token);
     void complete(const String& p_full_text);
     void fail(const String& p_error);
     void mark_cancelled();
+    void report_progress(const Dictionary& p_progress);
+    void set_scores(const PackedFloat32Array& p_scores);
     
     // User-facing
     void request_cancel();
     
     // For deferred signal emission from main thread
     void _emit_token_deferred(const String& p_token);
+    void _emit_token_ids_deferred();
     void _emit_completed_deferred(const String& p_full_text);
     void _emit_error_deferred(const String& p_error);
     void _emit_cancelled_deferred();
+    void _emit_progress_deferred(const Dictionary& p_progress);
 };
 
 } // namespace godot
 
 VARIANT_ENUM_CAST(LLMGenerationHandle::Status);
+VARIANT_ENUM_CAST(LLMGenerationHandle::OutputMode);
 
 #endif // LLM_GENERATION_HANDLE_H
@@ -0,0 +1,301 @@
+#include "llm_prompt_template.h"
+
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include "llama_cpp_provider.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace godot {
+
+// Slot values the compiled segments are checked with: empty, a bare word,
+// text with punctuation and blank lines around it, and a lone newline
+static const char* VERIFY_PROBES[] = { "", "x", " Some text, with punctuation.\n\nAnd a second line ", "\n" };
+
+// A newline followed by a non-space character ends a pre-token on every
+// supported tokenizer, so the text on either side tokenizes independently
+static bool is_safe_cut(const String& p_text, int p_pos) {
+    if (p_pos <= 0 || p_pos >= p_text.length() || p_text[p_pos - 1] != '\n') {
+        return false;
+    }
+    char32_t next = p_text[p_pos];
+    return next != ' ' && next != '\t' && next != '\n' && next != '\r';
+}
+
+static PackedInt32Array to_packed(const std::vector<int32_t>& p_tokens) {
+    PackedInt32Array packed;
+    packed.resize(p_tokens.size());
+    if (!p_tokens.empty()) {
+        memcpy(packed.ptrw(), p_tokens.data(), p_tokens.size() * sizeof(int32_t));
+    }
+    return packed;
+}
+
+void LLMPromptTemplate::_bind_methods() {
+    ClassDB::bind_method(D_METHOD("is_valid"), &LLMPromptTemplate::is_valid);
+    ClassDB::bind_method(D_METHOD("get_slots"), &LLMPromptTemplate::get_slots);
+    ClassDB::bind_method(D_METHOD("fill", "values"), &LLMPromptTemplate::fill);
+    ClassDB::bind_method(
+        D_METHOD("make_request", "values", "params"),
+        &LLMPromptTemplate::make_request, DEFVAL(Dictionary())
+    );
+    ClassDB::bind_method(D_METHOD("resolve", "values"), &LLMPromptTemplate::resolve);
+    ClassDB::bind_method(D_METHOD("get_prefix_tokens"), &LLMPromptTemplate::get_prefix_tokens);
+    ClassDB::bind_method(D_METHOD("warm", "context"), &LLMPromptTemplate::warm, DEFVAL("default"));
+    ClassDB::bind_method(D_METHOD("get_stats"), &LLMPromptTemplate::get_stats);
+    ClassDB::bind_method(D_METHOD("benchmark", "values", "iterations"), &LLMPromptTemplate::benchmark, DEFVAL(100));
+}
+
+LLMPromptTemplate::LLMPromptTemplate() {
+}
+
+LLMPromptTemplate::~LLMPromptTemplate() {
+}
+
+void LLMPromptTemplate::compile(const Ref<LlamaCppProvider>& p_provider, const String& p_model_id, const String& p_text) {
+    m_provider = p_provider;
+    m_model_id = p_model_id;
+    m_segments.clear();
+    m_slots.clear();
+
+    // Split at {{name}}; an unclosed "{{" is plain text
+    std::vector<String> texts;
+    int pos = 0;
+    while (true) {
+        int start = p_text.find("{{", pos);
+        int end = start < 0 ? -1 : p_text.find("}}", start + 2);
+        if (end < 0) {
+            texts.push_back(p_text.substr(pos));
+            break;
+        }
+        texts.push_back(p_text.substr(pos, start - pos));
+        m_slots.push_back(p_text.substr(start + 2, end - start - 2).strip_edges());
+        pos = end + 2;
+    }
+
+    const int n = static_cast<int>(texts.size()) - 1;
+    for (int i = 0; i <= n; i++) {
+        Segment segment;
+        segment.text = texts[i];
+        const int length = segment.text.length();
+
+        // The core runs from the first safe cut to the last one; the
+        // first segment's core starts at 0 and the last one's ends at length
+        int core_start = 0;
+        if (i > 0) {
+            core_start = length;
+            for (int j = 1; j < length; j++) {
+                if (is_safe_cut(segment.text, j)) {
+                    core_start = j;
+                    break;
+                }
+            }
+        }
+        int core_end = length;
+        if (i < n) {
+            core_end = core_start;
+            for (int j = length - 1; j > core_start; j--) {
+                if (is_safe_cut(segment.text, j)) {
+                    core_end = j;
+                    break;
+                }
+            }
+        }
+
+        segment.lead = segment.text.substr(0, core_start);
+        segment.trail = segment.text.substr(core_end);
+        String core = segment.text.substr(core_start, core_end - core_start);
+        // The first segment carries BOS even if its core is empty
+        if (i == 0 || !core.is_empty()) {
+            segment.core = m_provider->tokenize(core, i == 0);
+        }
+        m_segments.push_back(segment);
+    }
+
+    // Keep the spliced path only if it reproduces a full tokenization
+    m_pretokenized = true;
+    for (const char* probe : VERIFY_PROBES) {
+        Dictionary values;
+        for (int s = 0; s < m_slots.size(); s++) {
+            values[m_slots[s]] = String::utf8(probe);
+        }
+        std::vector<int32_t> spliced;
+        int64_t seam_tokens = 0;
+        _fill_tokens(values, spliced, seam_tokens);
+        if (spliced != m_provider->tokenize(_resolve(values), true)) {
+            m_pretokenized = false;
+            UtilityFunctions::print("[LocalLLM] WARNING: Prompt template does not split cleanly into tokens; "
+                                    "fill() will tokenize the whole text");
+            break;
+        }
+    }
+}
+
+bool LLMPromptTemplate::_check_model() const {
+    if (m_provider.is_null() || !m_provider->is_loaded() || m_provider->get_loaded_model_id() != m_model_id) {
+        UtilityFunctions::printerr("[LocalLLM] ERROR: Prompt template was compiled for ", m_model_id,
+                                   "; compile it again for the loaded model");
+        return false;
+    }
+    return true;
+}
+
+String LLMPromptTemplate::_resolve(const Dictionary& p_values) const {
+    String text;
+    for (size_t i = 0; i < m_segments.size(); i++) {
+        if (i > 0) {
+            text += String(p_values.get(m_slots[i - 1], ""));
+        }
+        text += m_segments[i].text;
+    }
+    return text;
+}
+
+void LLMPromptTemplate::_fill_tokens(const Dictionary& p_values, std::vector<int32_t>& r_tokens, int64_t& r_seam_tokens) const {
+    // Text between two cores (trail, slot value, lead, possibly across a
+    // segment without a core) is tokenized as one piece
+    r_tokens.clear();
+    r_seam_tokens = 0;
+    String pending;
+    auto flush = [&]() {
+        if (pending.is_empty()) {
+            return;
+        }
+        std::vector<int32_t> seam = m_provider->tokenize(pending, false);
+        r_tokens.insert(r_tokens.end(), seam.begin(), seam.end());
+        r_seam_tokens += static_cast<int64_t>(seam.size());
+        pending = String();
+    };
+    for (size_t i = 0; i < m_segments.size(); i++) {
+        const Segment& segment = m_segments[i];
+        if (i > 0) {
+            pending += String(p_values.get(m_slots[i - 1], ""));
+        }
+        pending += segment.lead;
+        if (!segment.core.empty()) {
+            flush();
+            r_tokens.insert(r_tokens.end(), segment.core.begin(), segment.core.end());
+        }
+        pending += segment.trail;
+    }
+    flush();
+}
+
+bool LLMPromptTemplate::is_valid() const {
+    return m_provider.is_valid() && !m_segments.empty();
+}
+
+PackedStringArray LLMPromptTemplate::get_slots() const {
+    return m_slots;
+}
+
+PackedInt32Array LLMPromptTemplate::fill(const Dictionary& p_values) {
+    if (!is_valid() || !_check_model()) {
+        return PackedInt32Array();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int32_t> tokens;
+    int64_t seam_tokens = 0;
+    if (m_pretokenized) {
+        _fill_tokens(p_values, tokens, seam_tokens);
+    } else {
+        tokens = m_provider->tokenize(_resolve(p_values), true);
+        seam_tokens = static_cast<int64_t>(tokens.size());
+    }
+    PackedInt32Array packed = to_packed(tokens);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    m_fills++;
+    m_seam_tokens += seam_tokens;
+    m_spliced_tokens += static_cast<int64_t>(tokens.size()) - seam_tokens;
+    m_fill_ms += ms;
+    return packed;
+}
+
+Dictionary LLMPromptTemplate::make_request(const Dictionary& p_values, const Dictionary& p_params) {
+    Dictionary request = p_params.duplicate();
+    request["prompt_tokens"] = fill(p_values);
+    return request;
+}
+
+String LLMPromptTemplate::resolve(const Dictionary& p_values) const {
+    return _resolve(p_values);
+}
+
+PackedInt32Array LLMPromptTemplate::get_prefix_tokens() const {
+    if (m_segments.empty()) {
+        return PackedInt32Array();
+    }
+    return to_packed(m_segments[0].core);
+}
+
+String LLMPromptTemplate::warm(const String& p_context) {
+    PackedInt32Array prefix = get_prefix_tokens();
+    if (prefix.is_empty() || !_check_model()) {
+        return "";
+    }
+    Dictionary request;
+    request["prompt_tokens"] = prefix;
+    request["mode"] = "prefill";
+    request["context"] = p_context;
+    return m_provider->register_speculative_request(request);
+}
+
+Dictionary LLMPromptTemplate::get_stats() const {
+    int64_t fixed_tokens = 0;
+    for (const Segment& segment : m_segments) {
+        fixed_tokens += static_cast<int64_t>(segment.core.size());
+    }
+
+    Dictionary stats;
+    stats["slots"] = m_slots.size();
+    stats["fixed_tokens"] = fixed_tokens;
+    stats["prefix_tokens"] = m_segments.empty() ? 0 : static_cast<int64_t>(m_segments[0].core.size());
+    stats["pretokenized"] = m_pretokenized;
+
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    stats["fills"] = m_fills;
+    stats["avg_fill_us"] = m_fills > 0 ? m_fill_ms * 1000.0 / m_fills : 0.0;
+    stats["avg_seam_tokens"] = m_fills > 0 ? static_cast<double>(m_seam_tokens) / m_fills : 0.0;
+    stats["avg_spliced_tokens"] = m_fills > 0 ? static_cast<double>(m_spliced_tokens) / m_fills : 0.0;
+    return stats;
+}
+
+Dictionary LLMPromptTemplate::benchmark(const Dictionary& p_values, int p_iterations) {
+    Dictionary result;
+    if (!is_valid() || !_check_model()) {
+        return result;
+    }
+    p_iterations = std::max(1, p_iterations);
+
+    PackedInt32Array filled;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < p_iterations; i++) {
+        filled = fill(p_values);
+    }
+    double fill_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<int32_t> full;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < p_iterations; i++) {
+        full = m_provider->tokenize(_resolve(p_values), true);
+    }
+    double tokenize_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double fill_us = fill_seconds * 1000000.0 / p_iterations;
+    double tokenize_us = tokenize_seconds * 1000000.0 / p_iterations;
+    result["iterations"] = p_iterations;
+    result["tokens"] = filled.size();
+    result["fill_us"] = fill_us;
+    result["tokenize_us"] = tokenize_us;
+    result["speedup"] = fill_us > 0.0 ? tokenize_us / fill_us : 0.0;
+    result["match"] = std::vector<int32_t>(filled.ptr(), filled.ptr() + filled.size()) == full;
+    result["pretokenized"] = m_pretokenized;
+    return result;
+}
+
+} // namespace godot
@@ -0,0 +1,104 @@
+#ifndef LLM_PROMPT_TEMPLATE_H
+#define LLM_PROMPT_TEMPLATE_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <mutex>
+#include <vector>
+
+namespace godot {
+
+class LlamaCppProvider;
+
+/// A chat prompt with {{name}} slots, compiled once against the loaded model
+/// (LlamaCppProvider::compile_prompt_template). The text between slots is
+/// tokenized at compile time; fill() only tokenizes the slot values together
+/// with the few characters next to each slot whose tokens could merge with
+/// them, and splices in the rest as stored token IDs. The tokens before the
+/// first slot form a fixed prefix that warm() keeps in a context's KV cache.
+///
+/// Segments are cut after a newline that is followed by a non-space
+/// character, which no supported pre-tokenizer merges across. Compilation
+/// checks the spliced tokens against a full tokenization; a template that
+/// does not match falls back to tokenizing the filled text, so fill() always
+/// returns what tokenize() would.
+///
+/// fill() only reads compiled state and can be called from any thread.
+class LLMPromptTemplate : public RefCounted {
+    GDCLASS(LLMPromptTemplate, RefCounted);
+
+protected:
+    static void _bind_methods();
+
+private:
+    // Fixed text between two slots. lead and trail are tokenized together
+    // with the neighbouring slot values; core does not depend on them.
+    struct Segment {
+        String text;
+        String lead;
+        std::vector<int32_t> core;
+        String trail;
+    };
+
+    Ref<LlamaCppProvider> m_provider;
+    String m_model_id;
+    std::vector<Segment> m_segments; // one more than m_slots
+    PackedStringArray m_slots;
+    bool m_pretokenized = false;
+
+    mutable std::mutex m_stats_mutex;
+    int64_t m_fills = 0;
+    int64_t m_seam_tokens = 0;
+    int64_t m_spliced_tokens = 0;
+    double m_fill_ms = 0.0;
+
+    String _resolve(const Dictionary& p_values) const;
+    void _fill_tokens(const Dictionary& p_values, std::vector<int32_t>& r_tokens, int64_t& r_seam_tokens) const;
+    bool _check_model() const;
+
+public:
+    LLMPromptTemplate();
+    ~LLMPromptTemplate();
+
+    /// Called by LlamaCppProvider with the chat-formatted text, slots included
+    void compile(const Ref<LlamaCppProvider>& p_provider, const String& p_model_id, const String& p_text);
+
+    bool is_valid() const;
+    PackedStringArray get_slots() const;
+
+    /// Prompt tokens (with BOS) for the given slot values; missing slots are
+    /// empty. Empty if the provider's model changed since compilation.
+    PackedInt32Array fill(const Dictionary& p_values);
+
+    /// p_params with "prompt_tokens" set, ready for LlamaCppProvider::generate
+    Dictionary make_request(const Dictionary& p_values, const Dictionary& p_params = Dictionary());
+
+    /// The filled prompt as text, as build_prompt-style callers would send it
+    String resolve(const Dictionary& p_values) const;
+
+    /// Tokens before the first slot (the whole prompt if it has no slots)
+    PackedInt32Array get_prefix_tokens() const;
+
+    /// Queue a speculative prefill of the fixed prefix on a context, so the
+    /// next fill() there only evaluates the slots and what follows.
+    /// Returns the speculative request id, or "" if nothing was queued.
+    String warm(const String& p_context = "default");
+
+    /// slots, fixed_tokens, prefix_tokens, pretokenized, fills,
+    /// avg_fill_us, avg_seam_tokens, avg_spliced_tokens
+    Dictionary get_stats() const;
+
+    /// Time p_iterations fills against resolving the same values to text
+    /// and tokenizing it in full. Returns fill_us, tokenize_us, speedup,
+    /// tokens and match (both produce the same tokens).
+    Dictionary benchmark(const Dictionary& p_values, int p_iterations = 100);
+};
+
+} // namespace godot
+
+#endif // LLM_PROMPT_TEMPLATE_H
@@ -0,0 +1,273 @@
+#include "llm_tokenizer.h"
+
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include "llama.h"
+#include "memory_introspection.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace godot {
+
+// Open vocabularies by path; entries expire with their last tokenizer
+static std::mutex s_vocab_mutex;
+static std::map<String, std::weak_ptr<SharedVocab>> s_vocabs;
+
+SharedVocab::~SharedVocab() {
+    if (model != nullptr) {
+        llama_model_free(model);
+    }
+}
+
+void LLMTokenizer::_bind_methods() {
+    ClassDB::bind_static_method("LLMTokenizer", D_METHOD("open", "model_path"), &LLMTokenizer::open);
+    ClassDB::bind_method(D_METHOD("is_open"), &LLMTokenizer::is_open);
+    ClassDB::bind_method(D_METHOD("get_model_path"), &LLMTokenizer::get_model_path);
+    ClassDB::bind_method(D_METHOD("get_vocab_size"), &LLMTokenizer::get_vocab_size);
+    ClassDB::bind_method(D_METHOD("has_tokens", "tokens"), &LLMTokenizer::has_tokens);
+    ClassDB::bind_method(
+        D_METHOD("tokenize", "text", "add_special", "parse_special"),
+        &LLMTokenizer::tokenize, DEFVAL(false), DEFVAL(false)
+    );
+    ClassDB::bind_method(
+        D_METHOD("detokenize", "tokens", "remove_special", "unparse_special"),
+        &LLMTokenizer::detokenize, DEFVAL(false), DEFVAL(false)
+    );
+    ClassDB::bind_method(D_METHOD("detokenize_bytes", "tokens"), &LLMTokenizer::detokenize_bytes);
+    ClassDB::bind_method(D_METHOD("token_to_piece", "token"), &LLMTokenizer::token_to_piece);
+    ClassDB::bind_method(D_METHOD("count_tokens", "text", "add_special"), &LLMTokenizer::count_tokens, DEFVAL(false));
+    ClassDB::bind_method(D_METHOD("get_stats"), &LLMTokenizer::get_stats);
+    ClassDB::bind_method(
+        D_METHOD("benchmark_throughput", "text", "iterations", "threads"),
+        &LLMTokenizer::benchmark_throughput, DEFVAL(20), DEFVAL(1)
+    );
+}
+
+LLMTokenizer::LLMTokenizer() {
+}
+
+LLMTokenizer::~LLMTokenizer() {
+}
+
+Ref<LLMTokenizer> LLMTokenizer::open(const String& p_model_path) {
+    std::lock_guard<std::mutex> lock(s_vocab_mutex);
+
+    std::shared_ptr<SharedVocab> shared = s_vocabs[p_model_path].lock();
+    if (!shared) {
+        if (!FileAccess::file_exists(p_model_path)) {
+            UtilityFunctions::printerr("[LocalLLM] ERROR: Tokenizer model not found: ", p_model_path);
+            s_vocabs.erase(p_model_path);
+            return Ref<LLMTokenizer>();
+        }
+
+        llama_model_params params = llama_model_default_params();
+        params.vocab_only = true;
+
+        int64_t rss_before = read_resident_bytes();
+        auto start = std::chrono::steady_clock::now();
+        CharString path_utf8 = p_model_path.utf8();
+        llama_model* model = llama_model_load_from_file(path_utf8.get_data(), params);
+        auto end = std::chrono::steady_clock::now();
+
+        if (model == nullptr) {
+            UtilityFunctions::printerr("[LocalLLM] ERROR: Failed to load vocabulary from: ", p_model_path);
+            s_vocabs.erase(p_model_path);
+            return Ref<LLMTokenizer>();
+        }
+
+        shared = std::make_shared<SharedVocab>();
+        shared->path = p_model_path;
+        shared->model = model;
+        shared->vocab = llama_model_get_vocab(model);
+        shared->load_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        int64_t rss_after = read_resident_bytes();
+        if (rss_before >= 0 && rss_after >= 0) {
+            shared->rss_delta_bytes = rss_after - rss_before;
+        }
+        s_vocabs[p_model_path] = shared;
+
+        UtilityFunctions::print("[LocalLLM] Tokenizer opened: ", p_model_path.get_file(),
+                                " (", String::num(shared->load_ms, 1), " ms)");
+    }
+
+    Ref<LLMTokenizer> tokenizer;
+    tokenizer.instantiate();
+    tokenizer->m_shared = shared;
+    return tokenizer;
+}
+
+bool LLMTokenizer::is_open() const {
+    return m_shared != nullptr;
+}
+
+String LLMTokenizer::get_model_path() const {
+    return m_shared ? m_shared->path : String();
+}
+
+int LLMTokenizer::get_vocab_size() const {
+    return m_shared ? llama_vocab_n_tokens(m_shared->vocab) : 0;
+}
+
+bool LLMTokenizer::has_tokens(const PackedInt32Array& p_tokens) const {
+    if (!m_shared) {
+        return false;
+    }
+    // llama.cpp does not range-check IDs; an unknown one throws through the C API
+    const int32_t n_vocab = llama_vocab_n_tokens(m_shared->vocab);
+    const int32_t* ids = p_tokens.ptr();
+    for (int64_t i = 0; i < p_tokens.size(); i++) {
+        if (ids[i] < 0 || ids[i] >= n_vocab) {
+            return false;
+        }
+    }
+    return true;
+}
+
+PackedInt32Array LLMTokenizer::tokenize(const String& p_text, bool p_add_special, bool p_parse_special) const {
+    PackedInt32Array tokens;
+    if (!m_shared || p_text.is_empty()) {
+        return tokens;
+    }
+
+    CharString text_utf8 = p_text.utf8();
+    // A token covers at least one byte, so this is almost always enough
+    tokens.resize(text_utf8.length() + 2);
+    int n = llama_tokenize(m_shared->vocab, text_utf8.get_data(), text_utf8.length(),
+                           tokens.ptrw(), tokens.size(), p_add_special, p_parse_special);
+    if (n < 0) {
+        tokens.resize(-n);
+        n = llama_tokenize(m_shared->vocab, text_utf8.get_data(), text_utf8.length(),
+                           tokens.ptrw(), tokens.size(), p_add_special, p_parse_special);
+    }
+    tokens.resize(std::max(n, 0));
+    return tokens;
+}
+
+bool LLMTokenizer::_detokenize(const PackedInt32Array& p_tokens, bool p_remove_special, bool p_unparse_special, std::vector<char>& r_bytes) const {
+    r_bytes.clear();
+    if (!m_shared || p_tokens.is_empty()) {
+        return true;
+    }
+    if (!has_tokens(p_tokens)) {
+        UtilityFunctions::printerr("[LocalLLM] ERROR: Token ID outside the vocabulary of ", m_shared->path);
+        return false;
+    }
+
+    r_bytes.resize(p_tokens.size() * 8 + 16);
+    int32_t n = llama_detokenize(m_shared->vocab, p_tokens.ptr(), p_tokens.size(),
+                                 r_bytes.data(), r_bytes.size(), p_remove_special, p_unparse_special);
+    if (n < 0) {
+        r_bytes.resize(-n);
+        n = llama_detokenize(m_shared->vocab, p_tokens.ptr(), p_tokens.size(),
+                             r_bytes.data(), r_bytes.size(), p_remove_special, p_unparse_special);
+    }
+    r_bytes.resize(std::max(n, 0));
+    return true;
+}
+
+String LLMTokenizer::detokenize(const PackedInt32Array& p_tokens, bool p_remove_special, bool p_unparse_special) const {
+    std::vector<char> bytes;
+    if (!_detokenize(p_tokens, p_remove_special, p_unparse_special, bytes) || bytes.empty()) {
+        return String();
+    }
+    return String::utf8(bytes.data(), bytes.size());
+}
+
+PackedByteArray LLMTokenizer::detokenize_bytes(const PackedInt32Array& p_tokens) const {
+    PackedByteArray result;
+    std::vector<char> bytes;
+    if (_detokenize(p_tokens, false, false, bytes) && !bytes.empty()) {
+        result.resize(bytes.size());
+        memcpy(result.ptrw(), bytes.data(), bytes.size());
+    }
+    return result;
+}
+
+String LLMTokenizer::token_to_piece(int p_token) const {
+    if (!m_shared || p_token < 0 || p_token >= llama_vocab_n_tokens(m_shared->vocab)) {
+        return String();
+    }
+    char buf[256];
+    int n = llama_token_to_piece(m_shared->vocab, p_token, buf, sizeof(buf), 0, true);
+    return n > 0 ? String::utf8(buf, n) : String();
+}
+
+int LLMTokenizer::count_tokens(const String& p_text, bool p_add_special) const {
+    if (!m_shared || p_text.is_empty()) {
+        return 0;
+    }
+    CharString text_utf8 = p_text.utf8();
+    // With no output buffer llama_tokenize returns minus the required size
+    int n = llama_tokenize(m_shared->vocab, text_utf8.get_data(), text_utf8.length(),
+                           nullptr, 0, p_add_special, false);
+    return n < 0 ? -n : n;
+}
+
+Dictionary LLMTokenizer::get_stats() const {
+    Dictionary stats;
+    if (!m_shared) {
+        return stats;
+    }
+    stats["model_path"] = m_shared->path;
+    stats["vocab_size"] = get_vocab_size();
+    stats["load_ms"] = m_shared->load_ms;
+    stats["rss_delta_bytes"] = m_shared->rss_delta_bytes;
+    stats["shared_instances"] = static_cast<int64_t>(m_shared.use_count());
+    return stats;
+}
+
+Dictionary LLMTokenizer::benchmark_throughput(const String& p_text, int p_iterations, int p_threads) const {
+    Dictionary result;
+    if (!m_shared || p_text.is_empty()) {
+        return result;
+    }
+    p_iterations = std::max(1, p_iterations);
+    p_threads = std::max(1, p_threads);
+
+    CharString text_utf8 = p_text.utf8();
+    const llama_vocab* vocab = m_shared->vocab;
+    std::vector<int64_t> counts(p_threads, 0);
+
+    auto run = [&](int p_index) {
+        std::vector<llama_token> tokens(text_utf8.length() + 2);
+        for (int i = 0; i < p_iterations; i++) {
+            int n = llama_tokenize(vocab, text_utf8.get_data(), text_utf8.length(),
+                                   tokens.data(), tokens.size(), false, false);
+            counts[p_index] += std::max(n, 0);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 1; t < p_threads; t++) {
+        threads.emplace_back(run, t);
+    }
+    run(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int64_t total_tokens = 0;
+    for (int64_t count : counts) {
+        total_tokens += count;
+    }
+    int64_t total_bytes = static_cast<int64_t>(text_utf8.length()) * p_iterations * p_threads;
+
+    result["threads"] = p_threads;
+    result["tokens"] = total_tokens;
+    result["bytes"] = total_bytes;
+    result["seconds"] = seconds;
+    result["tokens_per_second"] = seconds > 0.0 ? total_tokens / seconds : 0.0;
+    result["mb_per_second"] = seconds > 0.0 ? total_bytes / seconds / (1024.0 * 1024.0) : 0.0;
+    return result;
+}
+
+} // namespace godot
@@ -0,0 +1,88 @@
+#ifndef LLM_TOKENIZER_H
+#define LLM_TOKENIZER_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <memory>
+#include <vector>
+
+struct llama_model;
+struct llama_vocab;
+
+namespace godot {
+
+/// Vocabulary of one GGUF file, loaded with vocab_only (no weights, no
+/// context). Shared by every LLMTokenizer opened on the same path.
+struct SharedVocab {
+    String path;
+    llama_model* model = nullptr;
+    const llama_vocab* vocab = nullptr;
+    double load_ms = 0.0;
+    int64_t rss_delta_bytes = -1;
+
+    ~SharedVocab();
+};
+
+/// Token counting and (de)tokenization without loading model weights, for
+/// exact context budgeting before or without load_model().
+///
+/// Tokenizing only reads the vocabulary, so one instance can be used from
+/// any number of threads at once (WorkerThreadPool tasks, Thread, ...).
+class LLMTokenizer : public RefCounted {
+    GDCLASS(LLMTokenizer, RefCounted);
+
+protected:
+    static void _bind_methods();
+
+private:
+    std::shared_ptr<SharedVocab> m_shared;
+
+    // llama_detokenize into r_bytes; false if any ID is outside the vocabulary
+    bool _detokenize(const PackedInt32Array& p_tokens, bool p_remove_special, bool p_unparse_special, std::vector<char>& r_bytes) const;
+
+public:
+    LLMTokenizer();
+    ~LLMTokenizer();
+
+    /// Open the vocabulary of a GGUF model. Reuses an already open one for
+    /// the same path. Returns null on failure.
+    static Ref<LLMTokenizer> open(const String& p_model_path);
+
+    bool is_open() const;
+    String get_model_path() const;
+    int get_vocab_size() const;
+
+    /// True if every ID is inside this vocabulary. IDs from elsewhere (a
+    /// server running another model) must be checked before decoding.
+    bool has_tokens(const PackedInt32Array& p_tokens) const;
+
+    PackedInt32Array tokenize(const String& p_text, bool p_add_special = false, bool p_parse_special = false) const;
+    /// Empty if any ID is outside the vocabulary (see has_tokens)
+    String detokenize(const PackedInt32Array& p_tokens, bool p_remove_special = false, bool p_unparse_special = false) const;
+    /// UTF-8 bytes of the tokens, for decoding a stream a few tokens at a
+    /// time: a character can end in a later call's bytes. Empty if any ID
+    /// is outside the vocabulary.
+    PackedByteArray detokenize_bytes(const PackedInt32Array& p_tokens) const;
+    /// Empty if any ID is outside the vocabulary
+    String token_to_piece(int p_token) const;
+
+    /// Exact token count without allocating the token array
+    int count_tokens(const String& p_text, bool p_add_special = false) const;
+
+    /// load_ms, rss_delta_bytes (-1 if unknown), vocab_size, shared_instances
+    Dictionary get_stats() const;
+
+    /// Tokenize p_text p_iterations times on each of p_threads threads
+    /// sharing this instance. Returns tokens_per_second, mb_per_second,
+    /// tokens, bytes, seconds, threads.
+    Dictionary benchmark_throughput(const String& p_text, int p_iterations = 20, int p_threads = 1) const;
+};
+
+} // namespace godot
+
+#endif // LLM_TOKENIZER_H
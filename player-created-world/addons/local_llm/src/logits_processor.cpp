@@ -0,0 +1,319 @@
+#include "logits_processor.h"
+
+#include "llama.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace godot {
+
+std::mutex LogitsProcessorRegistry::s_mutex;
+std::map<std::string, LogitsProcessorFactory> LogitsProcessorRegistry::s_factories;
+
+void LogitsProcessor::ban_token(llama_token_data_array* r_candidates, int32_t p_token) {
+    // The sampler chain hands us the full vocabulary in id order, so the
+    // candidate for a token is normally at its own index
+    if (p_token >= 0 && static_cast<size_t>(p_token) < r_candidates->size &&
+            r_candidates->data[p_token].id == p_token) {
+        r_candidates->data[p_token].logit = -INFINITY;
+        return;
+    }
+    // A restricted vocabulary is a sorted subset
+    llama_token_data* end = r_candidates->data + r_candidates->size;
+    llama_token_data* found = std::lower_bound(r_candidates->data, end, p_token,
+        [](const llama_token_data& p_candidate, int32_t p_id) { return p_candidate.id < p_id; });
+    if (found != end && found->id == p_token) {
+        found->logit = -INFINITY;
+    }
+}
+
+// ============================================================================
+// Built-in: ban_strings
+// ============================================================================
+
+/// Never emits any of the given strings, even when they would be split
+/// across several tokens. Args: { "strings": PackedStringArray }
+class BanStringsProcessor : public LogitsProcessor {
+public:
+    struct Pattern {
+        std::string text;
+        /// completions[k]: tokens whose text starts with text[k..], i.e. the
+        /// tokens that finish the pattern when the output ends with text[0..k)
+        std::vector<std::vector<int32_t>> completions;
+    };
+
+    BanStringsProcessor(const std::vector<std::string>& p_strings, const std::vector<std::string>& p_pieces)
+        : m_pieces(p_pieces) {
+        for (const std::string& text : p_strings) {
+            Pattern pattern;
+            pattern.text = text;
+            pattern.completions.resize(text.size());
+            m_patterns.push_back(std::move(pattern));
+            m_tail_max = std::max(m_tail_max, text.size() - 1);
+        }
+
+        for (size_t id = 0; id < p_pieces.size(); id++) {
+            const std::string& piece = p_pieces[id];
+            if (piece.empty()) {
+                continue;
+            }
+            for (Pattern& pattern : m_patterns) {
+                const std::string& text = pattern.text;
+                if (piece.find(text) != std::string::npos) {
+                    m_always.push_back(static_cast<int32_t>(id));
+                    break;
+                }
+                for (size_t k = 1; k < text.size(); k++) {
+                    size_t rest = text.size() - k;
+                    if (piece.size() >= rest && piece.compare(0, rest, text, k, rest) == 0) {
+                        pattern.completions[k].push_back(static_cast<int32_t>(id));
+                    }
+                }
+            }
+        }
+    }
+
+    void apply(llama_token_data_array* r_candidates) override {
+        for (int32_t id : m_always) {
+            ban_token(r_candidates, id);
+        }
+        for (const Pattern& pattern : m_patterns) {
+            const std::string& text = pattern.text;
+            for (size_t k = 1; k < text.size() && k <= m_tail.size(); k++) {
+                if (m_tail.compare(m_tail.size() - k, k, text, 0, k) != 0) {
+                    continue;
+                }
+                for (int32_t id : pattern.completions[k]) {
+                    ban_token(r_candidates, id);
+                }
+            }
+        }
+    }
+
+    void accept(int32_t p_token) override {
+        if (p_token < 0 || static_cast<size_t>(p_token) >= m_pieces.size()) {
+            return;
+        }
+        m_tail += m_pieces[p_token];
+        if (m_tail.size() > m_tail_max) {
+            m_tail.erase(0, m_tail.size() - m_tail_max);
+        }
+    }
+
+private:
+    const std::vector<std::string>& m_pieces;
+    std::vector<Pattern> m_patterns;
+    std::vector<int32_t> m_always;
+    std::string m_tail;
+    size_t m_tail_max = 0;
+};
+
+static std::unique_ptr<LogitsProcessor> create_ban_strings(
+    const Dictionary& p_args,
+    const LogitsProcessorContext& p_context,
+    String& r_error
+) {
+    PackedStringArray strings = p_args.get("strings", PackedStringArray());
+    std::vector<std::string> texts;
+    for (int i = 0; i < strings.size(); i++) {
+        CharString utf8 = strings[i].utf8();
+        if (utf8.length() > 0) {
+            texts.emplace_back(utf8.get_data(), utf8.length());
+        }
+    }
+    if (texts.empty()) {
+        r_error = "ban_strings: 'strings' must contain at least one non-empty string";
+        return nullptr;
+    }
+    return std::make_unique<BanStringsProcessor>(texts, *p_context.pieces);
+}
+
+// ============================================================================
+// Built-in: max_number_length
+// ============================================================================
+
+/// Caps runs of ASCII digits in the output. Args: { "digits": int }
+class MaxNumberLengthProcessor : public LogitsProcessor {
+public:
+    MaxNumberLengthProcessor(int p_max_digits, const std::vector<std::string>& p_pieces)
+        : m_max_digits(p_max_digits) {
+        m_leading.resize(p_pieces.size(), 0);
+        m_trailing.resize(p_pieces.size(), 0);
+        m_all_digits.resize(p_pieces.size(), 0);
+
+        for (size_t id = 0; id < p_pieces.size(); id++) {
+            const std::string& piece = p_pieces[id];
+            size_t lead = 0;
+            while (lead < piece.size() && piece[lead] >= '0' && piece[lead] <= '9') {
+                lead++;
+            }
+            size_t trail = 0;
+            while (trail < piece.size() && piece[piece.size() - 1 - trail] >= '0' && piece[piece.size() - 1 - trail] <= '9') {
+                trail++;
+            }
+            m_leading[id] = static_cast<uint16_t>(lead);
+            m_trailing[id] = static_cast<uint16_t>(trail);
+            m_all_digits[id] = !piece.empty() && lead == piece.size();
+            if (lead > 0) {
+                m_digit_tokens.push_back(static_cast<int32_t>(id));
+            }
+        }
+    }
+
+    void apply(llama_token_data_array* r_candidates) override {
+        // Only tokens that start with a digit can extend the current run
+        for (int32_t id : m_digit_tokens) {
+            if (m_run + m_leading[id] > m_max_digits) {
+                ban_token(r_candidates, id);
+            }
+        }
+    }
+
+    void accept(int32_t p_token) override {
+        if (p_token < 0 || static_cast<size_t>(p_token) >= m_leading.size()) {
+            return;
+        }
+        if (m_all_digits[p_token]) {
+            m_run += m_leading[p_token];
+        } else {
+            m_run = m_trailing[p_token];
+        }
+    }
+
+private:
+    int m_max_digits;
+    int m_run = 0;
+    std::vector<uint16_t> m_leading;
+    std::vector<uint16_t> m_trailing;
+    std::vector<uint8_t> m_all_digits;
+    std::vector<int32_t> m_digit_tokens;
+};
+
+static std::unique_ptr<LogitsProcessor> create_max_number_length(
+    const Dictionary& p_args,
+    const LogitsProcessorContext& p_context,
+    String& r_error
+) {
+    int digits = p_args.get("digits", 0);
+    if (digits <= 0) {
+        r_error = "max_number_length: 'digits' must be positive";
+        return nullptr;
+    }
+    return std::make_unique<MaxNumberLengthProcessor>(digits, *p_context.pieces);
+}
+
+// ============================================================================
+// Sampler bridge
+// ============================================================================
+
+struct ProcessorSamplerContext {
+    std::unique_ptr<LogitsProcessor> processor;
+    LogitsProcessorTiming* timing = nullptr;
+    std::string name;
+};
+
+static const char* processor_sampler_name(const llama_sampler* p_sampler) {
+    return static_cast<const ProcessorSamplerContext*>(p_sampler->ctx)->name.c_str();
+}
+
+static void processor_sampler_accept(llama_sampler* p_sampler, llama_token p_token) {
+    static_cast<ProcessorSamplerContext*>(p_sampler->ctx)->processor->accept(p_token);
+}
+
+static void processor_sampler_apply(llama_sampler* p_sampler, llama_token_data_array* r_candidates) {
+    ProcessorSamplerContext* ctx = static_cast<ProcessorSamplerContext*>(p_sampler->ctx);
+    auto start = std::chrono::steady_clock::now();
+    ctx->processor->apply(r_candidates);
+    if (ctx->timing != nullptr) {
+        ctx->timing->total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        ctx->timing->tokens++;
+    }
+}
+
+static void processor_sampler_free(llama_sampler* p_sampler) {
+    delete static_cast<ProcessorSamplerContext*>(p_sampler->ctx);
+}
+
+static const llama_sampler_i* processor_sampler_iface() {
+    // Assigned by name so new optional hooks in llama_sampler_i stay null
+    static const llama_sampler_i iface = [] {
+        llama_sampler_i i = {};
+        i.name = processor_sampler_name;
+        i.accept = processor_sampler_accept;
+        i.apply = processor_sampler_apply;
+        i.free = processor_sampler_free;
+        return i;
+    }();
+    return &iface;
+}
+
+// ============================================================================
+// Registry
+// ============================================================================
+
+void LogitsProcessorRegistry::register_processor(const String& p_name, LogitsProcessorFactory p_factory) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_factories[p_name.utf8().get_data()] = std::move(p_factory);
+}
+
+void LogitsProcessorRegistry::unregister_processor(const String& p_name) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_factories.erase(p_name.utf8().get_data());
+}
+
+bool LogitsProcessorRegistry::has_processor(const String& p_name) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_factories.count(p_name.utf8().get_data()) > 0;
+}
+
+PackedStringArray LogitsProcessorRegistry::get_processor_names() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    PackedStringArray names;
+    for (const auto& entry : s_factories) {
+        names.push_back(String::utf8(entry.first.c_str()));
+    }
+    return names;
+}
+
+std::unique_ptr<LogitsProcessor> LogitsProcessorRegistry::create(
+    const String& p_name,
+    const Dictionary& p_args,
+    const LogitsProcessorContext& p_context,
+    String& r_error
+) {
+    LogitsProcessorFactory factory;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto it = s_factories.find(p_name.utf8().get_data());
+        if (it == s_factories.end()) {
+            r_error = "Unknown logits processor: " + p_name;
+            return nullptr;
+        }
+        factory = it->second;
+    }
+    return factory(p_args, p_context, r_error);
+}
+
+llama_sampler* LogitsProcessorRegistry::create_sampler(std::unique_ptr<LogitsProcessor> p_processor, LogitsProcessorTiming* r_timing) {
+    ProcessorSamplerContext* ctx = new ProcessorSamplerContext();
+    ctx->processor = std::move(p_processor);
+    ctx->timing = r_timing;
+    if (r_timing != nullptr) {
+        ctx->name = r_timing->name.utf8().get_data();
+    }
+    return llama_sampler_init(processor_sampler_iface(), ctx);
+}
+
+void LogitsProcessorRegistry::register_builtin_processors() {
+    register_processor("ban_strings", create_ban_strings);
+    register_processor("max_number_length", create_max_number_length);
+}
+
+void LogitsProcessorRegistry::clear() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_factories.clear();
+}
+
+} // namespace godot
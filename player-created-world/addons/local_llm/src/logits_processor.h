@@ -0,0 +1,97 @@
+#ifndef LOGITS_PROCESSOR_H
+#define LOGITS_PROCESSOR_H
+
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Forward declarations for llama.cpp
+struct llama_vocab;
+struct llama_sampler;
+struct llama_token_data_array;
+
+namespace godot {
+
+/// What a processor factory gets to know about the loaded model.
+struct LogitsProcessorContext {
+    const llama_vocab* vocab = nullptr;
+    /// UTF-8 text of every token id, indexed by token id
+    const std::vector<std::string>* pieces = nullptr;
+};
+
+/// A game-specific sampling constraint. One instance is created per request
+/// and runs inside the worker's sampling step, before top-k/top-p/temperature,
+/// so constraints are never defeated by truncation.
+class LogitsProcessor {
+public:
+    virtual ~LogitsProcessor() = default;
+
+    /// Adjust candidate logits for the next token. Set a logit to -INFINITY
+    /// to ban a token. Candidates are in token-id order when this runs: the
+    /// whole vocabulary, or a sorted subset for restricted-vocabulary requests.
+    virtual void apply(llama_token_data_array* r_candidates) = 0;
+
+    /// Called with every token accepted into the output.
+    virtual void accept(int32_t p_token) { (void)p_token; }
+
+protected:
+    /// Ban one token, using the token-id order fast path when it holds
+    static void ban_token(llama_token_data_array* r_candidates, int32_t p_token);
+};
+
+/// Builds a processor from the arguments given in the request. Returns
+/// nullptr and sets r_error if the arguments are invalid.
+using LogitsProcessorFactory = std::function<std::unique_ptr<LogitsProcessor>(
+    const Dictionary& p_args,
+    const LogitsProcessorContext& p_context,
+    String& r_error
+)>;
+
+/// Per-processor timing collected while a request runs.
+struct LogitsProcessorTiming {
+    String name;
+    int64_t total_ns = 0;
+    int64_t tokens = 0;
+};
+
+/// Process-wide registry of named logits processors. Requests reference
+/// processors by name in "logits_processors"; native code adds its own with
+/// register_processor() from initialize_local_llm_module().
+class LogitsProcessorRegistry {
+public:
+    static void register_processor(const String& p_name, LogitsProcessorFactory p_factory);
+    static void unregister_processor(const String& p_name);
+    static bool has_processor(const String& p_name);
+    static PackedStringArray get_processor_names();
+
+    static std::unique_ptr<LogitsProcessor> create(
+        const String& p_name,
+        const Dictionary& p_args,
+        const LogitsProcessorContext& p_context,
+        String& r_error
+    );
+
+    /// Wrap a processor as a llama.cpp sampler. The sampler owns the
+    /// processor; r_timing must outlive it.
+    static llama_sampler* create_sampler(std::unique_ptr<LogitsProcessor> p_processor, LogitsProcessorTiming* r_timing);
+
+    /// Built-ins: "ban_strings" and "max_number_length"
+    static void register_builtin_processors();
+    static void clear();
+
+private:
+    static std::mutex s_mutex;
+    static std::map<std::string, LogitsProcessorFactory> s_factories;
+};
+
+} // namespace godot
+
+#endif // LOGITS_PROCESSOR_H
@@ -0,0 +1,127 @@
+#include "memory_introspection.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__linux__)
+#include <climits>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace godot {
+
+#if defined(__linux__)
+// mincore() scratch is bounded by checking large mappings in slices
+static const size_t MINCORE_SLICE_PAGES = 64 * 1024;
+#endif
+
+ProcessMemoryUsage read_process_memory_usage() {
+    ProcessMemoryUsage usage;
+#if defined(__linux__)
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+    if (f == nullptr) {
+        // Kernels before 4.14 only have statm
+        usage.rss = read_resident_bytes();
+        return usage;
+    }
+    struct Field {
+        const char* key;
+        int64_t* value;
+    };
+    const Field fields[] = {
+        { "Rss:", &usage.rss },
+        { "Pss:", &usage.pss },
+        { "Pss_Anon:", &usage.pss_anon },
+        { "Pss_File:", &usage.pss_file },
+        { "Swap:", &usage.swap },
+    };
+    char line[256];
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        for (const Field& field : fields) {
+            size_t key_len = strlen(field.key);
+            if (strncmp(line, field.key, key_len) == 0) {
+                long long kb = 0;
+                if (sscanf(line + key_len, "%lld", &kb) == 1) {
+                    *field.value = static_cast<int64_t>(kb) * 1024;
+                }
+                break;
+            }
+        }
+    }
+    fclose(f);
+#endif
+    return usage;
+}
+
+int64_t read_resident_bytes() {
+#if defined(__linux__)
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f == nullptr) {
+        return -1;
+    }
+    long pages_total = 0;
+    long pages_resident = 0;
+    int n = fscanf(f, "%ld %ld", &pages_total, &pages_resident);
+    fclose(f);
+    return n == 2 ? static_cast<int64_t>(pages_resident) * sysconf(_SC_PAGESIZE) : -1;
+#else
+    return -1;
+#endif
+}
+
+MappedFileResidency query_mapped_file_residency(const String& p_path) {
+    MappedFileResidency residency;
+#if defined(__linux__)
+    // /proc/self/maps lists canonical paths
+    char resolved[PATH_MAX];
+    CharString path_utf8 = p_path.utf8();
+    if (realpath(path_utf8.get_data(), resolved) == nullptr) {
+        return residency;
+    }
+    
+    FILE* f = fopen("/proc/self/maps", "r");
+    if (f == nullptr) {
+        return residency;
+    }
+    
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> pages;
+    char line[PATH_MAX + 256];
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        unsigned long start = 0;
+        unsigned long end = 0;
+        int path_pos = 0;
+        if (sscanf(line, "%lx-%lx %*s %*s %*s %*s %n", &start, &end, &path_pos) < 2 || path_pos == 0) {
+            continue;
+        }
+        char* path = line + path_pos;
+        path[strcspn(path, "\n")] = '\0';
+        if (strcmp(path, resolved) != 0) {
+            continue;
+        }
+        
+        residency.mappings++;
+        residency.mapped += static_cast<int64_t>(end - start);
+        for (unsigned long addr = start; addr < end; addr += MINCORE_SLICE_PAGES * page_size) {
+            size_t len = std::min<size_t>(end - addr, MINCORE_SLICE_PAGES * page_size);
+            pages.resize((len + page_size - 1) / page_size);
+            if (mincore(reinterpret_cast<void*>(addr), len, pages.data()) != 0) {
+                continue;
+            }
+            for (unsigned char page : pages) {
+                if (page & 1) {
+                    residency.resident += static_cast<int64_t>(page_size);
+                }
+            }
+        }
+    }
+    fclose(f);
+#endif
+    return residency;
+}
+
+} // namespace godot
@@ -0,0 +1,42 @@
+#ifndef MEMORY_INTROSPECTION_H
+#define MEMORY_INTROSPECTION_H
+
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+
+namespace godot {
+
+/// Memory of this process as the kernel accounts it. PSS splits shared
+/// pages (e.g. a model file mapped by several processes) between their
+/// users. Fields are -1 where the platform does not report them.
+struct ProcessMemoryUsage {
+    int64_t rss = -1;
+    int64_t pss = -1;
+    int64_t pss_anon = -1;
+    int64_t pss_file = -1;
+    int64_t swap = -1;
+};
+
+/// How much of a file is mapped into this process and how much of that is
+/// currently resident in RAM (the rest faults in from disk on access).
+struct MappedFileResidency {
+    int64_t mapped = 0;
+    int64_t resident = 0;
+    int mappings = 0;
+};
+
+/// Read /proc/self/smaps_rollup (Linux). A single pass in the kernel; cheap
+/// enough to call every second.
+ProcessMemoryUsage read_process_memory_usage();
+
+/// Resident bytes only, from /proc/self/statm. Cheaper than the above.
+int64_t read_resident_bytes();
+
+/// Find every mapping of p_path in /proc/self/maps and count its resident
+/// pages with mincore(). Costs one bit of scratch per page of the file.
+MappedFileResidency query_mapped_file_residency(const String& p_path);
+
+} // namespace godot
+
+#endif // MEMORY_INTROSPECTION_H
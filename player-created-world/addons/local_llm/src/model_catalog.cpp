@@ -0,0 +1,470 @@
+#include "model_catalog.h"
+
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include "gguf_header.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define LOCAL_LLM_POSIX_STAT 1
+#endif
+
+namespace godot {
+
+// Catalog file layout: magic, entry count, then one record per entry.
+// Bump the magic whenever a record field is added.
+static const char CATALOG_MAGIC[8] = { 'L', 'L', 'M', 'C', 'A', 'T', '0', '1' };
+
+// Initial header read; doubled until the whole GGUF header fits
+static const uint64_t CATALOG_HEADER_BYTES = 2 * 1024 * 1024;
+
+static const int CATALOG_MAX_THREADS = 8;
+
+// general.file_type values (llama_ftype) as quantization names
+static const char* FILE_TYPE_NAMES[] = {
+    "F32", "F16", "Q4_0", "Q4_1", nullptr, nullptr, nullptr, "Q8_0", "Q5_0", "Q5_1",
+    "Q2_K", "Q3_K_S", "Q3_K_M", "Q3_K_L", "Q4_K_S", "Q4_K_M", "Q5_K_S", "Q5_K_M", "Q6_K", "IQ2_XXS",
+    "IQ2_XS", "Q2_K_S", "IQ3_XS", "IQ3_XXS", "IQ1_S", "IQ4_NL", "IQ3_S", "IQ3_M", "IQ2_S", "IQ2_M",
+    "IQ4_XS", "IQ1_M", "BF16",
+};
+
+static String file_type_name(uint32_t p_file_type) {
+    if (p_file_type < sizeof(FILE_TYPE_NAMES) / sizeof(FILE_TYPE_NAMES[0]) && FILE_TYPE_NAMES[p_file_type] != nullptr) {
+        return FILE_TYPE_NAMES[p_file_type];
+    }
+    return "unknown";
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point p_since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - p_since).count();
+}
+
+// ============================================================================
+// Record encoding
+// ============================================================================
+
+class CatalogWriter {
+public:
+    template <typename T>
+    void write(const T& p_value) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&p_value);
+        m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+    }
+
+    void write_string(const std::string& p_value) {
+        write(static_cast<uint32_t>(p_value.size()));
+        m_data.insert(m_data.end(), p_value.begin(), p_value.end());
+    }
+
+    const std::vector<uint8_t>& data() const { return m_data; }
+
+private:
+    std::vector<uint8_t> m_data;
+};
+
+// Bounds-checked; any short read leaves the reader failed
+class CatalogReader {
+public:
+    CatalogReader(const uint8_t* p_data, size_t p_size) : m_data(p_data), m_size(p_size) {}
+
+    template <typename T>
+    bool read(T& r_value) {
+        if (m_failed || m_pos + sizeof(T) > m_size) {
+            m_failed = true;
+            return false;
+        }
+        std::memcpy(&r_value, m_data + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return true;
+    }
+
+    bool read_string(std::string& r_value) {
+        uint32_t len = 0;
+        if (!read(len) || m_pos + len > m_size) {
+            m_failed = true;
+            return false;
+        }
+        r_value.assign(reinterpret_cast<const char*>(m_data + m_pos), len);
+        m_pos += len;
+        return true;
+    }
+
+    bool failed() const { return m_failed; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+    bool m_failed = false;
+};
+
+static void write_entry(CatalogWriter& p_writer, const ModelCatalogEntry& p_entry) {
+    p_writer.write_string(p_entry.path);
+    p_writer.write(p_entry.size);
+    p_writer.write(p_entry.mtime_ns);
+    p_writer.write(p_entry.inode);
+    p_writer.write(static_cast<uint8_t>(p_entry.valid));
+    if (!p_entry.valid) {
+        p_writer.write_string(p_entry.error);
+        return;
+    }
+    p_writer.write(p_entry.gguf_version);
+    p_writer.write(p_entry.tensor_count);
+    p_writer.write(p_entry.data_offset);
+    p_writer.write(p_entry.metadata_count);
+    p_writer.write_string(p_entry.architecture);
+    p_writer.write_string(p_entry.name);
+    p_writer.write(p_entry.file_type);
+    p_writer.write(p_entry.context_length);
+    p_writer.write(p_entry.block_count);
+    p_writer.write(p_entry.embedding_length);
+    p_writer.write(p_entry.head_count);
+    p_writer.write(p_entry.head_count_kv);
+    p_writer.write(p_entry.vocab_size);
+}
+
+static bool read_entry(CatalogReader& p_reader, ModelCatalogEntry& r_entry) {
+    uint8_t valid = 0;
+    p_reader.read_string(r_entry.path);
+    p_reader.read(r_entry.size);
+    p_reader.read(r_entry.mtime_ns);
+    p_reader.read(r_entry.inode);
+    p_reader.read(valid);
+    r_entry.valid = valid != 0;
+    if (!r_entry.valid) {
+        p_reader.read_string(r_entry.error);
+        return !p_reader.failed();
+    }
+    p_reader.read(r_entry.gguf_version);
+    p_reader.read(r_entry.tensor_count);
+    p_reader.read(r_entry.data_offset);
+    p_reader.read(r_entry.metadata_count);
+    p_reader.read_string(r_entry.architecture);
+    p_reader.read_string(r_entry.name);
+    p_reader.read(r_entry.file_type);
+    p_reader.read(r_entry.context_length);
+    p_reader.read(r_entry.block_count);
+    p_reader.read(r_entry.embedding_length);
+    p_reader.read(r_entry.head_count);
+    p_reader.read(r_entry.head_count_kv);
+    p_reader.read(r_entry.vocab_size);
+    return !p_reader.failed();
+}
+
+// ============================================================================
+// LLMModelCatalog
+// ============================================================================
+
+void LLMModelCatalog::_bind_methods() {
+    ClassDB::bind_method(
+        D_METHOD("scan", "paths", "catalog_path", "n_threads"),
+        &LLMModelCatalog::scan, DEFVAL(0)
+    );
+    ClassDB::bind_method(D_METHOD("get_entry", "path"), &LLMModelCatalog::get_entry);
+    ClassDB::bind_method(D_METHOD("get_entries"), &LLMModelCatalog::get_entries);
+    ClassDB::bind_method(D_METHOD("get_stats"), &LLMModelCatalog::get_stats);
+}
+
+LLMModelCatalog::LLMModelCatalog() {
+}
+
+LLMModelCatalog::~LLMModelCatalog() {
+}
+
+bool LLMModelCatalog::_stat_file(const std::string& p_path, ModelCatalogEntry& r_entry) {
+#ifdef LOCAL_LLM_POSIX_STAT
+    struct stat st;
+    if (stat(p_path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    r_entry.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+    r_entry.mtime_ns = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    r_entry.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    r_entry.inode = static_cast<uint64_t>(st.st_ino);
+    return true;
+#else
+    // No inode here; size and mtime (seconds) still catch replaced files
+    String path = String::utf8(p_path.c_str());
+    Ref<FileAccess> file = FileAccess::open(path, FileAccess::READ);
+    if (file.is_null()) {
+        return false;
+    }
+    r_entry.size = file->get_length();
+    r_entry.mtime_ns = static_cast<int64_t>(FileAccess::get_modified_time(path)) * 1000000000;
+    r_entry.inode = 0;
+    return true;
+#endif
+}
+
+void LLMModelCatalog::_read_header(ModelCatalogEntry& r_entry) {
+    r_entry.valid = false;
+    Ref<FileAccess> file = FileAccess::open(String::utf8(r_entry.path.c_str()), FileAccess::READ);
+    if (file.is_null()) {
+        r_entry.error = "Failed to open file";
+        return;
+    }
+
+    GGUFHeader header;
+    String error;
+    uint64_t want = std::min<uint64_t>(CATALOG_HEADER_BYTES, r_entry.size);
+    std::vector<uint8_t> buffer;
+    while (true) {
+        // Only the bytes beyond what was already read are fetched
+        size_t have = buffer.size();
+        buffer.resize(want);
+        file->seek(have);
+        if (file->get_buffer(buffer.data() + have, want - have) != want - have) {
+            r_entry.error = "Failed to read header";
+            return;
+        }
+
+        GGUFParseResult result = parse_gguf_header(buffer.data(), want, r_entry.size, header, error);
+        if (result == GGUF_PARSE_OK) {
+            break;
+        }
+        if (result == GGUF_PARSE_INVALID || want == r_entry.size) {
+            r_entry.error = (error.is_empty() ? String("Truncated GGUF header") : error).utf8().get_data();
+            return;
+        }
+        if (want >= GGUF_MAX_HEADER_BYTES) {
+            r_entry.error = "GGUF header too large";
+            return;
+        }
+        want = std::min<uint64_t>({ want * 2, r_entry.size, GGUF_MAX_HEADER_BYTES });
+    }
+
+    const Dictionary& metadata = header.metadata;
+    String architecture = metadata.get("general.architecture", "");
+    auto arch_value = [&](const char* p_key) -> uint32_t {
+        return static_cast<uint32_t>(static_cast<int64_t>(metadata.get(architecture + "." + p_key, 0)));
+    };
+
+    r_entry.valid = true;
+    r_entry.gguf_version = header.version;
+    r_entry.tensor_count = header.tensors.size();
+    r_entry.data_offset = header.data_offset;
+    r_entry.metadata_count = metadata.size();
+    r_entry.architecture = architecture.utf8().get_data();
+    r_entry.name = String(metadata.get("general.name", "")).utf8().get_data();
+    r_entry.file_type = static_cast<uint32_t>(static_cast<int64_t>(metadata.get("general.file_type", -1)));
+    r_entry.context_length = arch_value("context_length");
+    r_entry.block_count = arch_value("block_count");
+    r_entry.embedding_length = arch_value("embedding_length");
+    r_entry.head_count = arch_value("attention.head_count");
+    r_entry.head_count_kv = arch_value("attention.head_count_kv");
+    // Arrays are recorded as their length
+    r_entry.vocab_size = static_cast<uint32_t>(static_cast<int64_t>(metadata.get("tokenizer.ggml.tokens", 0)));
+}
+
+bool LLMModelCatalog::_load_catalog(const String& p_catalog_path, std::vector<ModelCatalogEntry>& r_entries) {
+    if (p_catalog_path.is_empty() || !FileAccess::file_exists(p_catalog_path)) {
+        return false;
+    }
+    Ref<FileAccess> file = FileAccess::open(p_catalog_path, FileAccess::READ);
+    if (file.is_null()) {
+        return false;
+    }
+    std::vector<uint8_t> data(file->get_length());
+    if (file->get_buffer(data.data(), data.size()) != data.size()) {
+        return false;
+    }
+
+    CatalogReader reader(data.data(), data.size());
+    char magic[sizeof(CATALOG_MAGIC)] = {};
+    uint32_t count = 0;
+    reader.read(magic);
+    reader.read(count);
+    if (reader.failed() || std::memcmp(magic, CATALOG_MAGIC, sizeof(magic)) != 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        ModelCatalogEntry entry;
+        if (!read_entry(reader, entry)) {
+            // A damaged catalog is rebuilt from scratch
+            r_entries.clear();
+            return false;
+        }
+        r_entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+int64_t LLMModelCatalog::_save_catalog(const String& p_catalog_path, const std::vector<ModelCatalogEntry>& p_entries) {
+    CatalogWriter writer;
+    writer.write(CATALOG_MAGIC);
+    writer.write(static_cast<uint32_t>(p_entries.size()));
+    for (const ModelCatalogEntry& entry : p_entries) {
+        write_entry(writer, entry);
+    }
+
+    Ref<FileAccess> file = FileAccess::open(p_catalog_path, FileAccess::WRITE);
+    if (file.is_null() || !file->store_buffer(writer.data().data(), writer.data().size())) {
+        return -1;
+    }
+    return static_cast<int64_t>(writer.data().size());
+}
+
+Dictionary LLMModelCatalog::_entry_to_dict(const ModelCatalogEntry& p_entry) {
+    Dictionary result;
+    if (!p_entry.valid) {
+        result["error"] = String::utf8(p_entry.error.c_str());
+        return result;
+    }
+    result["size_bytes"] = static_cast<int64_t>(p_entry.size);
+    result["gguf_version"] = p_entry.gguf_version;
+    result["tensor_count"] = static_cast<int64_t>(p_entry.tensor_count);
+    result["tensor_bytes"] = static_cast<int64_t>(p_entry.size - std::min(p_entry.data_offset, p_entry.size));
+    result["metadata_count"] = static_cast<int64_t>(p_entry.metadata_count);
+    result["architecture"] = String::utf8(p_entry.architecture.c_str());
+    result["name"] = String::utf8(p_entry.name.c_str());
+    result["quantization"] = file_type_name(p_entry.file_type);
+    result["context_length"] = p_entry.context_length;
+    result["block_count"] = p_entry.block_count;
+    result["embedding_length"] = p_entry.embedding_length;
+    result["head_count"] = p_entry.head_count;
+    result["head_count_kv"] = p_entry.head_count_kv;
+    result["vocab_size"] = p_entry.vocab_size;
+    return result;
+}
+
+Dictionary LLMModelCatalog::scan(const PackedStringArray& p_paths, const String& p_catalog_path, int p_n_threads) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Warm path: read the catalog and stat every file
+    std::vector<ModelCatalogEntry> cached;
+    _load_catalog(p_catalog_path, cached);
+    std::map<std::string, const ModelCatalogEntry*> by_path;
+    for (const ModelCatalogEntry& entry : cached) {
+        by_path[entry.path] = &entry;
+    }
+
+    m_entries.clear();
+    std::vector<size_t> misses;
+    int missing = 0;
+    for (int i = 0; i < p_paths.size(); i++) {
+        ModelCatalogEntry entry;
+        entry.path = ProjectSettings::get_singleton()->globalize_path(p_paths[i]).utf8().get_data();
+        if (!_stat_file(entry.path, entry)) {
+            // Not on the filesystem (e.g. still inside the PCK); not cached
+            entry.error = "File not found";
+            missing++;
+        } else {
+            auto found = by_path.find(entry.path);
+            bool hit = found != by_path.end() && found->second->size == entry.size &&
+                  found->second->mtime_ns == entry.mtime_ns && found->second->inode == entry.inode;
+            if (hit) {
+                entry = *found->second;
+                entry.from_catalog = true;
+            } else {
+                misses.push_back(m_entries.size());
+            }
+        }
+        m_entries.emplace_back(p_paths[i], std::move(entry));
+    }
+    double load_ms = elapsed_ms(start);
+
+    // Cold path: parse the headers of new or changed files in parallel
+    auto scan_start = std::chrono::steady_clock::now();
+    int n_threads = p_n_threads > 0 ? p_n_threads
+        : std::min<int>(CATALOG_MAX_THREADS, std::max(1u, std::thread::hardware_concurrency()));
+    n_threads = std::max(1, std::min<int>(n_threads, static_cast<int>(misses.size())));
+    if (!misses.empty()) {
+        std::atomic<size_t> next{0};
+        auto worker = [&]() {
+            for (size_t i = next.fetch_add(1); i < misses.size(); i = next.fetch_add(1)) {
+                _read_header(m_entries[misses[i]].second);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < n_threads; t++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    double scan_ms = elapsed_ms(scan_start);
+
+    // Rewrite only when the scanned set differs from what was loaded
+    auto save_start = std::chrono::steady_clock::now();
+    std::vector<ModelCatalogEntry> catalog;
+    for (const auto& pair : m_entries) {
+        if (pair.second.size > 0 || pair.second.valid) {
+            catalog.push_back(pair.second);
+        }
+    }
+    int64_t catalog_bytes = -1;
+    if (!p_catalog_path.is_empty() && (!misses.empty() || catalog.size() != cached.size())) {
+        catalog_bytes = _save_catalog(p_catalog_path, catalog);
+        if (catalog_bytes < 0) {
+            UtilityFunctions::printerr("[LocalLLM] WARNING: Failed to write model catalog: ", p_catalog_path);
+        }
+    } else if (!p_catalog_path.is_empty()) {
+        Ref<FileAccess> file = FileAccess::open(p_catalog_path, FileAccess::READ);
+        catalog_bytes = file.is_valid() ? file->get_length() : -1;
+    }
+    double save_ms = elapsed_ms(save_start);
+
+    int invalid = 0;
+    for (const auto& pair : m_entries) {
+        invalid += !pair.second.valid && pair.second.size > 0 ? 1 : 0;
+    }
+
+    m_stats = Dictionary();
+    m_stats["files"] = static_cast<int64_t>(m_entries.size());
+    m_stats["hits"] = static_cast<int64_t>(m_entries.size() - misses.size() - missing);
+    m_stats["misses"] = static_cast<int64_t>(misses.size());
+    m_stats["missing"] = missing;
+    m_stats["invalid"] = invalid;
+    m_stats["threads"] = misses.empty() ? 0 : n_threads;
+    m_stats["load_ms"] = load_ms;
+    m_stats["scan_ms"] = scan_ms;
+    m_stats["save_ms"] = save_ms;
+    m_stats["total_ms"] = elapsed_ms(start);
+    m_stats["catalog_bytes"] = catalog_bytes;
+
+    UtilityFunctions::print("[LocalLLM] Model catalog: ", static_cast<int64_t>(m_entries.size()), " files, ",
+                            static_cast<int64_t>(misses.size()), " scanned in ", String::num(scan_ms, 1),
+                            " ms, warm load ", String::num(load_ms, 1), " ms");
+    return m_stats;
+}
+
+Dictionary LLMModelCatalog::get_entry(const String& p_path) const {
+    for (const auto& pair : m_entries) {
+        if (pair.first == p_path) {
+            Dictionary result = _entry_to_dict(pair.second);
+            if (pair.second.valid) {
+                result["cached"] = pair.second.from_catalog;
+            }
+            return result;
+        }
+    }
+    return Dictionary();
+}
+
+Dictionary LLMModelCatalog::get_entries() const {
+    Dictionary result;
+    for (const auto& pair : m_entries) {
+        result[pair.first] = get_entry(pair.first);
+    }
+    return result;
+}
+
+Dictionary LLMModelCatalog::get_stats() const {
+    return m_stats.duplicate();
+}
+
+} // namespace godot
@@ -0,0 +1,94 @@
+#ifndef MODEL_CATALOG_H
+#define MODEL_CATALOG_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/packed_string_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace godot {
+
+/// What the catalog keeps about one model file. The first four fields
+/// identify the file on disk; an entry is reused as long as they match.
+struct ModelCatalogEntry {
+    std::string path; // absolute filesystem path
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    uint64_t inode = 0; // 0 where the platform has none
+
+    bool valid = false;
+    std::string error;
+
+    uint32_t gguf_version = 0;
+    uint64_t tensor_count = 0;
+    uint64_t data_offset = 0;
+    uint64_t metadata_count = 0;
+    std::string architecture;
+    std::string name;
+    uint32_t file_type = UINT32_MAX;
+    uint32_t context_length = 0;
+    uint32_t block_count = 0;
+    uint32_t embedding_length = 0;
+    uint32_t head_count = 0;
+    uint32_t head_count_kv = 0;
+    uint32_t vocab_size = 0;
+
+    bool from_catalog = false; // runtime only, not stored
+};
+
+/// Reads the GGUF headers of many model files in parallel and caches the
+/// results in a small binary catalog. On a warm start every file whose path,
+/// size, mtime and inode are unchanged is served from the catalog after a
+/// single stat(); only new or modified files are opened.
+class LLMModelCatalog : public RefCounted {
+    GDCLASS(LLMModelCatalog, RefCounted);
+
+protected:
+    static void _bind_methods();
+
+private:
+    // Keyed by the path the caller passed to scan()
+    std::vector<std::pair<String, ModelCatalogEntry>> m_entries;
+    Dictionary m_stats;
+
+    static bool _stat_file(const std::string& p_path, ModelCatalogEntry& r_entry);
+    static void _read_header(ModelCatalogEntry& r_entry);
+    static bool _load_catalog(const String& p_catalog_path, std::vector<ModelCatalogEntry>& r_entries);
+    static int64_t _save_catalog(const String& p_catalog_path, const std::vector<ModelCatalogEntry>& p_entries);
+    static Dictionary _entry_to_dict(const ModelCatalogEntry& p_entry);
+
+public:
+    LLMModelCatalog();
+    ~LLMModelCatalog();
+
+    /// Catalog every file in p_paths (res://, user:// or absolute). Files
+    /// unchanged since the catalog at p_catalog_path was written are not
+    /// opened; the rest are parsed on up to n_threads threads (0 = auto) and
+    /// the catalog is rewritten if anything changed.
+    /// @return get_stats()
+    Dictionary scan(const PackedStringArray& p_paths, const String& p_catalog_path, int p_n_threads = 0);
+
+    /// Header summary for one scanned path: size_bytes, gguf_version,
+    /// tensor_count, tensor_bytes, architecture, name, quantization,
+    /// context_length, block_count, embedding_length, head_count,
+    /// head_count_kv, vocab_size, cached. { "error": ... } if the file is
+    /// missing or not a GGUF model; empty if the path was not scanned.
+    Dictionary get_entry(const String& p_path) const;
+
+    /// get_entry() for every scanned path
+    Dictionary get_entries() const;
+
+    /// Timings of the last scan: files, hits, misses, missing, invalid,
+    /// threads, load_ms (catalog read + stats), scan_ms, save_ms, total_ms,
+    /// catalog_bytes
+    Dictionary get_stats() const;
+};
+
+} // namespace godot
+
+#endif // MODEL_CATALOG_H
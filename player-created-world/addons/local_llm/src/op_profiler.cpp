@@ -0,0 +1,150 @@
+#include "op_profiler.h"
+
+#include <godot_cpp/variant/array.hpp>
+
+#include "ggml.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace godot {
+
+// llama.cpp names the logits tensor of every graph like this; seeing it
+// computed marks the end of one decode step
+static const char* GRAPH_OUTPUT_NAME = "result_output";
+
+// Layer index from llama.cpp's "<name>-<layer>" tensor names, -1 otherwise
+static int tensor_layer(const char* p_name) {
+    const char* dash = strrchr(p_name, '-');
+    if (dash == nullptr || dash[1] == '\0') {
+        return -1;
+    }
+    char* end = nullptr;
+    long layer = strtol(dash + 1, &end, 10);
+    return *end == '\0' ? static_cast<int>(layer) : -1;
+}
+
+static std::string shape_string(const ggml_tensor* p_tensor) {
+    std::string shape = "[";
+    for (int i = 0; i < GGML_MAX_DIMS; i++) {
+        if (i > 0) {
+            shape += ",";
+        }
+        shape += std::to_string(p_tensor->ne[i]);
+    }
+    return shape + "]";
+}
+
+void OpProfiler::start(int p_max_steps) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_max_steps = std::max(1, p_max_steps);
+    m_steps = 0;
+    m_total_ns = 0;
+    m_nodes = 0;
+    m_by_op.clear();
+    m_by_shape.clear();
+    m_by_layer.clear();
+    m_collecting.store(true, std::memory_order_release);
+}
+
+void OpProfiler::stop() {
+    m_collecting.store(false, std::memory_order_release);
+}
+
+bool OpProfiler::is_collecting() const {
+    return m_collecting.load(std::memory_order_acquire);
+}
+
+int OpProfiler::get_steps() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_steps;
+}
+
+bool OpProfiler::eval_callback(ggml_tensor* p_tensor, bool p_ask, void* p_user_data) {
+    OpProfiler* profiler = static_cast<OpProfiler*>(p_user_data);
+    if (p_ask) {
+        // Observing a node splits the graph right after it
+        if (!profiler->m_collecting.load(std::memory_order_acquire)) {
+            return false;
+        }
+        profiler->m_node_start = std::chrono::steady_clock::now();
+        return true;
+    }
+    
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - profiler->m_node_start).count();
+    profiler->_record(p_tensor, ns);
+    // Returning false here would abort the graph
+    return true;
+}
+
+void OpProfiler::_record(const ggml_tensor* p_tensor, int64_t p_ns) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    // The weight type is what decides which kernel a matmul runs
+    std::string op = ggml_op_desc(p_tensor);
+    const ggml_tensor* weights = p_tensor->src[0];
+    if (weights != nullptr && ggml_is_quantized(weights->type)) {
+        op += std::string(" ") + ggml_type_name(weights->type);
+    }
+    std::string shape = op + " " + shape_string(p_tensor);
+    if (weights != nullptr) {
+        shape += " <- " + shape_string(weights);
+    }
+    
+    for (OpTiming* timing : { &m_by_op[op], &m_by_shape[shape], &m_by_layer[tensor_layer(p_tensor->name)] }) {
+        timing->count++;
+        timing->total_ns += p_ns;
+        timing->max_ns = std::max(timing->max_ns, p_ns);
+    }
+    m_total_ns += p_ns;
+    m_nodes++;
+    
+    if (strcmp(p_tensor->name, GRAPH_OUTPUT_NAME) == 0 && ++m_steps >= m_max_steps) {
+        m_collecting.store(false, std::memory_order_release);
+    }
+}
+
+Dictionary OpProfiler::to_dict(int p_top_n) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    auto rank = [&](auto& p_timings, auto p_to_name) {
+        using Entry = std::pair<typename std::decay_t<decltype(p_timings)>::key_type, OpTiming>;
+        std::vector<Entry> sorted(p_timings.begin(), p_timings.end());
+        std::sort(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b) {
+            return a.second.total_ns > b.second.total_ns;
+        });
+        Array rows;
+        for (size_t i = 0; i < sorted.size() && static_cast<int>(i) < p_top_n; i++) {
+            const OpTiming& timing = sorted[i].second;
+            Dictionary row;
+            row["name"] = p_to_name(sorted[i].first);
+            row["count"] = timing.count;
+            row["total_ms"] = timing.total_ns / 1e6;
+            row["ms_per_step"] = m_steps > 0 ? timing.total_ns / 1e6 / m_steps : 0.0;
+            row["avg_us"] = timing.count > 0 ? timing.total_ns / 1e3 / timing.count : 0.0;
+            row["max_us"] = timing.max_ns / 1e3;
+            row["share"] = m_total_ns > 0 ? static_cast<double>(timing.total_ns) / m_total_ns : 0.0;
+            rows.push_back(row);
+        }
+        return rows;
+    };
+    auto string_name = [](const std::string& p_key) { return String::utf8(p_key.c_str()); };
+    auto layer_name = [](int p_layer) { return p_layer >= 0 ? String::num_int64(p_layer) : String("other"); };
+    
+    Dictionary result;
+    result["collecting"] = m_collecting.load(std::memory_order_acquire);
+    result["steps"] = m_steps;
+    result["max_steps"] = m_max_steps;
+    result["nodes"] = m_nodes;
+    result["total_ms"] = m_total_ns / 1e6;
+    result["ms_per_step"] = m_steps > 0 ? m_total_ns / 1e6 / m_steps : 0.0;
+    result["by_op"] = rank(m_by_op, string_name);
+    result["by_shape"] = rank(m_by_shape, string_name);
+    result["by_layer"] = rank(m_by_layer, layer_name);
+    return result;
+}
+
+} // namespace godot
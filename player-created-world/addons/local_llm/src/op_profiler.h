@@ -0,0 +1,62 @@
+#ifndef OP_PROFILER_H
+#define OP_PROFILER_H
+
+#include <godot_cpp/variant/dictionary.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+struct ggml_tensor;
+
+namespace godot {
+
+/// Per-node compute time of llama.cpp graphs, collected through the ggml
+/// scheduler's eval callback (llama_context_params::cb_eval).
+///
+/// Asking to observe every node makes the scheduler compute the graph one
+/// node at a time, so the time between the "ask" and the "done" call of a
+/// node is that node's cost. This slows decoding down while collecting;
+/// the provider only installs the callback for the duration of a profile.
+class OpProfiler {
+public:
+    /// Clear previous results and collect the next p_max_steps decode steps
+    void start(int p_max_steps);
+    void stop();
+    bool is_collecting() const;
+    int get_steps() const;
+
+    /// Callback for llama_context_params::cb_eval; p_user_data is the profiler
+    static bool eval_callback(ggml_tensor* p_tensor, bool p_ask, void* p_user_data);
+
+    /// Ranked tables by op (with weight type), by op and shape, and by layer,
+    /// p_top_n rows each
+    Dictionary to_dict(int p_top_n) const;
+
+private:
+    struct OpTiming {
+        int64_t count = 0;
+        int64_t total_ns = 0;
+        int64_t max_ns = 0;
+    };
+
+    void _record(const ggml_tensor* p_tensor, int64_t p_ns);
+
+    std::atomic<bool> m_collecting{false};
+    std::chrono::steady_clock::time_point m_node_start;
+    int m_max_steps = 0;
+    int m_steps = 0;
+    int64_t m_total_ns = 0;
+    int64_t m_nodes = 0;
+    std::map<std::string, OpTiming> m_by_op;
+    std::map<std::string, OpTiming> m_by_shape;
+    std::map<int, OpTiming> m_by_layer;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace godot
+
+#endif // OP_PROFILER_H
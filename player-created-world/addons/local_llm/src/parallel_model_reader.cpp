@@ -0,0 +1,568 @@
+#include "parallel_model_reader.h"
+
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LOCAL_LLM_POSIX_IO 1
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace godot {
+
+// Work unit size; a multiple of the direct I/O alignment
+static const uint64_t READER_CHUNK_BYTES = 8 * 1024 * 1024;
+
+// O_DIRECT needs offsets, lengths and buffers aligned to the logical block
+// size; 4 KiB covers every common device
+static const uint64_t READER_ALIGNMENT = 4096;
+
+// Bytes read single-threaded to estimate the device's sequential bandwidth
+static const uint64_t READER_PROBE_BYTES = 64 * 1024 * 1024;
+
+// Initial header read; doubled until the whole GGUF header fits
+static const uint64_t READER_HEADER_BYTES = 4 * 1024 * 1024;
+
+static const int READER_MAX_THREADS = 8;
+
+static uint64_t align_up(uint64_t p_value) {
+    return (p_value + READER_ALIGNMENT - 1) & ~(READER_ALIGNMENT - 1);
+}
+
+// ============================================================================
+// Aligned buffer
+// ============================================================================
+
+class AlignedBuffer {
+public:
+    explicit AlignedBuffer(uint64_t p_size) : m_size(p_size) {
+#ifdef _WIN32
+        m_data = static_cast<uint8_t*>(_aligned_malloc(p_size, READER_ALIGNMENT));
+#else
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, READER_ALIGNMENT, p_size) == 0) {
+            m_data = static_cast<uint8_t*>(ptr);
+        }
+#endif
+    }
+
+    ~AlignedBuffer() {
+#ifdef _WIN32
+        _aligned_free(m_data);
+#else
+        free(m_data);
+#endif
+    }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    uint8_t* data() const { return m_data; }
+    uint64_t size() const { return m_size; }
+
+private:
+    uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+};
+
+// ============================================================================
+// Positional file access
+// ============================================================================
+
+// Each reader thread opens its own handles, so implementations need not be
+// thread-safe
+class RangeFile {
+public:
+    virtual ~RangeFile() = default;
+    /// Read p_size bytes at p_offset; p_size may run past EOF for the last chunk
+    virtual bool read_at(uint64_t p_offset, uint8_t* r_dst, uint64_t p_size, uint64_t p_needed) = 0;
+    virtual bool write_at(uint64_t p_offset, const uint8_t* p_src, uint64_t p_size) = 0;
+    /// Whether the aligned (padded) sizes must be used for every transfer
+    virtual bool is_direct() const { return false; }
+};
+
+class GodotRangeFile : public RangeFile {
+public:
+    explicit GodotRangeFile(Ref<FileAccess> p_file) : m_file(p_file) {}
+
+    bool read_at(uint64_t p_offset, uint8_t* r_dst, uint64_t p_size, uint64_t p_needed) override {
+        (void)p_size;
+        m_file->seek(p_offset);
+        return m_file->get_buffer(r_dst, p_needed) == p_needed;
+    }
+
+    bool write_at(uint64_t p_offset, const uint8_t* p_src, uint64_t p_size) override {
+        m_file->seek(p_offset);
+        return m_file->store_buffer(p_src, p_size);
+    }
+
+private:
+    Ref<FileAccess> m_file;
+};
+
+#ifdef LOCAL_LLM_POSIX_IO
+class PosixRangeFile : public RangeFile {
+public:
+    PosixRangeFile(int p_fd, bool p_direct) : m_fd(p_fd), m_direct(p_direct) {}
+    ~PosixRangeFile() override { close(m_fd); }
+
+    /// Open with O_DIRECT where supported, falling back to buffered I/O
+    /// (e.g. tmpfs rejects O_DIRECT)
+    static std::unique_ptr<PosixRangeFile> open_path(const String& p_path, int p_flags) {
+        CharString path = p_path.utf8();
+#ifdef O_DIRECT
+        int fd = ::open(path.get_data(), p_flags | O_DIRECT, 0644);
+        if (fd >= 0) {
+            return std::make_unique<PosixRangeFile>(fd, true);
+        }
+#endif
+        int fd_buffered = ::open(path.get_data(), p_flags, 0644);
+        if (fd_buffered < 0) {
+            return nullptr;
+        }
+#ifdef __APPLE__
+        fcntl(fd_buffered, F_NOCACHE, 1);
+#endif
+        return std::make_unique<PosixRangeFile>(fd_buffered, false);
+    }
+
+    bool read_at(uint64_t p_offset, uint8_t* r_dst, uint64_t p_size, uint64_t p_needed) override {
+        uint64_t want = m_direct ? p_size : p_needed;
+        uint64_t done = 0;
+        while (done < want) {
+            ssize_t n = pread(m_fd, r_dst + done, want - done, p_offset + done);
+            if (n < 0) {
+                return false;
+            }
+            if (n == 0) {
+                break; // EOF inside the padded tail
+            }
+            done += n;
+        }
+        return done >= p_needed;
+    }
+
+    bool write_at(uint64_t p_offset, const uint8_t* p_src, uint64_t p_size) override {
+        uint64_t done = 0;
+        while (done < p_size) {
+            ssize_t n = pwrite(m_fd, p_src + done, p_size - done, p_offset + done);
+            if (n <= 0) {
+                return false;
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    bool is_direct() const override { return m_direct; }
+
+private:
+    int m_fd;
+    bool m_direct;
+};
+#endif
+
+// res:// may live inside a PCK, which only FileAccess can read
+static bool is_virtual_path(const String& p_path) {
+    return p_path.begins_with("res://") || p_path.begins_with("user://");
+}
+
+static std::unique_ptr<RangeFile> open_source(const String& p_path) {
+#ifdef LOCAL_LLM_POSIX_IO
+    if (!is_virtual_path(p_path)) {
+        return PosixRangeFile::open_path(p_path, O_RDONLY);
+    }
+#endif
+    Ref<FileAccess> file = FileAccess::open(p_path, FileAccess::READ);
+    if (file.is_null()) {
+        return nullptr;
+    }
+    return std::make_unique<GodotRangeFile>(file);
+}
+
+static std::unique_ptr<RangeFile> open_destination(const String& p_path) {
+#ifdef LOCAL_LLM_POSIX_IO
+    return PosixRangeFile::open_path(p_path, O_WRONLY);
+#else
+    Ref<FileAccess> file = FileAccess::open(p_path, FileAccess::READ_WRITE);
+    if (file.is_null()) {
+        return nullptr;
+    }
+    return std::make_unique<GodotRangeFile>(file);
+#endif
+}
+
+// Create the destination at its final size so threads can write anywhere
+static bool preallocate_destination(const String& p_path, uint64_t p_size) {
+#ifdef LOCAL_LLM_POSIX_IO
+    int fd = ::open(p_path.utf8().get_data(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    // Padded so direct writes of the last chunk stay in bounds; trimmed after
+    bool ok = ftruncate(fd, align_up(p_size)) == 0;
+    close(fd);
+    return ok;
+#else
+    Ref<FileAccess> file = FileAccess::open(p_path, FileAccess::WRITE);
+    if (file.is_null()) {
+        return false;
+    }
+    if (p_size > 0) {
+        uint8_t zero = 0;
+        file->seek(p_size - 1);
+        file->store_buffer(&zero, 1);
+    }
+    file->close();
+    return true;
+#endif
+}
+
+static bool finalize_destination(const String& p_path, uint64_t p_size) {
+#ifdef LOCAL_LLM_POSIX_IO
+    return truncate(p_path.utf8().get_data(), p_size) == 0;
+#else
+    (void)p_path;
+    (void)p_size;
+    return true;
+#endif
+}
+
+static uint64_t get_source_size(const String& p_path) {
+    Ref<FileAccess> file = FileAccess::open(p_path, FileAccess::READ);
+    if (file.is_null()) {
+        return 0;
+    }
+    return file->get_length();
+}
+
+// ============================================================================
+// ParallelModelReader
+// ============================================================================
+
+void ParallelModelReader::_bind_methods() {
+    ADD_SIGNAL(MethodInfo("tensor_completed",
+        PropertyInfo(Variant::STRING, "tensor_name"),
+        PropertyInfo(Variant::INT, "index"),
+        PropertyInfo(Variant::INT, "total")));
+    ADD_SIGNAL(MethodInfo("finished", PropertyInfo(Variant::DICTIONARY, "result")));
+
+    ClassDB::bind_method(D_METHOD("start", "src_path", "dst_path", "n_threads", "probe"), &ParallelModelReader::start, DEFVAL(0), DEFVAL(true));
+    ClassDB::bind_method(D_METHOD("cancel"), &ParallelModelReader::cancel);
+    ClassDB::bind_method(D_METHOD("is_running"), &ParallelModelReader::is_running);
+    ClassDB::bind_method(D_METHOD("get_progress"), &ParallelModelReader::get_progress);
+    ClassDB::bind_method(D_METHOD("get_result"), &ParallelModelReader::get_result);
+
+    // Internal deferred methods
+    ClassDB::bind_method(D_METHOD("_emit_tensor_completed_deferred", "name", "index", "total"), &ParallelModelReader::_emit_tensor_completed_deferred);
+    ClassDB::bind_method(D_METHOD("_emit_finished_deferred", "result"), &ParallelModelReader::_emit_finished_deferred);
+}
+
+ParallelModelReader::ParallelModelReader() {
+}
+
+ParallelModelReader::~ParallelModelReader() {
+    m_cancel.store(true, std::memory_order_release);
+    if (m_thread && m_thread->joinable()) {
+        m_thread->join();
+    }
+}
+
+int ParallelModelReader::_default_thread_count() {
+    int cores = OS::get_singleton()->get_processor_count();
+    return std::max(2, std::min(cores, READER_MAX_THREADS));
+}
+
+bool ParallelModelReader::start(const String& p_src_path, const String& p_dst_path, int n_threads, bool probe) {
+    if (m_running.load(std::memory_order_acquire)) {
+        return false;
+    }
+    if (m_thread && m_thread->joinable()) {
+        m_thread->join();
+    }
+
+    m_src_path = p_src_path;
+    m_dst_path = p_dst_path;
+    m_n_threads = n_threads > 0 ? n_threads : _default_thread_count();
+    m_probe = probe;
+
+    m_cancel.store(false, std::memory_order_release);
+    m_failed.store(false, std::memory_order_release);
+    m_bytes_done.store(0, std::memory_order_release);
+    m_tensors_done.store(0, std::memory_order_release);
+    m_next_chunk.store(0, std::memory_order_release);
+    m_total_bytes.store(0, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_result_mutex);
+        m_error = "";
+        m_result = Dictionary();
+    }
+
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::make_unique<std::thread>(&ParallelModelReader::_run, this);
+    return true;
+}
+
+void ParallelModelReader::cancel() {
+    m_cancel.store(true, std::memory_order_release);
+}
+
+bool ParallelModelReader::is_running() const {
+    return m_running.load(std::memory_order_acquire);
+}
+
+float ParallelModelReader::get_progress() const {
+    const uint64_t total = m_total_bytes.load(std::memory_order_acquire);
+    if (total == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(static_cast<double>(m_bytes_done.load(std::memory_order_acquire)) / total);
+}
+
+Dictionary ParallelModelReader::get_result() {
+    std::lock_guard<std::mutex> lock(m_result_mutex);
+    return m_result;
+}
+
+void ParallelModelReader::_fail(const String& p_error) {
+    std::lock_guard<std::mutex> lock(m_result_mutex);
+    if (!m_failed.exchange(true)) {
+        m_error = p_error;
+    }
+}
+
+bool ParallelModelReader::_read_header(String& r_error) {
+    std::unique_ptr<RangeFile> src = open_source(m_src_path);
+    if (!src) {
+        r_error = "Failed to open source: " + m_src_path;
+        return false;
+    }
+
+    const uint64_t total = m_total_bytes.load(std::memory_order_acquire);
+    uint64_t want = std::min<uint64_t>(READER_HEADER_BYTES, total);
+    while (true) {
+        AlignedBuffer buffer(align_up(want));
+        if (buffer.data() == nullptr || !src->read_at(0, buffer.data(), buffer.size(), want)) {
+            r_error = "Failed to read model header";
+            return false;
+        }
+
+        GGUFParseResult result = parse_gguf_header(buffer.data(), want, total, m_header, r_error);
+        if (result == GGUF_PARSE_OK) {
+            return true;
+        }
+        if (result == GGUF_PARSE_INVALID || want == total) {
+            if (r_error.is_empty()) {
+                r_error = "Truncated GGUF header";
+            }
+            return false;
+        }
+        if (want >= GGUF_MAX_HEADER_BYTES) {
+            r_error = "GGUF header larger than " + String::num_int64(GGUF_MAX_HEADER_BYTES) + " bytes";
+            return false;
+        }
+        want = std::min<uint64_t>({ want * 2, total, GGUF_MAX_HEADER_BYTES });
+    }
+}
+
+void ParallelModelReader::_plan_chunks() {
+    m_chunks.clear();
+    const std::vector<GGUFTensorRange>& tensors = m_header.tensors;
+    m_tensor_remaining.reset(new std::atomic<int>[tensors.size()]);
+    for (size_t i = 0; i < tensors.size(); i++) {
+        m_tensor_remaining[i].store(0, std::memory_order_relaxed);
+    }
+
+    const uint64_t total = m_total_bytes.load(std::memory_order_acquire);
+    size_t first = 0;
+    for (uint64_t offset = 0; offset < total; offset += READER_CHUNK_BYTES) {
+        Chunk chunk;
+        chunk.offset = offset;
+        chunk.size = std::min(READER_CHUNK_BYTES, total - offset);
+        uint64_t end = offset + chunk.size;
+
+        // Tensors are sorted by offset, so overlapping ones are contiguous
+        while (first < tensors.size() && tensors[first].offset + tensors[first].size <= offset) {
+            first++;
+        }
+        size_t last = first;
+        while (last < tensors.size() && tensors[last].offset < end) {
+            if (tensors[last].size > 0) {
+                m_tensor_remaining[last].fetch_add(1, std::memory_order_relaxed);
+            }
+            last++;
+        }
+        chunk.first_tensor = first;
+        chunk.end_tensor = last;
+        m_chunks.push_back(chunk);
+    }
+}
+
+double ParallelModelReader::_probe_sequential_gbps() {
+    std::unique_ptr<RangeFile> src = open_source(m_src_path);
+    if (!src) {
+        return 0.0;
+    }
+
+    // Read the tail of the file: the header was just read, so the start is
+    // the region most likely to be cached already
+    const uint64_t total = m_total_bytes.load(std::memory_order_acquire);
+    uint64_t probe = std::min(READER_PROBE_BYTES, total);
+    uint64_t start = (total - probe) & ~(READER_ALIGNMENT - 1);
+    AlignedBuffer buffer(READER_CHUNK_BYTES);
+    if (buffer.data() == nullptr) {
+        return 0.0;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t done = 0;
+    for (uint64_t offset = start; offset < total && !m_cancel.load(std::memory_order_acquire); offset += READER_CHUNK_BYTES) {
+        uint64_t needed = std::min(READER_CHUNK_BYTES, total - offset);
+        if (!src->read_at(offset, buffer.data(), align_up(needed), needed)) {
+            return 0.0;
+        }
+        done += needed;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return seconds > 0.0 ? done / seconds / 1e9 : 0.0;
+}
+
+void ParallelModelReader::_worker_func() {
+    std::unique_ptr<RangeFile> src = open_source(m_src_path);
+    std::unique_ptr<RangeFile> dst = open_destination(m_dst_path);
+    if (!src || !dst) {
+        _fail("Failed to open " + String(src ? "destination: " + m_dst_path : "source: " + m_src_path));
+        return;
+    }
+    if (src->is_direct() || dst->is_direct()) {
+        m_direct_io.store(true, std::memory_order_release);
+    }
+
+    AlignedBuffer buffer(READER_CHUNK_BYTES);
+    if (buffer.data() == nullptr) {
+        _fail("Out of memory for read buffer");
+        return;
+    }
+
+    const int total_tensors = static_cast<int>(m_header.tensors.size());
+    while (!m_cancel.load(std::memory_order_acquire) && !m_failed.load(std::memory_order_acquire)) {
+        size_t index = m_next_chunk.fetch_add(1, std::memory_order_acq_rel);
+        if (index >= m_chunks.size()) {
+            return;
+        }
+        const Chunk& chunk = m_chunks[index];
+        uint64_t padded = align_up(chunk.size);
+
+        if (!src->read_at(chunk.offset, buffer.data(), padded, chunk.size)) {
+            _fail("Read failed at offset " + String::num_int64(chunk.offset));
+            return;
+        }
+        if (padded > chunk.size) {
+            std::memset(buffer.data() + chunk.size, 0, padded - chunk.size);
+        }
+        if (!dst->write_at(chunk.offset, buffer.data(), dst->is_direct() ? padded : chunk.size)) {
+            _fail("Write failed at offset " + String::num_int64(chunk.offset));
+            return;
+        }
+        m_bytes_done.fetch_add(chunk.size, std::memory_order_acq_rel);
+
+        for (size_t t = chunk.first_tensor; t < chunk.end_tensor; t++) {
+            if (m_header.tensors[t].size > 0 && m_tensor_remaining[t].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                int done = m_tensors_done.fetch_add(1, std::memory_order_acq_rel);
+                call_deferred("_emit_tensor_completed_deferred",
+                    String::utf8(m_header.tensors[t].name.c_str()), done, total_tensors);
+            }
+        }
+    }
+}
+
+void ParallelModelReader::_run() {
+    Dictionary result;
+    String error;
+    m_direct_io.store(false, std::memory_order_release);
+
+    const uint64_t total = get_source_size(m_src_path);
+    m_total_bytes.store(total, std::memory_order_release);
+    if (total == 0) {
+        _fail("Source is empty or missing: " + m_src_path);
+    } else if (!_read_header(error)) {
+        // Still copy non-GGUF or unusual files, just without tensor progress
+        UtilityFunctions::print("[LocalLLM] WARNING: ", error, " - copying without tensor progress");
+        m_header = GGUFHeader();
+    }
+
+    double sequential_gbps = 0.0;
+    if (!m_failed.load() && m_probe) {
+        sequential_gbps = _probe_sequential_gbps();
+    }
+
+    double elapsed = 0.0;
+    if (!m_failed.load()) {
+        _plan_chunks();
+        if (!preallocate_destination(m_dst_path, total)) {
+            _fail("Failed to create destination: " + m_dst_path);
+        }
+    }
+
+    if (!m_failed.load()) {
+        auto begin = std::chrono::steady_clock::now();
+        int n_threads = std::max(1, std::min<int>(m_n_threads, static_cast<int>(m_chunks.size())));
+        std::vector<std::thread> workers;
+        for (int i = 0; i < n_threads; i++) {
+            workers.emplace_back(&ParallelModelReader::_worker_func, this);
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        if (m_cancel.load(std::memory_order_acquire)) {
+            _fail("Cancelled");
+        } else if (!m_failed.load() && !finalize_destination(m_dst_path, total)) {
+            _fail("Failed to finalize destination: " + m_dst_path);
+        }
+    }
+
+    uint64_t bytes = m_bytes_done.load(std::memory_order_acquire);
+    double gbps = elapsed > 0.0 ? bytes / elapsed / 1e9 : 0.0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_result_mutex);
+        result["success"] = !m_failed.load();
+        result["error"] = m_error;
+        result["bytes"] = static_cast<int64_t>(bytes);
+        result["elapsed_s"] = elapsed;
+        result["gbps"] = gbps;
+        result["sequential_gbps"] = sequential_gbps;
+        result["speedup"] = sequential_gbps > 0.0 ? gbps / sequential_gbps : 0.0;
+        result["threads"] = m_n_threads;
+        result["direct_io"] = m_direct_io.load(std::memory_order_acquire);
+        result["tensors"] = static_cast<int64_t>(m_header.tensors.size());
+        m_result = result;
+    }
+
+    m_running.store(false, std::memory_order_release);
+    call_deferred("_emit_finished_deferred", result);
+}
+
+void ParallelModelReader::_emit_tensor_completed_deferred(const String& p_name, int p_index, int p_total) {
+    emit_signal("tensor_completed", p_name, p_index, p_total);
+}
+
+void ParallelModelReader::_emit_finished_deferred(const Dictionary& p_result) {
+    emit_signal("finished", p_result);
+}
+
+} // namespace godot
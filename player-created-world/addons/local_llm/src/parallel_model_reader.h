@@ -0,0 +1,103 @@
+#ifndef PARALLEL_MODEL_READER_H
+#define PARALLEL_MODEL_READER_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/dictionary.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include "gguf_header.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace godot {
+
+/// Copies a model file out of a source llama.cpp cannot mmap (a PCK entry
+/// read through FileAccess, or any file when mmap is disabled) using several
+/// threads. Each thread reads aligned chunks of the tensor data into aligned
+/// buffers, bypassing the page cache with O_DIRECT where the platform allows,
+/// and writes them while the other threads are still reading.
+///
+/// Progress is reported per tensor; the finished result compares the
+/// achieved throughput against a single-threaded sequential probe.
+class ParallelModelReader : public RefCounted {
+    GDCLASS(ParallelModelReader, RefCounted);
+
+protected:
+    static void _bind_methods();
+
+private:
+    struct Chunk {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        size_t first_tensor = 0; // tensors overlapping this chunk
+        size_t end_tensor = 0;
+    };
+
+    String m_src_path;
+    String m_dst_path;
+    int m_n_threads = 0;
+    bool m_probe = true;
+
+    std::atomic<uint64_t> m_total_bytes{0};
+    GGUFHeader m_header;
+    std::vector<Chunk> m_chunks;
+    std::unique_ptr<std::atomic<int>[]> m_tensor_remaining;
+
+    std::unique_ptr<std::thread> m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_cancel{false};
+    std::atomic<bool> m_failed{false};
+    std::atomic<size_t> m_next_chunk{0};
+    std::atomic<uint64_t> m_bytes_done{0};
+    std::atomic<int> m_tensors_done{0};
+    std::atomic<bool> m_direct_io{false};
+
+    std::mutex m_result_mutex;
+    String m_error;
+    Dictionary m_result;
+
+    void _run();
+    void _worker_func();
+    bool _read_header(String& r_error);
+    void _plan_chunks();
+    double _probe_sequential_gbps();
+    void _fail(const String& p_error);
+
+    static int _default_thread_count();
+
+public:
+    ParallelModelReader();
+    ~ParallelModelReader();
+
+    /// Start copying p_src_path to p_dst_path (absolute filesystem path) in
+    /// the background. Emits tensor_completed per tensor and finished once.
+    /// @param n_threads Reader threads (0 = auto)
+    /// @param probe Measure single-threaded sequential bandwidth first
+    /// @return false if a copy is already running
+    bool start(const String& p_src_path, const String& p_dst_path, int n_threads = 0, bool probe = true);
+
+    /// Stop the copy; finished is emitted with success = false
+    void cancel();
+
+    bool is_running() const;
+
+    /// Fraction of bytes copied (0.0 to 1.0)
+    float get_progress() const;
+
+    /// Result of the last finished copy: success, error, bytes, elapsed_s,
+    /// gbps, sequential_gbps, speedup, threads, direct_io, tensors
+    Dictionary get_result();
+
+    // Called via call_deferred from the reader threads
+    void _emit_tensor_completed_deferred(const String& p_name, int p_index, int p_total);
+    void _emit_finished_deferred(const Dictionary& p_result);
+};
+
+} // namespace godot
+
+#endif // PARALLEL_MODEL_READER_H
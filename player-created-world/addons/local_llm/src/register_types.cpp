@@ -4,8 +4,15 @@
 #include <godot_cpp/core/defs.hpp>
 #include <godot_cpp/godot.hpp>
 
+#include "eval_runner.h"
 #include "llama_cpp_provider.h"
+#include "llm_engine.h"
 #include "llm_generation_handle.h"
+#include "llm_prompt_template.h"
+#include "llm_tokenizer.h"
+#include "logits_processor.h"
+#include "model_catalog.h"
+#include "parallel_model_reader.h"
 
 using namespace godot;
 
@@ -14,8 +21,20 @@ void initialize_local_llm_module(ModuleInitializationLevel p_level) {
         return;
     }
 
+    ClassDB::register_class<LLMEngine>();
     ClassDB::register_class<LLMGenerationHandle>();
     ClassDB::register_class<LlamaCppProvider>();
+    ClassDB::register_class<ParallelModelReader>();
+    ClassDB::register_class<LLMTokenizer>();
+    ClassDB::register_class<LLMModelCatalog>();
+    ClassDB::register_class<LLMEvalRunner>();
+    ClassDB::register_class<LLMPromptTemplate>();
+
+    // Game-specific processors register here too, after the built-ins
+    LogitsProcessorRegistry::register_builtin_processors();
+
+    // Backend and model pool shared by every provider
+    LLMEngine::initialize();
 }
 
 void uninitialize_local_llm_module(ModuleInitializationLevel p_level) {
@@ -23,6 +42,8 @@ void uninitialize_local_llm_module(ModuleInitializationLevel p_level) {
         return;
     }
     // Cleanup handled by destructors
+    LogitsProcessorRegistry::clear();
+    LLMEngine::shutdown();
 }
 
 extern "C" {
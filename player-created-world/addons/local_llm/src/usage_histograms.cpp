@@ -0,0 +1,178 @@
+#include "usage_histograms.h"
+
+#include <godot_cpp/variant/array.hpp>
+
+#include <algorithm>
+
+namespace godot {
+
+// Once this many samples accumulate, everything is halved so older sessions
+// fade out instead of dominating forever
+static const double USAGE_WINDOW = 1000.0;
+
+UsageHistogram::UsageHistogram(int64_t p_bucket_width, int p_n_buckets)
+    : m_bucket_width(p_bucket_width), m_counts(p_n_buckets, 0.0) {
+}
+
+void UsageHistogram::add(int64_t p_value) {
+    // Bucket i holds values in (i * width - width, i * width]; the last
+    // bucket also takes everything larger
+    int64_t index = (std::max<int64_t>(p_value, 0) + m_bucket_width - 1) / m_bucket_width;
+    index = std::min<int64_t>(index, static_cast<int64_t>(m_counts.size()) - 1);
+    m_counts[index] += 1.0;
+}
+
+void UsageHistogram::decay(double p_factor) {
+    for (double& count : m_counts) {
+        count *= p_factor;
+    }
+}
+
+void UsageHistogram::clear() {
+    std::fill(m_counts.begin(), m_counts.end(), 0.0);
+}
+
+double UsageHistogram::total() const {
+    double sum = 0.0;
+    for (double count : m_counts) {
+        sum += count;
+    }
+    return sum;
+}
+
+double UsageHistogram::mean() const {
+    double sum = 0.0;
+    double weighted = 0.0;
+    for (size_t i = 0; i < m_counts.size(); i++) {
+        sum += m_counts[i];
+        weighted += m_counts[i] * static_cast<double>(i * m_bucket_width);
+    }
+    return sum > 0.0 ? weighted / sum : 0.0;
+}
+
+int64_t UsageHistogram::quantile(double p_quantile) const {
+    double sum = total();
+    if (sum <= 0.0) {
+        return 0;
+    }
+    double target = std::clamp(p_quantile, 0.0, 1.0) * sum;
+    double running = 0.0;
+    for (size_t i = 0; i < m_counts.size(); i++) {
+        running += m_counts[i];
+        if (running >= target && m_counts[i] > 0.0) {
+            return static_cast<int64_t>(i) * m_bucket_width;
+        }
+    }
+    return static_cast<int64_t>(m_counts.size() - 1) * m_bucket_width;
+}
+
+double UsageHistogram::fraction_above(int64_t p_value) const {
+    double sum = total();
+    if (sum <= 0.0) {
+        return 0.0;
+    }
+    // Buckets are coarse; count a bucket as above if its upper edge is
+    double above = 0.0;
+    for (size_t i = 0; i < m_counts.size(); i++) {
+        if (static_cast<int64_t>(i) * m_bucket_width > p_value) {
+            above += m_counts[i];
+        }
+    }
+    return above / sum;
+}
+
+Dictionary UsageHistogram::to_dict() const {
+    Dictionary buckets;
+    for (size_t i = 0; i < m_counts.size(); i++) {
+        if (m_counts[i] > 0.0) {
+            buckets[String::num_int64(i)] = m_counts[i];
+        }
+    }
+    Dictionary dict;
+    dict["bucket_width"] = m_bucket_width;
+    dict["buckets"] = buckets;
+    return dict;
+}
+
+void UsageHistogram::from_dict(const Dictionary& p_dict) {
+    clear();
+    // A different bucket width means an incompatible layout; start over
+    int64_t width = p_dict.get("bucket_width", 0);
+    if (width != m_bucket_width) {
+        return;
+    }
+    Dictionary buckets = p_dict.get("buckets", Dictionary());
+    Array keys = buckets.keys();
+    for (int64_t i = 0; i < keys.size(); i++) {
+        int64_t index = String(keys[i]).to_int();
+        if (index >= 0 && index < static_cast<int64_t>(m_counts.size())) {
+            m_counts[index] = buckets[keys[i]];
+        }
+    }
+}
+
+void ModelUsageStats::record_request(int64_t p_prompt_tokens, int64_t p_output_tokens, int64_t p_peak_cells, int64_t p_reused_tokens) {
+    prompt_tokens.add(p_prompt_tokens);
+    output_tokens.add(p_output_tokens);
+    peak_kv_cells.add(p_peak_cells);
+    prefix_reuse.add(p_prompt_tokens > 0 ? p_reused_tokens * 100 / p_prompt_tokens : 0);
+    requests += 1.0;
+    _maybe_decay();
+}
+
+void ModelUsageStats::record_too_long(int64_t p_prompt_tokens) {
+    // The request needed at least its prompt plus one generated token
+    prompt_tokens.add(p_prompt_tokens);
+    peak_kv_cells.add(p_prompt_tokens + 1);
+    rejected_too_long += 1.0;
+    _maybe_decay();
+}
+
+void ModelUsageStats::record_arrival(int64_t p_in_flight, bool p_busy) {
+    concurrency.add(p_in_flight);
+    if (p_busy) {
+        rejected_busy += 1.0;
+    }
+    if (concurrency.total() >= USAGE_WINDOW) {
+        concurrency.decay(0.5);
+        rejected_busy *= 0.5;
+    }
+}
+
+void ModelUsageStats::_maybe_decay() {
+    if (peak_kv_cells.total() < USAGE_WINDOW) {
+        return;
+    }
+    prompt_tokens.decay(0.5);
+    output_tokens.decay(0.5);
+    peak_kv_cells.decay(0.5);
+    prefix_reuse.decay(0.5);
+    requests *= 0.5;
+    rejected_too_long *= 0.5;
+}
+
+Dictionary ModelUsageStats::to_dict() const {
+    Dictionary dict;
+    dict["prompt_tokens"] = prompt_tokens.to_dict();
+    dict["output_tokens"] = output_tokens.to_dict();
+    dict["peak_kv_cells"] = peak_kv_cells.to_dict();
+    dict["prefix_reuse"] = prefix_reuse.to_dict();
+    dict["concurrency"] = concurrency.to_dict();
+    dict["requests"] = requests;
+    dict["rejected_too_long"] = rejected_too_long;
+    dict["rejected_busy"] = rejected_busy;
+    return dict;
+}
+
+void ModelUsageStats::from_dict(const Dictionary& p_dict) {
+    prompt_tokens.from_dict(p_dict.get("prompt_tokens", Dictionary()));
+    output_tokens.from_dict(p_dict.get("output_tokens", Dictionary()));
+    peak_kv_cells.from_dict(p_dict.get("peak_kv_cells", Dictionary()));
+    prefix_reuse.from_dict(p_dict.get("prefix_reuse", Dictionary()));
+    concurrency.from_dict(p_dict.get("concurrency", Dictionary()));
+    requests = p_dict.get("requests", 0.0);
+    rejected_too_long = p_dict.get("rejected_too_long", 0.0);
+    rejected_busy = p_dict.get("rejected_busy", 0.0);
+}
+
+} // namespace godot
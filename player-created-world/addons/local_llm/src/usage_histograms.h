@@ -0,0 +1,70 @@
+#ifndef USAGE_HISTOGRAMS_H
+#define USAGE_HISTOGRAMS_H
+
+#include <godot_cpp/variant/dictionary.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace godot {
+
+/// Fixed-width histogram of token counts. Counts are fractional so the whole
+/// histogram can be decayed, letting it follow recent usage rather than
+/// all-time usage.
+class UsageHistogram {
+public:
+    UsageHistogram(int64_t p_bucket_width, int p_n_buckets);
+
+    void add(int64_t p_value);
+    void decay(double p_factor);
+    void clear();
+
+    double total() const;
+    double mean() const;
+
+    /// Upper edge of the bucket that covers p_quantile of the samples
+    int64_t quantile(double p_quantile) const;
+
+    /// Fraction of samples greater than p_value
+    double fraction_above(int64_t p_value) const;
+
+    /// Sparse form: { "bucket_width": int, "buckets": { "index": count } }
+    Dictionary to_dict() const;
+    void from_dict(const Dictionary& p_dict);
+
+private:
+    int64_t m_bucket_width;
+    std::vector<double> m_counts;
+};
+
+/// Request shape observed for one model. Persisted across sessions by the
+/// service so capacity advice improves with use.
+struct ModelUsageStats {
+    UsageHistogram prompt_tokens{64, 2048};
+    UsageHistogram output_tokens{16, 1024};
+    /// KV cells occupied when a request finished (prompt + output)
+    UsageHistogram peak_kv_cells{64, 2048};
+    /// Percentage of the prompt served from the resident KV prefix
+    UsageHistogram prefix_reuse{1, 101};
+    /// Requests wanting the context at the same time, the arriving one
+    /// included; busy rejections count too, as demand that was turned away
+    UsageHistogram concurrency{1, 17};
+
+    double requests = 0.0;
+    double rejected_too_long = 0.0;
+    double rejected_busy = 0.0;
+
+    void record_request(int64_t p_prompt_tokens, int64_t p_output_tokens, int64_t p_peak_cells, int64_t p_reused_tokens);
+    void record_too_long(int64_t p_prompt_tokens);
+    void record_arrival(int64_t p_in_flight, bool p_busy);
+
+    Dictionary to_dict() const;
+    void from_dict(const Dictionary& p_dict);
+
+private:
+    void _maybe_decay();
+};
+
+} // namespace godot
+
+#endif // USAGE_HISTOGRAMS_H
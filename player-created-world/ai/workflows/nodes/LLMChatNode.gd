@@ -8,6 +8,8 @@ extends RefCounted
 ##   prompt            — template string for the user prompt
 ##   system_prompt     — template string for the system prompt
 ##   system_prompt_file — path to a file containing the system prompt
+##   model.name        — optional model ID to run on (switched to if not loaded;
+##                       WorkflowExecutor declares these up front for preloading)
 ##   model.params      — optional overrides (max_tokens, temperature, etc.)
 ##   args.max_tokens   — alternative location for max_tokens
 ##   args.temperature  — alternative location for temperature
@@ -38,8 +40,10 @@ func run(ctx: WorkflowContext, node_def: Dictionary) -> Dictionary:
 
 	# Build request params
 	var params: Dictionary = {}
+	var model_name: String = ""
 	if node_def.has("model") and node_def["model"] is Dictionary:
 		var model_def: Dictionary = node_def["model"]
+		model_name = str(model_def.get("name", ""))
 		if model_def.has("params") and model_def["params"] is Dictionary:
 			params = (model_def["params"] as Dictionary).duplicate()
 
@@ -57,6 +61,12 @@ func run(ctx: WorkflowContext, node_def: Dictionary) -> Dictionary:
 	if llm == null:
 		return {"text": "", "_error": "LocalLLMService not available"}
 
+	# Switch to the node's model if it names one other than the loaded model
+	if not model_name.is_empty() and llm.get_loaded_model_id() != model_name:
+		var load_result: Dictionary = await llm.load_model(model_name)
+		if not load_result.get("success", false):
+			return {"text": "", "_error": "Failed to load model '%s': %s" % [model_name, str(load_result.get("error", ""))]}
+
 	var request: Dictionary = {
 		"prompt": prompt,
 		"system_prompt": system_prompt,
@@ -50,6 +50,9 @@ func run_workflow_def(workflow: Dictionary, inputs: Dictionary = {}) -> Dictiona
 
 	var exec_order: Array = sort_result["order"] as Array
 
+	# Let the LLM service preload the models upcoming llm.chat nodes need
+	_declare_upcoming_models(nodes, exec_order)
+
 	# Build a lookup: node_id -> node_def
 	var node_map: Dictionary = {}
 	for node_def in nodes:
@@ -127,6 +130,20 @@ func run_workflow_def(workflow: Dictionary, inputs: Dictionary = {}) -> Dictiona
 	return wf_outputs
 
 
+## Tell LocalLLMService which models this run will need, in execution order,
+## so it can prefetch them while earlier nodes are still running.
+func _declare_upcoming_models(nodes: Array, exec_order: Array) -> void:
+	var models: PackedStringArray = WorkflowGraph.collect_models(nodes, exec_order)
+	if models.is_empty():
+		return
+	var tree: SceneTree = Engine.get_main_loop() as SceneTree
+	if tree == null or tree.root == null:
+		return
+	var llm: Node = tree.root.get_node_or_null("LocalLLMService")
+	if llm != null and llm.has_method("declare_upcoming_models"):
+		llm.declare_upcoming_models(models)
+
+
 ## Merge declared input defaults with caller-supplied inputs.
 func _merge_defaults(workflow: Dictionary, inputs: Dictionary) -> Dictionary:
 	var result: Dictionary = inputs.duplicate()
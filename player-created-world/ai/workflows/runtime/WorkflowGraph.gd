@@ -124,3 +124,27 @@ static func validate(workflow: Dictionary) -> PackedStringArray:
 						errors.append("Output '%s' references unknown node '%s'" % [str(key), parts[1]])
 
 	return errors
+
+
+## Collect the model names that llm.chat nodes request (via model.name),
+## following the given execution order and without duplicates.
+## Used to declare upcoming models so they can be preloaded ahead of time.
+static func collect_models(node_defs: Array, order: Array) -> PackedStringArray:
+	var models_by_node: Dictionary = {}  # node_id -> model name
+	for node_def_v: Variant in node_defs:
+		var node_def: Dictionary = node_def_v as Dictionary
+		if str(node_def.get("type", "")) != "llm.chat":
+			continue
+		var model_raw: Variant = node_def.get("model", {})
+		if not model_raw is Dictionary:
+			continue
+		var model_name: String = str((model_raw as Dictionary).get("name", ""))
+		if not model_name.is_empty():
+			models_by_node[str(node_def["id"])] = model_name
+
+	var models: PackedStringArray = []
+	for nid: Variant in order:
+		var model_name: String = str(models_by_node.get(str(nid), ""))
+		if not model_name.is_empty() and not models.has(model_name):
+			models.append(model_name)
+	return models
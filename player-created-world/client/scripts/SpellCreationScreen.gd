@@ -67,12 +67,27 @@ func show_screen(model_id: String) -> void:
 	input_field.grab_focus()
 	_update_status("Ready")
 	_set_camera_controls(false)
+	_prefill_description_prompt()
 
 
 func hide_screen() -> void:
 	_close_active_popup()
 	visible = false
 	_set_camera_controls(true)
+	if LocalLLMService.is_extension_available():
+		LocalLLMService.clear_speculative_requests()
+
+
+## While the player is still typing, let the idle model evaluate the
+## description system prompt so the first request only decodes the user text
+func _prefill_description_prompt() -> void:
+	if not LocalLLMService.is_extension_available() or not LocalLLMService.is_model_loaded():
+		return
+	LocalLLMService.register_speculative_request({
+		"prompt": "",
+		"system_prompt": _prompts.get("description", ""),
+		"mode": "prefill",
+	})
 
 
 func _on_close_pressed() -> void:
@@ -26,6 +26,8 @@ signal world_left(world_id: String)
 signal job_progress(job_id: String, stage: String, pct: int, message: String, extras: Dictionary)
 signal spell_active_update(spell_id: String, revision_id: String, channel: String, manifest: Dictionary)
 
+const PROTOCOL := preload("res://shared/scripts/protocol/Protocol.gd")
+
 const DEFAULT_CONTROL_PLANE := "http://127.0.0.1:5000"
 const PRODUCTION_CONTROL_PLANE := "https://ugc-world-backend.fly.dev"
 
@@ -57,6 +59,10 @@ var _http: HTTPRequest = null
 var _pending_request: String = ""
 var _last_gs_state: int = -1  # Track connection state for debug output
 
+## Server-hosted LLM generations: request_id -> RemoteLLMStream
+var _llm_streams: Dictionary = {}
+var _next_llm_request_id: int = 1
+
 
 func _ready() -> void:
 	_http = HTTPRequest.new()
@@ -93,6 +99,9 @@ func _process(_delta: float) -> void:
 		if state == State.HANDSHAKING or state == State.IN_WORLD:
 			while _gs_ws.get_available_packet_count() > 0:
 				var packet := _gs_ws.get_packet()
+				if not _gs_ws.was_string_packet():
+					_handle_ws_binary_message(packet)
+					continue
 				var text := packet.get_string_from_utf8()
 				# Only log non-snapshot messages
 				if not text.contains('"type":101'):
@@ -102,6 +111,7 @@ func _process(_delta: float) -> void:
 	elif gs_state == WebSocketPeer.STATE_CLOSED:
 		print("[Net] Game server disconnected (code: %d)" % _gs_ws.get_close_code())
 		_gs_ws = null
+		_fail_llm_streams("Disconnected from game server")
 		
 		if state == State.IN_WORLD or state == State.CONNECTING_GAME or state == State.HANDSHAKING:
 			state = State.IN_LOBBY if not session_token.is_empty() else State.DISCONNECTED
@@ -178,6 +188,7 @@ func leave_world() -> void:
 	if _gs_ws:
 		_gs_ws.close()
 		_gs_ws = null
+	_fail_llm_streams("Left world")
 	
 	world_id = ""
 	local_entity_id = 0
@@ -190,6 +201,7 @@ func disconnect_from_server() -> void:
 	if _gs_ws:
 		_gs_ws.close()
 		_gs_ws = null
+	_fail_llm_streams("Disconnected from game server")
 	
 	if _cp_ws:
 		_cp_ws.close()
@@ -224,6 +236,23 @@ func ping() -> void:
 	_send_to_game_server({"type": 5})  # Protocol.ClientMsg.PING
 
 
+func request_llm_generation(request: Dictionary) -> RemoteLLMStream:
+	"""Run a generation on the game server (for machines that cannot hold the model).
+	Takes the same request keys as LocalLLMService.generate_streaming()."""
+	var request_id := _next_llm_request_id
+	_next_llm_request_id += 1
+	var stream := RemoteLLMStream.new(request_id, self)
+	_llm_streams[request_id] = stream
+	_send_to_game_server(PROTOCOL.build_llm_generate_request(request_id, request))
+	return stream
+
+
+func cancel_llm_generation(request_id: int) -> void:
+	"""Cancel a server-hosted generation; the stream ends with a final frame."""
+	if _llm_streams.has(request_id):
+		_send_to_game_server(PROTOCOL.build_llm_cancel(request_id))
+
+
 # =============================================================================
 # Control Plane WebSocket (for spell updates, etc.)
 # =============================================================================
@@ -320,6 +349,23 @@ func _send_to_game_server(data: Dictionary) -> void:
 		print("[Net] Sent successfully")
 
 
+func _handle_ws_binary_message(packet: PackedByteArray) -> void:
+	"""Handle binary game server frames (currently only LLM token frames)."""
+	var frame := PROTOCOL.decode_token_frame(packet)
+	if frame.is_empty():
+		push_warning("[Net] Unknown binary frame (%d bytes)" % packet.size())
+		return
+	var stream: RemoteLLMStream = _llm_streams.get(frame.request_id)
+	if stream != null and stream._on_token_frame(frame):
+		_llm_streams.erase(frame.request_id)
+
+
+func _fail_llm_streams(reason: String) -> void:
+	for request_id in _llm_streams.keys():
+		_llm_streams[request_id]._fail(reason)
+	_llm_streams.clear()
+
+
 func _send_to_control_plane(data: Dictionary) -> void:
 	"""Send message to control plane WebSocket."""
 	if _cp_ws == null or _cp_ws.get_ready_state() != WebSocketPeer.STATE_OPEN:
@@ -367,6 +413,14 @@ func _handle_ws_message(text: String) -> void:
 		109:  # ERROR
 			push_warning("[Net] Server error: %s" % data.get("message", ""))
 		
+		113:  # LLM_STREAM_START
+			var request_id := int(data.get("request_id", 0))
+			var stream: RemoteLLMStream = _llm_streams.get(request_id)
+			if stream != null:
+				stream._on_stream_start(data)
+				if stream.get_status() == RemoteLLMStream.Status.ERROR:
+					_llm_streams.erase(request_id)
+		
 		# Control plane messages (string types)
 		"connected":
 			print("[Net] Control plane WebSocket connected")
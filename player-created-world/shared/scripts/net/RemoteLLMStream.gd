@@ -0,0 +1,172 @@
+extends RefCounted
+class_name RemoteLLMStream
+## Client side of a server-hosted LLM generation.
+## Mirrors the LLMGenerationHandle API (token/completed/error/cancelled
+## signals, status, full text) so UI code can treat local and remote
+## generations alike. The server sends token IDs only; they are decoded here
+## with a vocabulary-only load of the server's model
+## (LocalLLMService.get_tokenizer), so the server's model id must be in the
+## client's models.json.
+
+signal token(text: String)
+signal completed(full_text: String)
+signal error(message: String)
+signal cancelled()
+
+## Same values as LLMGenerationHandle.Status
+enum Status { PENDING, RUNNING, COMPLETED, CANCELLED, ERROR }
+
+var _request_id: int = 0
+var _net: Node = null
+var _model_id: String = ""
+var _vocab = null  # LLMTokenizer for the server's model
+var _status: Status = Status.PENDING
+var _token_ids := PackedInt32Array()
+var _text: String = ""
+var _utf8_carry := PackedByteArray()  # start of a character split across frames
+var _error_message: String = ""
+var _next_seq: int = 0
+var _start_usec: int = 0
+
+
+func _init(request_id: int, net: Node) -> void:
+	_request_id = request_id
+	_net = net
+	_start_usec = Time.get_ticks_usec()
+
+
+func get_id() -> int:
+	return _request_id
+
+
+func get_model_id() -> String:
+	return _model_id
+
+
+func get_status() -> Status:
+	return _status
+
+
+func get_full_text() -> String:
+	return _text
+
+
+func get_error_message() -> String:
+	return _error_message
+
+
+func get_tokens_generated() -> int:
+	return _token_ids.size()
+
+
+func get_token_ids() -> PackedInt32Array:
+	return _token_ids
+
+
+func get_elapsed_seconds() -> float:
+	return (Time.get_ticks_usec() - _start_usec) / 1000000.0
+
+
+func get_tokens_per_second() -> float:
+	var elapsed := get_elapsed_seconds()
+	return _token_ids.size() / elapsed if elapsed > 0.0 else 0.0
+
+
+func request_cancel() -> void:
+	if _status == Status.PENDING or _status == Status.RUNNING:
+		_net.cancel_llm_generation(_request_id)
+
+
+# =============================================================================
+# Called by Net
+# =============================================================================
+
+func _on_stream_start(data: Dictionary) -> void:
+	if not data.get("accepted", false):
+		_fail(data.get("error", "Request rejected"))
+		return
+
+	_model_id = data.get("model_id", "")
+	var service: Node = _net.get_node_or_null("/root/LocalLLMService")
+	if service != null:
+		_vocab = service.get_tokenizer(_model_id)
+	if _vocab == null:
+		# Without the vocabulary the IDs are meaningless; stop the server work
+		_net.cancel_llm_generation(_request_id)
+		_fail("No local vocabulary for model %s" % _model_id)
+		return
+	_status = Status.RUNNING
+
+
+## Returns true once the stream has finished (completed or failed)
+func _on_token_frame(frame: Dictionary) -> bool:
+	if _status != Status.RUNNING:
+		return _status != Status.PENDING
+
+	if int(frame.seq) != _next_seq:
+		_fail("Token frame %d arrived, expected %d" % [frame.seq, _next_seq])
+		return true
+	_next_seq += 1
+
+	var tokens: PackedInt32Array = frame.tokens
+	if not tokens.is_empty():
+		# A server running another model sends IDs this vocabulary lacks
+		if not _vocab.has_tokens(tokens):
+			_net.cancel_llm_generation(_request_id)
+			_fail("Token ID outside the vocabulary of %s" % _model_id)
+			return true
+		_token_ids.append_array(tokens)
+		# Decode only the new tokens; the bytes of a character that a later
+		# token completes wait in the carry
+		var bytes: PackedByteArray = _utf8_carry + _vocab.detokenize_bytes(tokens)
+		var complete := _complete_utf8_length(bytes)
+		_utf8_carry = bytes.slice(complete)
+		if complete > 0:
+			var delta := bytes.slice(0, complete).get_string_from_utf8()
+			_text += delta
+			token.emit(delta)
+
+	var flags: int = frame.flags
+	if flags & Protocol.LLM_FRAME_ERROR:
+		var message: String = frame.error
+		if message == "Cancelled":
+			_status = Status.CANCELLED
+			_error_message = message
+			cancelled.emit()
+		else:
+			_fail(message)
+		return true
+	if flags & Protocol.LLM_FRAME_FINAL:
+		if not _utf8_carry.is_empty():
+			# Truncated character at the very end
+			_text += _utf8_carry.get_string_from_utf8()
+			_utf8_carry = PackedByteArray()
+		_status = Status.COMPLETED
+		completed.emit(_text)
+		return true
+	return false
+
+
+## Length of the prefix of bytes that ends on a character boundary
+static func _complete_utf8_length(bytes: PackedByteArray) -> int:
+	var n := bytes.size()
+	# A lead byte at most three bytes back starts the last character
+	for back in range(1, mini(n, 4) + 1):
+		var b := bytes[n - back]
+		if (b & 0xC0) == 0x80:
+			continue  # continuation byte
+		var length := 1
+		if (b & 0xE0) == 0xC0:
+			length = 2
+		elif (b & 0xF0) == 0xE0:
+			length = 3
+		elif (b & 0xF8) == 0xF0:
+			length = 4
+		return n if back >= length else n - back
+	return n
+
+
+func _fail(message: String) -> void:
+	_status = Status.ERROR
+	_error_message = message
+	error.emit(message)
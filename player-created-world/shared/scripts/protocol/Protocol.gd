@@ -19,6 +19,8 @@ enum ClientMsg {
 	PING = 5,
 	DISCONNECT = 6,
 	SPELL_CAST_REQUEST = 7,
+	LLM_GENERATE_REQUEST = 8,
+	LLM_CANCEL = 9,
 }
 
 ## Message types - Server to Client
@@ -36,6 +38,8 @@ enum ServerMsg {
 	PLAYER_JOINED = 110,
 	PLAYER_LEFT = 111,
 	SPELL_CAST_EVENT = 112,
+	LLM_STREAM_START = 113,
+	LLM_TOKENS = 114,  ## Binary frame, see encode_token_frame()
 }
 
 ## Entity types
@@ -60,6 +64,10 @@ enum TerraformOp {
 	PAINT = 3,
 }
 
+## Flags carried by LLM token frames
+const LLM_FRAME_FINAL := 1  ## Last frame of the stream
+const LLM_FRAME_ERROR := 2  ## Stream failed; frame ends with a UTF-8 message
+
 # =============================================================================
 # Message Builders - Client to Server
 # =============================================================================
@@ -153,6 +161,22 @@ static func build_spell_cast_request(
 		"extra_params": extra_params,
 	}
 
+static func build_llm_generate_request(request_id: int, request: Dictionary) -> Dictionary:
+	"""Build server-hosted LLM generation request (same keys as LocalLLMService.generate)."""
+	return {
+		"type": ClientMsg.LLM_GENERATE_REQUEST,
+		"request_id": request_id,
+		"request": request,
+	}
+
+
+static func build_llm_cancel(request_id: int) -> Dictionary:
+	"""Build cancellation for a server-hosted LLM generation."""
+	return {
+		"type": ClientMsg.LLM_CANCEL,
+		"request_id": request_id,
+	}
+
 # =============================================================================
 # Message Builders - Server to Client
 # =============================================================================
@@ -337,6 +361,100 @@ static func build_spell_cast_event(
 		"extra_params": extra_params,
 	}
 
+
+static func build_llm_stream_start(request_id: int, accepted: bool, model_id: String = "", error: String = "") -> Dictionary:
+	"""Build acknowledgement for an LLM request; tokens follow as LLM_TOKENS frames."""
+	return {
+		"type": ServerMsg.LLM_STREAM_START,
+		"request_id": request_id,
+		"accepted": accepted,
+		"model_id": model_id,
+		"error": error,
+	}
+
+# =============================================================================
+# LLM Token Frames (binary)
+# =============================================================================
+# Layout: [u8 LLM_TOKENS][varint request_id][varint seq][u8 flags]
+#         [varint count][varint token_id * count][error UTF-8 if LLM_FRAME_ERROR]
+# Varints are unsigned LEB128, so most token IDs take 2-3 bytes.
+
+static func encode_token_frame(
+	request_id: int,
+	seq: int,
+	tokens: PackedInt32Array,
+	flags: int = 0,
+	error: String = ""
+) -> PackedByteArray:
+	"""Encode a batch of generated token IDs as a binary frame."""
+	var buf := PackedByteArray()
+	buf.append(ServerMsg.LLM_TOKENS)
+	_put_varint(buf, request_id)
+	_put_varint(buf, seq)
+	buf.append(flags & 0xFF)
+	_put_varint(buf, tokens.size())
+	for token in tokens:
+		_put_varint(buf, token)
+	if flags & LLM_FRAME_ERROR:
+		buf.append_array(error.to_utf8_buffer())
+	return buf
+
+
+static func decode_token_frame(data: PackedByteArray) -> Dictionary:
+	"""Decode a binary token frame. Returns {} if the frame is malformed."""
+	if data.is_empty() or data[0] != ServerMsg.LLM_TOKENS:
+		return {}
+	var cursor := [1]
+	var request_id := _get_varint(data, cursor)
+	var seq := _get_varint(data, cursor)
+	if request_id < 0 or seq < 0 or cursor[0] >= data.size():
+		return {}
+	var flags: int = data[cursor[0]]
+	cursor[0] += 1
+	var count := _get_varint(data, cursor)
+	if count < 0 or count > data.size():
+		return {}
+	var tokens := PackedInt32Array()
+	tokens.resize(count)
+	for i in count:
+		var token := _get_varint(data, cursor)
+		if token < 0:
+			return {}
+		tokens[i] = token
+	var error := ""
+	if flags & LLM_FRAME_ERROR:
+		error = data.slice(cursor[0]).get_string_from_utf8()
+	return {
+		"request_id": request_id,
+		"seq": seq,
+		"flags": flags,
+		"tokens": tokens,
+		"error": error,
+	}
+
+
+static func _put_varint(buf: PackedByteArray, value: int) -> void:
+	"""Append a non-negative integer as unsigned LEB128."""
+	var v := maxi(value, 0)
+	while v >= 0x80:
+		buf.append((v & 0x7F) | 0x80)
+		v >>= 7
+	buf.append(v)
+
+
+static func _get_varint(data: PackedByteArray, cursor: Array) -> int:
+	"""Read an unsigned LEB128 at cursor[0], advancing it. Returns -1 if truncated."""
+	var value := 0
+	var shift := 0
+	while cursor[0] < data.size() and shift < 63:
+		var byte: int = data[cursor[0]]
+		cursor[0] += 1
+		value |= (byte & 0x7F) << shift
+		if byte < 0x80:
+			return value
+		shift += 7
+	return -1
+
 # =============================================================================
 # Entity State Serialization
 # =============================================================================
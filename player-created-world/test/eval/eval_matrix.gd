@@ -0,0 +1,96 @@
+extends SceneTree
+## Quality-versus-throughput matrix for the local LLM (LLMEvalRunner).
+##
+## Runs a prompt suite across models, KV cache types, speculative modes and
+## concurrency levels, and prints pass rate, tokens/sec, TTFT and CPU-seconds
+## per configuration:
+##
+##   godot --headless --path player-created-world \
+##       --script res://test/eval/eval_matrix.gd -- --suite=res://path/to/suite.json
+##
+## Suite format:
+##   {
+##     "prompts": ["...", {"prompt": "...", "system_prompt": "...", "max_tokens": 512}],
+##     "matrix": {
+##       "models": ["qwen2.5-coder-14b", {"id": "local", "path": "/abs/model.gguf"}],
+##       "kv_types": ["f16", "q8_0"],
+##       "speculative": ["off", "prefill", "lookup"],
+##       "concurrency": [1, 2],
+##       "validator": "python3",
+##       "validator_args": ["tools/check.py", "{file}"]
+##     }
+##   }
+##
+## Model ids are resolved through models.json (extracted copies only).
+## Results are written to res://artifacts/eval/eval_matrix.{md,json}.
+
+const ModelRegistry := preload("res://addons/local_llm/scripts/ModelRegistry.gd")
+const ModelExtractor := preload("res://addons/local_llm/scripts/ModelExtractor.gd")
+const RESULTS_DIR := "res://artifacts/eval"
+
+
+func _initialize() -> void:
+	var suite_path := ""
+	for arg in OS.get_cmdline_user_args():
+		if arg.begins_with("--suite="):
+			suite_path = arg.substr("--suite=".length())
+	if suite_path.is_empty() or not FileAccess.file_exists(suite_path):
+		printerr("[eval_matrix] Pass --suite=<path to suite JSON>")
+		quit(2)
+		return
+	if not ClassDB.class_exists("LLMEvalRunner"):
+		printerr("[eval_matrix] LLM GDExtension not loaded")
+		quit(2)
+		return
+
+	var suite = JSON.parse_string(FileAccess.get_file_as_string(suite_path))
+	if not suite is Dictionary:
+		printerr("[eval_matrix] Invalid suite JSON: %s" % suite_path)
+		quit(2)
+		return
+
+	var matrix: Dictionary = suite.get("matrix", {}).duplicate(true)
+	matrix["models"] = _resolve_models(matrix.get("models", []))
+
+	var runner = ClassDB.instantiate("LLMEvalRunner")
+	runner.configuration_finished.connect(func(row: Dictionary):
+		print("[eval_matrix] %s / %s / %s / x%d: %s" % [
+			row.model, row.kv_type, row.speculative, row.concurrency,
+			row.get("error", "pass %.0f%%, %.1f tok/s" % [row.get("pass_rate", 0.0) * 100.0, row.get("tokens_per_second", 0.0)])
+		]))
+	if not runner.start(suite.get("prompts", []), matrix):
+		printerr("[eval_matrix] Nothing to run (no prompts or no models)")
+		quit(2)
+		return
+
+	var results: Array = await runner.finished
+	var table: String = runner.format_table()
+	print(table)
+
+	DirAccess.make_dir_recursive_absolute(ProjectSettings.globalize_path(RESULTS_DIR))
+	var md := FileAccess.open(RESULTS_DIR.path_join("eval_matrix.md"), FileAccess.WRITE)
+	if md:
+		md.store_string(table)
+	var json := FileAccess.open(RESULTS_DIR.path_join("eval_matrix.json"), FileAccess.WRITE)
+	if json:
+		json.store_string(JSON.stringify(results, "  "))
+	quit(0)
+
+
+## Registry ids become { id, path } entries; paths pass through unchanged
+func _resolve_models(models: Array) -> Array:
+	var registry := ModelRegistry.new()
+	registry.load_registry()
+	var extractor := ModelExtractor.new()
+	var resolved := []
+	for model in models:
+		if model is Dictionary or (model as String).is_absolute_path():
+			resolved.append(model)
+			continue
+		var info := registry.get_model(model)
+		var path := extractor.get_cached_path(info) if not info.is_empty() else ""
+		if path.is_empty():
+			push_warning("[eval_matrix] Model '%s' is not extracted; skipping" % model)
+			continue
+		resolved.append({"id": model, "path": path})
+	return resolved
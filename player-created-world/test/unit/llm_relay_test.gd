@@ -0,0 +1,168 @@
+extends GdUnitTestSuite
+## Queueing, flushing and cancellation of the server's LLMRelay, with a fake
+## provider in place of the local_llm extension.
+
+## The relay lives in the server project, next to this one
+const RELAY_PATH := "../server_godot/server/scripts/LLMRelay.gd"
+
+var _relay: Node = null
+var _messages: Array = []  # [client_id, Dictionary]
+var _frames: Array = []  # [client_id, decoded frame]
+
+
+class FakeHandle:
+	var status: int = 1  # RUNNING
+	var pending := PackedInt32Array()
+	var cancel_requested := false
+	var error_message := ""
+
+	func get_status() -> int:
+		return status
+
+	func take_token_ids() -> PackedInt32Array:
+		var ids := pending
+		pending = PackedInt32Array()
+		return ids
+
+	func request_cancel() -> void:
+		cancel_requested = true
+
+	func get_error_message() -> String:
+		return error_message
+
+
+class FakeProvider:
+	var requests: Array = []
+	var handles: Array = []
+
+	func generate(request: Dictionary) -> FakeHandle:
+		requests.append(request)
+		var handle := FakeHandle.new()
+		handles.append(handle)
+		return handle
+
+
+func before_each() -> void:
+	var path := ProjectSettings.globalize_path("res://").path_join(RELAY_PATH).simplify_path()
+	_relay = load(path).new()
+	_relay._provider = FakeProvider.new()
+	_relay._model_id = "test-model"
+	_messages = []
+	_frames = []
+	_relay._send_message = func(client_id: int, message: Dictionary) -> void:
+		_messages.append([client_id, message])
+	_relay._send_binary = func(client_id: int, frame: PackedByteArray) -> void:
+		_frames.append([client_id, Protocol.decode_token_frame(frame)])
+
+
+func after_each() -> void:
+	_relay.free()
+
+
+func _request(client_id: int, request_id: int, request: Dictionary = {"prompt": "hi"}) -> void:
+	_relay.handle_request(client_id, {"request_id": request_id, "request": request})
+
+
+func test_sanitize_drops_client_settings() -> void:
+	var clean: Dictionary = _relay.sanitize_request({
+		"prompt": "hi",
+		"max_tokens": 1000000.0,
+		"temperature": 0.2,
+		"context": "spells",
+		"prompt_tokens": PackedInt32Array([1, 2]),
+		"logits_processors": ["no_repeat"],
+		"cache": false,
+		"top_k": "40",
+		"stop_sequences": ["\n\n", 7],
+	})
+	assert_eq(_relay.max_tokens_per_request, clean["max_tokens"], "max_tokens should be clamped.")
+	assert_eq(0.2, clean["temperature"])
+	assert_eq("default", clean["context"], "Context is chosen by the server.")
+	assert_eq("tokens", clean["output"])
+	assert_false(clean.has("prompt_tokens"))
+	assert_false(clean.has("logits_processors"))
+	assert_false(clean.has("cache"))
+	assert_false(clean.has("top_k"), "Values of the wrong type should be dropped.")
+	assert_eq(PackedStringArray(["\n\n"]), clean["stop_sequences"])
+
+
+func test_rejects_empty_and_oversized_prompts() -> void:
+	_request(1, 1, {"prompt": ""})
+	_request(1, 2, {"prompt": "x".repeat(_relay.max_prompt_length + 1)})
+	_request(1, 3, {"prompt": 42})
+	assert_eq(3, _messages.size())
+	assert_eq("Empty prompt", _messages[0][1]["error"])
+	assert_eq("Prompt too long", _messages[1][1]["error"])
+	assert_eq("Empty prompt", _messages[2][1]["error"])
+	assert_eq(0, _relay._provider.requests.size())
+
+
+func test_runs_one_request_and_queues_the_rest() -> void:
+	_request(1, 10)
+	_request(2, 20)
+	assert_true(_messages[0][1]["accepted"])
+	assert_true(_messages[1][1]["accepted"])
+	assert_eq(1, _relay._provider.requests.size(), "Only one generation runs at a time.")
+	assert_eq(1, _relay.get_stats()["queued"])
+
+	_relay.max_queued_requests = 1
+	_request(3, 30)
+	assert_false(_messages[2][1]["accepted"])
+	assert_eq("Server busy", _messages[2][1]["error"])
+
+
+func test_flushes_tokens_per_interval_and_starts_next() -> void:
+	_relay.flush_interval_ticks = 3
+	_request(1, 10)
+	_request(2, 20)
+	var handle: FakeHandle = _relay._provider.handles[0]
+
+	handle.pending = PackedInt32Array([5, 6])
+	_relay.simulate_tick(1)
+	_relay.simulate_tick(2)
+	assert_eq(0, _frames.size(), "Tokens wait for the flush interval.")
+	_relay.simulate_tick(3)
+	assert_eq(1, _frames.size())
+	assert_eq(1, _frames[0][0])
+	assert_eq(PackedInt32Array([5, 6]), _frames[0][1]["tokens"])
+	assert_eq(0, _frames[0][1]["seq"])
+
+	# A finished generation flushes at once, then the queued one starts
+	handle.pending = PackedInt32Array([7])
+	handle.status = 2  # COMPLETED
+	_relay.simulate_tick(4)
+	assert_eq(2, _frames.size())
+	assert_eq(1, _frames[1][1]["seq"])
+	assert_eq(Protocol.LLM_FRAME_FINAL, _frames[1][1]["flags"])
+	assert_eq(2, _relay._provider.requests.size())
+
+
+func test_cancel_queued_and_active() -> void:
+	_request(1, 10)
+	_request(1, 11)
+	_relay.handle_cancel(1, {"request_id": 11})
+	assert_eq(1, _frames.size())
+	assert_eq(11, _frames[0][1]["request_id"])
+	assert_eq(Protocol.LLM_FRAME_FINAL | Protocol.LLM_FRAME_ERROR, _frames[0][1]["flags"])
+	assert_eq("Cancelled", _frames[0][1]["error"])
+	assert_eq(0, _relay.get_stats()["queued"])
+
+	_relay.handle_cancel(2, {"request_id": 10})
+	assert_false(_relay._provider.handles[0].cancel_requested, "Other clients cannot cancel the stream.")
+	_relay.handle_cancel(1, {"request_id": 10})
+	assert_true(_relay._provider.handles[0].cancel_requested)
+
+
+func test_drop_client_forgets_its_streams() -> void:
+	_request(1, 10)
+	_request(1, 11)
+	_request(2, 20)
+	_relay.drop_client(1)
+	var handle: FakeHandle = _relay._provider.handles[0]
+	assert_true(handle.cancel_requested)
+
+	handle.status = 3  # CANCELLED
+	_relay.simulate_tick(1)
+	assert_eq(0, _frames.size(), "Nothing is sent to a dropped client.")
+	assert_eq(2, _relay._provider.requests.size(), "The other client's request runs next.")
+	assert_eq("hi", _relay._provider.requests[1]["prompt"])
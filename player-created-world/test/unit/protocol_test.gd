@@ -29,3 +29,21 @@ func test_entity_state_roundtrip() -> void:
 	assert_eq(Protocol.EntityType.PLAYER, restored["entity_type"])
 	assert_true(restored["position"].is_equal_approx(Vector3(2, 3, 4)))
 	assert_eq("blue", restored["extra"]["team"])
+
+func test_token_frame_roundtrip() -> void:
+	var tokens := PackedInt32Array([0, 127, 128, 16383, 16384, 151935])
+	var frame := Protocol.encode_token_frame(300, 7, tokens, Protocol.LLM_FRAME_FINAL)
+	# type + request_id(2) + seq(1) + flags + count(1) + ids(1+1+2+2+3+3)
+	assert_eq(18, frame.size())
+	var decoded := Protocol.decode_token_frame(frame)
+	assert_eq(300, decoded["request_id"])
+	assert_eq(7, decoded["seq"])
+	assert_eq(Protocol.LLM_FRAME_FINAL, decoded["flags"])
+	assert_eq(tokens, decoded["tokens"])
+
+func test_token_frame_error_and_truncation() -> void:
+	var frame := Protocol.encode_token_frame(1, 0, PackedInt32Array(), Protocol.LLM_FRAME_ERROR, "Model unloaded")
+	assert_eq("Model unloaded", Protocol.decode_token_frame(frame)["error"])
+	var truncated := Protocol.encode_token_frame(1, 0, PackedInt32Array([50000]))
+	truncated.resize(truncated.size() - 1)
+	assert_true(Protocol.decode_token_frame(truncated).is_empty(), "Truncated frame should be rejected.")
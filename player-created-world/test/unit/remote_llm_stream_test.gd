@@ -0,0 +1,102 @@
+extends GdUnitTestSuite
+## Frame handling of RemoteLLMStream, with fakes for Net and the vocabulary.
+
+var _net: FakeNet = null
+var _stream: RemoteLLMStream = null
+var _events: Array = []
+
+
+class FakeNet:
+	extends Node
+	var cancelled_ids: Array = []
+
+	func cancel_llm_generation(request_id: int) -> void:
+		cancelled_ids.append(request_id)
+
+
+## Token i decodes to the i-th letter, 26 and 27 to the two bytes of "é";
+## higher IDs are unknown
+class FakeVocab:
+	func has_tokens(tokens: PackedInt32Array) -> bool:
+		for id in tokens:
+			if id < 0 or id >= 28:
+				return false
+		return true
+
+	func detokenize_bytes(tokens: PackedInt32Array) -> PackedByteArray:
+		var bytes := PackedByteArray()
+		for id in tokens:
+			if id == 26:
+				bytes.append(0xC3)
+			elif id == 27:
+				bytes.append(0xA9)
+			else:
+				bytes.append(97 + id)
+		return bytes
+
+
+func before_each() -> void:
+	_net = FakeNet.new()
+	_stream = RemoteLLMStream.new(7, _net)
+	_stream._model_id = "test-model"
+	_stream._vocab = FakeVocab.new()
+	_stream._status = RemoteLLMStream.Status.RUNNING
+	_events = []
+	_stream.token.connect(func(text: String) -> void: _events.append("token:" + text))
+	_stream.completed.connect(func(text: String) -> void: _events.append("completed:" + text))
+	_stream.error.connect(func(message: String) -> void: _events.append("error:" + message))
+	_stream.cancelled.connect(func() -> void: _events.append("cancelled"))
+
+
+func after_each() -> void:
+	_net.free()
+
+
+func _frame(seq: int, tokens: Array, flags: int = 0, error: String = "") -> Dictionary:
+	return {"seq": seq, "tokens": PackedInt32Array(tokens), "flags": flags, "error": error}
+
+
+func test_frames_in_order_complete() -> void:
+	assert_false(_stream._on_token_frame(_frame(0, [7, 8])))
+	assert_false(_stream._on_token_frame(_frame(1, [])))
+	assert_true(_stream._on_token_frame(_frame(2, [0], Protocol.LLM_FRAME_FINAL)))
+	assert_eq(["token:hi", "token:a", "completed:hia"], _events)
+	assert_eq(RemoteLLMStream.Status.COMPLETED, _stream.get_status())
+	assert_eq(3, _stream.get_tokens_generated())
+
+
+func test_character_split_across_frames() -> void:
+	assert_false(_stream._on_token_frame(_frame(0, [2, 0, 5, 26])))
+	assert_false(_stream._on_token_frame(_frame(1, [27])))
+	assert_true(_stream._on_token_frame(_frame(2, [], Protocol.LLM_FRAME_FINAL)))
+	assert_eq(["token:caf", "token:é", "completed:café"], _events)
+
+
+func test_out_of_order_frame_fails() -> void:
+	_stream._on_token_frame(_frame(0, [1]))
+	assert_true(_stream._on_token_frame(_frame(2, [2])))
+	assert_eq(RemoteLLMStream.Status.ERROR, _stream.get_status())
+	assert_eq("Token frame 2 arrived, expected 1", _stream.get_error_message())
+	# Frames after the stream ended are ignored
+	assert_true(_stream._on_token_frame(_frame(1, [2], Protocol.LLM_FRAME_FINAL)))
+	assert_eq(["token:b", "error:Token frame 2 arrived, expected 1"], _events)
+
+
+func test_unknown_token_id_fails_and_cancels() -> void:
+	assert_true(_stream._on_token_frame(_frame(0, [3, 151000])))
+	assert_eq(RemoteLLMStream.Status.ERROR, _stream.get_status())
+	assert_eq([7], _net.cancelled_ids, "The server should stop generating.")
+	assert_eq(0, _stream.get_tokens_generated(), "No IDs from the bad frame are kept.")
+
+
+func test_cancelled_frame_emits_cancelled() -> void:
+	_stream._on_token_frame(_frame(0, [2]))
+	assert_true(_stream._on_token_frame(_frame(1, [], Protocol.LLM_FRAME_FINAL | Protocol.LLM_FRAME_ERROR, "Cancelled")))
+	assert_eq(RemoteLLMStream.Status.CANCELLED, _stream.get_status())
+	assert_eq(["token:c", "cancelled"], _events)
+
+
+func test_server_error_frame_fails() -> void:
+	assert_true(_stream._on_token_frame(_frame(0, [], Protocol.LLM_FRAME_FINAL | Protocol.LLM_FRAME_ERROR, "Model unloaded")))
+	assert_eq(RemoteLLMStream.Status.ERROR, _stream.get_status())
+	assert_eq(["error:Model unloaded"], _events)
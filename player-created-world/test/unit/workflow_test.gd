@@ -186,6 +186,19 @@ func test_validate_unknown_node_type() -> void:
 	assert_bool(errors.size() > 0).is_true()
 
 
+func test_collect_models_follows_execution_order() -> void:
+	var nodes: Array = [
+		{"id": "b", "type": "llm.chat", "needs": ["a"], "model": {"name": "coder"}},
+		{"id": "a", "type": "llm.chat", "model": {"name": "phi"}},
+		{"id": "c", "type": "llm.chat", "needs": ["b"], "model": {"name": "phi"}},
+		{"id": "d", "type": "control.noop", "needs": ["c"], "model": {"name": "ignored"}},
+	]
+	var models: PackedStringArray = WorkflowGraph.collect_models(nodes, ["a", "b", "c", "d"])
+	assert_eq(models.size(), 2)
+	assert_eq(models[0], "phi")
+	assert_eq(models[1], "coder")
+
+
 # ============================================================================
 # WorkflowExecutor — noop + skip via when
 # ============================================================================
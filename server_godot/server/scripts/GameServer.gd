@@ -46,6 +46,13 @@ var _physics_world: Node3D = null
 var _chunk_manager: Node = null
 var _npc_manager: Node = null
 var _projectile_manager: Node = null
+var _llm_relay: Node = null
+
+## Optional server-hosted LLM (--llm-model). --llm-model-id is required with
+## it and must be the model's id in the clients' models.json
+var llm_model_path: String = ""
+var llm_model_id: String = ""
+var llm_context_length: int = 4096
 
 ## Entity registry reference
 @onready var entity_registry: Node = get_node("/root/EntityRegistry")
@@ -91,6 +98,18 @@ func _parse_arguments() -> void:
 				if i + 1 < args.size():
 					control_plane_url = args[i + 1]
 					i += 1
+			"--llm-model":
+				if i + 1 < args.size():
+					llm_model_path = args[i + 1]
+					i += 1
+			"--llm-model-id":
+				if i + 1 < args.size():
+					llm_model_id = args[i + 1]
+					i += 1
+			"--llm-context":
+				if i + 1 < args.size():
+					llm_context_length = int(args[i + 1])
+					i += 1
 		i += 1
 	
 	# Generate world ID if not provided
@@ -137,6 +156,14 @@ func _setup_simulation() -> void:
 	_projectile_manager.name = "ProjectileManager"
 	add_child(_projectile_manager)
 	
+	# Add LLM relay (requests are rejected unless --llm-model loads)
+	var relay_script := load("res://server/scripts/LLMRelay.gd") as GDScript
+	_llm_relay = relay_script.new()
+	_llm_relay.name = "LLMRelay"
+	add_child(_llm_relay)
+	if not llm_model_path.is_empty():
+		_llm_relay.setup(llm_model_path, llm_model_id, llm_context_length, _send_to_client, _send_binary_to_client)
+	
 	# Verify all managers are initialized
 	if _chunk_manager == null:
 		push_error("[GameServer] ChunkManager failed to initialize!")
@@ -149,6 +176,7 @@ func _setup_simulation() -> void:
 	print("[GameServer] ChunkManager: %s" % ("OK" if _chunk_manager != null else "FAILED"))
 	print("[GameServer] NPCManager: %s" % ("OK" if _npc_manager != null else "FAILED"))
 	print("[GameServer] ProjectileManager: %s" % ("OK" if _projectile_manager != null else "FAILED"))
+	print("[GameServer] LLMRelay: %s" % ("OK" if _llm_relay.is_available() else "DISABLED"))
 
 
 func _start_server() -> void:
@@ -375,6 +403,12 @@ func _handle_message(client_id: int, text: String) -> void:
 		Protocol.ClientMsg.SPELL_CAST_REQUEST:
 			if session.state == ClientSession.State.AUTHENTICATED:
 				_handle_spell_cast_request(client_id, data)
+		Protocol.ClientMsg.LLM_GENERATE_REQUEST:
+			if session.state == ClientSession.State.AUTHENTICATED:
+				_llm_relay.handle_request(client_id, data)
+		Protocol.ClientMsg.LLM_CANCEL:
+			if session.state == ClientSession.State.AUTHENTICATED:
+				_llm_relay.handle_cancel(client_id, data)
 		Protocol.ClientMsg.PING:
 			_handle_ping(client_id, data)
 		Protocol.ClientMsg.DISCONNECT:
@@ -526,6 +560,8 @@ func _on_client_disconnected(client_id: int) -> void:
 	
 	_clients.erase(client_id)
 	_input_buffers.erase(client_id)
+	if _llm_relay != null:
+		_llm_relay.drop_client(client_id)
 	
 	print("[GameServer] Client %d disconnected" % client_id)
 	client_disconnected.emit(client_id)
@@ -546,6 +582,10 @@ func _simulate_tick() -> void:
 	if _npc_manager != null:
 		_npc_manager.simulate_tick(server_tick, TICK_INTERVAL, entity_registry)
 	
+	# Stream generated LLM tokens
+	if _llm_relay != null:
+		_llm_relay.simulate_tick(server_tick)
+	
 	# Broadcast snapshots periodically
 	_ticks_since_snapshot += 1
 	if _ticks_since_snapshot >= SNAPSHOT_INTERVAL:
@@ -672,6 +712,19 @@ func _send_to_client(client_id: int, data: Dictionary) -> void:
 	_send_to_peer(session.peer_id, data)
 
 
+func _send_binary_to_client(client_id: int, data: PackedByteArray) -> void:
+	"""Send a binary frame to a specific client."""
+	var session: ClientSession = _clients.get(client_id)
+	if session == null or session.peer_id == 0:
+		return
+	
+	var ws_peer: WebSocketPeer = _ws_peers.get(session.peer_id)
+	if ws_peer == null or ws_peer.get_ready_state() != WebSocketPeer.STATE_OPEN:
+		return
+	
+	ws_peer.send(data, WebSocketPeer.WRITE_MODE_BINARY)
+
+
 func _broadcast_message(data: Dictionary, exclude_client: int = -1) -> void:
 	"""Broadcast message to all authenticated clients."""
 	for client_id in _clients.keys():
@@ -694,6 +747,7 @@ func get_server_state() -> Dictionary:
 		"server_tick": server_tick,
 		"client_count": _clients.size(),
 		"entity_count": entity_registry.get_entity_count(),
+		"llm": _llm_relay.get_stats() if _llm_relay != null and _llm_relay.is_available() else {},
 	}
 
 
@@ -760,6 +814,9 @@ func shutdown() -> void:
 	_clients.clear()
 	_peer_to_client.clear()
 	
+	if _llm_relay != null:
+		_llm_relay.shutdown()
+	
 	print("[GameServer] Shutdown complete")
 	get_tree().quit()
 
@@ -0,0 +1,270 @@
+extends Node
+## Server-hosted LLM generation for thin clients.
+## Runs a LlamaCppProvider (local_llm GDExtension) on the game server and
+## streams each generation back to the requesting client as binary frames of
+## varint token IDs (Protocol.encode_token_frame), batched per network tick.
+## Clients decode the IDs with a vocabulary-only load of the same model.
+##
+## Enable with: --llm-model <absolute path to .gguf> --llm-model-id <id>
+## The id is sent to clients, which look it up in their models.json to open
+## the vocabulary, so it must be the id of the same model there.
+##
+## Client requests are untrusted: only the keys in CLIENT_REQUEST_KEYS are
+## forwarded, max_tokens is clamped, and every generation runs on the
+## server's default context.
+
+## Status values of LLMGenerationHandle
+const STATUS_COMPLETED := 2
+const STATUS_CANCELLED := 3
+const STATUS_ERROR := 4
+
+## Request keys a client may set; everything else is dropped
+const CLIENT_REQUEST_KEYS := [
+	"prompt", "system_prompt", "max_tokens", "temperature", "top_p",
+	"top_k", "repeat_penalty", "stop_sequences", "seed",
+]
+
+## Server ticks between token frames (snapshot rate by default)
+@export var flush_interval_ticks: int = Protocol.TICKS_PER_SNAPSHOT
+
+## Waiting requests are rejected beyond this
+@export var max_queued_requests: int = 8
+
+## Upper bound on a client's max_tokens (also the default)
+@export var max_tokens_per_request: int = 512
+
+## Longest prompt plus system prompt accepted, in characters
+@export var max_prompt_length: int = 16384
+
+## Stop strings beyond this are ignored
+@export var max_stop_sequences: int = 8
+
+var _provider = null  # LlamaCppProvider - dynamically typed to handle missing extension
+var _model_id: String = ""
+
+## Callables supplied by GameServer: (client_id, Dictionary) and (client_id, PackedByteArray)
+var _send_message: Callable
+var _send_binary: Callable
+
+## Requests waiting for the provider (it runs one generation at a time)
+var _queue: Array[StreamState] = []
+var _active: StreamState = null
+var _ticks_since_flush: int = 0
+
+## Totals across all streams
+var _stats := {
+	"streams": 0,
+	"tokens": 0,
+	"frames": 0,
+	"bytes": 0,
+	"encode_usec": 0,
+}
+
+
+class StreamState:
+	var client_id: int = 0
+	var request_id: int = 0
+	var request: Dictionary = {}
+	var handle = null  # LLMGenerationHandle
+	var seq: int = 0
+	var tokens: int = 0
+	var bytes: int = 0
+	var encode_usec: int = 0
+
+
+func setup(
+	model_path: String,
+	model_id: String,
+	context_length: int,
+	send_message: Callable,
+	send_binary: Callable
+) -> bool:
+	"""Load the model. Returns false if the extension or model is unavailable."""
+	_send_message = send_message
+	_send_binary = send_binary
+
+	if model_id.is_empty():
+		push_error("[LLMRelay] --llm-model-id is required: the models.json id clients open the vocabulary with")
+		return false
+	if not ClassDB.class_exists("LlamaCppProvider"):
+		push_warning("[LLMRelay] local_llm extension not installed - LLM requests will be rejected")
+		return false
+
+	_provider = ClassDB.instantiate("LlamaCppProvider")
+	var n_threads: int = _provider.get_recommended_threads()
+	if not _provider.load_model(model_path, model_id, context_length, n_threads, 0):
+		push_error("[LLMRelay] Failed to load model: %s" % model_path)
+		_provider = null
+		return false
+
+	_model_id = model_id
+	print("[LLMRelay] Serving model %s (ctx=%d, threads=%d)" % [model_id, context_length, n_threads])
+	return true
+
+
+func is_available() -> bool:
+	return _provider != null
+
+
+func handle_request(client_id: int, data: Dictionary) -> void:
+	"""Queue an LLM_GENERATE_REQUEST from a client."""
+	var request_id := int(data.get("request_id", 0))
+	var request = data.get("request", {})
+
+	if not is_available():
+		_send_message.call(client_id, Protocol.build_llm_stream_start(request_id, false, "", "LLM not available on this server"))
+		return
+	request = sanitize_request(request) if request is Dictionary else {}
+	if String(request.get("prompt", "")).is_empty():
+		_send_message.call(client_id, Protocol.build_llm_stream_start(request_id, false, _model_id, "Empty prompt"))
+		return
+	if String(request.prompt).length() + String(request.get("system_prompt", "")).length() > max_prompt_length:
+		_send_message.call(client_id, Protocol.build_llm_stream_start(request_id, false, _model_id, "Prompt too long"))
+		return
+	if _queue.size() >= max_queued_requests:
+		_send_message.call(client_id, Protocol.build_llm_stream_start(request_id, false, _model_id, "Server busy"))
+		return
+
+	var stream := StreamState.new()
+	stream.client_id = client_id
+	stream.request_id = request_id
+	stream.request = request
+	_queue.append(stream)
+
+	# Acknowledge right away so the client can open its vocabulary while
+	# the request waits for the provider
+	_send_message.call(client_id, Protocol.build_llm_stream_start(request_id, true, _model_id))
+	_start_next()
+
+
+func handle_cancel(client_id: int, data: Dictionary) -> void:
+	"""Handle an LLM_CANCEL from a client."""
+	var request_id := int(data.get("request_id", 0))
+	if _active != null and _active.client_id == client_id and _active.request_id == request_id:
+		_active.handle.request_cancel()
+		return
+	for i in range(_queue.size()):
+		if _queue[i].client_id == client_id and _queue[i].request_id == request_id:
+			var stream: StreamState = _queue[i]
+			_queue.remove_at(i)
+			_send_frame(stream, PackedInt32Array(), Protocol.LLM_FRAME_FINAL | Protocol.LLM_FRAME_ERROR, "Cancelled")
+			return
+
+
+func drop_client(client_id: int) -> void:
+	"""Forget a disconnected client's streams."""
+	_queue = _queue.filter(func(s: StreamState) -> bool: return s.client_id != client_id)
+	if _active != null and _active.client_id == client_id:
+		_active.handle.request_cancel()
+		_active.client_id = 0  # Nothing more to send; flush() retires it
+
+
+func simulate_tick(_server_tick: int) -> void:
+	"""Send the tokens generated since the last flush."""
+	if _active == null:
+		return
+	_ticks_since_flush += 1
+	var status: int = _active.handle.get_status()
+	var finished := status >= STATUS_COMPLETED
+	if not finished and _ticks_since_flush < flush_interval_ticks:
+		return
+	_ticks_since_flush = 0
+
+	# Status is read first: once it is terminal, every token is already queued
+	var tokens: PackedInt32Array = _active.handle.take_token_ids()
+	if finished:
+		var flags := Protocol.LLM_FRAME_FINAL
+		var error := ""
+		if status == STATUS_ERROR or status == STATUS_CANCELLED:
+			flags |= Protocol.LLM_FRAME_ERROR
+			error = _active.handle.get_error_message()
+			if error.is_empty():
+				error = "Cancelled" if status == STATUS_CANCELLED else "Generation failed"
+		_send_frame(_active, tokens, flags, error)
+		_stats.streams += 1
+		_active = null
+		_start_next()
+	elif not tokens.is_empty():
+		_send_frame(_active, tokens, 0)
+
+
+func sanitize_request(request: Dictionary) -> Dictionary:
+	"""Keep the client-settable keys with the types the provider expects."""
+	# Values of the wrong type are dropped (JSON numbers arrive as floats)
+	var clean := {}
+	for key in CLIENT_REQUEST_KEYS:
+		if not request.has(key):
+			continue
+		var value = request[key]
+		match key:
+			"prompt", "system_prompt":
+				if value is String:
+					clean[key] = value
+			"stop_sequences":
+				if value is Array or value is PackedStringArray:
+					var stops := PackedStringArray()
+					for stop in value:
+						if stop is String and not stop.is_empty() and stops.size() < max_stop_sequences:
+							stops.append(stop)
+					clean[key] = stops
+			"max_tokens", "top_k", "seed":
+				if value is int or value is float:
+					clean[key] = int(value)
+			_:
+				if value is int or value is float:
+					clean[key] = float(value)
+
+	clean["max_tokens"] = clampi(clean.get("max_tokens", max_tokens_per_request), 1, max_tokens_per_request)
+
+	# Server-side settings, never taken from the client
+	clean["context"] = "default"
+	clean["output"] = "tokens"  # Clients detokenize; skip text on the server
+	return clean
+
+
+func get_stats() -> Dictionary:
+	"""Bandwidth and encode cost of the streams served so far."""
+	var stats := _stats.duplicate()
+	stats["bytes_per_token"] = float(_stats.bytes) / maxi(_stats.tokens, 1)
+	stats["encode_usec_per_stream"] = float(_stats.encode_usec) / maxi(_stats.streams, 1)
+	stats["queued"] = _queue.size()
+	stats["active"] = _active != null
+	return stats
+
+
+func shutdown() -> void:
+	_queue.clear()
+	if _active != null:
+		_active.handle.request_cancel()
+		_active = null
+	if _provider != null:
+		_provider.unload_model()
+		_provider = null
+
+
+func _start_next() -> void:
+	while _active == null and not _queue.is_empty():
+		var stream: StreamState = _queue.pop_front()
+		stream.handle = _provider.generate(stream.request)
+		if stream.handle == null:
+			_send_frame(stream, PackedInt32Array(), Protocol.LLM_FRAME_FINAL | Protocol.LLM_FRAME_ERROR, "Failed to start generation")
+			continue
+		_active = stream
+		_ticks_since_flush = 0
+
+
+func _send_frame(stream: StreamState, tokens: PackedInt32Array, flags: int, error: String = "") -> void:
+	if stream.client_id == 0:
+		return
+	var start := Time.get_ticks_usec()
+	var frame := Protocol.encode_token_frame(stream.request_id, stream.seq, tokens, flags, error)
+	var elapsed := Time.get_ticks_usec() - start
+	stream.seq += 1
+	stream.tokens += tokens.size()
+	stream.bytes += frame.size()
+	stream.encode_usec += elapsed
+	_stats.tokens += tokens.size()
+	_stats.frames += 1
+	_stats.bytes += frame.size()
+	_stats.encode_usec += elapsed
+	_send_binary.call(stream.client_id, frame)